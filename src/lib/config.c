@@ -20,6 +20,14 @@
 				07 Feb 2018 : Add memory support back.
 				14 Feb 2018 : Add default for vf config name.
 				13 Apr 2018 : Add cpu alarm threshold to the config.
+				16 Oct 2026 : Add request socket path (sock) to the parm file.
+				16 Oct 2026 : Add stats_interval.
+				16 Oct 2026 : Add enable_rates.
+				16 Oct 2026 : Add shm_stats.
+				16 Oct 2026 : Add metrics.
+				16 Oct 2026 : Add xstats.
+				16 Oct 2026 : VF configs are parsed with the jwrapper arena; vlan ids are exact integers.
+				16 Oct 2026 : enable_rates defaults to false.
 
 	TODO:		convert things to the new jw_xapi functions to make for easier to read code.
 */
@@ -189,6 +197,7 @@ extern parms_t* read_parms( char* fname ) {
 		parms->init_log_level = !jw_is_value( jblob, "init_log_level" ) ? 1 : (int) jw_value( jblob, "init_log_level" );
 		parms->log_keep = !jw_is_value( jblob, "log_keep" ) ? 30 : (int) jw_value( jblob, "log_keep" );
 		parms->delete_keep = !jw_is_bool( jblob, "delete_keep" ) ? 0 : (int) jw_value( jblob, "delete_keep" );
+		parms->stats_ivl = !jw_is_value( jblob, "stats_interval" ) ? 0 : (int) jw_value( jblob, "stats_interval" );		// ms; 0 == on demand
 
 		parms->cpu_alrm_thresh = 0.10;										// default to 10%
 		if( jw_is_value( jblob, "cpu_alarm" ) ) {							// we allow real float value e.g. 1.05 == 105%, or string
@@ -222,6 +231,12 @@ extern parms_t* read_parms( char* fname ) {
 			}
 		}
 
+		if( jw_is_bool( jblob, "enable_rates" ) ) {				// rate sampler is off by default
+			if( jw_value( jblob, "enable_rates" ) ) {
+				parms->rflags |= RF_ENABLE_RATES;
+			}
+		}
+
 		if( jw_is_bool( jblob, "enable_flowcontrol" ) ) {
 			if( jw_value( jblob, "enable_flowcontrol" ) ) {
 				parms->rflags |= RF_ENABLE_FC;
@@ -252,12 +267,45 @@ extern parms_t* read_parms( char* fname ) {
 			parms->stats_path = strdup( "/var/lib/vfd/stats" );
 		}
 
+		if(  (stuff = jw_string( jblob, "shm_stats" )) ) {			// "" turns off the shared memory segment
+			parms->shm_path = ltrim( stuff );
+		} else {
+			parms->shm_path = strdup( SHM_STATS_PATH );
+		}
+
+		if(  (stuff = jw_string( jblob, "metrics" )) ) {			// exporter is off unless an address is given
+			parms->metrics_addr = ltrim( stuff );
+		}
+
+		if( (parms->nxstats = jw_array_len( jblob, "xstats" )) > 0 ) {			// extended stats to show/export; patterns like "rx_q*_errors"
+			if( (parms->xstats = (char **) malloc( sizeof( *parms->xstats ) * parms->nxstats )) != NULL ) {
+				for( i = 0; i < parms->nxstats; i++ ) {
+					if( (stuff = jw_string_ele( jblob, "xstats", i )) != NULL ) {
+						parms->xstats[i] = ltrim( stuff );
+					} else {
+						parms->xstats[i] = NULL;
+					}
+				}
+			} else {
+				parms->nxstats = 0;
+			}
+		} else {
+			parms->nxstats = 0;							// len() might return -1
+		}
+
 		if(  (stuff = jw_string( jblob, "fifo" )) ) {
 			parms->fifo_path = ltrim( stuff );
 		} else {
 			parms->fifo_path = strdup( "/var/lib/vfd/request" );
 		}
 
+		if(  (stuff = jw_string( jblob, "sock" )) ) {
+			parms->sock_path = ltrim( stuff );
+		} else {
+			snprintf( sm_wrk, sizeof( sm_wrk ), "%s.sock", parms->fifo_path );		// default to living beside the fifo
+			parms->sock_path = strdup( sm_wrk );
+		}
+
 		if(  (stuff = jw_string( jblob, "log_dir" )) ) {
 			parms->log_dir = ltrim( stuff );
 		} else {
@@ -422,11 +470,18 @@ extern void free_parms( parms_t* parms ) {
 
 	SFREE( parms->log_dir );
 	SFREE( parms->fifo_path );
+	SFREE( parms->sock_path );
 	SFREE( parms->config_dir );
 	SFREE( parms->pciids );
 	SFREE( parms->pid_fname );
 	SFREE( parms->stats_path );
+	SFREE( parms->shm_path );
+	SFREE( parms->metrics_addr );
 	SFREE( parms->numa_mem );
+	for( i = 0; i < parms->nxstats; i++ ) {
+		SFREE( parms->xstats[i] );
+	}
+	SFREE( parms->xstats );
 
 	free( parms );
 }
@@ -448,6 +503,7 @@ extern vf_config_t*	read_config( char* fname ) {
 	uid_t		uid;
 	int			jnqueues;		// number of queue definitions in the json
 	void*		qobj;			// pointer to the queue object in the json
+	char		abuf[JW_ARENA_SIZE] __attribute__ ((aligned (8)));	// parse arena; an oversized config is allocated
 
 	if( (buf = file_into_buf( fname, &uid )) == NULL ) {
 		return NULL;
@@ -458,7 +514,7 @@ extern vf_config_t*	read_config( char* fname ) {
 		return NULL;
 	}
 
-	if( (jblob = jw_new( buf )) != NULL ) {						// json successfully parsed
+	if( (jblob = jw_new_arena( buf, abuf, sizeof( abuf ) )) != NULL ) {		// json successfully parsed
 		if( (vfc = (vf_config_t *) malloc( sizeof( *vfc ) )) == NULL ) {
 			errno = ENOMEM;
 			return NULL;
@@ -518,7 +574,7 @@ extern vf_config_t*	read_config( char* fname ) {
 			if( vfc->vlans != NULL ) {
 				for( i = 0; i < vfc->nvlans; i++ ) {
 					if( jw_is_value_ele( jblob, "vlans", i ) ) {
-						vfc->vlans[i] = (int) jw_value_ele( jblob, "vlans", i );
+						vfc->vlans[i] = (int) jw_ivalue_ele( jblob, "vlans", i );
 					} else {
 						vfc->vlans[i] = -1;												// vfd should toss this out
 					}
@@ -127,6 +127,22 @@ extern void rfifo_detect_close( void* vfifo ) {
 	fifo->close_on_data = 1;
 }
 
+/*
+	Return the file descriptor of the read side of the fifo so that the caller
+	can include it in a poll/epoll set. The fd is open non-blocking and remains
+	owned by the fifo; the caller must not close it or read from it directly.
+	Returns -1 if the handle is bad.
+*/
+extern int rfifo_fd( void* vfifo ) {
+	fifo_t*	fifo;
+
+	if( (fifo = (fifo_t *) vfifo ) == NULL ) {
+		return -1;
+	}
+
+	return fifo->fd;
+}
+
 /*
 	Close the fifo and clean up the flow. Ultimately unlink the fifo.
 */
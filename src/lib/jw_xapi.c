@@ -5,7 +5,7 @@
 	Author:		E. Scott Daniels
 	Date:		11 Feb 2017
 
-	Mods:
+	Mods:		16 Oct 2026 : Use the exact integer value for ivalue and int/hex formats.
 */
 
 #include <stdio.h>
@@ -47,7 +47,7 @@ extern int jwx_get_ivalue( void* jblob, char const* field_name, int def_value )
 		return def_value;
 	}
 	
-	return (int) jw_value( jblob, field_name );
+	return (int) jw_ivalue( jblob, field_name );
 }
 
 /*
@@ -67,13 +67,13 @@ extern char* jwx_get_value_as_str( void* jblob, char const* field_name, char con
 		jvalue = jw_value( jblob, field_name );
 		switch( fmt ) {
 			case JWFMT_INT:
-				snprintf( stuff, sizeof( stuff ), "%d", (int) jvalue );
+				snprintf( stuff, sizeof( stuff ), "%lld", jw_ivalue( jblob, field_name ) );
 				break;
 			case JWFMT_FLOAT:
 				snprintf( stuff, sizeof( stuff ), "%f", jvalue );
 
 			case JWFMT_HEX:
-				snprintf( stuff, sizeof( stuff ), "0x%x", (int) jvalue );
+				snprintf( stuff, sizeof( stuff ), "0x%llx", (unsigned long long) jw_ivalue( jblob, field_name ) );
 		}
 		return strdup( stuff );
 	}
@@ -11,10 +11,14 @@
 				13 Jun 2016 : Added more granularity to sussing out primative types
 								allowing the caller to determine whether the primative 
 								is a bool, value, or null.
+				16 Oct 2026 : Added the arena parse mode (jw_new_arena()) and exact
+								integer values (jw_ivalue()).
+				16 Oct 2026 : Symtabs now grow, so start them small.
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <jsmn.h>
 
@@ -23,20 +27,26 @@
 
 #define JSON_SYM_NAME	"_jw_json_string"
 #define MAX_THINGS		1024		// max objects/elements
+#define ST_SIZE			64			// initial symtab size; symtabs grow as needed
 
 #define PT_UNKNOWN		0			// primative types; unk for non prim
 #define PT_VALUE		1
 #define PT_BOOL			2
 #define PT_NULL			3
 
+#define JW_ARENA_MAGIC	0x4a57a5e1	// first word of an arena handle; odd so it can't be the first word (a pointer) of a symtab
+#define JW_MAX_DEPTH	128			// nesting deeper than this is rejected in arena mode
+#define JW_ALIGN(n)		(((n) + 7) & ~((size_t) 7))
+
+#define IS_ARENA(st)	(*((uint32_t *) (st)) == JW_ARENA_MAGIC)
+
 extern void jw_nuke( void* st );
 
 // ---------------------------------------------------------------------------------------
 
 /*
-	This is what we will manage in the symtab. Right now we store all values (primatives)
-	as float, but we could be smarter about it and look for a decimal. Unsigned and 
-	differences between long, long long etc are tough.
+	This is what we will manage in the symtab. Values (primatives) are stored as float
+	for the float interface, and as a long long (iv) so that integers are exact.
 */
 typedef struct jthing {
 	int jsmn_type;				// propigated type from jsmn (jsmn constants)
@@ -46,8 +56,39 @@ typedef struct jthing {
 		float fv;
 		void *pv;
 	} v;
+	long long iv;				// integer value of a primative
 } jthing_t;
 
+/*
+	Arena mode. The json is copied into a single block along with the jsmn tokens and
+	a small index, and lookups walk the tokens in place: no symtab, no per element
+	allocation and nothing is duplicated. If the caller supplies a large enough buffer
+	the parse does not allocate at all; otherwise the arena is one malloc.
+
+	The handle given out is a view: the token of an object within the arena. The root
+	object's view is the one returned by jw_new_arena(); jw_blob() and jw_obj_ele() return
+	views of nested objects, which live as long as the root.
+*/
+typedef struct jw_arena jw_arena_t;
+
+typedef struct jw_view {
+	uint32_t	magic;			// JW_ARENA_MAGIC; must be first
+	int			tok;			// the object's token
+	jw_arena_t*	arena;
+} jw_view_t;
+
+struct jw_arena {
+	int			allocated;		// we malloc'd it and must free on nuke
+	int			ntoks;
+	char*		json;			// copy of the json; each string/primative is nil terminated in place
+	jsmntok_t*	toks;
+	int*		next;			// index of the token following the subtree rooted at the token
+	int*		vix;			// index in views for object tokens, -1 for others
+	jw_view_t*	views;			// views[0] is the root object
+	int			nviews;
+	int			maxviews;
+};
+
 
 /*
 	Given the json token, 'extract' the element by marking the end with a
@@ -60,6 +101,56 @@ static char* extract( char* buf, jsmntok_t *jtoken ) {
 	return &buf[jtoken->start];
 }
 
+/*
+	Convert the primative string to an integer; a value with a fraction or exponent
+	is converted through double so that 1e3 is 1000 and not 1.
+*/
+static long long jw_atoll( const char* data ) {
+	if( strpbrk( data, ".eE" ) != NULL ) {
+		return (long long) strtod( data, NULL );
+	}
+
+	return strtoll( data, NULL, 10 );
+}
+
+/*
+	Set the primative type and value in the thing from the primative's string.
+	We assume T|t is true, F|f is false, and N|n is null or some form of that.
+*/
+static void set_prim( jthing_t* jtp, const char* data ) {
+	jtp->iv = 0;
+	jtp->v.fv = 0;
+
+	switch( *data ) {
+		case 0:
+			jtp->prim_type = PT_VALUE;
+			break;
+
+		case 'T':
+		case 't':
+			jtp->prim_type = PT_BOOL;
+			jtp->v.fv = 1;
+			jtp->iv = 1;
+			break;
+
+		case 'F':
+		case 'f':
+			jtp->prim_type = PT_BOOL;
+			break;
+
+		case 'N':
+		case 'n':
+			jtp->prim_type = PT_NULL;
+			break;
+
+		default:
+			jtp->prim_type = PT_VALUE;
+			jtp->v.fv = strtof( data, NULL );
+			jtp->iv = jw_atoll( data );
+			break;
+	}
+}
+
 /*
 	create a new jthing and add a reference to it in the symbol table st.
 	sets the number of elements to 1 by default.
@@ -80,6 +171,7 @@ static jthing_t *mk_thing( void *st, char *name, int jsmn_type ) {
 	jtp->prim_type = PT_UNKNOWN;			// caller must set this
 	jtp->nele = 1;
 	jtp->v.fv = 0;
+	jtp->iv = 0;
 
 	sym_fmap( st, (unsigned char *) name, 0, jtp );
 	return jtp;
@@ -239,7 +331,7 @@ void* parse_jobject( void* st, char *json, char* prefix ) {
 					sym_free( st );
 					return NULL;
 				}
-				jtp->v.pv = (void *) sym_alloc( 255 );						// object is just a blob
+				jtp->v.pv = (void *) sym_alloc( ST_SIZE );						// object is just a blob
 				if( jtp->v.pv == NULL ) {
 					fprintf( stderr, "error: [%d] symtab for object blob could not be allocated\n", i );
 					sym_free( st );
@@ -283,7 +375,7 @@ void* parse_jobject( void* st, char *json, char* prefix ) {
 							break;
 
 						case JSMN_OBJECT:
-							jarray[n].v.pv = (void *) sym_alloc( 255 );
+							jarray[n].v.pv = (void *) sym_alloc( ST_SIZE );
 							if( jarray[n].v.pv == NULL ) {
 								fprintf( stderr, "error: [%d] array element %d size=%d could not allocate symtab\n", i, n, jtokens[i+n].size );
 								sym_free( st );
@@ -314,36 +406,7 @@ void* parse_jobject( void* st, char *json, char* prefix ) {
 
 						case JSMN_PRIMITIVE:
 							data = extract( json, &jtokens[i+n] );
-							switch( *data ) {
-								case 0:
-									jarray[n].prim_type	 = PT_VALUE;
-									jarray[n].v.fv = 0;
-									break;
-
-								case 'T':
-								case 't':
-									jarray[n].v.fv = 1;
-									jarray[n].prim_type	 = PT_BOOL;
-									break;
-
-								case 'F':
-								case 'f':
-									jarray[n].prim_type	 = PT_BOOL;
-									jarray[n].v.fv = 0;
-									break;
-
-								case 'N':										// assume null, nil, or some variant
-								case 'n':
-									jarray[n].prim_type	 = PT_NULL;
-									jarray[n].v.fv = 0;
-									break;
-
-								default:
-									jarray[n].prim_type	 = PT_VALUE;
-									jarray[n].v.fv = strtof( data, NULL ); 		// store all numerics as float
-									break;
-							}
-
+							set_prim( &jarray[n], data );
 							jarray[n].jsmn_type = JSMN_PRIMITIVE;
 							break;
 						
@@ -377,35 +440,7 @@ void* parse_jobject( void* st, char *json, char* prefix ) {
 					sym_free( st );
 					return NULL;
 				}
-				switch( *data ) {								// assume T|t is true and F|f is false
-					case 0:
-						jtp->v.fv = 0;
-						jtp->prim_type = PT_VALUE;
-						break;
-
-					case 'T':
-					case 't':
-						jtp->prim_type = PT_BOOL;
-						jtp->v.fv = 1; 
-						break;
-
-					case 'F':
-					case 'f':
-						jtp->prim_type = PT_BOOL;
-						jtp->v.fv = 0; 
-						break;
-
-					case 'N':									// Null or some form of that
-					case 'n':
-						jtp->prim_type = PT_NULL;
-						jtp->v.fv = 0; 
-						break;
-
-					default:
-						jtp->prim_type = PT_VALUE;
-						jtp->v.fv = strtof( data, NULL ); 		// store all numerics as float
-						break;
-				}
+				set_prim( jtp, data );
 				break;
 
 			default:
@@ -418,17 +453,241 @@ void* parse_jobject( void* st, char *json, char* prefix ) {
 	return st;
 }
 
+// --------------- arena mode ------------------------------------------------------------------------
+
+/*
+	Build the next[] and vix[] indexes for the tokens in the arena. The subtree of a token
+	is every token following it that starts before it ends, so next[] is computed with a
+	stack rather than relying on jsmn's size counts. Each object token is given a view.
+	String and primative tokens are nil terminated in place. Returns 0 if the json is
+	nested too deeply.
+*/
+static int ja_index( jw_arena_t* a ) {
+	int		stack[JW_MAX_DEPTH];
+	int		sp = 0;
+	int		t;
+	jsmntok_t*	tok;
+
+	for( t = 0; t < a->ntoks; t++ ) {
+		tok = &a->toks[t];
+		while( sp > 0 && a->toks[stack[sp-1]].end <= tok->start ) {
+			sp--;
+			a->next[stack[sp]] = t;
+		}
+
+		a->vix[t] = -1;
+		switch( tok->type ) {
+			case JSMN_OBJECT:
+				if( a->nviews >= a->maxviews ) {
+					return 0;
+				}
+				a->views[a->nviews].magic = JW_ARENA_MAGIC;
+				a->views[a->nviews].tok = t;
+				a->views[a->nviews].arena = a;
+				a->vix[t] = a->nviews++;
+				// fall through
+			case JSMN_ARRAY:
+				if( sp >= JW_MAX_DEPTH ) {
+					return 0;
+				}
+				stack[sp++] = t;
+				break;
+
+			default:
+				a->next[t] = t + 1;
+				break;
+		}
+	}
+
+	while( sp > 0 ) {
+		sp--;
+		a->next[stack[sp]] = a->ntoks;
+	}
+
+	for( t = 0; t < a->ntoks; t++ ) {				// done with positions; safe to terminate in place
+		if( a->toks[t].type == JSMN_STRING || a->toks[t].type == JSMN_PRIMITIVE ) {
+			a->json[a->toks[t].end] = 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+	Find the named member in the object at token obj and return the token of its value
+	or -1. The name may be dotted (a.b.c) to reference a member of a nested object; a key
+	which itself contains a dot is matched first. As with the symtab, when a key is
+	duplicated the last one wins.
+*/
+static int ja_member( jw_arena_t* a, int obj, const char* name ) {
+	int		k;
+	int		end;
+	int		klen;
+	int		found = -1;
+	int		nested;
+	char*	key;
+
+	if( obj < 0 || a->toks[obj].type != JSMN_OBJECT ) {
+		return -1;
+	}
+
+	end = a->next[obj];
+	for( k = obj + 1; k < end - 1; k = a->next[k+1] ) {		// k is the key, k+1 its value
+		key = a->json + a->toks[k].start;
+		klen = a->toks[k].end - a->toks[k].start;
+		if( strncmp( key, name, klen ) != 0 ) {
+			continue;
+		}
+
+		if( name[klen] == 0 ) {
+			found = k + 1;
+		} else {
+			if( name[klen] == '.' && (nested = ja_member( a, k + 1, name + klen + 1 )) >= 0 ) {
+				found = nested;
+			}
+		}
+	}
+
+	return found;
+}
+
+/*
+	Return the token of the idx'th element of the array at token arr, or -1. When the
+	array holds only strings and primatives the element is indexed directly.
+*/
+static int ja_element( jw_arena_t* a, int arr, int idx ) {
+	int		t;
+	int		end;
+
+	if( arr < 0 || a->toks[arr].type != JSMN_ARRAY || idx < 0 || idx >= a->toks[arr].size ) {
+		return -1;
+	}
+
+	end = a->next[arr];
+	if( end == arr + 1 + a->toks[arr].size ) {
+		return arr + 1 + idx;
+	}
+
+	for( t = arr + 1; t < end && idx > 0; t = a->next[t] ) {
+		idx--;
+	}
+
+	return t < end ? t : -1;
+}
+
+/*
+	Fill in a thing for the token so that the public functions can treat both modes alike.
+*/
+static void ja_thing( jw_arena_t* a, int t, jthing_t* jtp ) {
+	jtp->jsmn_type = a->toks[t].type;
+	jtp->prim_type = PT_UNKNOWN;
+	jtp->nele = 1;
+	jtp->v.pv = NULL;
+	jtp->iv = 0;
+
+	switch( jtp->jsmn_type ) {
+		case JSMN_STRING:
+			jtp->v.pv = a->json + a->toks[t].start;
+			break;
+
+		case JSMN_PRIMITIVE:
+			set_prim( jtp, a->json + a->toks[t].start );
+			break;
+
+		case JSMN_OBJECT:
+			jtp->v.pv = &a->views[a->vix[t]];
+			break;
+
+		case JSMN_ARRAY:
+			jtp->nele = a->toks[t].size;
+			break;
+	}
+}
+
+/*
+	Look up name in either a symtab or an arena view and fill in the thing. Returns 0
+	if the name isn't there.
+*/
+static int jw_lookup( void* st, const char* name, jthing_t* jtp ) {
+	jw_view_t*	v;
+	jthing_t*	sjtp;
+	int			t;
+
+	if( st == NULL || name == NULL ) {
+		return 0;
+	}
+
+	if( IS_ARENA( st ) ) {
+		v = (jw_view_t *) st;
+		if( (t = ja_member( v->arena, v->tok, name )) < 0 ) {
+			return 0;
+		}
+
+		ja_thing( v->arena, t, jtp );
+		return 1;
+	}
+
+	if( (sjtp = (jthing_t *) sym_get( st, name, 0 )) == NULL ) {
+		return 0;
+	}
+
+	*jtp = *sjtp;
+	return 1;
+}
+
+/*
+	Look up the idx'th element of the named array and fill in the thing. Returns 0 if
+	name isn't an array or idx is out of range.
+*/
+static int jw_lookup_ele( void* st, const char* name, int idx, jthing_t* jtp ) {
+	jw_view_t*	v;
+	jthing_t*	sjtp;
+	int			t;
+
+	if( st == NULL || name == NULL ) {
+		return 0;
+	}
+
+	if( IS_ARENA( st ) ) {
+		v = (jw_view_t *) st;
+		if( (t = ja_element( v->arena, ja_member( v->arena, v->tok, name ), idx )) < 0 ) {
+			return 0;
+		}
+
+		ja_thing( v->arena, t, jtp );
+		return 1;
+	}
+
+	if( (sjtp = suss_element( st, name, idx )) == NULL ) {
+		return 0;
+	}
+
+	*jtp = *sjtp;
+	return 1;
+}
+
 // --------------- public functions -----------------------------------------------------------------
 
 /*
 	Destroy all operating structures assocaited with the symtab pointer passed in.
+	For an arena, only the root view releases anything and then only if the arena
+	was not built in a caller supplied buffer.
 */
 extern void jw_nuke( void* st ) {
-	char* 	buf;					// pointer to the original json to free
+	jw_view_t*	v;
+
 	if( st == NULL ) {
 		return;
 	}
 
+	if( IS_ARENA( st ) ) {
+		v = (jw_view_t *) st;
+		if( v == &v->arena->views[0] && v->arena->allocated ) {
+			free( v->arena );
+		}
+		return;
+	}
+
 	sym_foreach_class( st, 0, nix_things, NULL );			// free anything that the symtab references
 	sym_free( st );											// free the symtab itself
 }
@@ -445,7 +704,7 @@ extern void jw_nuke( void* st ) {
 extern void* jw_new( char* json ) {
 	void	*st;				// symbol table
 
-	st = sym_alloc( MAX_THINGS );
+	st = sym_alloc( ST_SIZE );
 	if( st == NULL ) {
 		return NULL;
 	}
@@ -456,144 +715,201 @@ extern void* jw_new( char* json ) {
 	return parse_jobject( st,  json, "" );								// empty prefix for the root object
 }
 
+/*
+	Parse the json into an arena and return a handle which can be passed to all of the
+	other jw_ functions. The arena holds a copy of the json, so the caller may reuse
+	their buffer. Strings returned point into the arena and are valid until jw_nuke()
+	is called with the handle.
+
+	If buf is not nil, and is large enough (and 8 byte aligned), the arena is built in it
+	and nothing is allocated; jw_nuke() must still be called before buf is reused, but
+	frees nothing. Otherwise the arena is allocated as a single block.
+
+	Returns nil if the json is not an object, or cannot be parsed.
+*/
+extern void* jw_new_arena( char* json, void* buf, int blen ) {
+	jsmn_parser	jp;
+	jw_arena_t*	a;
+	int		len;
+	int		ntoks;
+	int		nobj = 0;
+	size_t	need;
+	char*	cp;
+
+	if( json == NULL ) {
+		return NULL;
+	}
+
+	len = strlen( json );
+	jsmn_init( &jp );
+	if( (ntoks = jsmn_parse( &jp, json, len, NULL, 0 )) <= 0 ) {		// counting pass, no tokens
+		return NULL;
+	}
+
+	for( cp = json; (cp = strchr( cp, '{' )) != NULL; cp++ ) {			// upper bound on the views needed
+		nobj++;
+	}
+
+	need = JW_ALIGN( sizeof( *a ) ) +
+		JW_ALIGN( sizeof( jw_view_t ) * nobj ) +
+		JW_ALIGN( sizeof( jsmntok_t ) * ntoks ) +
+		JW_ALIGN( sizeof( int ) * ntoks ) * 2 +
+		len + 1;
+
+	if( buf != NULL && (size_t) blen >= need && ((uintptr_t) buf & 7) == 0 ) {
+		a = (jw_arena_t *) buf;
+		a->allocated = 0;
+	} else {
+		if( (a = (jw_arena_t *) malloc( need )) == NULL ) {
+			return NULL;
+		}
+		a->allocated = 1;
+	}
+
+	cp = (char *) a + JW_ALIGN( sizeof( *a ) );
+	a->views = (jw_view_t *) cp;
+	cp += JW_ALIGN( sizeof( jw_view_t ) * nobj );
+	a->toks = (jsmntok_t *) cp;
+	cp += JW_ALIGN( sizeof( jsmntok_t ) * ntoks );
+	a->next = (int *) cp;
+	cp += JW_ALIGN( sizeof( int ) * ntoks );
+	a->vix = (int *) cp;
+	cp += JW_ALIGN( sizeof( int ) * ntoks );
+	a->json = cp;
+	memcpy( a->json, json, len + 1 );
+
+	a->nviews = 0;
+	a->maxviews = nobj;
+	jsmn_init( &jp );
+	a->ntoks = jsmn_parse( &jp, a->json, len, a->toks, ntoks );
+
+	if( a->ntoks <= 0 || a->toks[0].type != JSMN_OBJECT ) {
+		fprintf( stderr, "warn: badly formed json; initial opening bracket ({) not detected\n" );
+		if( a->allocated ) {
+			free( a );
+		}
+		return NULL;
+	}
+
+	if( ! ja_index( a ) ) {
+		fprintf( stderr, "warn: json is nested too deeply (max %d)\n", JW_MAX_DEPTH );
+		if( a->allocated ) {
+			free( a );
+		}
+		return NULL;
+	}
+
+	return &a->views[0];
+}
+
 /*
 	Returns true (1) if the named field is missing. 
 */
 extern int jw_missing( void* st, const char* name ) {
-	return sym_get( st, name, 0 ) == NULL;
+	jthing_t	jt;
+
+	return ! jw_lookup( st, name, &jt );
 }
 
 /*
 	Returns true (1) if the named field is in the blob;
 */
 extern int jw_exists( void* st, const char* name ) {
-	return sym_get( st, name, 0 ) != NULL;
+	jthing_t	jt;
+
+	return jw_lookup( st, name, &jt );
 }
 
 /*
 	Returns true (1) if the primative type is value (float).
 */
 extern int jw_is_value( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
-
-	if( st == NULL ) {
-		return 0;
-	}
+	jthing_t	jt;
 
-	jtp = (jthing_t *) sym_get( st, name, 0 );		// get it or NULL
-
-	if( ! jtp ) {
+	if( ! jw_lookup( st, name, &jt ) ) {
 		return 0;
 	}
 
-	return jtp->prim_type == PT_VALUE;
+	return jt.prim_type == PT_VALUE;
 }
 
 /*
 	Returns true (1) if the primative type is boolean.
 */
 extern int jw_is_bool( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
+	jthing_t	jt;
 
-	if( st == NULL ) {
+	if( ! jw_lookup( st, name, &jt ) ) {
 		return 0;
 	}
 
-	jtp = (jthing_t *) sym_get( st, name, 0 );		// get it or NULL
-
-	if( ! jtp ) {
-		return 0;
-	}
-
-	return jtp->prim_type == PT_BOOL;
+	return jt.prim_type == PT_BOOL;
 }
 
 /*
 	Returns true (1) if the primative type was a 'null' type.
 */
 extern int jw_is_null( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
+	jthing_t	jt;
 
-	if( st == NULL ) {
+	if( ! jw_lookup( st, name, &jt ) ) {
 		return 0;
 	}
 
-	jtp = (jthing_t *) sym_get( st, name, 0 );		// get it or NULL
-
-	if( ! jtp ) {
-		return 0;
-	}
-
-	return jtp->prim_type == PT_NULL;
+	return jt.prim_type == PT_NULL;
 }
 
 /*
 	Look up the name in the symtab and return the string (data).
 */
 extern char* jw_string( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
+	jthing_t	jt;
 
-	if( st == NULL ) {
+	if( ! jw_lookup( st, name, &jt ) || jt.jsmn_type != JSMN_STRING ) {
 		return NULL;
 	}
 
-	jtp = (jthing_t *) sym_get( st, name, 0 );		// get it or NULL
-
-	if( ! jtp ) {
-		return NULL;
-	}
-
-	if( jtp->jsmn_type != JSMN_STRING ) {
-		return NULL;
-	}
-
-	return (char *) jtp->v.pv;
+	return (char *) jt.v.pv;
 }
 
 /*
 	Look up name and return the value.
 */
 extern float jw_value( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
+	jthing_t	jt;
 
-	if( st == NULL ) {
+	if( ! jw_lookup( st, name, &jt ) || jt.jsmn_type != JSMN_PRIMITIVE ) {
 		return 0;
 	}
 
-	jtp = (jthing_t *) sym_get( st, name, 0 );		// get it or NULL
+	return jt.v.fv;
+}
 
-	if( ! jtp ) {
-		return 0;
-	}
+/*
+	Look up name and return the value as an integer. Unlike jw_value() the value
+	is exact for integers which cannot be represented by a float.
+*/
+extern long long jw_ivalue( void* st, const char* name ) {
+	jthing_t	jt;
 
-	if( jtp->jsmn_type != JSMN_PRIMITIVE ) {
+	if( ! jw_lookup( st, name, &jt ) || jt.jsmn_type != JSMN_PRIMITIVE ) {
 		return 0;
 	}
 
-	return jtp->v.fv;
+	return jt.iv;
 }
 
 /*
 	Look up name and return the blob (symtab).
 */
 extern void* jw_blob( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
+	jthing_t	jt;
 
-	if( st == NULL ) {
+	if( ! jw_lookup( st, name, &jt ) || jt.jsmn_type != JSMN_OBJECT ) {
 		return NULL;
 	}
 
-	jtp = (jthing_t *) sym_get( st, name, 0 );		// get it or NULL
-
-	if( ! jtp ) {
-		return NULL;
-	}
-
-	if( jtp->jsmn_type != JSMN_OBJECT ) {
-		return NULL;
-	}
-
-	return jtp->v.pv;
+	return jt.v.pv;
 }
 
 /*
@@ -604,21 +920,13 @@ extern void* jw_blob( void* st, const char* name ) {
 		element is not a string
 */
 extern char* jw_string_ele( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
-
-	if( st == NULL ) {
-		return NULL;
-	}
-
-	if( (jtp = suss_element( st, name, idx )) == NULL ) {
-		return NULL;
-	}
+	jthing_t	jt;
 
-	if( jtp->jsmn_type != JSMN_STRING ) {
+	if( ! jw_lookup_ele( st, name, idx, &jt ) || jt.jsmn_type != JSMN_STRING ) {
 		return NULL;
 	}
 
-	return (char *) jtp->v.pv;
+	return (char *) jt.v.pv;
 }
 
 /*
@@ -629,21 +937,27 @@ extern char* jw_string_ele( void* st, const char* name, int idx ) {
 		element is not a value
 */
 extern float jw_value_ele( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
+	jthing_t	jt;
 
-	if( st == NULL ) {
+	if( ! jw_lookup_ele( st, name, idx, &jt ) || jt.jsmn_type != JSMN_PRIMITIVE ) {
 		return 0;
 	}
 
-	if( (jtp = suss_element( st, name, idx )) == NULL ) {
-		return 0;
-	}
+	return jt.v.fv;
+}
+
+/*
+	Look up array element as an exact integer; returns 0 in the same cases as
+	jw_value_ele().
+*/
+extern long long jw_ivalue_ele( void* st, const char* name, int idx ) {
+	jthing_t	jt;
 
-	if( jtp->jsmn_type != JSMN_PRIMITIVE ) {
+	if( ! jw_lookup_ele( st, name, idx, &jt ) || jt.jsmn_type != JSMN_PRIMITIVE ) {
 		return 0;
 	}
 
-	return jtp->v.fv;
+	return jt.iv;
 }
 
 /*
@@ -651,17 +965,13 @@ extern float jw_value_ele( void* st, const char* name, int idx ) {
 	Return true (1) if it is.
 */
 extern int jw_is_value_ele( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
+	jthing_t	jt;
 
-	if( st == NULL ) {
-		return 0;
-	}
-
-	if( (jtp = suss_element( st, name, idx )) == NULL ) {
+	if( ! jw_lookup_ele( st, name, idx, &jt ) ) {
 		return 0;
 	}
 
-	return jtp->prim_type == PT_VALUE;
+	return jt.prim_type == PT_VALUE;
 }
 
 /*
@@ -669,17 +979,13 @@ extern int jw_is_value_ele( void* st, const char* name, int idx ) {
 	Return true (1) if it is.
 */
 extern int jw_is_bool_ele( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
+	jthing_t	jt;
 
-	if( st == NULL ) {
+	if( ! jw_lookup_ele( st, name, idx, &jt ) ) {
 		return 0;
 	}
 
-	if( (jtp = suss_element( st, name, idx )) == NULL ) {
-		return 0;
-	}
-
-	return jtp->prim_type == PT_BOOL;
+	return jt.prim_type == PT_BOOL;
 }
 
 /*
@@ -687,17 +993,17 @@ extern int jw_is_bool_ele( void* st, const char* name, int idx ) {
 	Return true (1) if it is.
 */
 extern int jw_is_null_ele( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
+	jthing_t	jt;
 
 	if( st == NULL ) {
 		return -1;
 	}
 
-	if( (jtp = suss_element( st, name, idx )) == NULL ) {
+	if( ! jw_lookup_ele( st, name, idx, &jt ) ) {
 		return 0;
 	}
 
-	return jtp->prim_type == PT_NULL;
+	return jt.prim_type == PT_NULL;
 }
 
 /*
@@ -713,21 +1019,13 @@ extern int jw_is_null_ele( void* st, const char* name, int idx ) {
 	namespace.
 */
 extern void* jw_obj_ele( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
+	jthing_t	jt;
 
-	if( st == NULL ) {
+	if( ! jw_lookup_ele( st, name, idx, &jt ) || jt.jsmn_type != JSMN_OBJECT ) {
 		return NULL;
 	}
 
-	if( (jtp = suss_element( st, name, idx )) == NULL ) {
-		return NULL;
-	}
-
-	if( jtp->jsmn_type != JSMN_OBJECT ) {
-		return NULL;
-	}
-
-	return (void *) jtp->v.pv;
+	return jt.v.pv;
 }
 
 /*
@@ -735,15 +1033,11 @@ extern void* jw_obj_ele( void* st, const char* name, int idx ) {
 	and returns the number of elements otherwise.
 */
 extern int jw_array_len( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
-
-	if( st == NULL ) {
-		return -1;
-	}
+	jthing_t	jt;
 
-	if( (jtp = suss_array( st, name )) == NULL ) {
+	if( ! jw_lookup( st, name, &jt ) || jt.jsmn_type != JSMN_ARRAY ) {
 		return -1;
 	}
 
-	return jtp->nele;
+	return jt.nele;
 }
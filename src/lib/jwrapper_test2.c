@@ -6,10 +6,14 @@
 				this uses a static json string so as to test specific things and report
 				a binary good/bad for each.
 
+				The checks are run against a symtab parse (jw_new) and against an
+				arena parse, both in a caller supplied buffer and allocated.
+
 				Example:
 
 	Author:		E. Scott Daniels
 	Date:		31 March 2016
+	Mods:		16 Oct 2026 : Run the checks in arena mode too; check exact integers.
 */
 
 #include <stdio.h>
@@ -20,6 +24,7 @@
 
 char* raw_json = "{ \
 	\"patient_id\": 1027844, \
+	\"record_id\": 16777217, \
 	\"active_patient\": true,\
 	\"last_visit\": \"2015/02/03\",\
 	\"patient_info\": {\
@@ -176,22 +181,40 @@ static int check_value( void* jblob, char* field, float expect ) {
 }
 
 
-int main( int argc, char **argv ) {
-	void*	jblob;						// parsed json stuff
+/*
+	Check that an integer too large to be exact as a float comes back exactly.
+*/
+static int check_ivalue( void* jblob, char* field, long long expect ) {
+	long long	value;
+
+	value = jw_ivalue( jblob, field );
+	if( value != expect ) {
+		fprintf( stderr, "[FAIL]  %s integer value did not match the expected value: %lld != %lld\n", field, expect, value );
+		return 1;
+	}
+
+	fprintf( stderr, "[OK]   found %s:  %lld\n", field, value );
+	return 0;
+}
+
+/*
+	Run all checks against the parsed blob; returns the number of errors.
+*/
+static int run_checks( void* jblob ) {
 	void*	sub_blob;					// nested object
-	char	*stuff;
 	float	value;
 	int		errors = 0;
 
-	if( (jblob = jw_new( raw_json )) == NULL ) {
-		fprintf( stderr, "failed to create wrapper\n" );
-		exit( 1 );
-	}
-	
 	fprintf( stderr, "\n[INFO] testing outer layer things\n" );
 	errors += check_str( jblob, "last_visit", "2015/02/03" );
 	errors += check_value( jblob, "patient_id", 1027844.0 );
 	errors += check_value( jblob, "active_patient", 1.0 );
+	errors += check_ivalue( jblob, "record_id", 16777217LL );
+	errors += check_ivalue( jblob, "patient_info.weight_kilo", 65 );
+	if( jwx_get_ivalue( jblob, "record_id", 0 ) != 16777217 ) {
+		fprintf( stderr, "[FAIL]  jwx_get_ivalue did not return the exact value\n" );
+		errors++;
+	}
 
 	fprintf( stderr, "\n[INFO] testing array and embedded object in an array\n" );
 	if( (value = jw_array_len( jblob, "family" )) == 3 ) {				// dig into the array and get the blob
@@ -204,11 +227,24 @@ int main( int argc, char **argv ) {
 			fprintf( stderr, "[FAIL]  family array has expected number of elements, but did not return element 1\n" );
 			errors++;
 		}
+		if( (sub_blob = jw_obj_ele( jblob, "family", 2 )) == NULL || jw_ivalue( sub_blob, "age" ) != 70 ) {
+			fprintf( stderr, "[FAIL]  family array element 2 missing or has the wrong age\n" );
+			errors++;
+		}
 	} else {
 		fprintf( stderr, "[FAIL]  wrong number of elements for family arry: expected 3 got %.2f\n", value );
 		errors++;
 	}
 
+	if( jw_string_ele( jblob, "patient_info.drug_alergies", 1 ) == NULL || strcmp( jw_string_ele( jblob, "patient_info.drug_alergies", 1 ), "darvaset" ) != 0 ) {
+		fprintf( stderr, "[FAIL]  nested array element 1 not found or wrong\n" );
+		errors++;
+	}
+	if( jw_string_ele( jblob, "patient_info.drug_alergies", 2 ) != NULL ) {
+		fprintf( stderr, "[FAIL]  out of range array element returned a string\n" );
+		errors++;
+	}
+
 	fprintf( stderr, "\n[INFO] testing embedded object at the outer level\n" );
 	if( (sub_blob = jw_blob( jblob, "Contact_info" )) != NULL ) {			// should be able to reach it by loading the blob and then referencing into it
 		fprintf( stderr, "[OK]   found embedded object Contact_info\n" );
@@ -221,6 +257,11 @@ int main( int argc, char **argv ) {
 
 	errors += check_str( jblob, "Contact_info.relation", "wife" );		// should be able to reach it through dotted notation too
 
+	if( jw_exists( jblob, "Contact_info.mobile" ) || ! jw_missing( jblob, "no_such_thing" ) ) {
+		fprintf( stderr, "[FAIL]  missing fields reported as existing\n" );
+		errors++;
+	}
+
 	// check to see if the primative types are reporting correctly
 	fprintf( stderr, "\n[INFO] checking that primative types report correctly\n" );
 	errors += check_type_bool( jblob, "last_visit", 0 );				// shouldn't report boolean
@@ -234,9 +275,43 @@ int main( int argc, char **argv ) {
 
 	errors += check_ele_types( jblob );
 
+	return errors;
+}
 
+int main( int argc, char **argv ) {
+	void*	jblob;						// parsed json stuff
+	char	abuf[16384] __attribute__((aligned(8)));		// arena buffer
+	int		errors = 0;
+
+	if( (jblob = jw_new( raw_json )) == NULL ) {
+		fprintf( stderr, "failed to create wrapper\n" );
+		exit( 1 );
+	}
+	fprintf( stderr, "\n[INFO] ----- symtab mode -----\n" );
+	errors += run_checks( jblob );
+	jw_nuke( jblob );
+
+	if( (jblob = jw_new_arena( raw_json, abuf, sizeof( abuf ) )) == NULL ) {
+		fprintf( stderr, "failed to create arena wrapper\n" );
+		exit( 1 );
+	}
+	fprintf( stderr, "\n[INFO] ----- arena mode, supplied buffer -----\n" );
+	errors += run_checks( jblob );
+	jw_nuke( jblob );
+
+	if( (jblob = jw_new_arena( raw_json, abuf, 64 )) == NULL ) {		// too small, must allocate
+		fprintf( stderr, "failed to create allocated arena wrapper\n" );
+		exit( 1 );
+	}
+	fprintf( stderr, "\n[INFO] ----- arena mode, allocated -----\n" );
+	errors += run_checks( jblob );
 	jw_nuke( jblob );
 
+	if( jw_new_arena( "[ 1, 2, 3 ]", NULL, 0 ) != NULL ) {
+		fprintf( stderr, "[FAIL] arena parse of a non-object did not fail\n" );
+		errors++;
+	}
+
 
 	// ----------------------------------------------------------------------------------------
 	if( errors ) {
@@ -34,6 +34,13 @@ void pprint( parms_t* parms ) {
 	fprintf( stderr, "\tlog_keep: %d\n", parms->log_keep );
 	fprintf( stderr, "\tdelete_keep: %d\n", parms->delete_keep );
 	fprintf( stderr, "\tfifo: %s\n", parms->fifo_path );
+	fprintf( stderr, "\tsock: %s\n", parms->sock_path );
+	fprintf( stderr, "\tstats_interval: %d\n", parms->stats_ivl );
+	fprintf( stderr, "\tshm_stats: (%s)\n", parms->shm_path );
+	fprintf( stderr, "\tmetrics: (%s)\n", parms->metrics_addr ? parms->metrics_addr : "off" );
+	for( i = 0; i < parms->nxstats; i++ ) {
+		fprintf( stderr, "\txstats[%d]: (%s)\n", i, parms->xstats[i] ? parms->xstats[i] : "" );
+	}
 	fprintf( stderr, "\tcpu_mask: %s\n", parms->cpu_mask );
 	fprintf( stderr, "\tdpdk_log_level: %d\n", parms->dpdk_log_level );
 	fprintf( stderr, "\tdpdk_init_log_level: %d\n", parms->dpdk_init_log_level );
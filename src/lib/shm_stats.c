@@ -0,0 +1,339 @@
+// vi: sw=4 ts=4 noet:
+/*
+	Mnemonic:	shm_stats.c
+	Abstract:	Both sides of the shared memory stats segment. VFd creates the
+				segment and rewrites the records after each stats sweep; external
+				readers (monitoring agents, the vfd_stats command) map it read only
+				and copy records out without making a request or taking a lock.
+
+				The segment is a versioned header followed by an array of fixed size
+				records (see shm_stats_hdr_t and shm_stats_rec_t in vfdlib.h). Both
+				are cache line aligned so that a reader spinning on one record never
+				shares a line with the record being written next to it.
+
+				Each record carries a sequence number (seqlock). The single writer
+				bumps it to odd, writes the fields, then bumps it to even. A reader
+				copies the record and accepts the copy only if the sequence was even
+				and unchanged across the copy; otherwise it tries again.
+
+	Date:		16 Oct 2026
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "vfdlib.h"
+
+#define SHM_MAX_TRIES	1024			// reader gives up after this many torn copies
+
+typedef struct {
+	int		fd;
+	size_t	size;						// mapped length
+	shm_stats_hdr_t* hdr;
+	char*	recs;						// first record
+	int		writer;						// we created it (unlink on close)
+	char*	path;
+} shm_seg_t;
+
+/*
+	Return the record at idx or nil if out of range.
+*/
+static shm_stats_rec_t* rec_at( shm_seg_t* seg, int idx ) {
+	if( seg == NULL || idx < 0 || (uint32_t) idx >= seg->hdr->nrecs ) {
+		return NULL;
+	}
+
+	return (shm_stats_rec_t *) (seg->recs + ((size_t) idx * seg->hdr->rec_size));
+}
+
+/*
+	Copy len bytes guarded by the sequence number at seq into dest. Returns 1 on
+	success, 0 if a consistent copy could not be made (errno is EAGAIN).
+*/
+static int seq_copy( void* dest, const void* src, size_t len, const uint32_t* seq ) {
+	uint32_t	s1;
+	uint32_t	s2;
+	int			tries;
+
+	for( tries = 0; tries < SHM_MAX_TRIES; tries++ ) {
+		s1 = __atomic_load_n( seq, __ATOMIC_ACQUIRE );
+		if( s1 & 1 ) {									// writer is in the middle
+			continue;
+		}
+
+		memcpy( dest, src, len );
+		__atomic_thread_fence( __ATOMIC_ACQUIRE );		// copy must complete before the recheck
+		s2 = __atomic_load_n( seq, __ATOMIC_RELAXED );
+		if( s1 == s2 ) {
+			return 1;
+		}
+	}
+
+	errno = EAGAIN;
+	return 0;
+}
+
+// ---------------------------- writer ---------------------------------------------------------
+
+/*
+	Create (replacing any left over from a previous run) and map a segment large
+	enough for nrecs records. Returns a handle or nil on error (errno set).
+*/
+extern void* shm_stats_create( const_str path, int nrecs ) {
+	shm_seg_t*	seg;
+	size_t		hsize;
+	size_t		rsize;
+
+	if( path == NULL || *path == 0 || nrecs <= 0 ) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if( (seg = (shm_seg_t *) malloc( sizeof( *seg ) )) == NULL ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset( seg, 0, sizeof( *seg ) );
+
+	hsize = sizeof( shm_stats_hdr_t );
+	rsize = sizeof( shm_stats_rec_t );
+	seg->size = hsize + ((size_t) nrecs * rsize);
+
+	unlink( path );										// a reader mapping an old one sees pid 0 and reopens
+	if( (seg->fd = open( path, O_RDWR | O_CREAT | O_EXCL, 0644 )) < 0 ) {
+		free( seg );
+		return NULL;
+	}
+
+	if( ftruncate( seg->fd, seg->size ) < 0 ||
+		(seg->hdr = (shm_stats_hdr_t *) mmap( NULL, seg->size, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0 )) == MAP_FAILED ) {
+		close( seg->fd );
+		unlink( path );
+		free( seg );
+		return NULL;
+	}
+
+	memset( seg->hdr, 0, seg->size );
+	seg->recs = ((char *) seg->hdr) + hsize;
+	seg->writer = 1;
+	seg->path = strdup( path );
+
+	seg->hdr->version = SHM_STATS_VERSION;
+	seg->hdr->hdr_size = hsize;
+	seg->hdr->rec_size = rsize;
+	seg->hdr->nrecs = nrecs;
+	seg->hdr->pid = getpid();
+	__atomic_store_n( &seg->hdr->magic, SHM_STATS_MAGIC, __ATOMIC_RELEASE );		// last; readers reject the segment until set
+
+	return seg;
+}
+
+/*
+	Start an update of the record at idx; the record is returned so the caller can
+	fill it in and must be passed to shm_stats_wend() when done. Returns nil if idx
+	is out of range. Only one thread may write to a segment.
+*/
+extern shm_stats_rec_t* shm_stats_wbegin( void* vseg, int idx ) {
+	shm_stats_rec_t* rec;
+
+	if( (rec = rec_at( (shm_seg_t *) vseg, idx )) == NULL ) {
+		return NULL;
+	}
+
+	__atomic_store_n( &rec->seq, rec->seq + 1, __ATOMIC_RELAXED );		// odd: readers will retry
+	__atomic_thread_fence( __ATOMIC_SEQ_CST );							// odd seq visible before any field changes
+	return rec;
+}
+
+/*
+	Finish the update started by shm_stats_wbegin().
+*/
+extern void shm_stats_wend( shm_stats_rec_t* rec ) {
+	if( rec != NULL ) {
+		__atomic_store_n( &rec->seq, rec->seq + 1, __ATOMIC_RELEASE );	// even: fields visible before the seq
+	}
+}
+
+/*
+	Publish the number of records now valid along with the generation and time of
+	the sweep which filled them. Records beyond nused which were valid before are
+	marked invalid so that a reader not checking the header does not use them.
+*/
+extern void shm_stats_commit( void* vseg, int nused, uint64_t gen, int64_t ms ) {
+	shm_seg_t*	seg;
+	shm_stats_hdr_t* hdr;
+	shm_stats_rec_t* rec;
+	int			i;
+
+	if( (seg = (shm_seg_t *) vseg) == NULL ) {
+		return;
+	}
+	hdr = seg->hdr;
+	if( nused < 0 || (uint32_t) nused > hdr->nrecs ) {
+		nused = hdr->nrecs;
+	}
+
+	for( i = nused; (uint32_t) i < hdr->nused; i++ ) {
+		if( (rec = shm_stats_wbegin( seg, i )) != NULL ) {
+			rec->valid = 0;
+			shm_stats_wend( rec );
+		}
+	}
+
+	__atomic_store_n( &hdr->seq, hdr->seq + 1, __ATOMIC_RELAXED );
+	__atomic_thread_fence( __ATOMIC_SEQ_CST );
+	hdr->nused = nused;
+	hdr->gen = gen;
+	hdr->ms = ms;
+	__atomic_store_n( &hdr->seq, hdr->seq + 1, __ATOMIC_RELEASE );
+}
+
+// ---------------------------- reader ---------------------------------------------------------
+
+/*
+	Map an existing segment read only. Returns a handle or nil if the segment
+	does not exist or is not one we understand (errno set).
+*/
+extern void* shm_stats_open( const_str path ) {
+	shm_seg_t*	seg;
+	struct stat	st;
+	shm_stats_hdr_t* hdr;
+
+	if( path == NULL || *path == 0 ) {
+		path = SHM_STATS_PATH;
+	}
+
+	if( (seg = (shm_seg_t *) malloc( sizeof( *seg ) )) == NULL ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset( seg, 0, sizeof( *seg ) );
+
+	if( (seg->fd = open( path, O_RDONLY )) < 0 ) {
+		free( seg );
+		return NULL;
+	}
+
+	if( fstat( seg->fd, &st ) < 0 || st.st_size < (off_t) sizeof( shm_stats_hdr_t ) ) {
+		close( seg->fd );
+		free( seg );
+		errno = ENODATA;
+		return NULL;
+	}
+
+	seg->size = st.st_size;
+	if( (seg->hdr = (shm_stats_hdr_t *) mmap( NULL, seg->size, PROT_READ, MAP_SHARED, seg->fd, 0 )) == MAP_FAILED ) {
+		close( seg->fd );
+		free( seg );
+		return NULL;
+	}
+
+	hdr = seg->hdr;
+	if( __atomic_load_n( &hdr->magic, __ATOMIC_ACQUIRE ) != SHM_STATS_MAGIC || hdr->version != SHM_STATS_VERSION ||
+		hdr->rec_size < sizeof( shm_stats_rec_t ) || hdr->hdr_size < sizeof( shm_stats_hdr_t ) ||
+		(size_t) hdr->hdr_size + ((size_t) hdr->nrecs * hdr->rec_size) > seg->size ) {
+
+		munmap( seg->hdr, seg->size );
+		close( seg->fd );
+		free( seg );
+		errno = EPROTO;
+		return NULL;
+	}
+
+	seg->recs = ((char *) hdr) + hdr->hdr_size;
+	return seg;
+}
+
+/*
+	Copy a consistent view of the header into hdr. Returns 1 on success.
+	A pid of 0 in the copy means VFd has stopped; the values are the last
+	it published and the caller should reopen to pick up a new instance.
+*/
+extern int shm_stats_hdr( void* vseg, shm_stats_hdr_t* hdr ) {
+	shm_seg_t* seg;
+
+	if( (seg = (shm_seg_t *) vseg) == NULL || hdr == NULL ) {
+		errno = EINVAL;
+		return 0;
+	}
+
+	return seq_copy( hdr, seg->hdr, sizeof( *hdr ), &seg->hdr->seq );
+}
+
+/*
+	Copy a consistent view of the record at idx into rec. Returns 1 on
+	success, 0 if idx is out of range or the record is not valid.
+*/
+extern int shm_stats_read( void* vseg, int idx, shm_stats_rec_t* rec ) {
+	shm_stats_rec_t* src;
+
+	if( rec == NULL || (src = rec_at( (shm_seg_t *) vseg, idx )) == NULL ) {
+		errno = EINVAL;
+		return 0;
+	}
+
+	if( ! seq_copy( rec, src, sizeof( *rec ), &src->seq ) ) {
+		return 0;
+	}
+
+	return rec->valid;
+}
+
+/*
+	Find the record for the port/vf pair (vf -1 is the pf) and copy it into rec.
+	Returns 1 if found.
+*/
+extern int shm_stats_find( void* vseg, int port, int vf, shm_stats_rec_t* rec ) {
+	shm_stats_hdr_t	hdr;
+	int		i;
+
+	if( ! shm_stats_hdr( vseg, &hdr ) ) {
+		return 0;
+	}
+
+	for( i = 0; (uint32_t) i < hdr.nused; i++ ) {
+		if( shm_stats_read( vseg, i, rec ) && rec->port == port && rec->vf == vf ) {
+			return 1;
+		}
+	}
+
+	errno = ENOENT;
+	return 0;
+}
+
+/*
+	Unmap the segment. When called by the writer the pid is cleared so that
+	readers know the values are no longer being updated, and the file is removed.
+*/
+extern void shm_stats_close( void* vseg ) {
+	shm_seg_t* seg;
+
+	if( (seg = (shm_seg_t *) vseg) == NULL ) {
+		return;
+	}
+
+	if( seg->writer ) {
+		__atomic_store_n( &seg->hdr->seq, seg->hdr->seq + 1, __ATOMIC_RELAXED );
+		__atomic_thread_fence( __ATOMIC_SEQ_CST );
+		seg->hdr->pid = 0;
+		__atomic_store_n( &seg->hdr->seq, seg->hdr->seq + 1, __ATOMIC_RELEASE );
+		if( seg->path != NULL ) {
+			unlink( seg->path );
+		}
+	}
+
+	munmap( seg->hdr, seg->size );
+	close( seg->fd );
+	if( seg->path != NULL ) {
+		free( seg->path );
+	}
+	free( seg );
+}
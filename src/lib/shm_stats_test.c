@@ -0,0 +1,171 @@
+// :vi ts=4 sw=4 noet :
+/*
+	Mneminic:	shm_stats_test.c
+	Abstract: 	Unit test for the shm_stats module. Creates a segment, writes
+				records and reads them back through a second (reader) mapping.
+				Then a writer thread rewrites the records continually while the
+				main thread reads them; every counter in a record is written with
+				the same value so a torn copy is detected.
+
+				Usage: shm_stats_test [path]   (default /tmp/shm_stats_test)
+
+	Date:		16 Oct 2026
+*/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "vfdlib.h"
+
+#include "shm_stats.c"
+
+#define NRECS	64
+
+static volatile int	done = 0;
+
+/*
+	Fill rec so that every counter is v.
+*/
+static void fill( shm_stats_rec_t* rec, int port, int vf, uint64_t v ) {
+	rec->port = port;
+	rec->vf = vf;
+	rec->valid = 1;
+	rec->link = 1;
+	snprintf( rec->pciid, sizeof( rec->pciid ), "0000:%02x:00.%d", port, vf < 0 ? 0 : 1 );
+	rec->gen = v;
+	rec->ipackets = rec->ibytes = rec->ierrors = rec->imissed = rec->nombuf = v;
+	rec->opackets = rec->obytes = rec->oerrors = rec->spoofed = v;
+}
+
+static int consistent( shm_stats_rec_t* rec ) {
+	uint64_t v;
+
+	v = rec->gen;
+	return rec->ipackets == v && rec->ibytes == v && rec->ierrors == v && rec->imissed == v && rec->nombuf == v &&
+		rec->opackets == v && rec->obytes == v && rec->oerrors == v && rec->spoofed == v;
+}
+
+static void* writer( void* data ) {
+	shm_stats_rec_t* rec;
+	uint64_t	v = 100;
+	int			i;
+
+	while( ! done ) {
+		v++;
+		for( i = 0; i < NRECS; i++ ) {
+			if( (rec = shm_stats_wbegin( data, i )) != NULL ) {
+				fill( rec, i / 8, (i % 8) - 1, v );
+				shm_stats_wend( rec );
+			}
+		}
+		shm_stats_commit( data, NRECS, v, 0 );
+	}
+
+	return NULL;
+}
+
+int main( int argc, char** argv ) {
+	char*	path = "/tmp/shm_stats_test";
+	void*	wseg;
+	void*	rseg;
+	shm_stats_rec_t*	rec;
+	shm_stats_rec_t		copy;
+	shm_stats_hdr_t		hdr;
+	pthread_t	tid;
+	int		errors = 0;
+	int		reads = 0;
+	int		i;
+	int		j;
+
+	if( argc > 1 ) {
+		path = argv[1];
+	}
+
+	if( (wseg = shm_stats_create( path, NRECS )) == NULL ) {
+		fprintf( stderr, "[FAIL] unable to create segment: %s: %s\n", path, strerror( errno ) );
+		exit( 1 );
+	}
+	fprintf( stderr, "[OK]   segment created: %s  hdr=%d rec=%d\n", path, (int) sizeof( shm_stats_hdr_t ), (int) sizeof( shm_stats_rec_t ) );
+
+	if( sizeof( shm_stats_rec_t ) % 64 != 0 || sizeof( shm_stats_hdr_t ) % 64 != 0 ) {
+		fprintf( stderr, "[FAIL] header/record are not multiples of a cache line\n" );
+		errors++;
+	}
+
+	if( (rseg = shm_stats_open( path )) == NULL ) {
+		fprintf( stderr, "[FAIL] unable to open segment for read: %s\n", strerror( errno ) );
+		exit( 1 );
+	}
+
+	if( shm_stats_read( rseg, 0, &copy ) ) {
+		fprintf( stderr, "[FAIL] unwritten record reported valid\n" );
+		errors++;
+	}
+
+	for( i = 0; i < 3; i++ ) {
+		rec = shm_stats_wbegin( wseg, i );
+		fill( rec, 1, i - 1, 42 + i );
+		shm_stats_wend( rec );
+	}
+	shm_stats_commit( wseg, 3, 1, 0 );
+
+	if( ! shm_stats_hdr( rseg, &hdr ) || hdr.nused != 3 || hdr.gen != 1 || hdr.pid != getpid() ) {
+		fprintf( stderr, "[FAIL] header not as expected: nused=%d gen=%d\n", (int) hdr.nused, (int) hdr.gen );
+		errors++;
+	} else {
+		fprintf( stderr, "[OK]   header read: nused=%d nrecs=%d\n", (int) hdr.nused, (int) hdr.nrecs );
+	}
+
+	if( ! shm_stats_find( rseg, 1, 1, &copy ) || copy.ipackets != 44 || strcmp( copy.pciid, "0000:01:00.1" ) != 0 ) {
+		fprintf( stderr, "[FAIL] find of 1/1 failed or returned wrong data\n" );
+		errors++;
+	} else {
+		fprintf( stderr, "[OK]   find returned 1/1 %s\n", copy.pciid );
+	}
+
+	if( shm_stats_find( rseg, 1, 7, &copy ) ) {
+		fprintf( stderr, "[FAIL] find of missing 1/7 succeeded\n" );
+		errors++;
+	}
+
+	shm_stats_commit( wseg, 1, 2, 0 );						// shrink; records 1 and 2 must become invalid
+	if( shm_stats_read( rseg, 2, &copy ) ) {
+		fprintf( stderr, "[FAIL] record beyond nused still valid after shrink\n" );
+		errors++;
+	} else {
+		fprintf( stderr, "[OK]   shrink invalidated the tail\n" );
+	}
+
+	pthread_create( &tid, NULL, writer, wseg );
+	for( j = 0; j < 20000; j++ ) {
+		for( i = 0; i < NRECS; i++ ) {
+			if( shm_stats_read( rseg, i, &copy ) ) {
+				reads++;
+				if( ! consistent( &copy ) ) {
+					errors++;
+				}
+			}
+		}
+	}
+	done = 1;
+	pthread_join( tid, NULL );
+	fprintf( stderr, "[%s] %d reads made while writing, %d torn\n", errors ? "FAIL" : "OK  ", reads, errors );
+
+	shm_stats_close( wseg );
+	if( ! shm_stats_hdr( rseg, &hdr ) || hdr.pid != 0 ) {
+		fprintf( stderr, "[FAIL] pid not cleared on writer close\n" );
+		errors++;
+	}
+	if( access( path, F_OK ) == 0 ) {
+		fprintf( stderr, "[FAIL] segment not removed on writer close\n" );
+		errors++;
+	}
+	shm_stats_close( rseg );
+
+	fprintf( stderr, "\n%s\n", errors ? "[FAIL] one or more tests failed" : "[PASS] all tests passed" );
+	return errors != 0;
+}
@@ -35,10 +35,16 @@ Date:     11 Feb 2000
 Author:   E. Scott Daniels
 Mod:		2016 23 Feb - converted Symtab refs so that caller need only a
 				void pointer to use and struct does not need to be exposed.
+			2026 16 Oct - replaced the fixed size chained table with an open
+				addressed (linear probe) table which doubles as it fills. Names
+				shorter than SYM_INLINE are kept in the slot, so a lookup is a
+				hash and (usually) a single cache line. Deletes leave a tombstone
+				so that elements never move while the table is walked.
 ------------------------------------------------------------------------------
 */
 
 #include <stdio.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
@@ -48,78 +54,196 @@ Mod:		2016 23 Feb - converted Symtab refs so that caller need only a
 
 //-----------------------------------------------------------------------------------------------
 
+#define SYM_INLINE		24			/* names shorter than this are kept in the slot */
+#define SYM_MIN_SIZE	16			/* smallest table (slots) */
+
+#define SYM_EMPTY		0			/* hash values for unused slots; real hashes are never < 2 */
+#define SYM_TOMB		1			/* deleted; probes must continue past it */
+
+#define SF_LONG			0x100		/* name is allocated rather than inline (internal flag) */
+
+#define SE_NAME(e)		((e)->flags & SF_LONG ? (e)->n.lname : (e)->n.iname)
+#define SE_LIVE(e)		((e)->hash > SYM_TOMB)
+
 typedef struct Sym_ele
 {
-	struct Sym_ele *next;          /* pointer at next element in list */
-	struct Sym_ele *prev;          /* larger table, easier deletes */
-	const char *name;			           /* symbol name */
+	uint64_t hash;					/* full hash of the name and class, or SYM_EMPTY/SYM_TOMB */
 	void *val;                     /* user data associated with name */
-	unsigned long mcount;          /* modificaitons to value */
-	unsigned long rcount;          /* references to symbol */
-	unsigned int flags; 
 	unsigned int class;		/* helps divide things up and allows for duplicate names */
-} Sym_ele;
+	unsigned int flags; 
+	unsigned int mcount;          /* modificaitons to value */
+	unsigned int rcount;          /* references to symbol */
+	unsigned int nlen;				/* length of the name */
+	union {
+		char iname[SYM_INLINE];		/* short names live here */
+		char *lname;				/* long names are allocated */
+	} n;
+} Sym_ele;							/* 64 bytes; one cache line */
 
 typedef struct Sym_tab {
-	Sym_ele **symlist;			/* pointer to list of element pointerss */
+	Sym_ele *slots;				/* the table; must be first (see jwrapper) */
 	long	inhabitants;             	/* number of active residents */
 	long	deaths;                 	/* number of deletes */
-	long	size;	
+	long	size;						/* number of slots; always a power of two */
+	long	tombs;						/* slots holding a tombstone */
+	int		walking;					/* foreach is active; resizes are deferred */
 } Sym_tab;
 
 /* ----- private functions ---- */
-static int sym_hash( const char *n, long size )
-{
-	const char *p;
-	unsigned long t = 0;
-	unsigned long tt = 0;
-	unsigned long x = 79;
 
-	for( p = n; *p; p++ )      /* a bit of magic */
-		t = (t * 79 ) + *p;
+/* read 8 or 4 bytes from an unaligned address */
+static inline uint64_t rd8( const uint8_t *p ) {
+	uint64_t v;
+
+	memcpy( &v, p, sizeof( v ) );
+	return v;
+}
 
-	if( t < 0 )
-		t = ~t;
+static inline uint64_t rd4( const uint8_t *p ) {
+	uint32_t v;
 
-	return (int ) (t % size);
+	memcpy( &v, p, sizeof( v ) );
+	return v;
 }
 
-/* delete element pointed to by eptr at hash loc hv */
-static void del_ele( Sym_tab *table, int hv, Sym_ele *eptr )
-{
-	Sym_ele **sym_tab;
+/* 64x64 multiply, folding the 128 bit result */
+static inline uint64_t mum( uint64_t a, uint64_t b ) {
+	__uint128_t r;
 
-	sym_tab = table->symlist;
+	r = (__uint128_t) a * b;
+	return (uint64_t) r ^ (uint64_t) (r >> 64);
+}
 
-	if( eptr )         /* unchain it */
-	{
-		if( eptr->prev )
-			eptr->prev->next = eptr->next;
-		else
-			sym_tab[hv] = eptr->next;
+/*
+	Hash the name and class. This is the wyhash construction: 16 bytes are
+	consumed per multiply and short names (most of ours) cost two multiplies.
+*/
+static uint64_t sym_hash( const char *name, size_t len, unsigned int class )
+{
+	static const uint64_t s0 = 0xa0761d6478bd642full;
+	static const uint64_t s1 = 0xe7037ed1a0b428dbull;
+	static const uint64_t s2 = 0x8ebc6af09c88c6e3ull;
+	const uint8_t *p;
+	uint64_t seed;
+	uint64_t a;
+	uint64_t b;
+	size_t	i;
+	uint64_t h;
+
+	p = (const uint8_t *) name;
+	seed = s0 ^ mum( class ^ s0, s1 );
+	if( len <= 16 ) {
+		if( len >= 4 ) {
+			a = (rd4( p ) << 32) | rd4( p + ((len >> 3) << 2) );
+			b = (rd4( p + len - 4 ) << 32) | rd4( p + len - 4 - ((len >> 3) << 2) );
+		} else {
+			if( len > 0 ) {
+				a = ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+			} else {
+				a = 0;
+			}
+			b = 0;
+		}
+	} else {
+		for( i = len; i > 16; i -= 16, p += 16 ) {
+			seed = mum( rd8( p ) ^ s1, rd8( p + 8 ) ^ seed );
+		}
+		a = rd8( p + i - 16 );
+		b = rd8( p + i - 8 );
+	}
 
-		if( eptr->next )
-			eptr->next->prev = eptr->prev;
+	h = mum( s1 ^ len, mum( a ^ s1, b ^ seed ) ^ s2 );
+	return h > SYM_TOMB ? h : h + 2;
+}
 
-		if( eptr->val && eptr->flags & UT_FL_FREE )
-			free( eptr->val );
-		if( eptr->name )
-			free( (void *) eptr->name );			// and if free fails, what?  panic? 
-		free( eptr );
+/*
+	Find the slot holding name/class. Returns the index or -1.
+*/
+static long find( Sym_tab *table, const char *name, size_t len, unsigned int class, uint64_t hv )
+{
+	Sym_ele *e;
+	long	mask;
+	long	i;
+
+	mask = table->size - 1;
+	for( i = hv & mask; ; i = (i + 1) & mask ) {
+		e = &table->slots[i];
+		if( e->hash == SYM_EMPTY ) {
+			return -1;
+		}
 
-		table->deaths++;
-		table->inhabitants--;
+		if( e->hash == hv && e->class == class && e->nlen == len && memcmp( SE_NAME( e ), name, len ) == 0 ) {
+			return i;
+		}
 	}
 }
 
-static int same( unsigned int c1, unsigned int c2, const char *s1, const char* s2 )
+/*
+	Move every live element into a new table of newsize slots; tombstones are
+	dropped. Elements are not compared as they are known to be unique.
+*/
+static void rehash( Sym_tab *table, long newsize )
 {
-	if( c1 != c2 )
-		return 0;		/* different class - not the same */
+	Sym_ele *old;
+	Sym_ele *e;
+	long	osize;
+	long	mask;
+	long	i;
+	long	j;
+
+	old = table->slots;
+	osize = table->size;
+
+	if( (table->slots = (Sym_ele *) calloc( newsize, sizeof( Sym_ele ) )) == NULL )
+	{
+		fprintf( stderr, "symtab/rehash: out of memory\n" );
+		exit( 1 );
+	}
+	table->size = newsize;
+	table->tombs = 0;
+
+	mask = newsize - 1;
+	for( i = 0; i < osize; i++ ) {
+		e = &old[i];
+		if( SE_LIVE( e ) ) {
+			for( j = e->hash & mask; table->slots[j].hash != SYM_EMPTY; j = (j + 1) & mask );
+			table->slots[j] = *e;
+		}
+	}
 
-	if( *s1 == *s2 && strcmp( s1, s2 ) == 0 )
-		return 1;
-	return 0;
+	free( old );
+}
+
+/*
+	Release what the element holds and mark the slot unused. If the next slot is
+	empty no probe sequence passes through this one, so it (and any tombstones
+	before it) can go back to empty rather than being left as a tombstone.
+*/
+static void del_ele( Sym_tab *table, long i )
+{
+	Sym_ele *e;
+	long	mask;
+
+	e = &table->slots[i];
+	if( e->val && e->flags & UT_FL_FREE )
+		free( e->val );
+	if( e->flags & SF_LONG )
+		free( e->n.lname );
+
+	memset( e, 0, sizeof( *e ) );
+	table->deaths++;
+	table->inhabitants--;
+
+	mask = table->size - 1;
+	if( table->slots[(i + 1) & mask].hash == SYM_EMPTY ) {
+		do {
+			table->slots[i].hash = SYM_EMPTY;
+			i = (i - 1) & mask;
+		} while( table->slots[i].hash == SYM_TOMB && table->tombs-- > 0 );
+	} else {
+		e->hash = SYM_TOMB;
+		table->tombs++;
+	}
 }
 
 /* generic rtn to put something into the table */
@@ -127,40 +251,52 @@ static int same( unsigned int c1, unsigned int c2, const char *s1, const char* s
 static int putin( Sym_tab *table, const char *name, unsigned int class, void *val, int flags )
 {
 	Sym_ele *eptr;    	/* pointer into hash table */ 
-	Sym_ele **sym_tab;    	/* pointer into hash table */ 
-	int hv;                  /* hash value */
+	uint64_t hv;             /* hash value */
+	size_t	len;
+	long	mask;
+	long	i;
 	int rc = 0;              /* assume it existed */
 
-	sym_tab = table->symlist;
+	len = strlen( name );
+	hv = sym_hash( name, len, class );
 
-	hv = sym_hash( name, table->size );
+	if( (i = find( table, name, len, class, hv )) < 0 )    /* new symbol for the table */
+	{
+		rc++;
 
+		if( (table->inhabitants + table->tombs + 1) * 4 > table->size * 3 )		/* keep load under 3/4 */
+		{
+			if( ! table->walking || table->inhabitants + 1 >= table->size )		/* don't move things under a walker unless we must */
+				rehash( table, (table->inhabitants + 1) * 2 > table->size ? table->size * 2 : table->size );
+		}
 
-	for(eptr=sym_tab[hv]; eptr && ! same( class, eptr->class, eptr->name, name); eptr=eptr->next );
+		mask = table->size - 1;
+		for( i = hv & mask; SE_LIVE( &table->slots[i] ); i = (i + 1) & mask );		/* first empty or tombstone */
 
-	if( ! eptr )    /* new symbol for the table */
-	{
-		rc++;
+		eptr = &table->slots[i];
+		if( eptr->hash == SYM_TOMB )
+			table->tombs--;
 		table->inhabitants++;
-	
-		eptr = (Sym_ele *) malloc( sizeof( Sym_ele) );
-		if( ! eptr )
-		{
-			fprintf( stderr, "symtab/putin: out of memory\n" );
-			exit( 1 );
-		} 
 
-		eptr->flags = flags & (UT_FL_FREE | UT_FL_COPY) ? UT_FL_FREE : 0;		/* set free flag if we made a copy of things */
-		eptr->prev = NULL;
+		memset( eptr, 0, sizeof( *eptr ) );
+		eptr->hash = hv;
 		eptr->class = class;
-		eptr->mcount = eptr->rcount = 0;	/* init counters */
-		eptr->val = NULL;                	/* add to head of the list */
-		eptr->name = strdup( name );
-		eptr->next = sym_tab[hv];
-		sym_tab[hv] = eptr;
-		if( eptr->next )
-			eptr->next->prev = eptr;         /* chain back to new one */
+		eptr->nlen = len;
+		eptr->flags = flags & (UT_FL_FREE | UT_FL_COPY) ? UT_FL_FREE : 0;		/* set free flag if we made a copy of things */
+		if( len < SYM_INLINE )
+			memcpy( eptr->n.iname, name, len + 1 );
+		else
+		{
+			eptr->flags |= SF_LONG;
+			if( (eptr->n.lname = strdup( name )) == NULL )
+			{
+				fprintf( stderr, "symtab/putin: out of memory\n" );
+				exit( 1 );
+			}
+		}
 	}
+	else
+		eptr = &table->slots[i];
 
 	eptr->mcount++;
 
@@ -183,15 +319,27 @@ static int putin( Sym_tab *table, const char *name, unsigned int class, void *va
 void sym_clear( void *vtable )
 {
 	Sym_tab *table;
-	Sym_ele **sym_tab;
-	int i; 
+	Sym_ele *e;
+	long i; 
 
 	table = (Sym_tab *) vtable;
-	sym_tab = table->symlist;
 
 	for( i = 0; i < table->size; i++ )
-		while( sym_tab[i] ) 
-			del_ele( table, i, sym_tab[i] );
+	{
+		e = &table->slots[i];
+		if( SE_LIVE( e ) )
+		{
+			if( e->val && e->flags & UT_FL_FREE )
+				free( e->val );
+			if( e->flags & SF_LONG )
+				free( e->n.lname );
+			table->deaths++;
+		}
+	}
+
+	memset( table->slots, 0, sizeof( Sym_ele ) * table->size );
+	table->inhabitants = 0;
+	table->tombs = 0;
 }
 
 /*
@@ -206,42 +354,42 @@ void sym_free( void *vtable ) {
 		return;
 
 	sym_clear( vtable );
-	free( table->symlist );
+	free( table->slots );
 	free( table );
 }
 
 void sym_dump( void *vtable )
 {
 	Sym_tab *table;
-	int i; 
 	Sym_ele *eptr;
-	Sym_ele **sym_tab;
+	long i; 
 
 	table = (Sym_tab *) vtable;
-	sym_tab = table->symlist;
 
 	for( i = 0; i < table->size; i++ )
 	{
-		if( sym_tab[i] )
-		for( eptr = sym_tab[i]; eptr; eptr = eptr->next )  
+		eptr = &table->slots[i];
+		if( SE_LIVE( eptr ) )
 		{
 			if( eptr->val && eptr->flags & UT_FL_FREE )
-				fprintf( stderr, "%s %s\n", eptr->name, (char *) eptr->val );
+				fprintf( stderr, "%s %s\n", SE_NAME( eptr ), (char *) eptr->val );
 			else
-				fprintf( stderr, "%s -> %p\n", eptr->name, eptr->val );
+				fprintf( stderr, "%s -> %p\n", SE_NAME( eptr ), eptr->val );
 		}
 	}
 }
 
-/* allocate a table the size requested - best if size is prime */
-/* returns a pointer to the management block */
+/*
+	Allocate a table. Size is a hint: it is rounded up to a power of two and the
+	table doubles when it becomes 3/4 full, so there is no need to over allocate.
+	Returns a pointer to the management block.
+*/
 void *sym_alloc( int size )
 {
-	int i;
 	Sym_tab *table;
+	long	n;
 
-	if( size < 11 )     /* provide a bit of sanity */
-		size = 11;
+	for( n = SYM_MIN_SIZE; n < size; n <<= 1 );
 
 	if( (table = (Sym_tab *) malloc( sizeof( Sym_tab ))) == NULL )
 	{
@@ -251,14 +399,13 @@ void *sym_alloc( int size )
 
 	memset( table, 0, sizeof( *table ) );
 
-	if((table->symlist = (Sym_ele **) malloc( sizeof( Sym_ele *) * size ))) 
+	if((table->slots = (Sym_ele *) calloc( n, sizeof( Sym_ele ) ))) 
 	{
-		memset( table->symlist, 0, sizeof( Sym_ele *) * size );
-		table->size = size;
+		table->size = n;
 	}
 	else
 	{
-		fprintf( stderr, "sym_alloc: unable to get memory for %d elements", size );
+		fprintf( stderr, "sym_alloc: unable to get memory for %ld elements", n );
 		exit( 1 );
 	}
 
@@ -269,37 +416,30 @@ void *sym_alloc( int size )
 void sym_del( void *vtable, const char *name, unsigned int class )
 {
 	Sym_tab	*table;
-	Sym_ele **sym_tab;
-	Sym_ele *eptr;    /* pointer into hash table */ 
-	int hv;                  /* hash value */
+	size_t	len;
+	long	i;
 
 	table = (Sym_tab *) vtable;
-	sym_tab = table->symlist;
-
-	hv = sym_hash( name, table->size );
-
-	for(eptr=sym_tab[hv]; eptr && eptr->class != class &&  ! same(class, eptr->class, eptr->name, name); eptr=eptr->next );
 
-	del_ele( table, hv, eptr );    /* ignors null ptr, so safe to always call */
+	len = strlen( name );
+	if( (i = find( table, name, len, class, sym_hash( name, len, class ) )) >= 0 )
+		del_ele( table, i );
 }
 
 
 void *sym_get( void *vtable, const char *name, unsigned int class )
 {
 	Sym_tab	*table;
-	Sym_ele **sym_tab;
 	Sym_ele *eptr;    /* pointer into hash table */ 
-	int hv;                  /* hash value */
+	size_t	len;
+	long	i;
 
 	table = (Sym_tab *) vtable;
-	sym_tab = table->symlist;
 
-	hv = sym_hash( name, table->size );
-
-	for(eptr=sym_tab[hv]; eptr && ! same( eptr->class, class, eptr->name, name); eptr=eptr->next );
-
-	if( eptr )
+	len = strlen( name );
+	if( (i = find( table, name, len, class, sym_hash( name, len, class ) )) >= 0 )
 	{
+		eptr = &table->slots[i];
 		eptr->rcount++;
 		return eptr->val;
 	}
@@ -350,82 +490,91 @@ int sym_fmap( void *vtable, const char *name, unsigned int class, void *val )
 	return putin( table, name, class, val, UT_FL_FREE );
 }
 
-/* dump some statistics to stderr dev. Higher level is the more info dumpped */
+/*
+	Dump some statistics to stderr. The probe length of an element is the number
+	of slots examined to find it (1 == in its home slot). Higher level is the more
+	info dumpped: 2 adds a probe length histogram, 3 each element.
+*/
 void sym_stats( void *vtable, int level )
 {
 	Sym_tab	*table;
 	Sym_ele *eptr;    /* pointer into the elements */
-	Sym_ele **sym_tab;
-	int i;
-	int empty = 0;
-	long ch_count;
-	long max_chain = 0;
-	int maxi = 0;
-	int twoper = 0;
+	long	hist[9];	/* probe lengths 1..8, and more */
+	long	i;
+	long	plen;
+	long	max_probe = 0;
+	long	tot_probe = 0;
+	long	maxi = 0;
+	long	nlong = 0;
 
 	table = (Sym_tab *) vtable;
-	sym_tab = table->symlist;
+	memset( hist, 0, sizeof( hist ) );
 
 	for( i = 0; i < table->size; i++ )
 	{
-		ch_count = 0;
-		if( sym_tab[i] )
+		eptr = &table->slots[i];
+		if( ! SE_LIVE( eptr ) )
+			continue;
+
+		plen = ((i - (long) (eptr->hash & (table->size - 1))) & (table->size - 1)) + 1;
+		tot_probe += plen;
+		hist[plen > 8 ? 8 : plen - 1]++;
+		if( plen > max_probe ) 
 		{
-			for( eptr = sym_tab[i]; eptr; eptr = eptr->next )  
-			{
-				ch_count++;
-				if( level > 3 )
-				if( eptr->val && eptr->flags & UT_FL_FREE )
-					fprintf( stderr, "sym: (%d) %s str=(%s)  ref=%ld mod=%lu\n", 
-						i, eptr->name, (char *) eptr->val, eptr->rcount, eptr->mcount );
-				else
-					fprintf( stderr, "sym: (%d) %s ptr=%p  ref=%ld mod=%lu\n", 
-						i, eptr->name, eptr->val, eptr->rcount, eptr->mcount );
-			}
-		}
-		else
-			empty++;
-
-		if( ch_count > max_chain ) 
-		{
-			max_chain = ch_count;
+			max_probe = plen;
 			maxi = i;
 		}
-		if( ch_count > 1 )
-			twoper++;
+		if( eptr->flags & SF_LONG )
+			nlong++;
 
 		if( level > 2 )
-			fprintf( stderr, "sym: (%d) chained=%ld\n", i, ch_count );
+		{
+			if( eptr->val && eptr->flags & UT_FL_FREE )
+				fprintf( stderr, "sym: (%ld) %s probe=%ld str=(%s)  ref=%u mod=%u\n", 
+					i, SE_NAME( eptr ), plen, (char *) eptr->val, eptr->rcount, eptr->mcount );
+			else
+				fprintf( stderr, "sym: (%ld) %s probe=%ld ptr=%p  ref=%u mod=%u\n", 
+					i, SE_NAME( eptr ), plen, eptr->val, eptr->rcount, eptr->mcount );
+		}
 	}
 
 	if( level > 1 )
 	{
-		fprintf( stderr, "sym: largest chain: (%d) ", maxi );
-		for( eptr = sym_tab[maxi]; eptr; eptr = eptr->next )
-	 		fprintf( stderr, "%s ", eptr->name );
+		fprintf( stderr, "sym: probe lengths:" );
+		for( i = 0; i < 9; i++ )
+			fprintf( stderr, " %ld%s=%ld", i + 1, i == 8 ? "+" : "", hist[i] );
 		fprintf( stderr, "\n" );
+		if( max_probe > 0 )
+			fprintf( stderr, "sym: longest probe: (%ld) %s\n", maxi, SE_NAME( &table->slots[maxi] ) );
 	}
 
-	fprintf( stderr, "sym:%ld(size)  %ld(inhab) %ld(occupied) %ld(dead) %ld(maxch) %d(>2per)\n", 
-			table->size, table->inhabitants, table->size - empty, table->deaths, max_chain, twoper );
+	fprintf( stderr, "sym:%ld(size)  %ld(inhab) %ld(tombs) %ld(dead) %.2f(avgprobe) %ld(maxprobe) %ld(longnames)\n", 
+			table->size, table->inhabitants, table->tombs, table->deaths,
+			table->inhabitants ? (double) tot_probe / table->inhabitants : 0.0, max_probe, nlong );
 }
 
+/*
+	Invoke the user function for each element in the class. The user function may
+	delete the element it is given (elements do not move on delete). Elements added
+	by the user function may, or may not, be visited.
+*/
 void sym_foreach_class( void *vst, unsigned int class, void (* user_fun)( void*, void*, const char*, void*, void* ), void *user_data )
 {
 	Sym_tab	*st;
-	Sym_ele **list;
 	Sym_ele *se;
-	Sym_ele *next;		/* allows user to delete the node(s) we return */
-	int 	i;
+	long 	i;
 
 	st = (Sym_tab *) vst;
 
-	if( st && (list = st->symlist) != NULL && user_fun != NULL )
+	if( st && st->slots != NULL && user_fun != NULL )
+	{
+		st->walking++;
 		for( i = 0; i < st->size; i++ )
-			for( se = list[i]; se; se = next )		/* using next allows user to delet via this */
-			{
-				next = se->next;
-				if( class == se->class )
-					user_fun( st, se, se->name, se->val, user_data );
-			}
+		{
+			se = &st->slots[i];
+			if( SE_LIVE( se ) && class == se->class )
+				user_fun( st, se, SE_NAME( se ), se->val, user_data );
+		}
+		st->walking--;
+	}
 }
@@ -0,0 +1,145 @@
+// :vi ts=4 sw=4 noet :
+/*
+	Mneminic:	symtab_test.c
+	Abstract: 	Unit test for the symtab module. Loads enough names to force the
+				table to grow several times, checks that classes keep duplicate
+				names apart, that long (not inline) names work, that deletes
+				leave everything else reachable, and that the user function
+				driven by foreach may delete the element it is given.
+
+				Usage: symtab_test [n-names]   (default 20000)
+
+	Date:		16 Oct 2026
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "symtab.c"
+
+/*
+	Build the i'th name; every 7th is long enough to not be kept inline.
+*/
+static char* mk_name( char* buf, int len, int i ) {
+	if( i % 7 == 0 ) {
+		snprintf( buf, len, "a-rather-long-symbol-name-which-will-not-fit-%d", i );
+	} else {
+		snprintf( buf, len, "fa:ce:%02x:%02x:%02x", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff );
+	}
+
+	return buf;
+}
+
+/*
+	Foreach callback: delete every element with an odd value and count them.
+*/
+static void del_odd( void* st, void* se, const char* name, void* val, void* data ) {
+	if( ((long) val) & 1 ) {
+		sym_del( st, name, 1 );
+		(*((int *) data))++;
+	}
+}
+
+int main( int argc, char** argv ) {
+	void*	st;
+	char	name[128];
+	long	v;
+	int		n = 20000;
+	int		errors = 0;
+	int		deleted = 0;
+	int		i;
+
+	if( argc > 1 ) {
+		n = atoi( argv[1] );
+	}
+
+	if( sizeof( Sym_ele ) != 64 ) {
+		fprintf( stderr, "[FAIL] element is %d bytes, expected one cache line\n", (int) sizeof( Sym_ele ) );
+		errors++;
+	}
+
+	st = sym_alloc( 11 );
+	for( i = 0; i < n; i++ ) {
+		mk_name( name, sizeof( name ), i );
+		if( sym_map( st, name, 1, (void *) (long) (i + 1) ) != 1 ) {
+			fprintf( stderr, "[FAIL] %s reported as existing on first insert\n", name );
+			errors++;
+		}
+		sym_put( st, name, 2, "class2" );						// same name, different class
+	}
+
+	if( sym_map( st, mk_name( name, sizeof( name ), 3 ), 1, (void *) 6L ) != 0 || sym_get( st, name, 1 ) != (void *) 6L ) {
+		fprintf( stderr, "[FAIL] replace reported as new or value not replaced\n" );
+		errors++;
+	}
+	sym_map( st, name, 1, (void *) 4L );								// put back the original value
+	fprintf( stderr, "[OK]   %d names loaded in two classes; table grew to %ld slots\n", n, ((Sym_tab *) st)->size );
+
+	for( i = 0; i < n; i++ ) {
+		mk_name( name, sizeof( name ), i );
+		v = (long) sym_get( st, name, 1 );
+		if( v != (long) (i + 1) ) {
+			fprintf( stderr, "[FAIL] %s class 1 returned %ld expected %d\n", name, v, i + 1 );
+			errors++;
+		}
+		if( sym_get( st, name, 2 ) == NULL || strcmp( sym_get( st, name, 2 ), "class2" ) != 0 ) {
+			fprintf( stderr, "[FAIL] %s class 2 value missing or wrong\n", name );
+			errors++;
+		}
+	}
+	if( sym_get( st, "no-such-name", 1 ) != NULL || sym_get( st, mk_name( name, sizeof( name ), 1 ), 3 ) != NULL ) {
+		fprintf( stderr, "[FAIL] lookup of missing name/class succeeded\n" );
+		errors++;
+	}
+
+	sym_foreach_class( st, 1, del_odd, &deleted );
+	if( deleted != (n + 1) / 2 ) {
+		fprintf( stderr, "[FAIL] foreach deleted %d, expected %d\n", deleted, (n + 1) / 2 );
+		errors++;
+	}
+
+	for( i = 0; i < n; i++ ) {
+		mk_name( name, sizeof( name ), i );
+		v = (long) sym_get( st, name, 1 );
+		if( (i & 1) == 0 && v != 0 ) {										// value i+1 was odd, so deleted
+			fprintf( stderr, "[FAIL] %s still present after delete\n", name );
+			errors++;
+		}
+		if( (i & 1) != 0 && v != (long) (i + 1) ) {
+			fprintf( stderr, "[FAIL] %s lost after deletes of its neighbours\n", name );
+			errors++;
+		}
+		if( sym_get( st, name, 2 ) == NULL ) {
+			fprintf( stderr, "[FAIL] %s class 2 lost after class 1 deletes\n", name );
+			errors++;
+		}
+	}
+
+	for( i = 0; i < n; i += 2 ) {											// reinsert over the tombstones
+		sym_map( st, mk_name( name, sizeof( name ), i ), 1, (void *) (long) (i + 1) );
+	}
+	for( i = 0; i < n; i++ ) {
+		if( (long) sym_get( st, mk_name( name, sizeof( name ), i ), 1 ) != (long) (i + 1) ) {
+			fprintf( stderr, "[FAIL] %s wrong after reinsert\n", name );
+			errors++;
+		}
+	}
+	fprintf( stderr, "[%s] delete during foreach and reinsert\n", errors ? "FAIL" : "OK  " );
+
+	sym_stats( st, 2 );
+	if( ((Sym_tab *) st)->inhabitants != n * 2 ) {
+		fprintf( stderr, "[FAIL] inhabitants %ld expected %d\n", ((Sym_tab *) st)->inhabitants, n * 2 );
+		errors++;
+	}
+
+	sym_clear( st );
+	if( ((Sym_tab *) st)->inhabitants != 0 || sym_get( st, mk_name( name, sizeof( name ), 1 ), 1 ) != NULL ) {
+		fprintf( stderr, "[FAIL] table not empty after clear\n" );
+		errors++;
+	}
+	sym_free( st );
+
+	fprintf( stderr, "\n%s\n", errors ? "[FAIL] one or more tests failed" : "[PASS] all tests passed" );
+	return errors != 0;
+}
@@ -36,6 +36,7 @@
 #define RF_INITIALISED	0x02		// init has finished
 #define RF_ENABLE_FC	0x04		// enable flow control for all PFs
 #define RF_NO_HUGE		0x08		// disable huget pages
+#define RF_ENABLE_RATES	0x10		// start the rate sampler (a 1Hz nic sweep of every VF)
 
 #define MAX_TCS			8			// max number of traffic classes supported (0 - 7)
 #define NUM_BWGS		8			// number of bandwidth groups
@@ -84,12 +85,18 @@ typedef struct {
 	int		dpdk_log_level;			// log level passed to dpdk; allow it to be different than verbose level
 	int		dpdk_init_log_level;	// log level for dpdk during initialisation
 	char*	fifo_path;      		// path to fifo that cli will write to
+	char*	sock_path;				// path of the unix (seqpacket) request socket; alternative to the fifo
 	int		log_keep;       		// number of days of logs to keep (do we need this?)
 	int		delete_keep;			// if true we will keep the deleted config files in the confid directory (marked with trailing -)
 	double	cpu_alrm_thresh;		// we'll alarm if our cpu usage is over this amount
 	char*	cpu_alrm_type;			// allow user to decide if these are critical, errors, or just warnings; default is warn
 	char*	config_dir;     		// directory where nova writes pf config files
 	char*	stats_path;				// filename where we might dump stats
+	int		stats_ivl;				// ms between stats snapshot sweeps; 0 sweeps only on demand
+	char*	shm_path;				// shared memory stats segment published for external readers; empty string disables
+	char*	metrics_addr;			// metrics exporter: unix socket path or loopback [host:]port; nil disables
+	char**	xstats;					// extended stat name patterns (fnmatch) shown/exported; nil uses the defaults
+	int		nxstats;
 	char*	pid_fname;				// if we daemonise we should write our pid here.
 	char*	cpu_mask;				// should be something like 0x04, but could be decimal.  string so it can have lead 0x
 	char*	numa_mem;				// something like 64 or 64,64 or 64,128.  For our little app, the default 64,64 should be fine
@@ -113,7 +120,7 @@ typedef struct {
 	uid_t	owner;					// user id that owns the file (used for pre/post command execution)
 	char*	name;					// nova supplied name or id; mostly ignored by us, but possibly useful
 	char*	pciid;					// physical interface id (0000:07:00.1)
-	int		vfid;					// the vf on the pf 1-32
+	int		vfid;					// the vf on the pf 0 - (configured VFs - 1)
 	int		strip_stag;				// bool
 	int		strip_ctag;				// bool
 	int		allow_bcast;			// bool
@@ -162,6 +169,7 @@ void ng_flow_ref( void *vf, char *buf, long len );
 extern void* rfifo_create( char* fname, int mode );
 extern void rfifo_close( void* vfifo );
 extern void rfifo_detect_close( void* vfifo );
+extern int rfifo_fd( void* vfifo );
 extern void* rfifo_open( char* fname, int mode );
 extern char* rfifo_read( void* vfifo );
 extern char* rfifo_readln( void* vfifo );
@@ -197,15 +205,19 @@ extern void bleat_printf( int level, const char* fmt, ... );
 extern int user_cmd( uid_t uid, char* cmd );
 
 //---------------- jwrapper -------------------------------------------------------------------------------
+#define JW_ARENA_SIZE	16384		// caller buffer size for jw_new_arena() which covers typical configs and requests
 extern void jw_nuke( void* st );
 extern void* jw_new( char* json );
+extern void* jw_new_arena( char* json, void* buf, int blen );
 extern int jw_missing( void* st, const char* name );
 extern int jw_exists( void* st, const char* name );
 extern char* jw_string( void* st, const char* name );
 extern float jw_value( void* st, const char* name );
+extern long long jw_ivalue( void* st, const char* name );
 extern void* jw_blob( void* st, const char* name );
 extern char* jw_string_ele( void* st, const char* name, int idx );
 extern float jw_value_ele( void* st, const char* name, int idx );
+extern long long jw_ivalue_ele( void* st, const char* name, int idx );
 extern void* jw_obj_ele( void* st, const char* name, int idx );
 extern int jw_array_len( void* st, const char* name );
 
@@ -241,5 +253,66 @@ extern int file_exists( const_str pathname );
 extern int cp_file( const_str path1, const_str path2, int rm_src );
 
 
+//----------------- shm_stats  ---------------------------------------------------------------------------------
+/*
+	Layout of the shared memory stats segment VFd publishes (default /dev/shm/vfd_stats).
+	The header is followed by nrecs records, each rec_size bytes, starting at hdr_size
+	from the front of the segment; readers must use the sizes from the header rather
+	than sizeof() so that fields can be appended without breaking old readers.
+
+	Each record (and the header) is guarded by a sequence number which is odd while
+	VFd is writing it. Readers copy the record and retry if the sequence was odd or
+	changed while copying; shm_stats_read() does this.
+*/
+#define SHM_STATS_PATH		"/dev/shm/vfd_stats"
+#define SHM_STATS_MAGIC		0x56464453		// "VFDS"
+#define SHM_STATS_VERSION	1
+
+typedef struct shm_stats_hdr {
+	uint32_t	magic;				// written last by VFd; segment is not usable until set
+	uint32_t	version;
+	uint32_t	hdr_size;			// offset of the first record
+	uint32_t	rec_size;			// stride between records
+	uint32_t	nrecs;				// records allocated
+	uint32_t	nused;				// records currently valid (0 - nused-1)
+	uint32_t	seq;				// header sequence (odd while being updated)
+	uint32_t	pid;				// pid of the writer; 0 once VFd has stopped
+	uint64_t	gen;				// stats sweep generation which last updated the segment
+	int64_t		ms;					// wall clock (epoch ms) of the last update
+} __attribute__ ((aligned (64))) shm_stats_hdr_t;
+
+typedef struct shm_stats_rec {
+	uint32_t	seq;				// record sequence (odd while being updated)
+	int16_t		port;				// rte port number of the pf
+	int16_t		vf;					// vf number; -1 for the pf itself
+	uint8_t		link;				// pf: link is up; vf: rx queue is ready
+	uint8_t		valid;
+	uint32_t	speed;				// pf link speed (Mb/s); 0 for vfs
+	char		pciid[16];			// 0000:08:00.0 form
+	uint64_t	gen;				// sweep generation of these values
+	int64_t		ms;					// wall clock (epoch ms) of the sweep
+	uint64_t	ipackets;
+	uint64_t	ibytes;
+	uint64_t	ierrors;
+	uint64_t	imissed;
+	uint64_t	nombuf;
+	uint64_t	opackets;
+	uint64_t	obytes;
+	uint64_t	oerrors;
+	uint64_t	spoofed;
+} __attribute__ ((aligned (64))) shm_stats_rec_t;
+
+										// writer side (VFd)
+extern void* shm_stats_create( const_str path, int nrecs );
+extern shm_stats_rec_t* shm_stats_wbegin( void* vseg, int idx );
+extern void shm_stats_wend( shm_stats_rec_t* rec );
+extern void shm_stats_commit( void* vseg, int nused, uint64_t gen, int64_t ms );
+										// reader side
+extern void* shm_stats_open( const_str path );
+extern int shm_stats_hdr( void* vseg, shm_stats_hdr_t* hdr );
+extern int shm_stats_read( void* vseg, int idx, shm_stats_rec_t* rec );
+extern int shm_stats_find( void* vseg, int port, int vf, shm_stats_rec_t* rec );
+extern void shm_stats_close( void* vseg );
+
 
 #endif
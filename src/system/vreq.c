@@ -12,6 +12,8 @@
 				invoke this for the generic user commands).
 	Author:		E. Scott Daniels
 	Date:		03 April 2017
+
+	Mods:		16 Oct 2026 - Add -s option to send requests over VFd's unix request socket.
 */
 
 #include <fcntl.h>
@@ -22,6 +24,8 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include <vfdlib.h>
 
@@ -32,15 +36,18 @@ typedef struct {
 	char	**argv;				// first positional parm
 	char*	vfd_channel;		// channel to vfd (fifo file name most likely)
 	char*	resp_channel;		// where we create fifo for response
+	char*	sock_path;			// VFd's request socket if we are to use it rather than the fifo
 } cl_parms_t;
 
+static int vsock = -1;			// connection to VFd's request socket when -s given
+
 /*
 	Present a usage message.
 */
 static void usage( void ) {
 	const char *version = VERSION "    build: " __DATE__ " " __TIME__;
 
-	fprintf( stdout, "vreq [-c channel-path] {dump | show {all|n|ex|pfs} | ping}\n" );
+	fprintf( stdout, "vreq [-c channel-path] [-s socket-path] {dump | show {all|n|ex|pfs} | ping}\n" );
 }
 
 /*
@@ -93,6 +100,10 @@ extern cl_parms_t* crack_args( int argc, char** argv ) {
 				case 'c':							// alternate fifo (channel) that VFd is reading from
 					parms->vfd_channel = get_nxt( argc, argv, &parg );		// get parm and inc parg
 					break;
+
+				case 's':							// use the request socket
+					parms->sock_path = get_nxt( argc, argv, &parg );
+					break;
 				
 				case '?':
 					usage();
@@ -123,11 +134,45 @@ extern cl_parms_t* crack_args( int argc, char** argv ) {
 
 
 /*
-	Open the VFd request channel.
+	Connect to VFd's request socket. Returns the fd or -1 on error.
+*/
+static int connect_sock( char* path ) {
+	struct sockaddr_un	addr;
+	int	fd;
+
+	if( strlen( path ) >= sizeof( addr.sun_path ) ) {
+		fprintf( stderr, "request socket path too long: %s\n", path );
+		return -1;
+	}
+
+	if( (fd = socket( AF_UNIX, SOCK_SEQPACKET, 0 )) < 0 ) {
+		fprintf( stderr, "unable to create socket: %s\n", strerror( errno ) );
+		return -1;
+	}
+
+	memset( &addr, 0, sizeof( addr ) );
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, path );
+	if( connect( fd, (struct sockaddr *) &addr, sizeof( addr ) ) < 0 ) {
+		fprintf( stderr, "unable to connect to VFd request socket: %s: %s\n", path, strerror( errno ) );
+		close( fd );
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+	Open the VFd request channel. When using the request socket this is a dup of
+	the connection so that the caller may close it as it would the fifo.
 */
 int open_rchannel( char* v_chan ) {
 	int vfifo;
 
+	if( vsock >= 0 ) {
+		return dup( vsock );
+	}
+
 	if( (vfifo = open( v_chan, O_RDWR, 0 )) < 0 ) {
 		fprintf( stderr, "unable to open VFd request channel: %s: %s\n", v_chan, strerror( errno ) );
 		return -1;
@@ -243,18 +288,23 @@ int main( int argc, char** argv ) {
 
 	//snprintf( resp_fname, sizeof( resp_fname ), "/tmp/PID%d.resp", getpid() );
 
-	if( (resp_fifo = rfifo_create( parms->resp_channel, 0666 )) == NULL ) {
-		fprintf( stderr, "unable to create response channel: %s: %s\n", parms->resp_channel, strerror( errno ) );
-		exit( 1 );
-	}
-	rfifo_detect_close( resp_fifo );		// detect when other side closes the fifo; will give us an empty buffer on the next read
-
-
 	if( parms == NULL || parms->argc < 1 ) {
 		usage();
 		exit( 1 );
 	}
 
+	if( parms->sock_path != NULL ) {
+		if( (vsock = connect_sock( parms->sock_path )) < 0 ) {
+			exit( 1 );
+		}
+	} else {
+		if( (resp_fifo = rfifo_create( parms->resp_channel, 0666 )) == NULL ) {
+			fprintf( stderr, "unable to create response channel: %s: %s\n", parms->resp_channel, strerror( errno ) );
+			exit( 1 );
+		}
+		rfifo_detect_close( resp_fifo );		// detect when other side closes the fifo; will give us an empty buffer on the next read
+	}
+
 	switch( *(parms->argv[0]) ) {		// jump table based on first char faster than nested strcmps; for now all are unique on 1st char
 		case 'd':
 			ok2read = do_dump( parms->vfd_channel, parms->resp_channel );
@@ -276,6 +326,22 @@ int main( int argc, char** argv ) {
 			break;
 	}
 
+	if( ok2read && vsock >= 0 ) {										// response comes back on the connection; read until end of message marker
+		char	rbuf[65537];
+		int		len;
+
+		while( (len = recv( vsock, rbuf, sizeof( rbuf ) - 1, 0 )) > 0 ) {
+			rbuf[len] = 0;
+			fprintf( stdout, "%s", rbuf );
+			if( strstr( rbuf, "@eom@" ) != NULL ) {
+				break;
+			}
+		}
+
+		close( vsock );
+		return 0;
+	}
+
 	if( ok2read ) {
 		char* rbuf;
 		int		timeout = 100;			// wait 10 seconds for initial response
@@ -0,0 +1,202 @@
+// :vi noet tw=4 ts=4:
+/*
+	Mnemonic:	vstats.c
+	Abstract:	Dump the counters VFd publishes in its shared memory stats segment.
+				Unlike vreq this does not send a request to VFd; it maps the segment
+				read only and so can be run as often as needed by any user who can
+				read the segment, without adding load to VFd.
+
+				Usage:	vfd_stats [-p segment-path] [-i seconds] [-c count] [port[:vf]]
+
+				With -i the dump is repeated every seconds (count times if -c is
+				given). A port, or port:vf, limits the output; vf may be pf to show
+				only the pf record.
+	Date:		16 Oct 2026
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <vfdlib.h>
+
+#define VERSION "v1.0"
+
+typedef struct {
+	char*	path;				// segment
+	int		ivl;				// seconds between dumps; 0 == once
+	int		count;				// number of dumps when ivl is set; 0 == forever
+	int		port;				// -1 == all
+	int		vf;					// -2 == all, -1 == just the pf
+} cl_parms_t;
+
+static void usage( void ) {
+	fprintf( stdout, "vfd_stats %s [-p segment-path] [-i seconds] [-c count] [port[:vf|:pf]]\n", VERSION );
+}
+
+static char* get_nxt( int argc, char** argv, int* pidx ) {
+	if( *pidx >= argc || argv[*pidx] == NULL ) {
+		fprintf( stderr, "abort: missing command line data; unable to parse command line\n" );
+		usage( );
+		exit( 1 );
+	}
+
+	(*pidx)++;
+	return argv[(*pidx-1)];
+}
+
+static void crack_args( int argc, char** argv, cl_parms_t* parms ) {
+	int		parg = 1;
+	char*	opt;
+	char*	tok;
+
+	memset( parms, 0, sizeof( *parms ) );
+	parms->path = SHM_STATS_PATH;
+	parms->port = -1;
+	parms->vf = -2;
+
+	while( parg < argc ) {
+		opt = argv[parg++];
+		if( *opt != '-' ) {
+			parg--;
+			break;
+		} else {
+			if( strcmp( opt, "--" ) == 0 ) {
+				break;
+			}
+		}
+
+		for( opt++; *opt; opt++ ) {
+			switch( *opt ) {
+				case 'c':
+					parms->count = atoi( get_nxt( argc, argv, &parg ) );
+					break;
+
+				case 'i':
+					parms->ivl = atoi( get_nxt( argc, argv, &parg ) );
+					break;
+
+				case 'p':
+					parms->path = get_nxt( argc, argv, &parg );
+					break;
+
+				case '?':
+					usage();
+					exit( 0 );
+					break;
+
+				default:
+					fprintf( stderr, "unrecognised commandline flag: %c\n", *opt );
+					usage();
+					exit( 1 );
+			}
+		}
+	}
+
+	if( parg < argc ) {						// port[:vf]
+		parms->port = atoi( argv[parg] );
+		if( (tok = strchr( argv[parg], ':' )) != NULL ) {
+			tok++;
+			parms->vf = strcmp( tok, "pf" ) == 0 ? -1 : atoi( tok );
+		}
+	}
+}
+
+/*
+	Write one dump of the segment to stdout. Returns 0 if VFd is no longer
+	writing to the segment (caller should reopen).
+*/
+static int dump( void* seg, cl_parms_t* parms ) {
+	shm_stats_hdr_t	hdr;
+	shm_stats_rec_t	rec;
+	long long	age;
+	char		vfs[16];
+	int			i;
+
+	if( ! shm_stats_hdr( seg, &hdr ) ) {
+		fprintf( stderr, "unable to read segment header: %s\n", strerror( errno ) );
+		return 1;
+	}
+
+	if( hdr.pid == 0 ) {
+		return 0;
+	}
+
+	age = 0;
+	if( hdr.ms > 0 ) {
+		struct timespec ts;
+
+		clock_gettime( CLOCK_REALTIME, &ts );
+		age = ((long long) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000) - hdr.ms;
+	}
+
+	fprintf( stdout, "vfd pid %u  sweep %llu  age %lldms  records %u/%u\n", hdr.pid, (unsigned long long) hdr.gen, age, hdr.nused, hdr.nrecs );
+	fprintf( stdout, "%4s %4s %-13s %4s %6s %15s %15s %10s %10s %15s %15s %10s %10s\n",
+		"port", "vf", "pciid", "link", "speed", "rx-pkts", "rx-bytes", "rx-errs", "rx-drop", "tx-pkts", "tx-bytes", "tx-errs", "spoofed" );
+
+	for( i = 0; (uint32_t) i < hdr.nused; i++ ) {
+		if( ! shm_stats_read( seg, i, &rec ) ) {
+			continue;
+		}
+		if( parms->port >= 0 && rec.port != parms->port ) {
+			continue;
+		}
+		if( parms->vf > -2 && rec.vf != parms->vf ) {
+			continue;
+		}
+
+		if( rec.vf < 0 ) {
+			strcpy( vfs, "pf" );
+		} else {
+			snprintf( vfs, sizeof( vfs ), "%d", rec.vf );
+		}
+		fprintf( stdout, "%4d %4s %-13s %4s %6u %15llu %15llu %10llu %10llu %15llu %15llu %10llu %10llu\n",
+			rec.port, vfs, rec.pciid, rec.link ? "UP" : "DOWN", rec.speed,
+			(unsigned long long) rec.ipackets, (unsigned long long) rec.ibytes, (unsigned long long) rec.ierrors,
+			(unsigned long long) (rec.imissed + rec.nombuf),
+			(unsigned long long) rec.opackets, (unsigned long long) rec.obytes, (unsigned long long) rec.oerrors,
+			(unsigned long long) rec.spoofed );
+	}
+
+	return 1;
+}
+
+int main( int argc, char** argv ) {
+	cl_parms_t	parms;
+	void*	seg;
+	int		n = 0;
+	int		reopened = 0;
+
+	crack_args( argc, argv, &parms );
+
+	if( (seg = shm_stats_open( parms.path )) == NULL ) {
+		fprintf( stderr, "unable to open stats segment: %s: %s\n", parms.path, strerror( errno ) );
+		exit( 1 );
+	}
+
+	while( 1 ) {
+		if( ! dump( seg, &parms ) ) {						// vfd restarted or stopped; try to pick up a new segment
+			shm_stats_close( seg );
+			if( reopened || (seg = shm_stats_open( parms.path )) == NULL ) {
+				fprintf( stderr, "VFd is not publishing stats: %s\n", parms.path );
+				exit( 1 );
+			}
+			reopened = 1;
+			continue;
+		}
+
+		reopened = 0;
+		n++;
+		if( parms.ivl <= 0 || (parms.count > 0 && n >= parms.count) ) {
+			break;
+		}
+
+		fprintf( stdout, "\n" );
+		sleep( parms.ivl );
+	}
+
+	shm_stats_close( seg );
+	return 0;
+}
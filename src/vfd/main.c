@@ -80,6 +80,38 @@
 				19 Feb 2018 - Add support to ensure config directories exist. (#263)
 				26 Mar 2018 - Send log to file unless log_dir == stderr; allow -f for container with log file.
 				18 Apr 2018 - Correct stop point when dumping mac addresses.
+				16 Oct 2026 - Replace the 50ms polling sleep in the main loop with an epoll
+							driven loop (request fifo, callback wake eventfd, housekeeping timerfd).
+				16 Oct 2026 - Update nic now works from a per-port dirty list of VFs and pushes
+							port level settings only when the port changes; nic calls are counted
+							and reported by show.
+				16 Oct 2026 - Restore marks all matched VFs and makes a single update pass.
+				16 Oct 2026 - Driver ops are selected for each PF as it is mapped.
+				16 Oct 2026 - Batch qos credit register writes; show register access counters.
+				16 Oct 2026 - Show refresh queue counters.
+				16 Oct 2026 - Start the mailbox event worker; show its counters.
+				16 Oct 2026 - Show per VF mailbox suppression counters.
+				16 Oct 2026 - Serve requests on the unix request socket as well as the fifo.
+				16 Oct 2026 - Start the request nic worker; show its counters.
+				16 Oct 2026 - Show formats from the stats snapshot; build the response linearly.
+				16 Oct 2026 - Start the rate sampler.
+				16 Oct 2026 - Publish stats to the shared memory segment.
+				16 Oct 2026 - Start the metrics exporter.
+				16 Oct 2026 - Set the xstats selection and resolve it as each port is initialised.
+				16 Oct 2026 - MACs in the dump are formatted from their 48 bit values.
+				16 Oct 2026 - Size each port's VF arrays when the port is mapped.
+				16 Oct 2026 - suss_vf()/suss_mirror() use the port's vfid map; suss_port()
+							bounds the rte port by the map size rather than the port count.
+				16 Oct 2026 - Split drop enable is set for the VFs the port has, not a fixed 64;
+							vlan filter masks are vf_mask_t.
+				16 Oct 2026 - Vlan filters are pushed per vlan from the port's vlan table (vfd_vlan.c)
+							rather than per vlan of each changed VF.
+				16 Oct 2026 - Drop cmp_vfs(); nothing sorts the VF list with qsort any more.
+				16 Oct 2026 - Keep the 50ms pf rx discard cadence when a port needs it (epoll timeout).
+				16 Oct 2026 - The rate sampler is started only when enable_rates is set.
+				16 Oct 2026 - Ports with failed vlan filter writes are visited by update_nic and
+							retried from housekeeping.
+				16 Oct 2026 - Stop the mailbox worker before the ports are closed.
 */
 
 
@@ -92,6 +124,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
 
 #include "sriov.h"		// main header file
@@ -107,8 +142,20 @@
 #define DEBUG
 #define MAX_ARGV_LEN	64		// number of parms (max) passed on eal_init call
 
+#define HK_TICK_MS		250		// housekeeping (cpu check, stats sweep) timer period
+#define PF_DISCARD_MS	50		// pf rx discard period (nics with NOF_DISCARD_PFRX); what the old polling loop gave
+#define VLAN_RETRY_SEC	5		// failed vlan filter writes on an otherwise quiet port are retried this often
+#define MAX_EVENTS		8		// max events we pull from epoll in one wait
+
+#define EV_FIFO			1		// epoll user data values so we know what popped
+#define EV_WAKE			2
+#define EV_HK			3
+#define EV_SOCK			4
+
 // ---------------------globals: bad form, but unavoidable -------------------------------------------------------
 static parms_t *g_parms = NULL;											// dpdk callback does not allow data pointer so we must have a global. all other functions should accept a pointer!
+static int wake_fd = -1;												// eventfd that callbacks poke to wake the main loop
+static int sock_fd = -1;												// request socket event fd (readable when a socket client needs attention)
 
 
 // -- global initialisation ----
@@ -237,7 +284,9 @@ static void run_stop_cbs( sriov_conf_t* conf ) {
 
 /*
 	Given a dpdk/hardware port id, find our port struct and return a pointer or
-	nil if we cant or it's out of range.
+	nil if we cant or it's out of range. The port is found directly through
+	port2config_map; the port id is an rte port number and so is bounded by
+	the map size, not by the number of ports we manage.
 
 	Depends on global running config so that it may be invoked by the callback
 	driver which gets no dynamic information.
@@ -245,7 +294,7 @@ static void run_stop_cbs( sriov_conf_t* conf ) {
 struct sriov_port_s *suss_port( int portid ) {
 	int		rc_idx; 					// index into our config
 
-	if( portid < 0 || portid > running_config->num_ports ) {
+	if( portid < 0 || portid >= MAX_PORTS ) {
 		bleat_printf( 1, "suss_port: port is out of range: %d", portid );
 		return NULL;
 	}
@@ -274,13 +323,11 @@ struct vf_s *suss_vf( int port, int vfid ) {
 		return NULL;
 	}
 
-	for( i = 0; i < p->num_vfs; i++ ) {
-		if( p->vfs[i].num == vfid ) {					// found it
-			return &p->vfs[i];
-		}
+	if( (i = vf_slot( p, vfid )) < 0 ) {
+		return NULL;
 	}
 
-	return NULL;
+	return &p->vfs[i];
 }
 
 /*
@@ -294,13 +341,11 @@ struct mirror_s* suss_mirror( int port, int vfid ) {
 		return NULL;
 	}
 
-	for( i = 0; i < p->num_vfs; i++ ) {
-		if( p->vfs[i].num == vfid ) {					// found it
-			return &p->mirrors[i];
-		}
+	if( (i = vf_slot( p, vfid )) < 0 ) {
+		return NULL;
 	}
 
-	return NULL;
+	return &p->mirrors[i];
 }
 
 
@@ -437,9 +482,9 @@ static void close_ports( void ) {
 	for( i = 0; i < running_config->num_ports; i++ ) {
 		port = &running_config->ports[i];
 		bleat_printf( 2, "port %d has %d mirrors", port->rte_port_number, port->num_mirrors );
-		for( j = 0; j < MAX_VFS; j++ ) {					// run regardless of what we think the count is!
+		for( j = 0; j < port->vfs_alloc; j++ ) {			// run regardless of what we think the count is!
 			if( port->mirrors[j].dir != MIRROR_OFF ) {
-				bleat_printf( 0, "terminating active mirror on shutdown: pf=%d vf=%d", port->rte_port_number,  port->vfs[i].num );
+				bleat_printf( 0, "terminating active mirror on shutdown: pf=%d vf=%d", port->rte_port_number,  port->vfs[j].num );
 				set_mirror_wrp( port->rte_port_number, port->vfs[j].num,  port->mirrors[j].id, port->mirrors[j].target, MIRROR_OFF );
 			}
 		}
@@ -448,7 +493,7 @@ static void close_ports( void ) {
 
 	bleat_printf( 0, "closing ports" );
 	for( i = 0; i < n_ports; i++) {
-		bleat_printf( 0, "closing port: %d", running_config->ports[i].rte_port_number );
+		bleat_printf( 0, "closing port: %d", i );
 		rte_eth_dev_stop( i );
 		rte_eth_dev_close( i );
 		//rte_eth_dev_detach( i, dev_name );
@@ -607,23 +652,58 @@ static int vfd_eal_init( parms_t* parms ) {
 
 // ----------------- actual nic management ------------------------------------------------------------------------------------
 
+/*
+	Append l bytes of str to the stats buffer growing it (by doubling) if needed so
+	that building the response is linear. Returns the buffer (possibly moved) or
+	NULL if it could not be grown (the old buffer is freed).
+*/
+static char* stats_cat( char* rbuf, int* rblen, int* rbidx, const char* str, int l ) {
+	char*	nbuf;
+
+	if( rbuf == NULL || l <= 0 ) {
+		return rbuf;
+	}
+
+	if( *rbidx + l + 1 > *rblen ) {
+		while( *rbidx + l + 1 > *rblen ) {
+			*rblen *= 2;
+		}
+		if( (nbuf = (char *) realloc( rbuf, sizeof( char ) * *rblen )) == NULL ) {
+			bleat_printf( 0, "ERR: gen_stats: realloc failed" );
+			free( rbuf );
+			return NULL;
+		}
+		rbuf = nbuf;
+	}
+
+	memcpy( rbuf + *rbidx, str, l );
+	*rbidx += l;
+	rbuf[*rbidx] = 0;
+	return rbuf;
+}
+
 /*
 	Generate a set of stats to a single buffer. Return buffer to caller (caller must free).
 	If pf_only is true, then the VF stats are skipped. If pf >= 0, then only that pf, and
 	its VFs are printed.
+
+	PF and VF counters come from the stats snapshot (vfd_stats.c) which is swept
+	again only if it is older than STATS_MAX_AGE.
 */
 char*  gen_stats( sriov_conf_t* conf, int pf_only, int pf ) {
+	const stats_snap_t* snap;
 	char*	rbuf;			// buffer to return
 	int		rblen = 0;		// lenght
 	int		rbidx = 0;
 	char	buf[BUF_SIZE];
 	int		l;
 	int		i;
-	struct rte_eth_dev_info dev_info;
+	int		v;
 
-	rblen = BUF_SIZE;
-	rbuf = (char *) malloc( sizeof( char ) * rblen );
-	if( !rbuf ) {
+	snap = stats_snap_get( conf, STATS_MAX_AGE );
+	rblen = BUF_SIZE + (snap->nports + snap->nvfs) * 256;			// enough for the counters; the rest grows as needed
+	if( (rbuf = (char *) malloc( sizeof( char ) * rblen )) == NULL ) {
+		stats_snap_put( );
 		return NULL;
 	}
 
@@ -642,93 +722,86 @@ char*  gen_stats( sriov_conf_t* conf, int pf_only, int pf ) {
 			 "Spoofed"
 		);
 	
-	for( i = 0; i < conf->num_ports; ++i ) {
+	for( i = 0; i < snap->nports && rbuf != NULL; ++i ) {
 		if( pf > 0 && i != pf ) {					// if specific pf requested, do only that one
 			continue;
 		}
 
-		memset( &dev_info, 0, sizeof( dev_info ) );										// no status from rte function, but if it fails to populate we need to know, so 0s required
-		rte_eth_dev_info_get( conf->ports[i].rte_port_number, &dev_info );				// must use port number that we mapped during initialisation
-
-		if( dev_info.pci_dev == NULL ) {
+		if( ! snap->pf_valid[i] ) {
 			continue;
 		}
 
-		l = snprintf( buf, sizeof( buf ), "%s   %4d    %04X:%02X:%02X.%01X",
-					"pf",
-					conf->ports[i].rte_port_number,
-					dev_info.pci_dev->addr.domain,
-					dev_info.pci_dev->addr.bus,
-					dev_info.pci_dev->addr.devid,
-					dev_info.pci_dev->addr.function);
-							
-		if( l + rbidx > rblen ) {
-			rblen += BUF_SIZE;
-			rbuf = (char *) realloc( rbuf, sizeof( char ) * rblen );
-			if( !rbuf ) {
-				return NULL;
+		l = stats_pf_line( snap, i, buf, sizeof( buf ) );
+		rbuf = stats_cat( rbuf, &rblen, &rbidx, buf, l );
+
+		if( ! pf_only ) {
+			for( v = snap->vf_first[i]; v < snap->vf_first[i] + snap->vf_count[i] && rbuf != NULL; v++ ) {		// configured VFs only, in vf order
+				l = stats_vf_line( snap, v, buf, sizeof( buf ) );
+				rbuf = stats_cat( rbuf, &rblen, &rbidx, buf, l );
 			}
+
+			rbuf = stats_cat( rbuf, &rblen, &rbidx, "\n", 1 );		// extra blank line for easy reading
 		}
+	}
+	stats_snap_put( );
 
-		strcat( rbuf+rbidx,  buf );
-		rbidx += l;		
-   				
-		l = nic_stats_display( conf->ports[i].rte_port_number, buf, sizeof( buf ) );
+	if( rbuf == NULL ) {
+		return NULL;
+	}
 
-		if( l + rbidx > rblen ) {
-			rblen += BUF_SIZE + l;
-			rbuf = (char *) realloc( rbuf, sizeof( char ) * rblen );
-			if( !rbuf ) {
-				return NULL;
-			}
+	l = snprintf( buf, sizeof( buf ), "\nnic updates: %llu  last: %d VFs %d nic calls  total nic calls: %llu\n",
+		(unsigned long long) conf->nupdates, conf->last_nvfs, conf->last_nic_calls, (unsigned long long) conf->tot_nic_calls );
+	rbuf = stats_cat( rbuf, &rblen, &rbidx, buf, l );
+
+	for( i = 0; i < conf->num_ports; ++i ) {									// link flap recovery times, only for ports that have flapped
+		if( conf->ports[i].nrestores <= 0 || (pf > 0 && i != pf) ) {
+			continue;
 		}
-		strcat( rbuf+rbidx,  buf );
-		rbidx += l;
-		
-		if( ! pf_only ) {
-			// pack PCI ARI into 32bit to be used to get VF's ARI later
-			uint32_t pf_ari = dev_info.pci_dev->addr.bus << 8 | dev_info.pci_dev->addr.devid << 3 | dev_info.pci_dev->addr.function;
-			
-			//iterate over active (configured) VF's only
-			int * vf_arr = malloc(sizeof(int) * conf->ports[i].num_vfs);
-			int v;
-			for (v = 0; v < conf->ports[i].num_vfs; v++)
-				vf_arr[v] = conf->ports[i].vfs[v].num;
-
-			// sort vf numbers
-			qsort(vf_arr, conf->ports[i].num_vfs, sizeof(int), cmp_vfs);
-			
-			for (v = 0; v < conf->ports[i].num_vfs; v++) {
-				if( (l = vf_stats_display(conf->ports[i].rte_port_number, pf_ari, vf_arr[v], buf, sizeof( buf ))) > 0 ) {  // < 0 out of range, not in use
-					if( l + rbidx > rblen ) {
-						rblen += BUF_SIZE + l;
-						rbuf = (char *) realloc( rbuf, sizeof( char ) * rblen );
-						if( !rbuf ) {
-							bleat_printf( 0, "ERR: gen_stats: realloc failed");
-							return NULL;
-						}
-					}
-					strcat( rbuf+rbidx,  buf );
-					rbidx += l;
-				}
-			}		
-			free(vf_arr);
+
+		l = snprintf( buf, sizeof( buf ), "pf %d link restores: %d  last: %d VFs in %.3fms  worst: %.3fms\n",
+			conf->ports[i].rte_port_number, conf->ports[i].nrestores, conf->ports[i].restore_nvfs,
+			conf->ports[i].restore_ms, conf->ports[i].restore_max_ms );
+		rbuf = stats_cat( rbuf, &rblen, &rbidx, buf, l );
+	}
+
+	for( i = 0; i < conf->num_ports; ++i ) {									// direct register access counters (niantic only)
+		if( pf > 0 && i != pf ) {
+			continue;
 		}
 
-		if( !pf_only ) {
-			strcat( rbuf+rbidx, "\n" );		// extra blank line for easy reading
-			rbidx++;
+		if( (l = reg_stats( conf->ports[i].rte_port_number, buf, sizeof( buf ) )) > 0 ) {
+			rbuf = stats_cat( rbuf, &rblen, &rbidx, buf, l );
 		}
 	}
 
-	bleat_printf( 2, "status buffer size: %d", rbidx );
-	return rbuf;
-}
+	l = mbq_stats_str( buf, sizeof( buf ) );									// mailbox event queue counters
+	rbuf = stats_cat( rbuf, &rblen, &rbidx, buf, l );
 
-int
-cmp_vfs (const void * a, const void * b)
-{
-   return ( *(const int*)a - *(const int*)b );
+	l = vfd_req_stats( buf, sizeof( buf ) );									// request lane counters
+	rbuf = stats_cat( rbuf, &rblen, &rbidx, buf, l );
+
+	l = stats_engine_str( buf, sizeof( buf ) );									// snapshot sweep counters
+	rbuf = stats_cat( rbuf, &rblen, &rbidx, buf, l );
+
+	l = refresh_stats( buf, sizeof( buf ) );									// pending reset (refresh queue) counters
+	rbuf = stats_cat( rbuf, &rblen, &rbidx, buf, l );
+
+	for( i = 0; i < conf->num_ports; ++i ) {									// per vf mailbox suppression, only VFs that have been throttled
+		if( pf > 0 && i != pf ) {
+			continue;
+		}
+
+		for( v = 0; v < conf->ports[i].num_vfs; v++ ) {
+			if( (l = mb_vf_stats( conf->ports[i].rte_port_number, conf->ports[i].vfs[v].num, buf, sizeof( buf ) )) > 0 ) {
+				rbuf = stats_cat( rbuf, &rblen, &rbidx, buf, l );
+			}
+		}
+	}
+
+	if( rbuf != NULL ) {
+		bleat_printf( 2, "status buffer size: %d", rbidx );
+	}
+	return rbuf;
 }
 
 /*
@@ -806,6 +879,81 @@ extern void log_port_state( struct sriov_port_s* port, const_str msg ) {
 	}
 }
 
+/*
+	Mark the VF at index vidx in the port's vfs array as changed and put it on
+	the port's dirty list (if not already there). State is one of ADDED, DELETED
+	or RESET. A reset never overrides a pending add or delete as both of those
+	do everything that a reset would do (and a delete must not be turned back
+	into a reset).  Only VFs on the dirty list are visited by vfd_update_nic().
+
+	Caller MUST hold the update lock.
+*/
+extern void mark_vf_dirty( struct sriov_port_s* port, int vidx, int state ) {
+	struct vf_s* vf;
+
+	if( port == NULL || vidx < 0 || vidx >= port->vfs_alloc ) {
+		return;
+	}
+
+	vf = &port->vfs[vidx];
+	if( state != RESET || vf->last_updated == UNCHANGED ) {
+		vf->last_updated = state;
+	}
+
+	if( ! vf->dirty ) {
+		vf->dirty = 1;
+		port->dirty[port->ndirty++] = vidx;
+	}
+}
+
+/*
+	Push the port level receive mode settings (promisc, allmulticast and the
+	unicast hash table for niantic) to the nic.
+*/
+static void set_port_rxmode( struct sriov_port_s* port ) {
+	int ret;
+
+	if( port->flags & PF_PROMISC ) {
+		bleat_printf( 1, "enabling promiscuous mode for port %d", port->rte_port_number );
+		rte_eth_promiscuous_enable(port->rte_port_number);
+	}
+	else {
+		bleat_printf( 1, "disabling promiscuous mode for port %d", port->rte_port_number );
+		rte_eth_promiscuous_disable(port->rte_port_number);
+	}
+	nic_calls++;
+
+	if (get_nic_type(port->rte_port_number) == VFD_BNXT)
+		rte_eth_allmulticast_disable(port->rte_port_number);
+	else
+		rte_eth_allmulticast_enable(port->rte_port_number);
+	nic_calls++;
+
+	if (get_nic_type(port->rte_port_number) == VFD_NIANTIC) {
+		ret = rte_eth_dev_uc_all_hash_table_set(port->rte_port_number, 1);
+		nic_calls++;
+
+		if (ret < 0)
+			bleat_printf( 0, "ERR: bad unicast hash table parameter, return code = %d", ret);
+	}
+}
+
+/*
+	Returns true if any port has vlan filter writes which failed and are waiting to be
+	retried. Read without the lock; a stale answer just moves the retry a tick.
+*/
+static int vlans_pending( sriov_conf_t* conf ) {
+	int i;
+
+	for( i = 0; i < conf->num_ports; i++ ) {
+		if( conf->ports[i].vlan_pending ) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
 /*
 	Runs through the configuration and makes adjustments.  This is
 	a tweak of the original code (update_ports_config) inasmuch as the dynamic
@@ -816,6 +964,14 @@ extern void log_port_state( struct sriov_port_s* port, const_str msg ) {
 		-1 delete (remove macs and vlans)
 		0  no change, no action
 		1  add (add macs  and vlans)
+		2  reset (push everything again)
+
+	Only the VFs on each port's dirty list (see mark_vf_dirty()) are visited, and
+	ports with nothing on the list which have not themselves changed are skipped.
+	Port level settings (loopback, default pool, rx mode) are pushed only when
+	the port was added, or when a VF on the port was reset as the NIC may have
+	lost them. The number of nic calls made by the pass is kept in the config
+	so that it can be reported by show.
 
 	Bleat messages have been added so that dynamically adjusted verbosity is
 	available.
@@ -829,9 +985,11 @@ extern void log_port_state( struct sriov_port_s* port, const_str msg ) {
 */
 extern int vfd_update_nic( parms_t* parms, sriov_conf_t* conf ) {
 	int i;
+	int d;
 	int need_ready_msg = 0;			// we only write a ready message for the port when added
 	int on = 1;
-    uint32_t vf_mask;
+	int nvfs = 0;					// number of VFs programmed by this pass
+	uint64_t calls_start;			// nic call counter when we started
     int y;
 
 	if( (parms->rflags & RF_INITIALISED) == 0 ) {
@@ -845,68 +1003,59 @@ extern int vfd_update_nic( parms_t* parms, sriov_conf_t* conf ) {
 	}
 
 	rte_spinlock_lock( &running_config->update_lock );
+	calls_start = nic_calls;
 	
 	for (i = 0; i < conf->num_ports; ++i){												// run each port we know about to apply port only changes
-		int ret;
 		struct sriov_port_s* port;
 		struct rte_eth_link link;
+		int	port_reset = 0;					// set if a VF on the port was reset; port level settings must be pushed again
 
 		port = &conf->ports[i];
 
+		if( port->last_updated == UNCHANGED && port->ndirty == 0 && ! port->vlan_pending ) {
+			bleat_printf( 3, "update configs: skipped port, nothing changed: %s/%s", port->name, port->pciid );
+			continue;
+		}
+
+		for( d = 0; d < port->ndirty; d++ ) {
+			if( port->vfs[port->dirty[d]].last_updated == RESET ) {
+				port_reset = 1;
+				vlan_forget( port, &port->vfs[port->dirty[d]] );			// nic may have lost the filters; push them again
+			}
+		}
+
 		rte_eth_link_get_nowait(port->rte_port_number, &link);
 
-		//  WHY is this and disable pool done every time?  why is it not just done at the time of add?
-		tx_set_loopback( port->rte_port_number, !!(port->flags & PF_LOOPBACK) );		// enable loopback if set (disabled: all vm-vm traffic must go to TOR and back
+		if( port->last_updated == ADDED || port_reset ) {
+			tx_set_loopback( port->rte_port_number, !!(port->flags & PF_LOOPBACK) );		// enable loopback if set (disabled: all vm-vm traffic must go to TOR and back
 
-		// do NOT call set_queue_drop() as it causes packetloss; drop enable handled by callback process now
+			// do NOT call set_queue_drop() as it causes packetloss; drop enable handled by callback process now
 
-		disable_default_pool( port->rte_port_number );
+			disable_default_pool( port->rte_port_number );
+			set_port_rxmode( port );
+		}
 
 		if( port->last_updated == ADDED ) {								// updated since last call, reconfigure
 			port->num_mirrors = 0;
 			need_ready_msg = 1;											// log port ready when VFs are finished configuring
 
 			bleat_printf( 1, "port updated: %s/%s",  port->name, port->pciid );
-
-			if( port->flags & PF_PROMISC ) {
-				bleat_printf( 1, "enabling promiscuous mode for port %d", port->rte_port_number );
-				rte_eth_promiscuous_enable(port->rte_port_number);
-			}
-			else {
-				bleat_printf( 1, "disabling promiscuous mode for port %d", port->rte_port_number );
-				rte_eth_promiscuous_disable(port->rte_port_number);
-			}
-			
-			if (get_nic_type(port->rte_port_number) == VFD_BNXT)
-				rte_eth_allmulticast_disable(port->rte_port_number);
-			else
-				rte_eth_allmulticast_enable(port->rte_port_number);
-		
-			if (get_nic_type(port->rte_port_number) == VFD_NIANTIC) {
-				ret = rte_eth_dev_uc_all_hash_table_set(port->rte_port_number, on);
-				
-				if (ret < 0)
-					bleat_printf( 0, "ERR: bad unicast hash table parameter, return code = %d", ret);
-			}	
-
 			port->last_updated = UNCHANGED;								// mark that we did this for next go round
-		} else {
-			bleat_printf( 2, "update configs: skipped port, not changed: %s/%s", port->name, port->pciid );
 		}
 
-	    for(y = 0; y < port->num_vfs; ++y){ 							/* go through all VF's and (un)set VLAN's/macs for any vf that has changed */
-			int v;
-			int	change2port;							// set true if one or more VFs changed; need to redo qos allotment if so
-			struct vf_s *vf = &port->vfs[y];   			// at the VF to work on
+		vlan_push( port );												// one filter write per vlan whose VF membership changed
 
-			vf_mask = VFN2MASK(vf->num);
+	    for( d = 0; d < port->ndirty; d++ ) { 							/* go through the changed VFs and (un)set macs etc. */
+			struct vf_s *vf;
+
+			y = port->dirty[d];											// index of the vf in the port list (mirrors are parallel)
+			vf = &port->vfs[y];   										// at the VF to work on
+			vf->dirty = 0;
 
-			change2port = 0;
 			if( vf->last_updated != UNCHANGED ) {					// this vf was changed (add/del/reset), reconfigure it
 				const char* reason;
 
-				change2port = 1;
-
+				nvfs++;
 				switch( vf->last_updated ) {
 					case ADDED:		
 						reason = "add"; 
@@ -946,33 +1095,12 @@ extern int vfd_update_nic( parms_t* parms, sriov_conf_t* conf ) {
 						}
 					}
 
-					//AZif (get_nic_type(port->rte_port_number) == VFD_NIANTIC)
-					//set_vf_rx_vlan(port->rte_port_number, 0, vf_mask, 0);		// remove vlan id 0 do we need it here for i40e?
-					
-					for(v = 0; v < vf->num_vlans; ++v) {
-						int vlan = vf->vlans[v];
-						int strip_on = (vf->strip_stag || vf->strip_ctag) ? 1 : 0;
-						if ((get_nic_type(port->rte_port_number) != VFD_MLX5) || !strip_on) { // strip/insert vlan is set differently in mlx5
-							bleat_printf( 2, "delete vlan: port: %d vf: %d vlan: %d", port->rte_port_number, vf->num, vlan );
-							set_vf_rx_vlan(port->rte_port_number, vlan, vf_mask, SET_OFF );		// remove the vlan id from the list
-						}
-					}
+					// vlan filters for the VF were removed by vlan_push() above (it left the table on delete)
 				} else {
-					int v;
-
 					if( port->mirrors[y].dir != MIRROR_OFF ) {						// setup the mirror
 						set_mirror_wrp( port->rte_port_number, vf->num, port->mirrors[y].id, port->mirrors[y].target, port->mirrors[y].dir );		// set target and type (in/out/both)
 						port->num_mirrors++;
 					}
-
-					for(v = 0; v < vf->num_vlans; ++v) {
-						int vlan = vf->vlans[v];
-						int strip_on = (vf->strip_stag || vf->strip_ctag) ? 1 : 0;
-						if ((get_nic_type(port->rte_port_number) != VFD_MLX5) || !strip_on) { // strip/insert vlan is set differently in mlx5
-							bleat_printf( 2, "add vlan: port: %d vf=%d vlan=%d", port->rte_port_number, vf->num, vlan );
-							set_vf_rx_vlan(port->rte_port_number, vlan, vf_mask, on );		// add the vlan id to the list
-						}
-					}
 				}
 
 				if( vf->last_updated == DELETED ) {				// delete the macs (need to disable anti-spoof first
@@ -1021,6 +1149,7 @@ extern int vfd_update_nic( parms_t* parms, sriov_conf_t* conf ) {
 					bleat_printf( 2, "port: %d vf: %d set allow mcast to %d", port->rte_port_number, vf->num, SET_OFF );
 					set_vf_allow_mcast(port->rte_port_number, vf->num, SET_OFF);
 				
+					port->vf_slot[vf->num] = -1;				// drop from the vfid map
 					vf->num = -1;								// must reset this so an add request with the now deleted number will succeed
 					// TODO -- is there anything else that we need to clean up in the struct?
 				}
@@ -1055,51 +1184,25 @@ extern int vfd_update_nic( parms_t* parms, sriov_conf_t* conf ) {
 
 
 				vf->last_updated = UNCHANGED;				// mark processed
-			}
 
-			if( change2port && (g_parms->rflags & RF_ENABLE_QOS) ) {		// changes, we must recompute queue shares and push to nic
-				gen_port_qshares( port );									// compute and save in the port struct
-				if (get_nic_type(port->rte_port_number) == VFD_MLX5) {
-					mlx5_set_vf_tcqos( port, link.link_speed );
-				} else {
-					//uint8_t* pp;
-					qos_set_credits( port->rte_port_number, port->mtu, port->vftc_qshares, TC_4PERQ_MODE );	// push out to nic
-					//qos_set_credits( port->rte_port_number, port->mtu, pp, TC_4PERQ_MODE );	// push out to nic
+				if( vf->num >= 0 ) {
+					set_vf_allow_untagged(port->rte_port_number, vf->num, !on);		// don't accept untagged frames
 				}
 			}
+		}				// end for each dirty vf on this port
 
-			if( change2port && vf->num >= 0 ) {
-				bleat_printf( 3, "set promiscuous: port: %d, vf: %d ", port->rte_port_number, vf->num);
-		
-				// az says: figure out if we have to update it every time we change VLANS/MACS
-				// 			or once when update ports config
-				if( port->flags & PF_PROMISC ) {
-					bleat_printf( 1, "enabling promiscuous mode for port %d", port->rte_port_number );
-					rte_eth_promiscuous_enable(port->rte_port_number);
-				}
-				else {
-					bleat_printf( 1, "disabling promiscuous mode for port %d", port->rte_port_number );
-					rte_eth_promiscuous_disable(port->rte_port_number);
-				}
-				
-				if (get_nic_type(port->rte_port_number) == VFD_BNXT)
-					rte_eth_allmulticast_disable(port->rte_port_number);
-				else
-					rte_eth_allmulticast_enable(port->rte_port_number);
-				
-				if (get_nic_type(port->rte_port_number) == VFD_NIANTIC) {
-					ret = rte_eth_dev_uc_all_hash_table_set(port->rte_port_number, on);
-					
-					if (ret < 0)
-						bleat_printf( 0, "ERR: bad unicast hash table parameter, return code = %d", ret);
-				}					
-				
-				// don't accept untagged frames
-				set_vf_allow_untagged(port->rte_port_number, vf->num, !on);
-
-			
+		if( port->ndirty > 0 && (g_parms->rflags & RF_ENABLE_QOS) ) {		// changes, we must recompute queue shares and push to nic (once for the port)
+			gen_port_qshares( port );									// compute and save in the port struct
+			if (get_nic_type(port->rte_port_number) == VFD_MLX5) {
+				mlx5_set_vf_tcqos( port, link.link_speed );
+			} else {
+				reg_batch( port->rte_port_number );						// hold register writes; only changed credits are pushed
+				qos_set_credits( port->rte_port_number, port->mtu, port->vftc_qshares, TC_4PERQ_MODE );	// push out to nic
+				reg_flush( port->rte_port_number );
 			}
-		}				// end for each vf on this port
+			nic_calls++;
+		}
+		port->ndirty = 0;
 
 		if( need_ready_msg ) {									// only on the first port init; all other updates are quiet
 			log_port_state( port, "ready" );
@@ -1107,6 +1210,14 @@ extern int vfd_update_nic( parms_t* parms, sriov_conf_t* conf ) {
 		}
     }   				  // end for each port
 
+	if( nvfs > 0 ) {
+		conf->nupdates++;
+		conf->last_nvfs = nvfs;
+		conf->last_nic_calls = (int) (nic_calls - calls_start);
+		conf->tot_nic_calls += conf->last_nic_calls;
+		bleat_printf( 2, "update_nic: %d VFs programmed with %d nic calls", nvfs, conf->last_nic_calls );
+	}
+
 	rte_spinlock_unlock( &running_config->update_lock );
 	return 0;
 }
@@ -1229,12 +1340,13 @@ timeDelta(struct timeval * now, struct timeval * before)
 
 
 /*
-	This should work without change.
 	Driven to refresh a single vf on a port. Called by the callback which (we assume)
 	is driven by the dpdk environment.
 
-	It does seem to be a duplication of the vfd_update_nic() function.  Would it make
-	sense to set the add flag in the matched VF and then just call update?
+	All matching VFs are marked for reset (put on the port's dirty list) and then a
+	single update_nic() pass is made to push them all to the NIC. Before this, each
+	matched VF drove a full update pass which made a link flap O(VFs^2) work.
+
 	It also seems that deleting VLAN and MAC values might not catch anything/everything
 	that has been set on the VF since it's only working off of the values that are
 	configured here.  Is there a reset all? for these?  If so, that should be worked into
@@ -1243,8 +1355,10 @@ timeDelta(struct timeval * now, struct timeval * before)
 	This function may also be called in an extreme event when all active VFs on the port
 	must be refreshed.  If vf_id passed in is < 0, then we reset all of the VFs that 
 	we are currently managing.
+
+	Returns the number of VFs that were matched and restored.
 */
-void
+int
 restore_vf_setings(portid_t port_id, int vf_id) {
 	int i;
 	int matched = 0;		// number matched for log
@@ -1257,6 +1371,7 @@ restore_vf_setings(portid_t port_id, int vf_id) {
 	//set_vf_allow_untagged(port_id, vf_id, 0);	
 	
 	bleat_printf( 3, "restore settings begins" );
+	rte_spinlock_lock( &running_config->update_lock );
 	for (i = 0; i < running_config->num_ports; ++i){
 		struct sriov_port_s *port = &running_config->ports[i];
 
@@ -1267,19 +1382,22 @@ restore_vf_setings(portid_t port_id, int vf_id) {
 				struct vf_s *vf = &port->vfs[y];
 
 				if( (vf_id < 0 && vf->num >= 0) || (vf_id == vf->num) ){
-					//uint32_t vf_mask = VFN2MASK(vf->num);
-
 					matched++;															// for bleat message at end
-					vf->last_updated = RESET;											// flag for update_nic()
-					if( vfd_update_nic( g_parms, running_config ) != 0 ) {				// now that dpdk is initialised run the list and 'activate' everything
-						bleat_printf( 0, "WRN: reset of port %d vf %d failed", port_id, vf_id );
-					}
+					mark_vf_dirty( port, y, RESET );									// flag for update_nic()
 				}
 			}
 		}
 	}
+	rte_spinlock_unlock( &running_config->update_lock );
+
+	if( matched > 0 ) {
+		if( vfd_update_nic( g_parms, running_config ) != 0 ) {				// one pass pushes all of the marked VFs
+			bleat_printf( 0, "WRN: reset of port %d vf %d failed", port_id, vf_id );
+		}
+	}
 	
 	bleat_printf( 1, "restore for  port=%d vf=%d matched %d vfs in the config", port_id, vf_id, matched );
+	return matched;
 }
 
 
@@ -1348,8 +1466,9 @@ dump_sriov_config( sriov_conf_t* sriov_config)
 				}
 	
 				int z;
+				char mbuf[MAC_STR_LEN];
 				for (z = sriov_config->ports[i].vfs[y].first_mac; z < sriov_config->ports[i].vfs[y].num_macs + sriov_config->ports[i].vfs[y].first_mac; z++) {
-					bleat_printf( 2, "dump: pf/vf: %d/%d mac[%d] %s ", sriov_config->ports[i].rte_port_number, sriov_config->ports[i].vfs[y].num, z, sriov_config->ports[i].vfs[y].macs[z]);
+					bleat_printf( 2, "dump: pf/vf: %d/%d mac[%d] %s ", sriov_config->ports[i].rte_port_number, sriov_config->ports[i].vfs[y].num, z, mac_ntoa( sriov_config->ports[i].vfs[y].macs[z], mbuf ));
 				}
 			} else {
 				bleat_printf( 2, "dump: port %d index %d is not configured", i, y );
@@ -1365,7 +1484,7 @@ chk_cpu_usage( char* msg_type, double threshold )
     static struct rusage ru_last;
     static struct timeval tv_last;
     static int printed = 0;
-	static int check_now = 600;		// initial delay to bump us past startup usage
+	static int check_now = 30000 / HK_TICK_MS;		// initial delay (~30s) to bump us past startup usage
 	static double last_pct = 0.0;	// last observed percentage
 
     struct rusage ru_now;  
@@ -1375,7 +1494,7 @@ chk_cpu_usage( char* msg_type, double threshold )
 		return;
 	}
 
-	check_now = 100;				// reset "timer"; next check in about 5 seeconds
+	check_now = 5000 / HK_TICK_MS;	// reset "timer"; next check in about 5 seeconds
 
     double cpu_udelta, cpu_sdelta, time_delta, cpu_pcent;
 
@@ -1410,6 +1529,106 @@ chk_cpu_usage( char* msg_type, double threshold )
     tv_last = tv_now;
 }
 
+// ---- main loop event support ---------------------------------------------------------------------------------
+
+/*
+	Wake the main loop. This is safe to call from the dpdk interrupt thread (mailbox
+	and lsc callbacks) or any other thread; it is a single write to the eventfd
+	counter so several wakes before the main loop gets round to it collapse into
+	one event. If the eventfd was never created this is a no-op and the main loop
+	will catch up on the next housekeeping tick.
+*/
+extern void vfd_wake( void ) {
+	uint64_t	one = 1;
+
+	if( wake_fd >= 0 ) {
+		if( write( wake_fd, &one, sizeof( one ) ) < 0 && errno != EAGAIN ) {
+			bleat_printf( 2, "wake: write to eventfd failed: %s", strerror( errno ) );
+		}
+	}
+}
+
+/*
+	Add a single fd to the epoll set with the event type (EV_*) as the user data.
+	Returns 0 on success, -1 on failure.
+*/
+static int add_event_fd( int ep_fd, int fd, uint32_t ev_type ) {
+	struct epoll_event	ev;
+
+	memset( &ev, 0, sizeof( ev ) );
+	ev.events = EPOLLIN;
+	ev.data.u32 = ev_type;
+
+	if( epoll_ctl( ep_fd, EPOLL_CTL_ADD, fd, &ev ) < 0 ) {
+		bleat_printf( 0, "WRN: unable to add fd %d (type %d) to epoll set: %s", fd, ev_type, strerror( errno ) );
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+	Build the epoll set which drives the main loop. We wake when the request
+	fifo is readable, when a request socket client connects or sends something,
+	when a callback pokes the wake eventfd, and when the
+	housekeeping timer pops (every HK_TICK_MS).  The timer fd is returned via
+	hk_fd so the caller can drain expirations.
+
+	Returns the epoll fd, or -1 if anything failed in which case the caller
+	should fall back to polling.
+*/
+static int mk_event_set( parms_t* parms, int* hk_fd ) {
+	struct itimerspec	its;
+	int	ep_fd;
+	int	ffd;
+
+	*hk_fd = -1;
+	if( (ep_fd = epoll_create1( EPOLL_CLOEXEC )) < 0 ) {
+		bleat_printf( 0, "WRN: unable to create epoll set; falling back to polling: %s", strerror( errno ) );
+		return -1;
+	}
+
+	if( (ffd = rfifo_fd( parms->rfifo )) < 0 || add_event_fd( ep_fd, ffd, EV_FIFO ) < 0 ) {
+		close( ep_fd );
+		return -1;
+	}
+
+	if( sock_fd >= 0 && add_event_fd( ep_fd, sock_fd, EV_SOCK ) < 0 ) {
+		close( ep_fd );
+		return -1;
+	}
+
+	if( (wake_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC )) < 0 || add_event_fd( ep_fd, wake_fd, EV_WAKE ) < 0 ) {
+		bleat_printf( 0, "WRN: unable to create wake eventfd; falling back to polling: %s", strerror( errno ) );
+		if( wake_fd >= 0 ) {
+			close( wake_fd );
+			wake_fd = -1;
+		}
+		close( ep_fd );
+		return -1;
+	}
+
+	memset( &its, 0, sizeof( its ) );
+	its.it_value.tv_sec = its.it_interval.tv_sec = HK_TICK_MS / 1000;
+	its.it_value.tv_nsec = its.it_interval.tv_nsec = (HK_TICK_MS % 1000) * 1000000;
+	if( (*hk_fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC )) < 0 ||
+		timerfd_settime( *hk_fd, 0, &its, NULL ) < 0 || add_event_fd( ep_fd, *hk_fd, EV_HK ) < 0 ) {
+
+		bleat_printf( 0, "WRN: unable to create housekeeping timer; falling back to polling: %s", strerror( errno ) );
+		if( *hk_fd >= 0 ) {
+			close( *hk_fd );
+			*hk_fd = -1;
+		}
+		close( wake_fd );
+		wake_fd = -1;
+		close( ep_fd );
+		return -1;
+	}
+
+	bleat_printf( 1, "main loop is event driven: fifo=%d wake=%d housekeeping=%d (%dms)", ffd, wake_fd, *hk_fd, HK_TICK_MS );
+	return ep_fd;
+}
+
 // ===============================================================================================================
 int
 main(int argc, char **argv)
@@ -1425,6 +1644,16 @@ main(int argc, char **argv)
 	int		state;
 	int 	j;
 	int		no_huge = 0;				// -H will turn on and we will flip the appropriate bit in parms
+	int		ep_fd = -1;					// epoll set which drives the main loop
+	int		hk_fd = -1;					// housekeeping timer fd
+	int		nev;						// number of events returned by epoll
+	int		run_hk;						// set when housekeeping should be run this pass
+	int		ev_to = -1;					// epoll timeout; PF_DISCARD_MS if a pf needs its rx drained, else wait for events
+	int		poll_ms = 0;				// ms slept since housekeeping when polling
+	time_t	vlan_retry_ts = 0;			// last retry of failed vlan filter writes
+	int		i;
+	uint64_t	evcount;				// eventfd/timerfd counter read (value is ignored)
+	struct epoll_event	events[MAX_EVENTS];
 
 	int		enable_fc = 0;				// enable flow control (-F sets)
 	u_int16_t portid;
@@ -1537,6 +1766,7 @@ main(int argc, char **argv)
 	memset( running_config, 0, sizeof( *running_config ) );
 	rte_spinlock_init( &running_config->update_lock );						// initialise and leave unlocked
 	running_config->mir_id_mgr = mk_idm( 256 );								// make an id manager with 256 ID 'slots' for allocating mirror IDs
+	xstats_select( g_parms->xstats, g_parms->nxstats );						// extended stats shown/exported (defaults if none in the parms)
 
 	if( strcmp( g_parms->log_dir, "stderr" ) != 0 ) {						// something other than stdin, we'll switch even if -f given
 		snprintf( log_file, BUF_1K, "%s/vfd.log", g_parms->log_dir );
@@ -1565,6 +1795,7 @@ main(int argc, char **argv)
 		bleat_printf( 0, "CRI: abort: unable to initialise request fifo" );
 		exit( 1 );
 	}
+	sock_fd = vfd_init_sock( g_parms );												// socket is optional; fifo is always there
 
 	if( vfd_eal_init( g_parms ) < 0 ) {												// dpdk function returns -1 on error
 		bleat_printf( 0, "CRI: abort: unable to initialise dpdk eal environment" );
@@ -1572,6 +1803,9 @@ main(int argc, char **argv)
 	}
 
 														// set up config structs. these always succeeed (see notes in README)
+	for( i = 0; i < MAX_PORTS; i++ ) {
+		port2config_map[i] = -1;						// no rte port maps until it is found in our config
+	}
 	vfd_add_ports( g_parms, running_config );			// add the pciid info from parms to the ports list (must do before dpdk init, config file adds wait til after)
 	mac_init();											// init the mac symtab etc to track MACs assigned to PFs.
 
@@ -1601,7 +1835,6 @@ main(int argc, char **argv)
 		}
 
 		static pthread_t tid;
-		rq_list = NULL;						// nothing initially on the reset list
 		
 		ret = pthread_create(&tid, NULL, (void *)process_refresh_queue, NULL);	
 		if (ret != 0) {
@@ -1615,6 +1848,8 @@ main(int argc, char **argv)
 		}
 		bleat_printf( 1, "refresh queue management thread created" );	
 
+		mbq_init();							// mailbox worker; must be running before callbacks are registered (failure is not fatal)
+
 #if VFD_KERNEL 		
 		netlink_init();
 #endif
@@ -1645,8 +1880,10 @@ main(int argc, char **argv)
 					port2config_map[portid] = i;									// map real port to our array index
 					running_config->ports[i].rte_port_number = portid; 				// record the real pf number
 					running_config->ports[i].nvfs_config = dev_info.max_vfs;		// number of configured VFs (could be less than max)
-					if (strcmp(dev_info.driver_name, "net_mlx5") == 0)
+					vfd_set_nic_ops( &running_config->ports[i] );					// select the driver functions before any nic call is made for the port
+					if( running_config->ports[i].nic_ops->type == VFD_MLX5 )
 						running_config->ports[i].nvfs_config = vfd_mlx5_get_num_vfs(portid);
+					vfd_size_port( &running_config->ports[i], running_config->ports[i].nvfs_config );	// VF arrays sized to what the nic has, not MAX_VFS
 					break;
 				}
 			}
@@ -1655,7 +1892,7 @@ main(int argc, char **argv)
 			if( pfidx >= 0 ) {														// initialise only if in our confilg file list (we may not manage everything)
 				port  = &running_config->ports[pfidx];
 
-				for( j = 0; j < 64; j++ ) {						//???  hardcoded 64 seems very dodgy!
+				for( j = 0; j < port->nvfs_config; j++ ) {
 					set_split_erop( portid, j, SET_ON );							// set the split receive drop enable for all VFs
 				}
 
@@ -1674,6 +1911,7 @@ main(int argc, char **argv)
 				}
 
 				set_pfrx_drop( portid, 1 );			// enable the drop bit for the PF queues on this port
+				xstats_init( portid );				// resolve the selected xstat ids once
 			
 				rte_eth_macaddr_get(portid, &addr);
 				bleat_printf( 1,  "mapping port: %u, MAC: %02" PRIx8 ":%02" PRIx8 ":%02" PRIx8 ":%02" PRIx8 ":%02" PRIx8 ":%02" PRIx8 ", ",
@@ -1761,6 +1999,19 @@ main(int argc, char **argv)
 	}
 	
 	run_start_cbs( running_config );				// run any user startup callback commands defined in VF configs
+	vfd_start_req_worker( g_parms, running_config );	// state changing requests run here from now on (failure is not fatal)
+	if( forreal && (g_parms->rflags & RF_ENABLE_RATES) ) {
+		rates_start( running_config );				// per pf/vf rate history for show rates (failure is not fatal)
+	}
+	if( forreal && g_parms->shm_path != NULL && *g_parms->shm_path ) {
+		if( stats_shm_start( g_parms->shm_path ) == 0 && g_parms->stats_ivl <= 0 && !(g_parms->rflags & RF_ENABLE_RATES) ) {
+			g_parms->stats_ivl = 1000;				// nothing else sweeps regularly; keep the segment fresh
+			bleat_printf( 1, "stats interval set to %dms to keep the shared memory segment current", g_parms->stats_ivl );
+		}
+	}
+	if( forreal && g_parms->metrics_addr != NULL ) {
+		metrics_start( g_parms->metrics_addr, running_config, g_parms->stats_ivl > 0 || (g_parms->rflags & RF_ENABLE_RATES) );	// failure is not fatal
+	}
 
 	bleat_printf( 0, "version: %s", version );
 	bleat_printf( 0, "initialisation complete, setting bleat level to %d; starting to loop", g_parms->log_level );
@@ -1779,20 +2030,79 @@ main(int argc, char **argv)
 	device_message(0, 0, NL_PF_UPD_DEV_RQ, NL_PF_RESP_OK);
 #endif
 
+	ep_fd = mk_event_set( g_parms, &hk_fd );				// fifo, wake and housekeeping timer; -1 if we must poll
+
+	for( portid = 0; portid < n_ports; portid++ ) {
+		if( get_nic_ops( portid )->flags & NOF_DISCARD_PFRX ) {		// nothing else reads the pf's rx queue; keep draining it as often as we always have
+			ev_to = PF_DISCARD_MS;
+			bleat_printf( 1, "pf %d rx is discarded every %dms", portid, PF_DISCARD_MS );
+		}
+	}
+
 	while(!terminated)
 	{
-		usleep(50000);			// .5s
+		run_hk = 0;
+		if( ep_fd < 0 ) {
+			i = ev_to > 0 ? ev_to : HK_TICK_MS;
+			usleep( i * 1000 );									// no epoll, old style polling
+			if( (poll_ms += i) >= HK_TICK_MS ) {
+				poll_ms = 0;
+				run_hk = 1;
+			}
+		} else {
+			if( (nev = epoll_wait( ep_fd, events, MAX_EVENTS, ev_to )) < 0 ) {
+				if( errno != EINTR ) {							// signals are expected; terminated is checked at the top
+					bleat_printf( 0, "ERR: epoll_wait failed: %s", strerror( errno ) );
+					usleep( HK_TICK_MS * 1000 );				// don't spin if something is very wrong
+				}
+				continue;
+			}
+
+			for( i = 0; i < nev; i++ ) {
+				switch( events[i].data.u32 ) {
+					case EV_WAKE:								// callback wants attention; drain counter and discard pf traffic
+						ignored = read( wake_fd, &evcount, sizeof( evcount ) );
+						break;
+
+					case EV_HK:
+						ignored = read( hk_fd, &evcount, sizeof( evcount ) );
+						run_hk = 1;
+						break;
+
+					default:									// fifo or socket is readable; handled below
+						break;
+				}
+			}
+		}
 
 		while( vfd_req_if( g_parms, running_config, 0 ) ); 				// process _all_ pending requests before going on
+		while( vfd_sock_if( g_parms, running_config ) );				// and everything waiting on the request socket
 
-		chk_cpu_usage( g_parms->cpu_alrm_type, g_parms->cpu_alrm_thresh );
+		if( run_hk ) {
+			chk_cpu_usage( g_parms->cpu_alrm_type, g_parms->cpu_alrm_thresh );
+			if( forreal ) {
+				stats_hk( running_config, g_parms->stats_ivl );			// sweep the counters if the interval has passed
 
-		// Discard any RX traffic...
+				if( vlans_pending( running_config ) && time( NULL ) - vlan_retry_ts >= VLAN_RETRY_SEC ) {
+					vlan_retry_ts = time( NULL );
+					vfd_update_nic( g_parms, running_config );				// only the failed vlan filters are written
+				}
+			}
+		}
+
+		// Discard any RX traffic (at least every PF_DISCARD_MS when a port needs it)...
 		for (portid = 0; portid < n_ports; portid++)
 			discard_pf_traffic(portid);
 
 	}		// end !terminated while
 
+	if( ep_fd >= 0 ) {
+		close( ep_fd );
+		close( hk_fd );
+		close( wake_fd );
+		wake_fd = -1;
+	}
+
 #if VFD_KERNEL
 	// send message to kernel module asking to delete all netdevs
 	device_message(0, 0, NL_PF_RES_DEV_RQ, NL_PF_RESP_OK);
@@ -1806,6 +2116,12 @@ main(int argc, char **argv)
 		close(fd);
 	}
 
+	metrics_stop( );
+	vfd_stop_req_worker( );			// let an in progress request finish before the ports go away
+	rates_stop( );
+	mbq_stop( );					// mailbox work must not run against ports being closed
+	stats_shm_stop( );				// readers see pid 0 and the segment is removed
+	vfd_close_sock( g_parms );
 	close_ports();				// clean up the PFs, terminate mirrors
 
 	gettimeofday(&st.endTime, NULL);
@@ -38,6 +38,10 @@
 
 	Author:		E. Scott Daniels
 	Date:		06 June 2016
+
+	Mods:		16 Oct 2026 - Use the shadowed register functions (vfd_reg.c) so that
+					unchanged values aren't rewritten and current values aren't reread
+					from the NIC on every recompute.
 */
 
 #include "sriov.h"
@@ -56,9 +60,8 @@ static void qos_set_minifg( portid_t pf ) {
 
 	offset = 0x08810;									//  SECTXMINIFG
 	val = 0x1f00;										// pfc is enabled; set 0x1f per data sheet (all bits in field, so no need to clear)
-	cval = port_pci_reg_read( pf, offset );						// snag current
+	cval = reg_rmw( pf, offset, 0xffffffff, val );				// flip our bits on and write; previous value returned
 	bleat_printf( 1, ">>> minifg: %08x %08x = %08x", cval, val, cval | val );
-	port_pci_reg_write( pf, offset, cval | val );				// flip our bits on and write
 }
 
 /*
@@ -123,21 +126,18 @@ extern void qos_enable_arb( portid_t pf ) {
 	} else {
 		val = 0x00400010;
 	}
-	cval = port_pci_reg_read( pf, offset );						// snag current
-	port_pci_reg_write( pf, offset, (cval & mask) | val );		
+	cval = reg_rmw( pf, offset, mask, val );					// set our bits, previous value returned
 	bleat_printf( 3, ">>>> qos: set_enable_rttdcs (%08x & %08x) | %08x = %08x", cval, mask, val, (cval & mask) | val );
 
 	offset = 0x0cd00;			// RTTPCS
 	mask = 0x003ffedf;
 	val = 0x01000120;
-	cval = port_pci_reg_read( pf, offset );						// snag current
-	port_pci_reg_write( pf, offset, (cval & mask) | val );		// add our bits or clear what we don't want
+	cval = reg_rmw( pf, offset, mask, val );					// add our bits or clear what we don't want
 	bleat_printf( 3, ">>>> qos: set_enable_rttpcsarb (%08x & %08x) | %08x = %08x", cval, mask, val, (cval & mask) | val );
 
 	offset = 0x02430;			// RTRPCS
 	val = 0x00000006;
-	cval = port_pci_reg_read( pf, offset );						// snag current
-	port_pci_reg_write( pf, offset, cval | val );				// flip on our bits (no mask needed since we aren't clearing bits)
+	cval = reg_rmw( pf, offset, 0xffffffff, val );				// flip on our bits (no mask needed since we aren't clearing bits)
 	bleat_printf( 3, ">>> qos: rtrpcs: %08x/nomask %08x = %08x", cval, val, (cval) | val );
 }
 
@@ -210,8 +210,7 @@ extern void qos_set_tdplane( portid_t pf, uint8_t* pctgs, uint8_t *bwgs, int ntc
 		group = bwgs[i] << 9;
 		credits = (int) (pctgs[i] * factor);
 		max = (credits * BURST_FACTOR) << 12;
-		cval = port_pci_reg_read( pf, offset );
-		port_pci_reg_write( pf, offset, (cval & mask) | max | credits | group );		
+		cval = reg_rmw( pf, offset, mask, max | credits | group );
 		bleat_printf( 1, "qos: set tdplane:  tc=%d cur=0x%08x max=%d creds=%d grp=%d write: [%04x] -> 0x%02x",
 			i, (int) cval, (int) credits * BURST_FACTOR, (int) credits, (int) bwgs[i], (int) offset, (int) (cval & mask) | max | credits | group );
 
@@ -247,8 +246,7 @@ extern void qos_set_txpplane( portid_t pf, uint8_t* pctgs, uint8_t *bwgs, int nt
 		group = bwgs[i] << 9;
 		credits = (int) (pctgs[i] * factor);
 		max = (credits * BURST_FACTOR) << 12;
-		cval = port_pci_reg_read( pf, offset );
-		port_pci_reg_write( pf, offset, (cval & mask) | max | credits | group );		
+		cval = reg_rmw( pf, offset, mask, max | credits | group );
 		bleat_printf( 1, "qos: set txpplane:  tc=%d cur=0x%08x max=%d creds=%d grp=%d write: [%04x] -> 0x%02x",
 			i, (int) cval, (int) credits * BURST_FACTOR, (int) credits, (int) bwgs[i], (int) offset, (int) (cval & mask) | max | credits | group );
 
@@ -275,8 +273,7 @@ static void qos_set_rxpplane( portid_t pf ) {
 	offset = 0x02140;			//RTRPT4C
 	for( i = 0; i < 8; i++ ) {
 		group = i << 9;
-		cval = port_pci_reg_read( pf, offset );
-		port_pci_reg_write( pf, offset, (cval & mask) | val | group );		
+		cval = reg_rmw( pf, offset, mask, val | group );
 		bleat_printf( 1, ">>>> qos: rtrp4tc  [%d] %08x & %08x | %08x = %08x", i, cval, mask, val, (cval & mask) | val| group  );
 
 		offset += 4;
@@ -285,7 +282,7 @@ static void qos_set_rxpplane( portid_t pf ) {
 
 extern void mlx5_set_vf_tcqos( sriov_port_t *port, uint32_t link_speed ) {
 	int *shares = port->vftc_qshares;
-	uint32_t rate;
+	uint32_t rates[MAX_TCS];
 	int vfid;
 	int i, j;
 
@@ -298,11 +295,11 @@ extern void mlx5_set_vf_tcqos( sriov_port_t *port, uint32_t link_speed ) {
 		vfid = port->vfs[i].num;
 		if( vfid >= 0 ) {
 			for(j = 0; j < MAX_TCS; j++) {
-				rate = (uint32_t)((float)(link_speed * shares[(vfid * MAX_TCS) + j]) / 100);
-				vfd_mlx5_set_vf_tcqos( port->rte_port_number, vfid, j, rate );
+				rates[j] = (uint32_t)((float)(link_speed * shares[(vfid * MAX_TCS) + j]) / 100);
 				bleat_printf( 2, "mlx5 set vf tc qos: port=%d vf=%d tc=%d rate_share=%d%% rate=%dMbps",
-						port->rte_port_number, vfid, j, shares[(vfid * MAX_TCS) + j], rate );
+						port->rte_port_number, vfid, j, shares[(vfid * MAX_TCS) + j], rates[j] );
 			}
+			vfd_mlx5_set_vf_tcqos_all( port->rte_port_number, vfid, rates );		// one open for all tcs
 		}
 	}
 }
@@ -372,9 +369,7 @@ extern void qos_set_credits( portid_t pf, int mtu, int* rates, int tc8_mode ) {
 		amt = ceil( (double)rates[q] * cred_factor[tc] );					// figure the amount for this pool
 
 		// --- this seems dodgy if another process/thread can select before we make our second write ----
-		port_pci_reg_write( pf, sel_offset, q );						// select the queue to work on
-		cval = port_pci_reg_read( pf, reg_offset );						// read to preserve reserved bits
-		port_pci_reg_write( pf, reg_offset, (cval & mask) | amt );		// set the credits
+		cval = reg_rmw_sel( pf, sel_offset, q, reg_offset, mask, amt );	// select the queue and set credits (skipped if unchanged)
 		if( amt > 0 ) {
 			bleat_printf( 2, "qos set rate: q=%d mtu=%d rate=%d%% credits=%d cval&mask|amt=%08x", q, mtu, rates[q], amt, (cval & mask) | amt );
 		}
@@ -395,16 +390,14 @@ static void qos_set_fcc( portid_t pf ) {
 
 	offset = 0x03d00;		// FCCFG.TFCE=10b
 	mask = 0xffffffe7;
-	cval = port_pci_reg_read( pf, offset );
 	val = 2 << 3;												// 10b (priority) when in dcb mode
-	port_pci_reg_write( pf, offset, (cval & mask) | val );		// flip on our bits, and set
+	cval = reg_rmw( pf, offset, mask, val );					// flip on our bits, and set
 	bleat_printf( 1, ">>>> qos: tfce %08x & %08x | %08x = %08x", cval, mask, val, (cval & mask) | val );
 
 	offset = 0x04294;    	// MFLCN.RPFCE=1b RFCE=0b
 	val = 0x1 << 2;
 	mask =0xfffffff0;
-	cval = port_pci_reg_read( pf, offset );
-	port_pci_reg_write( pf, offset, (cval & mask) | val );		// flip on our bits, and set
+	cval = reg_rmw( pf, offset, mask, val );					// flip on our bits, and set
 	bleat_printf( 1, ">>>> qos: rpfce %08x & %08x | %08x = %08x", cval, mask, val, (cval & mask) | val );
 }
 
@@ -414,7 +407,7 @@ static void qos_set_fcc( portid_t pf ) {
 static void qos_set_maxszreq( portid_t pf ) {
 	uint32_t val = 0x10;			// 256 * 16 =  4KB
 
-	port_pci_reg_write( pf, 0x08100, val );
+	reg_swrite( pf, 0x08100, val );
 }
 
 
@@ -457,8 +450,7 @@ static void qos_set_rup2tc( portid_t pf, int tc8_mode ) {
 
 	offset = 0x03020;				// RTRUP2TC
 	mask = 0xff000000;
-	cval = port_pci_reg_read( pf, offset );
-	port_pci_reg_write( pf, offset, (cval & mask) | val );
+	cval = reg_rmw( pf, offset, mask, val );
 	bleat_printf( 1, ">>>> qos: set_rup2tc %08x & %08x | %08x = %08x", cval, mask, val, (cval & mask) | val );
 }
 
@@ -473,7 +465,7 @@ static void qos_set_tup2tc( portid_t pf, int tc8_mode ) {
 		val = 0x053077;
 	}
 
-	port_pci_reg_write( pf, 0x0c800, val );
+	reg_swrite( pf, 0x0c800, val );
 }
 
 /*
@@ -495,8 +487,7 @@ static void qos_set_vtctl( portid_t pf ) {
 	//val = 1;					// enable VT
 
 	offset = 0x051b0;			// PFVTCTL
-	cval = port_pci_reg_read( pf, offset );
-	port_pci_reg_write( pf, offset, (cval & mask) | val );				// no mask needed; we're only setting bits
+	cval = reg_rmw( pf, offset, mask, val );
 	bleat_printf( 1, ">>> qos pfvtctl turn on: %08x", (cval & mask) | val );
 }
 
@@ -515,8 +506,7 @@ static void qos_set_mtqc( portid_t pf, int tc8_mode ) {
 		val = 0x0f;					// dcb/vt,TC0-7 & 16 VMs
 	}
 
-	cval = port_pci_reg_read( pf, offset );
-	port_pci_reg_write( pf, offset, (cval & mask) | val );				// no mask needed; we're only setting bits
+	cval = reg_rmw( pf, offset, mask, val );
 	bleat_printf( 1, ">>> qos mtqc: offset=%8x %08x", offset, (cval&mask) | val );
 }
 
@@ -554,9 +544,8 @@ static void qos_set_mrqc( portid_t pf, int tc8_mode ) {
 	mask = 0xff0c0ff0;
 	//mask = 0x0000fff0;
 
-	cval = port_pci_reg_read( pf, offset );
+	cval = reg_rmw( pf, offset, mask, val );
 	bleat_printf( 1, ">>>> qos: mrqc  -low %08x & %08x | %08x = %08x", cval, mask, val, (cval & mask) | val );
-	port_pci_reg_write( pf, offset, (cval & mask) | val );
 }
 
 /*
@@ -585,16 +574,14 @@ static void qos_set_sizes( portid_t pf, int tc8_mode ) {
 
 	offset = 0x0cc00; 					// TDWBAH
 	for( i = 0; i < 4; i++ ) {								// set TX 0-3
-		cval = port_pci_reg_read( pf, offset );
-		port_pci_reg_write( pf, offset, (cval & mask ) | val );
+		cval = reg_rmw( pf, offset, mask, val );
 		bleat_printf( 1, ">>>> qos: tdwbah  -low %08x & %08x | %08x = %08x", cval, mask, val, (cval & mask) | val );
 		offset += 4;
 	}
 
 	val = tx_high << 10;
 	for( i = 0; i < 4; i++ ) {								// clears TX 4-7 in 4 tc mode
-		cval = port_pci_reg_read( pf, offset );
-		port_pci_reg_write( pf, offset, (cval & mask ) | val );
+		cval = reg_rmw( pf, offset, mask, val );
 		bleat_printf( 1, ">>>> qos: tdwbah  -high %08x & %08x | %08x = %08x", cval, mask, val, (cval & mask) | val );
 		offset += 4;
 	}
@@ -602,16 +589,14 @@ static void qos_set_sizes( portid_t pf, int tc8_mode ) {
 	val = rx_low << 10;										// values are inserted at bytes 10-19
 	offset = 0x3c00;
 	for( i = 0; i < 4; i++ ) {								// set RX 0-3
-		cval = port_pci_reg_read( pf, offset );
-		port_pci_reg_write( pf, offset, (cval & mask ) | val );
+		cval = reg_rmw( pf, offset, mask, val );
 		bleat_printf( 1, ">>>> qos: rdwbah  -low %08x & %08x | %08x = %08x", cval, mask, val, (cval & mask) | val );
 		offset += 4;
 	}
 
 	val = rx_high << 10;
 	for( i = 0; i < 4; i++ ) {								// clears RX 4-7 in 4 tc mode
-		cval = port_pci_reg_read( pf, offset );
-		port_pci_reg_write( pf, offset, (cval & mask ) | val );
+		cval = reg_rmw( pf, offset, mask, val );
 		bleat_printf( 1, ">>>> qos: rdwbah  -high %08x & %08x | %08x = %08x", cval, mask, val, (cval & mask) | val );
 		offset += 4;
 	}
@@ -620,16 +605,14 @@ static void qos_set_sizes( portid_t pf, int tc8_mode ) {
 	offset = 0x04950;										// TXPBTHRESH
 	val = tx_low;
 	for( i = 0; i < 4; i++ ) {								// these values must match the tx_low and tx_high values set above
-		cval = port_pci_reg_read( pf, offset );
-		port_pci_reg_write( pf, offset, (cval & mask ) | tx_low );
+		cval = reg_rmw( pf, offset, mask, tx_low );
 		bleat_printf( 1, ">>>> qos: txpbthresh -low %08x & %08x | %08x = %08x", cval, mask, val, (cval & mask) | val );
 		offset += 4;
 	}
 
 	val = tx_high;
 	for( i = 0; i < 4; i++ ) {								// clears if in 4 TC mode
-		cval = port_pci_reg_read( pf, offset );
-		port_pci_reg_write( pf, offset, (cval & mask ) | tx_high );
+		cval = reg_rmw( pf, offset, mask, tx_high );
 		bleat_printf( 1, ">>>> qos: txpbthresh -high %08x & %08x | %08x = %08x", cval, mask, val, (cval & mask) | val );
 		offset += 4;
 	}
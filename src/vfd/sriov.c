@@ -32,11 +32,39 @@
 				06 Apr 2017 - Add set flowcontrol function, add mtu/jumbo confirmation msg to log.
 				22 May 2017 - Add ability to remove a whitelist RX mac.
 				10 Oct 2017 - Add range check on mirror target.
+				16 Oct 2026 - Wake the main loop when a refresh is queued or link state changes.
+				16 Oct 2026 - Count nic calls made through the setter wrappers.
+				16 Oct 2026 - Time link flap to VFs restored in the lsc callback.
+				16 Oct 2026 - Dispatch nic calls through the per port driver ops table rather
+					than switching on the device type (and its dev_info/strcmp cost) on every call.
+				16 Oct 2026 - Drop register shadow after port start.
+				16 Oct 2026 - Refresh queue is a [port][vf] table with a backoff timer
+					wheel; nic work is done outside of the queue lock.
+				16 Oct 2026 - Per VF token bucket and debounce for mailbox driven refreshes.
+				16 Oct 2026 - Count failed nic calls by op; refresh queue depth and metrics.
+				16 Oct 2026 - Resolve selected xstat ids once per port and fetch by id.
+				16 Oct 2026 - MAC set functions take the 48 bit value.
+				16 Oct 2026 - Stats display finds the port with suss_port().
+				16 Oct 2026 - VF limits come from the port's configured VF count, not 32.
+				16 Oct 2026 - Refresh deferrals are scheduled from the current tick; a mailbox
+								event which restores and refreshes costs one token.
+				16 Oct 2026 - Xstats lock is a mutex; selected xstats are collected by the
+								stats sweep rather than fetched per scrape.
+				16 Oct 2026 - Drop vf_stats_display(); show formats VFs from the stats snapshot.
+				16 Oct 2026 - Drop port_xstats_display(); show ex and dump format xstats from the snapshot.
+				16 Oct 2026 - Drop nic_stats_display(); the stats sweep is the only pf spoof counter reader.
+				16 Oct 2026 - Count nic calls per thread.
 
 	useful doc:
 				 http://www.intel.com/content/dam/doc/design-guide/82599-sr-iov-driver-companion-guide.pdf
 */
 
+#include <poll.h>
+#include <fnmatch.h>
+#include <sys/eventfd.h>
+
+#include <pthread.h>
+
 #include "vfdlib.h"
 #include "sriov.h"
 #include "vfd_dcb.h"
@@ -48,6 +76,13 @@
 
 struct rte_port *ports;
 
+/*
+	Nic calls are counted per thread: the request worker, stats sweep, rate sampler and
+	mailbox worker all make them, and a shared ++ would lose counts and pull the other
+	threads' calls into update_nic's per pass number.
+*/
+__thread uint64_t nic_calls = 0;
+
 
 static inline
 uint64_t RDTSC(void)
@@ -146,11 +181,32 @@ ether_aton_r(const char *asc, struct ether_addr *addr)
 }
 
 
-int
-get_nic_type(portid_t port_id)
-{
+// --------------- nic driver ops ---------------------------------------------------------------------------
+
+static const struct vfd_nic_ops null_ops = {		// unknown device; all nil so every nic call is a no-op
+	.driver = "unknown",
+	.type = 0,
+	.flags = 0,
+};
+
+static const struct vfd_nic_ops* nic_backends[] = {	// known NIC families; add new ones here
+	&vfd_ixgbe_ops,
+	&vfd_i40e_ops,
+	&vfd_bnxt_ops,
+	&vfd_mlx5_ops,
+	NULL
+};
+
+/*
+	Look up the ops table for the port using the driver name that dpdk reports. This is
+	the expensive path (dev_info copy and string compares) and is used only when the port
+	is mapped, or for a port that isn't in our config. Always returns a table; the null
+	table if the driver isn't one we know.
+*/
+static const struct vfd_nic_ops* find_nic_ops( portid_t port_id ) {
 	static int warned = 0;
 	struct rte_eth_dev_info dev_info;
+	int	i;
 
 	memset( &dev_info, 0, sizeof( dev_info ) );			// keep valgrind from complaining
 	rte_eth_dev_info_get(port_id, &dev_info);
@@ -161,52 +217,150 @@ get_nic_type(portid_t port_id)
 			warned = 1;
 		}
 
-		return 0;
+		return &null_ops;
 	}
-	
-	if (strcmp(dev_info.driver_name, "net_bnxt") == 0)
-		return VFD_BNXT;
-	
-	if (strcmp(dev_info.driver_name, "net_ixgbe") == 0)
-		return VFD_NIANTIC;
-	
-	if (strcmp(dev_info.driver_name, "net_i40e") == 0)
-		return VFD_FVL25;
 
-	if (strcmp(dev_info.driver_name, "net_mlx5") == 0)
-		return VFD_MLX5;
-	
-	return 0;
+	for( i = 0; nic_backends[i] != NULL; i++ ) {
+		if( strcmp( dev_info.driver_name, nic_backends[i]->driver ) == 0 ) {
+			return nic_backends[i];
+		}
+	}
+
+	return &null_ops;
+}
+
+/*
+	Return the ops table for the dpdk port number. The table cached in the port
+	block is used when the port is in our config; otherwise we go the long way.
+*/
+static inline const struct vfd_nic_ops* port_ops( portid_t port_id ) {
+	int idx;
+	sriov_port_t* pf;
+
+	if( running_config != NULL && port_id < MAX_PORTS ) {
+		idx = port2config_map[port_id];
+		if( idx >= 0 && idx < running_config->num_ports ) {
+			pf = &running_config->ports[idx];
+			if( pf->nic_ops != NULL && pf->rte_port_number == port_id ) {
+				return pf->nic_ops;
+			}
+		}
+	}
+
+	return find_nic_ops( port_id );
+}
+
+/*
+	Select and register the driver ops table for the port. Must be called once the
+	rte port number has been recorded in the port block, and before any nic calls are
+	made for it. Returns the table.
+*/
+extern const struct vfd_nic_ops* vfd_set_nic_ops( sriov_port_t* pf ) {
+	if( pf == NULL ) {
+		return &null_ops;
+	}
+
+	pf->nic_ops = find_nic_ops( pf->rte_port_number );
+	if( pf->nic_ops->type == 0 ) {
+		bleat_printf( 0, "WRN: pf %d (%s) is not a supported NIC type; nic calls will be ignored", pf->rte_port_number, pf->pciid );
+	} else {
+		bleat_printf( 1, "pf %d (%s) using %s driver ops", pf->rte_port_number, pf->pciid, pf->nic_ops->driver );
+	}
+
+	return pf->nic_ops;
+}
+
+/*
+	Return the driver ops table for the port; never nil.
+*/
+extern const struct vfd_nic_ops* get_nic_ops( portid_t port_id ) {
+	return port_ops( port_id );
+}
+
+/*
+	Failed nic calls by op and port for the metrics exporter. An op is given a slot
+	the first time it fails; op must be a constant string (the pointer is kept).
+*/
+#define NIC_ERR_OPS		32
+
+static struct {
+	const char*	op;
+	long		count[MAX_PORTS];
+} nic_errs[NIC_ERR_OPS];
+static int nic_nerr_ops = 0;
+static rte_spinlock_t nic_err_lock = RTE_SPINLOCK_INITIALIZER;
+
+static void nic_err( portid_t port_id, const char* op ) {
+	int	i;
+
+	if( port_id >= MAX_PORTS ) {
+		return;
+	}
+
+	rte_spinlock_lock( &nic_err_lock );
+	for( i = 0; i < nic_nerr_ops && strcmp( nic_errs[i].op, op ) != 0; i++ );
+	if( i == nic_nerr_ops && i < NIC_ERR_OPS ) {
+		nic_errs[i].op = op;
+		nic_nerr_ops++;
+	}
+	if( i < NIC_ERR_OPS ) {
+		nic_errs[i].count[port_id]++;
+	}
+	rte_spinlock_unlock( &nic_err_lock );
+}
+
+/*
+	Add the nic op error counters to buf in OpenMetrics form. Only op/port pairs
+	which have failed are listed. Returns the length added.
+*/
+extern int nic_err_metrics( char* buf, int blen ) {
+	int	l;
+	int	i;
+	int	p;
+
+	l = snprintf( buf, blen, "# TYPE vfd_nic_op_errors counter\n# HELP vfd_nic_op_errors Driver calls which returned an error.\n" );
+	rte_spinlock_lock( &nic_err_lock );
+	for( i = 0; i < nic_nerr_ops && l < blen; i++ ) {
+		for( p = 0; p < MAX_PORTS && l < blen; p++ ) {
+			if( nic_errs[i].count[p] ) {
+				l += snprintf( buf + l, blen - l, "vfd_nic_op_errors_total{port=\"%d\",op=\"%s\"} %ld\n", p, nic_errs[i].op, nic_errs[i].count[p] );
+			}
+		}
+	}
+	rte_spinlock_unlock( &nic_err_lock );
+
+	if( l >= blen ) {
+		l = blen - 1;
+	}
+	return l;
+}
+
+/*
+	Return the VFD_ constant for the port (0 if unknown).
+*/
+int
+get_nic_type(portid_t port_id)
+{
+	return port_ops( port_id )->type;
 }
 
 int
 set_vf_link_status(portid_t port_id, uint16_t vf, int status)
 {
 	int diag = 0;
+	const struct vfd_nic_ops* ops;
 
 	if ((status > VF_LINK_ON) || (status < VF_LINK_OFF))
 			bleat_printf( 0, "set_vf_link_status: invalid link status: %d, port: %u", status, port_id);
 
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_MLX5:
-			diag = vfd_mlx5_set_vf_link_status(port_id, vf, status);
-			break;
-
-		case VFD_NIANTIC:	// these are known, but don't support the call
-			break;
-			
-		case VFD_FVL25:
-			break;
-
-		case VFD_BNXT:
-			break;
-
-		default:
-			bleat_printf( 0, "set_vf_link_status: unknown device type: %u, port: %u", port_id, dev_type);
+	ops = port_ops( port_id );
+	if( ops->set_vf_link_status != NULL ) {		// not supported by all
+		nic_calls++;
+		diag = ops->set_vf_link_status(port_id, vf, status);
 	}
 
 	if (diag != 0) {
+		nic_err( port_id, "set_vf_link_status" );
 		bleat_printf( 0, "set_vf_link_status: unable to set link state %d: (%d) %s", status, diag, strerror( -diag ) );
 	}
 
@@ -217,31 +371,19 @@ int
 set_vf_min_rate(portid_t port_id, uint16_t vf, uint16_t rate, uint64_t q_msk)
 {
 	int diag = 0;
+	const struct vfd_nic_ops* ops;
 
 	if (q_msk == 0)
 		return 0;
 
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			break;
-			
-		case VFD_FVL25:
-			break;
-
-		case VFD_BNXT:
-			break;
-			
-		case VFD_MLX5:
-			diag = vfd_mlx5_set_vf_min_rate(port_id, vf, rate);
-			break;
-
-		default:
-			bleat_printf( 0, "set_vf_min_rate: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_vf_min_rate != NULL ) {
+		nic_calls++;
+		diag = ops->set_vf_min_rate(port_id, vf, rate, q_msk);
 	}
 
 	if (diag != 0) {
+		nic_err( port_id, "set_vf_min_rate" );
 		bleat_printf( 0, "set_vf_min_rate: unable to set value %u: (%d) %s", rate, diag, strerror( -diag ) );
 	}
 
@@ -253,6 +395,7 @@ set_vf_rate_limit(portid_t port_id, uint16_t vf, uint16_t rate, uint64_t q_msk)
 {
 	int diag = 0;
 	struct rte_eth_link link;
+	const struct vfd_nic_ops* ops;
 
 	if (q_msk == 0)
 		return 0;
@@ -264,28 +407,14 @@ set_vf_rate_limit(portid_t port_id, uint16_t vf, uint16_t rate, uint64_t q_msk)
 		return 1;
 	}
 	
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			diag = vfd_ixgbe_set_vf_rate_limit(port_id, vf, rate, q_msk);
-			break;
-			
-		case VFD_FVL25:
-			break;
-
-		case VFD_BNXT:
-			break;
-			
-		case VFD_MLX5:
-			diag = vfd_mlx5_set_vf_rate_limit(port_id, vf, rate);
-			break;
-
-		default:
-			bleat_printf( 0, "set_vf_rate: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_vf_rate_limit != NULL ) {
+		nic_calls++;
+		diag = ops->set_vf_rate_limit(port_id, vf, rate, q_msk);
 	}
 
 	if (diag != 0) {
+		nic_err( port_id, "set_vf_rate_limit" );
 		bleat_printf( 0, "set_vf_rate: unable to set value %u: (%d) %s", rate, diag, strerror( -diag ) );
 	}
 
@@ -302,31 +431,16 @@ void
 tx_vlan_insert_set_on_vf(portid_t port_id, uint16_t vf_id, int vlan_id)
 {
 	int diag = 0;
+	const struct vfd_nic_ops* ops;
 			
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			diag = vfd_ixgbe_set_vf_vlan_insert( port_id, vf_id, vlan_id );
-			break;
-			
-		case VFD_FVL25:		
-			diag = vfd_i40e_set_vf_vlan_insert(port_id, vf_id, vlan_id);
-			break;
-
-		case VFD_BNXT:
-			diag = vfd_bnxt_set_vf_vlan_insert( port_id, vf_id, vlan_id );
-			break;
-
-		case VFD_MLX5:
-			diag = vfd_mlx5_set_vf_vlan_insert( port_id, vf_id, vlan_id );
-			break;
-			
-		default:
-			bleat_printf( 0, "tx_vlan_insert_set_on_vf: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_vf_vlan_insert != NULL ) {
+		nic_calls++;
+		diag = ops->set_vf_vlan_insert( port_id, vf_id, vlan_id );
 	}
 	
 	if (diag < 0) {
+		nic_err( port_id, "set_vf_vlan_insert" );
 		bleat_printf( 0, "set tx vlan insert on vf failed: port_pi=%d, vf_id=%d, vlan_id=%d) failed rc=%d", port_id, vf_id, vlan_id, diag );
 	} else {
 		bleat_printf( 3, "set tx vlan insert on vf successful: port=%d, vf=%d vlan=%d", port_id, vf_id, vlan_id );
@@ -337,28 +451,16 @@ void
 tx_cvlan_insert_set_on_vf(portid_t port_id, uint16_t vf_id, int vlan_id)
 {
 	int diag = 0;
+	const struct vfd_nic_ops* ops;
 			
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			break;
-			
-		case VFD_FVL25:		
-			break;
-
-		case VFD_BNXT:
-			break;
-
-		case VFD_MLX5:
-			diag = vfd_mlx5_set_vf_cvlan_insert( port_id, vf_id, vlan_id );
-			break;
-			
-		default:
-			bleat_printf( 0, "tx_cvlan_insert_set_on_vf: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_vf_cvlan_insert != NULL ) {
+		nic_calls++;
+		diag = ops->set_vf_cvlan_insert( port_id, vf_id, vlan_id );
 	}
 	
 	if (diag < 0) {
+		nic_err( port_id, "set_vf_cvlan_insert" );
 		bleat_printf( 0, "set tx cvlan insert on vf failed: port_pi=%d, vf_id=%d, vlan_id=%d) failed rc=%d", port_id, vf_id, vlan_id, diag );
 	} else {
 		bleat_printf( 3, "set tx cvlan insert on vf successful: port=%d, vf=%d vlan=%d", port_id, vf_id, vlan_id );
@@ -369,31 +471,16 @@ void
 rx_vlan_strip_set_on_vf(portid_t port_id, uint16_t vf_id, int on)
 {
 	int diag = 0;
+	const struct vfd_nic_ops* ops;
 			
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			diag = vfd_ixgbe_set_vf_vlan_stripq(port_id, vf_id, on);
-		break;
-
-		case VFD_FVL25:		
-			diag = vfd_i40e_set_vf_vlan_stripq(port_id, vf_id, on);
-			break;
-
-		case VFD_BNXT:
-			diag = vfd_bnxt_set_vf_vlan_stripq(port_id, vf_id, on);
-			break;
-			
-		case VFD_MLX5:
-			diag = vfd_mlx5_set_vf_vlan_stripq(port_id, vf_id, on);
-			break;
-
-		default:
-			bleat_printf( 0, "rx_vlan_strip_set_on_vf: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_vf_vlan_stripq != NULL ) {
+		nic_calls++;
+		diag = ops->set_vf_vlan_stripq(port_id, vf_id, on);
 	}
 
 	if (diag < 0) {
+		nic_err( port_id, "set_vf_vlan_stripq" );
 		bleat_printf( 0, "set rx vlan strip on vf failed: port_pi=%d, vf_id=%d, on=%d) failed rc=%d", port_id, vf_id, on, diag );
 	} else {
 		bleat_printf( 3, "set rx vlan strip on vf successful: port=%d, vf_id=%d on/off=%d", port_id, vf_id, on );
@@ -404,27 +491,16 @@ void
 rx_cvlan_strip_set_on_vf(portid_t port_id, uint16_t vf_id, int on)
 {
 	int diag = 0;
+	const struct vfd_nic_ops* ops;
 			
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			break;
-
-		case VFD_FVL25:		
-			break;
-
-		case VFD_BNXT:
-			break;
-			
-		case VFD_MLX5:
-			break;
-
-		default:
-			bleat_printf( 0, "rx_cvlan_strip_set_on_vf: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_vf_cvlan_stripq != NULL ) {		// no NIC supports this yet
+		nic_calls++;
+		diag = ops->set_vf_cvlan_stripq(port_id, vf_id, on);
 	}
 
 	if (diag < 0) {
+		nic_err( port_id, "set_vf_cvlan_stripq" );
 		bleat_printf( 0, "set rx cvlan strip on vf failed: port_pi=%d, vf_id=%d, on=%d) failed rc=%d", port_id, vf_id, on, diag );
 	} else {
 		bleat_printf( 3, "set rx cvlan strip on vf successful: port=%d, vf_id=%d on/off=%d", port_id, vf_id, on );
@@ -434,31 +510,17 @@ rx_cvlan_strip_set_on_vf(portid_t port_id, uint16_t vf_id, int on)
 void
 set_vf_allow_bcast(portid_t port_id, uint16_t vf_id, int on)
 {
-  int ret = 0;
-
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			ret = vfd_ixgbe_set_vf_broadcast(port_id, vf_id, on);
-			break;
-			
-		case VFD_FVL25:		
-			ret = vfd_i40e_set_vf_broadcast(port_id, vf_id, on);
-			break;
-
-		case VFD_BNXT:
-			ret = vfd_bnxt_set_vf_broadcast(port_id, vf_id, on);
-			break;
-			
-		case VFD_MLX5:
-			break;
+	int ret = 0;
+	const struct vfd_nic_ops* ops;
 
-		default:
-			bleat_printf( 0, "set_vf_allow_bcast: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_vf_broadcast != NULL ) {
+		nic_calls++;
+		ret = ops->set_vf_broadcast(port_id, vf_id, on);
 	}
 	
 	if (ret < 0) {
+		nic_err( port_id, "set_vf_broadcast" );
 		bleat_printf( 0, "set allow bcast failed: port/vf %d/%d on/off=%d rc=%d", port_id, vf_id, on, ret );
 	} else {
 		bleat_printf( 3, "set allow bcast successful: port/vf %d/%d on/off=%d", port_id, vf_id, on );
@@ -470,30 +532,16 @@ void
 set_vf_allow_mcast(portid_t port_id, uint16_t vf_id, int on)
 {
 	int ret = 0;
+	const struct vfd_nic_ops* ops;
 
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			ret = vfd_ixgbe_set_vf_multicast_promisc(port_id, vf_id, on);
-			break;
-			
-		case VFD_FVL25:		
-			ret = vfd_i40e_set_vf_multicast_promisc(port_id, vf_id, on);
-			break;
-
-		case VFD_BNXT:
-			ret = vfd_bnxt_set_vf_multicast_promisc(port_id, vf_id, on);
-			break;
-			
-		case VFD_MLX5:
-			ret = vfd_mlx5_set_vf_promisc(port_id, vf_id, on);
-			break;
-		default:
-			bleat_printf( 0, "set_vf_allow_mcast: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_vf_multicast_promisc != NULL ) {
+		nic_calls++;
+		ret = ops->set_vf_multicast_promisc(port_id, vf_id, on);
 	}
 	
 	if (ret < 0) {
+		nic_err( port_id, "set_vf_multicast_promisc" );
 		bleat_printf( 0, "set allow mcast failed: port/vf %d/%d on/off=%d rc=%d", port_id, vf_id, on, ret );
 	} else {
 		bleat_printf( 3, "set allow mcast successful: port/vf %d/%d on/off=%d", port_id, vf_id, on );
@@ -505,31 +553,16 @@ void
 set_vf_allow_un_ucast(portid_t port_id, uint16_t vf_id, int on)
 {
 	int ret = 0;
+	const struct vfd_nic_ops* ops;
 
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			ret = vfd_ixgbe_set_vf_unicast_promisc(port_id, vf_id, on);
-			break;
-			
-		case VFD_FVL25:		
-			ret = vfd_i40e_set_vf_unicast_promisc(port_id, vf_id, on);
-			break;
-
-		case VFD_BNXT:	
-			ret = vfd_bnxt_set_vf_unicast_promisc(port_id, vf_id, on);
-			break;
-			
-		case VFD_MLX5:		
-			ret = vfd_mlx5_set_vf_promisc(port_id, vf_id, on);
-			break;
-
-		default:
-			bleat_printf( 0, "set_vf_allow_un_ucast: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_vf_unicast_promisc != NULL ) {
+		nic_calls++;
+		ret = ops->set_vf_unicast_promisc(port_id, vf_id, on);
 	}
 	
 	if (ret < 0) {
+		nic_err( port_id, "set_vf_unicast_promisc" );
 		bleat_printf( 0, "set allow ucast failed: port/vf %d/%d on/off=%d rc=%d", port_id, vf_id, on, ret );
 	} else {
 		bleat_printf( 3, "set allow ucast successful: port/vf %d/%d on/off=%d", port_id, vf_id, on );
@@ -541,31 +574,16 @@ void
 set_vf_allow_untagged(portid_t port_id, uint16_t vf_id, int on)
 {
 	int ret = 0;
+	const struct vfd_nic_ops* ops;
 
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			ret = vfd_ixgbe_allow_untagged(port_id, vf_id, on);
-			break;
-			
-		case VFD_FVL25:		
-			ret = vfd_i40e_allow_untagged(port_id, vf_id, on);
-			break;
-
-		case VFD_BNXT:		
-			ret = vfd_bnxt_allow_untagged(port_id, vf_id, on);
-			break;
-
-		case VFD_MLX5:
-			ret = vfd_mlx5_set_vf_vlan_filter(port_id, 0, VFN2MASK(vf_id), on);
-			break;
-			
-		default:
-			bleat_printf( 0, "set_vf_allow_untagged: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->allow_untagged != NULL ) {
+		nic_calls++;
+		ret = ops->allow_untagged(port_id, vf_id, on);
 	}
 	
 	if (ret < 0) {
+		nic_err( port_id, "allow_untagged" );
 		bleat_printf( 3, "set allow untagged failed: port/vf %d/%d on/off=%d rc=%d", port_id, vf_id, on, ret );
 	} else {
 		bleat_printf( 3, "set allow untagged successful: port/vf %d/%d on/off=%d", port_id, vf_id, on );
@@ -578,56 +596,42 @@ set_vf_allow_untagged(portid_t port_id, uint16_t vf_id, int on)
 	If on is false, then the MAC is removed from the port.
 */
 void
-set_vf_rx_mac(portid_t port_id, const char* mac, uint32_t vf,  uint8_t on)
+set_vf_rx_mac(portid_t port_id, uint64_t mac, uint32_t vf,  uint8_t on)
 {
-  int diag = 0;
-  struct ether_addr mac_addr;
-  ether_aton_r(mac, &mac_addr);
+	int diag = 0;
+	struct ether_addr mac_addr;
+	const struct vfd_nic_ops* ops;
+	char	mbuf[MAC_STR_LEN];
+
+	mac_to_ea( mac, &mac_addr );
+	mac_ntoa( mac, mbuf );
 
-  uint dev_type = get_nic_type(port_id);
+	ops = port_ops( port_id );
+	nic_calls++;
 	if(on)
 	{
-		switch (dev_type) {
-			case VFD_NIANTIC:
-				diag = vfd_ixgbe_set_vf_mac_addr(port_id, vf, &mac_addr);
-				break;
-				
-			case VFD_FVL25:		
-				diag = vfd_i40e_set_vf_mac_addr(port_id, vf, &mac_addr);
-				break;
-
-			case VFD_BNXT:	
-				diag = vfd_bnxt_set_vf_mac_addr(port_id, vf, &mac_addr);
-				break;
-				
-			case VFD_MLX5:	
-				diag = vfd_mlx5_set_vf_mac_addr(port_id, vf, mac, on);
-				break;
-
-			default:
-				bleat_printf( 0, "set_vf_rx_mac: unknown device type: %u, port: %u", port_id, dev_type);
-				break;	
+		if( ops->set_vf_mac_addr != NULL ) {
+			diag = ops->set_vf_mac_addr(port_id, vf, &mac_addr);
 		}
 	
 		if (diag < 0) {
-			bleat_printf( 0, "set rx whitelist mac failed: pf/vf=%d/%d on/off=%d mac=%s rc=%d", (int)port_id, (int)vf, on, mac, diag );
+			nic_err( port_id, "set_vf_mac_addr" );
+			bleat_printf( 0, "set rx whitelist mac failed: pf/vf=%d/%d on/off=%d mac=%s rc=%d", (int)port_id, (int)vf, on, mbuf, diag );
 		} else {
-			bleat_printf( 3, "set whitelist rx mac ok: pf/vf=%d/%d on/off=%d mac=%s rc=%d", (int)port_id, (int)vf, on, mac, diag );
+			bleat_printf( 3, "set whitelist rx mac ok: pf/vf=%d/%d on/off=%d mac=%s rc=%d", (int)port_id, (int)vf, on, mbuf, diag );
 		}
 	} else {
-		switch (dev_type) {
-			case VFD_MLX5:
-				diag = vfd_mlx5_set_vf_mac_addr(port_id, vf, mac, on);
-				break;
-			default:
-				diag = rte_eth_dev_mac_addr_remove( port_id, &mac_addr );
-				break;
+		if( ops->del_vf_mac_addr != NULL ) {
+			diag = ops->del_vf_mac_addr(port_id, vf, &mac_addr);
+		} else {
+			diag = rte_eth_dev_mac_addr_remove( port_id, &mac_addr );
 		}
 
 		if( diag < 0 ) {
-			bleat_printf( 0, "delete rx mac failed: pf/vf=%d/%d on/off=%d mac=%s rc=%d", (int)port_id, (int)vf, on, mac, diag );
+			nic_err( port_id, "del_vf_mac_addr" );
+			bleat_printf( 0, "delete rx mac failed: pf/vf=%d/%d on/off=%d mac=%s rc=%d", (int)port_id, (int)vf, on, mbuf, diag );
 		} else {
-			bleat_printf( 3, "delete rx mac successful: pf/vf=%d/%d on/off=%d mac=%s", (int)port_id, (int)vf, on, mac );
+			bleat_printf( 3, "delete rx mac successful: pf/vf=%d/%d on/off=%d mac=%s", (int)port_id, (int)vf, on, mbuf );
 		}
 	}
 }
@@ -643,78 +647,61 @@ set_vf_rx_mac(portid_t port_id, const char* mac, uint32_t vf,  uint8_t on)
 			set_vf_rx_mac() calls first, and then set the default so that the correct behavour
 			happens if the underlying NIC is fortville.
 */
-void set_vf_default_mac( portid_t port_id, const char* mac, uint32_t vf ) {
+void set_vf_default_mac( portid_t port_id, uint64_t mac, uint32_t vf ) {
 	int diag = 0;
 	struct ether_addr mac_addr;
-	ether_aton_r(mac, &mac_addr);
-
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			diag = vfd_ixgbe_set_vf_default_mac_addr(port_id, vf, &mac_addr );
-			break;
-			
-		case VFD_FVL25:		
-			diag = vfd_i40e_set_vf_default_mac_addr(port_id, vf, &mac_addr );
-			break;
+	const struct vfd_nic_ops* ops;
+	char	mbuf[MAC_STR_LEN];
 
-		case VFD_BNXT:	
-			diag = vfd_bnxt_set_vf_default_mac_addr(port_id, vf, &mac_addr );
-			break;
-			
-		case VFD_MLX5:	
-			diag = vfd_mlx5_set_vf_def_mac_addr(port_id, vf, mac);
-			break;
+	mac_to_ea( mac, &mac_addr );
 
-		default:
-			bleat_printf( 0, "set_vf_def_mac: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_vf_default_mac_addr != NULL ) {
+		nic_calls++;
+		diag = ops->set_vf_default_mac_addr(port_id, vf, &mac_addr );
 	}
 
 	if (diag < 0) {
-		bleat_printf( 0, "set default rx mac failed: pf/vf=%d/%d mac=%s rc=%d", (int)port_id, (int)vf, mac, diag );
+		nic_err( port_id, "set_vf_default_mac_addr" );
+		bleat_printf( 0, "set default rx mac failed: pf/vf=%d/%d mac=%s rc=%d", (int)port_id, (int)vf, mac_ntoa( mac, mbuf ), diag );
 	} else {
-		bleat_printf( 3, "set rx default mac ok: pf/vf=%d/%d mac=%s rc=%d", (int)port_id, (int)vf, mac, diag );
+		bleat_printf( 3, "set rx default mac ok: pf/vf=%d/%d mac=%s rc=%d", (int)port_id, (int)vf, mac_ntoa( mac, mbuf ), diag );
 	}
 
 	return;
 }
 
 
-void
-set_vf_rx_vlan(portid_t port_id, uint16_t vlan_id, uint64_t vf_mask, uint8_t on)
+/*
+	Add (on) or remove the vlan from the rx filter of every VF in the mask. Returns 0
+	on success, else the (negative) driver error; on error some words of the mask
+	may have been written.
+*/
+int
+set_vf_rx_vlan(portid_t port_id, uint16_t vlan_id, const vf_mask_t* vf_mask, uint8_t on)
 {
 	int diag = 0;
-
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			diag = vfd_ixgbe_set_vf_vlan_filter(port_id, vlan_id, vf_mask, on);
-			break;
-			
-		case VFD_FVL25:		
-			diag = vfd_i40e_set_vf_vlan_filter(port_id, vlan_id, vf_mask, on);
-			break;
-
-		case VFD_BNXT:
-			diag = vfd_bnxt_set_vf_vlan_filter(port_id, vlan_id, vf_mask, on);
-			break;
-
-		case VFD_MLX5:	
-			diag = vfd_mlx5_set_vf_vlan_filter(port_id, vlan_id, vf_mask, on);
-			break;
-			
-		default:
-			bleat_printf( 0, "set_vf_rx_vlan: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	int i;
+	const struct vfd_nic_ops* ops;
+
+	ops = port_ops( port_id );
+	if( ops->set_vf_vlan_filter != NULL ) {
+		for( i = 0; i < VF_MASK_WORDS && diag >= 0; i++ ) {			// one call for each 64 VF word with a bit set
+			if( vf_mask->w[i] != 0 ) {
+				nic_calls++;
+				diag = ops->set_vf_vlan_filter(port_id, vlan_id, vf_mask->w[i], i * 64, on);
+			}
+		}
 	}
 	
 	if (diag < 0) {
+		nic_err( port_id, "set_vf_vlan_filter" );
 		bleat_printf( 0, "set rx vlan filter failed: port=%d vlan=%d on/off=%d rc=%d", (int)port_id, (int) vlan_id, on, diag );
 	} else {
 		bleat_printf( 3, "set rx vlan filter successful: port=%d vlan=%d on/off=%d", (int)port_id, (int) vlan_id, on );
 	}
 
+	return diag;
 }
 
 
@@ -722,30 +709,16 @@ void
 set_vf_vlan_anti_spoofing(portid_t port_id, uint32_t vf, uint8_t on)
 {
 	int diag = 0;
+	const struct vfd_nic_ops* ops;
 			
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			diag = vfd_ixgbe_set_vf_vlan_anti_spoof(port_id, vf, on);
-			break;
-			
-		case VFD_FVL25:		
-			diag = vfd_i40e_set_vf_vlan_anti_spoof(port_id, vf, on);
-			break;
-
-		case VFD_BNXT:
-			diag = vfd_bnxt_set_vf_vlan_anti_spoof(port_id, vf, on);
-			break;
-			
-		case VFD_MLX5:
-			break;
-
-		default:
-			bleat_printf( 0, "set_vf_vlan_anti_spoofing: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
-	}	
+	ops = port_ops( port_id );
+	if( ops->set_vf_vlan_anti_spoof != NULL ) {
+		nic_calls++;
+		diag = ops->set_vf_vlan_anti_spoof(port_id, vf, on);
+	}
 	
 	if (diag < 0) {
+		nic_err( port_id, "set_vf_vlan_anti_spoof" );
 		bleat_printf( 0, "set vlan antispoof failed: pf/vf=%d/%d on/off=%d rc=%d", (int)port_id, (int)vf, on, diag );
 	} else {
 		bleat_printf( 3, "set vlan antispoof successful: pf/vf=%d/%d on/off=%d", (int)port_id, (int)vf, on );
@@ -754,35 +727,24 @@ set_vf_vlan_anti_spoofing(portid_t port_id, uint32_t vf, uint8_t on)
 }
 
 
+/*
+	Set mac antispoofing. Some NICs force the value (see the backend ops) so what is 
+	logged here is what was requested and not necessarily what was set.
+*/
 void
 set_vf_mac_anti_spoofing(portid_t port_id, uint32_t vf, uint8_t on)
 {
 	int diag = 0;
+	const struct vfd_nic_ops* ops;
 			
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			diag = vfd_ixgbe_set_vf_mac_anti_spoof(port_id, vf, 1);  // always set mac anti-spoof on for niantic
-			break;
-			
-		case VFD_FVL25:		
-			diag = vfd_i40e_set_vf_mac_anti_spoof(port_id, vf, 0);  // always set mac anti-spoof off for FVL
-			break;
-
-		case VFD_BNXT:
-			diag = vfd_bnxt_set_vf_mac_anti_spoof(port_id, vf, on);
-			break;
-
-		case VFD_MLX5:
-			diag = vfd_mlx5_set_vf_mac_anti_spoof(port_id, vf, on);
-			break;
-			
-		default:
-			bleat_printf( 0, "set_vf_mac_anti_spoofing: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
-	}	
+	ops = port_ops( port_id );
+	if( ops->set_vf_mac_anti_spoof != NULL ) {
+		nic_calls++;
+		diag = ops->set_vf_mac_anti_spoof(port_id, vf, on);
+	}
 	
 	if (diag < 0) {
+		nic_err( port_id, "set_vf_mac_anti_spoof" );
 		bleat_printf( 0, "set mac antispoof failed: pf/vf=%d/%d on/off=%d rc=%d", (int)port_id, (int)vf, on, diag );
 	} else {
 		bleat_printf( 3, "set mac antispoof successful: pf/vf=%d/%d on/off=%d", (int)port_id, (int)vf, on );
@@ -794,30 +756,16 @@ void
 tx_set_loopback(portid_t port_id, u_int8_t on)
 {
 	int diag = 0;
+	const struct vfd_nic_ops* ops;
 			
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			diag = vfd_ixgbe_set_tx_loopback(port_id, on);
-			break;
-			
-		case VFD_FVL25:		
-			diag = vfd_i40e_set_tx_loopback(port_id, on);
-			break;
-
-		case VFD_BNXT:
-			diag = vfd_bnxt_set_tx_loopback(port_id, on);
-			break;
-			
-		case VFD_MLX5:
-			break;
-
-		default:
-			bleat_printf( 0, "tx_set_loopback: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
-	}	
+	ops = port_ops( port_id );
+	if( ops->set_tx_loopback != NULL ) {
+		nic_calls++;
+		diag = ops->set_tx_loopback(port_id, on);
+	}
 
 	if (diag < 0) {
+		nic_err( port_id, "set_tx_loopback" );
 		bleat_printf( 0, "set tx loopback failed: port=%d on/off=%d rc=%d", (int)port_id, on, diag );
 	} else {
 		bleat_printf( 3, "set tx loopback successful: port=%d on/off=%d", (int)port_id, on );
@@ -843,7 +791,7 @@ int set_mirror( portid_t port_id, uint32_t vf, uint8_t id, uint8_t target, uint8
 
 	memset( &mconf, 0, sizeof( mconf ) );
 	mconf.dst_pool = target;					// assume 1:1 vf to pool mapping
-	mconf.pool_mask = 1 << vf;
+	mconf.pool_mask = 1ULL << vf;
 
 	switch( direction ) {
 		case MIRROR_IN:
@@ -876,22 +824,21 @@ int set_mirror( portid_t port_id, uint32_t vf, uint8_t id, uint8_t target, uint8
 }	
 
 int set_mirror_wrp( portid_t port_id, uint32_t vf, uint8_t id, uint8_t target, uint8_t direction ) {
-	uint dev_type = get_nic_type(port_id);
+	const struct vfd_nic_ops* ops;
 	int state = 0;
 	int on_off = (direction != MIRROR_OFF) ? 1 : 0; 
 	char const* fail_type = on_off ? "WRN" : "CRI";
 
-	switch (dev_type) {
-			
-		case VFD_MLX5:
-			state = vfd_mlx5_set_mirror(port_id, vf, target, direction);
-			break;
-
-		default:
-			state = set_mirror(port_id, vf, id, target, direction);
+	ops = port_ops( port_id );
+	nic_calls++;
+	if( ops->set_mirror != NULL ) {
+		state = ops->set_mirror(port_id, vf, id, target, direction);
+	} else {
+		state = set_mirror(port_id, vf, id, target, direction);
 	}
 
 	if( state < 0 ) {
+		nic_err( port_id, "set_mirror" );
 		bleat_printf( 0, "%s: set mirror for pf/vf=%d/%d mid=%d target=%d dir=%d on/off=%d failed: %d (%s)", 
 				fail_type, (int) port_id, (int) vf, (int) id, (int) target, (int) direction, (int) on_off, state, strerror( -state ) );
 	} else {
@@ -906,29 +853,14 @@ int set_mirror_wrp( portid_t port_id, uint32_t vf, uint8_t id, uint8_t target, u
 	of the port/vf pair.
 */
 int get_split_ctlreg( portid_t port_id, uint16_t vf_id ) {
-	int ret = 0;
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			ret = vfd_ixgbe_get_split_ctlreg(port_id, vf_id);
-			break;
-			
-		case VFD_FVL25:		
-			ret = vfd_ixgbe_get_split_ctlreg(port_id, vf_id);
-			break;
-
-		case VFD_BNXT:
-			break;
+	const struct vfd_nic_ops* ops;
 
-		case VFD_MLX5:
-			break;
-			
-		default:
-			bleat_printf( 0, "vfd_ixgbe_get_split_ctlreg: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->get_split_ctlreg != NULL ) {
+		return ops->get_split_ctlreg(port_id, vf_id);
 	}
 	
-	return ret;
+	return 0;
 }
 
 /*
@@ -939,27 +871,12 @@ int get_split_ctlreg( portid_t port_id, uint16_t vf_id ) {
 	for the queue if it is set.
 */
 void set_split_erop( portid_t port_id, uint16_t vf_id, int state ) {
+	const struct vfd_nic_ops* ops;
 
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			vfd_ixgbe_set_split_erop(port_id, vf_id, state);
-			break;
-			
-		case VFD_FVL25:		
-			vfd_i40e_set_split_erop(port_id, vf_id, state);
-			break;
-
-		case VFD_BNXT:
-			vfd_bnxt_set_split_erop(port_id, vf_id, state);
-			break;
-
-		case VFD_MLX5:
-			break;
-			
-		default:
-			bleat_printf( 0, "set_split_erop: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_split_erop != NULL ) {
+		nic_calls++;
+		ops->set_split_erop(port_id, vf_id, state);
 	}
 }
 
@@ -968,26 +885,12 @@ void set_split_erop( portid_t port_id, uint16_t vf_id, int state ) {
 */
 static void set_rx_drop(portid_t port_id, uint16_t vf_id, int state )
 {
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			vfd_ixgbe_set_rx_drop(port_id, vf_id, state);
-			break;
-			
-		case VFD_FVL25:		
-			vfd_i40e_set_rx_drop(port_id, vf_id, state);
-			break;
-
-		case VFD_BNXT:
-			vfd_bnxt_set_rx_drop(port_id, vf_id, state);
-			break;
+	const struct vfd_nic_ops* ops;
 
-		case VFD_MLX5:
-			break;
-			
-		default:
-			bleat_printf( 0, "set_rx_drop: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_rx_drop != NULL ) {
+		nic_calls++;
+		ops->set_rx_drop(port_id, vf_id, state);
 	}
 }
 
@@ -998,28 +901,14 @@ static void set_rx_drop(portid_t port_id, uint16_t vf_id, int state )
 */
 extern void set_pfrx_drop(portid_t port_id, int state )
 {
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			vfd_ixgbe_set_pfrx_drop( port_id, state ); 		// (re)set flag for all queues on the port
-			break;
-			
-		case VFD_FVL25:		
-			vfd_i40e_set_pfrx_drop( port_id, state );
-			break;
+	const struct vfd_nic_ops* ops;
 
-		case VFD_BNXT:
-			//vfd_bnxt_set_pfrx_drop( port_id, state ); 				// not implemented TODO
-			break;
-
-		case VFD_MLX5:
-			break;
-			
-		default:
-			bleat_printf( 0, "set_pfrx_drop: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
-	}
-}
+	ops = port_ops( port_id );
+	if( ops->set_pfrx_drop != NULL ) {				// not implemented for bnxt TODO
+		nic_calls++;
+		ops->set_pfrx_drop( port_id, state ); 		// (re)set flag for all queues on the port
+	}
+}
 
 
 /*
@@ -1034,36 +923,20 @@ extern void set_pfrx_drop(portid_t port_id, int state )
 */
 void set_queue_drop( portid_t port_id, int state ) {
 	int		result = 0;
+	const struct vfd_nic_ops* ops;
 
 	
 	bleat_printf( 0, "WARN: something is calling set_queue drop which may not be expected\n" );
 	bleat_printf( 2, "setting queue drop for port %d on all queues to: on/off=%d", port_id, !!state );
 	
-			
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			result = vfd_ixgbe_set_all_queues_drop_en( port_id, !!state ); 		// (re)set flag for all queues on the port
-			break;
-			
-		case VFD_FVL25:		
-			result = vfd_i40e_set_all_queues_drop_en( port_id, !!state );
-			break;
-
-		case VFD_BNXT:
-			result = vfd_bnxt_set_all_queues_drop_en( port_id, !!state ); 				// not implemented TODO
-			break;
-
-		case VFD_MLX5:
-			break;
-			
-		default:
-			bleat_printf( 0, "set_queue_drop: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->set_all_queues_drop_en != NULL ) {
+		nic_calls++;
+		result = ops->set_all_queues_drop_en( port_id, !!state ); 		// (re)set flag for all queues on the port
 	}
-	
 
 	if( result != 0 ) {
+		nic_err( port_id, "set_all_queues_drop_en" );
 		bleat_printf( 0, "fail: unable to set drop enable for port %d on/off=%d: errno=%d", port_id, !state, -result );
 	}
 
@@ -1081,26 +954,12 @@ void set_queue_drop( portid_t port_id, int state ) {
 */
 int get_mac_antispoof( portid_t port_id )
 {
-  int sv = 0;				// spoof value: default to setting to off (allow guests to use any mac)
-
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			sv = 1;
-			bleat_printf( 0, "forcing mac antispoofing to be on for niantic" );
-			break;
-			
-		case VFD_FVL25:		
-			break;
-
-		case VFD_BNXT:
-			break;
-			
-		default:
-			break;	
+	if( port_ops( port_id )->flags & NOF_FORCE_MACSPOOF ) {
+		bleat_printf( 0, "forcing mac antispoofing to be on for niantic" );
+		return 1;
 	}
 
-	return sv;
+	return 0;				// default to setting to off (allow guests to use any mac)
 }
 
 // --------------- pending reset support ----------------------------------------------------------------------
@@ -1111,10 +970,10 @@ int get_mac_antispoof( portid_t port_id )
 	are used to manage the queued reset requests until it is ok to actually
 	execute them.
 
-	When a reset is received, the device is checkecked and if not ready the reset
-	is added to the queue. If there is already a reset queued, the new one is ignored.
-	Periodically we test each device associated with a reset on our queue to see if
-	the tx/rx queues are ready and if they are we allow the reset to happen.
+	When a reset is received it is added to the queue. If there is already a reset
+	queued, the new one just causes the device to be checked sooner. Each device
+	associated with a reset is tested (with backoff) to see if the tx/rx queues
+	are ready and if they are we allow the reset to happen.
 */
 /*
 	Check to see if the NIC tx/rx queues are enabled for the pf/vf pair.
@@ -1123,30 +982,14 @@ int get_mac_antispoof( portid_t port_id )
 int
 is_rx_queue_on(portid_t port_id, uint16_t vf_id, int* mcounter )
 {
-	int result = 0;
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			result = vfd_ixgbe_is_rx_queue_on(port_id, vf_id, mcounter);
-			break;
-			
-		case VFD_FVL25:		
-			result = vfd_i40e_is_rx_queue_on(port_id, vf_id, mcounter);
-			break;
-
-		case VFD_BNXT:
-			result = vfd_bnxt_is_rx_queue_on(port_id, vf_id, mcounter);
-			break;
+	const struct vfd_nic_ops* ops;
 
-		case VFD_MLX5:
-			break;
-			
-		default:
-			bleat_printf( 0, "is_rx_queue_on: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
-	}	
+	ops = port_ops( port_id );
+	if( ops->is_rx_queue_on != NULL ) {
+		return ops->is_rx_queue_on(port_id, vf_id, mcounter);
+	}
 	
-	return result;
+	return 0;
 }
 
 /*
@@ -1157,152 +1000,584 @@ is_rx_queue_on(portid_t port_id, uint16_t vf_id, int* mcounter )
 void
 disable_default_pool(portid_t port_id)
 {
-  uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			vfd_ixgbe_disable_default_pool( port_id ); 
-			break;
-			
+	const struct vfd_nic_ops* ops;
 
-		case VFD_MLX5:
-		case VFD_FVL25:		
-		case VFD_BNXT:
-			break;
-			
-		default:
-			bleat_printf( 0, "disable_default_pool: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->disable_default_pool != NULL ) {		// niantic only
+		nic_calls++;
+		ops->disable_default_pool( port_id ); 
 	}
 }
 
+/*
+	Refresh state is kept in a [port][vf] table so that queueing a reset is a
+	single lookup. Entries waiting on queues are hung on a timer wheel; each
+	wheel slot is one tick and an entry whose queues are not yet on is pushed
+	out by an exponentially growing delay (capped) so that a VM which never
+	brings its queues up costs a register poll every couple of seconds rather
+	than five times a second. A newly queued (or kicked) entry goes on the
+	ready list which the refresh thread services as soon as it is woken.
+
+	Links in the table are index+1 so that a zeroed table (static init)
+	is a valid, empty, set of lists; 0 is the nil link.
+
+	Each entry on the wheel holds the tick it is due; deferrals are computed
+	from the current tick (not the last tick the thread processed, which is
+	stale after the thread has been idle) and an entry found in a slot being
+	swept is only taken if it has come due.
+
+	Only the refresh thread touches the NIC; the lock is held just long enough
+	to move entries between lists and to change state.
+*/
+#define RQ_SLOTS		1024				// slots in the wheel
+#define RQ_READY		RQ_SLOTS			// list index of the ready list
+#define RQ_TICK_MS		2					// ms per wheel slot
+#define RQ_MAX_DELAY	1000				// backoff cap in ticks (~2s); must be less than RQ_SLOTS
+
+#define RQ_DEBOUNCE		25					// ticks (~50ms); repeat events inside this window collapse into one restore
+#define MB_TOKENS		8					// token bucket depth: mailbox driven restores a VF may burst
+#define MB_REFILL_MS	250					// one token is added to a VF's bucket every this many ms
+
+#define RQ_TOK_TAKE		0					// rq_add() token handling: take one for the event
+#define RQ_TOK_PAID		1					// the caller has taken the event's token
+#define RQ_TOK_NONE		2					// the caller was refused a token for the event
+
+#define RQ_IDLE			0					// refresh entry states
+#define RQ_PENDING		1					// on the wheel or ready list
+#define RQ_BUSY			2					// being serviced by the refresh thread (on no list)
+
+typedef struct {
+	int			next;					// list links (index+1, 0 is nil)
+	int			prev;
+	int			list;					// list (slot or RQ_READY) the entry is on when pending
+	uint8_t		state;
+	uint8_t		again;					// reset arrived while busy; run it again
+	uint8_t		drop_on;				// we have set the drop enable bits (refresh thread only)
+	int			delay;					// next backoff delay (ticks)
+	int64_t		due;					// tick the entry is due when on the wheel
+	int			mcounter;				// message counter so as not to flood the log
+	int64_t		queued_ms;				// time the reset was queued (latency stats)
+	int64_t		kick_ms;				// last time a pending entry was moved to the ready list (debounce)
+	int			tokens;					// mailbox work token bucket
+	int64_t		refill_ms;				// time of last token refill; 0 if bucket not yet primed
+	long		events;					// mailbox events which asked for a refresh/restore
+	long		suppressed;				// events which were coalesced, debounced or deferred for lack of tokens
+} rq_ent_t;
+
 static rte_spinlock_t rte_refresh_q_lock = RTE_SPINLOCK_INITIALIZER;
+static rq_ent_t rq_tab[MAX_PORTS][MAX_VFS];
+static int rq_heads[RQ_SLOTS+1];			// wheel slots plus the ready list
+static int64_t rq_last = 0;					// last tick processed by the refresh thread
+static int rq_efd = -1;						// eventfd used to wake the refresh thread
+
+static struct {								// counters for show
+	long	queued;							// resets queued
+	long	kicks;							// resets received while one was pending
+	long	polls;							// queue ready register polls
+	long	restores;						// resets completed
+	int		depth;							// resets pending or being serviced
+	int		max_depth;
+	double	lat_ms;							// queue to restore time of last completion
+	double	lat_max_ms;
+} rq_stats;
+
+/*
+	Current time in ms using the monotonic clock.
+*/
+static int64_t rq_now_ms( void ) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ((int64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+/*
+	Push the entry at index idx onto the head of list. Lock must be held.
+*/
+static void rq_link( int idx, int list ) {
+	rq_ent_t*	ep;
+	rq_ent_t*	tab = &rq_tab[0][0];
+
+	ep = &tab[idx];
+	ep->list = list;
+	ep->prev = 0;
+	ep->next = rq_heads[list];
+	if( ep->next ) {
+		tab[ep->next-1].prev = idx + 1;
+	}
+	rq_heads[list] = idx + 1;
+}
+
+/*
+	Remove the entry at index idx from whatever list it is on. Lock must be held.
+*/
+static void rq_unlink( int idx ) {
+	rq_ent_t*	ep;
+	rq_ent_t*	tab = &rq_tab[0][0];
+
+	ep = &tab[idx];
+	if( ep->prev ) {
+		tab[ep->prev-1].next = ep->next;
+	} else {
+		rq_heads[ep->list] = ep->next;
+	}
+	if( ep->next ) {
+		tab[ep->next-1].prev = ep->prev;
+	}
+	ep->next = ep->prev = 0;
+}
+
+/*
+	Put the entry on the wheel to come due delay ticks from now. Lock must be held.
+*/
+static void rq_sched( int idx, int delay ) {
+	int64_t	due;
+
+	due = (rq_now_ms() / RQ_TICK_MS) + delay;
+	(&rq_tab[0][0])[idx].due = due;
+	rq_link( idx, due % RQ_SLOTS );
+}
+
+/*
+	Move the entries on list which are due by tick now (all of them for the ready
+	list) to the work array and mark them busy. Returns the new count in the work
+	array. Lock must be held.
+*/
+static int rq_take( int list, int* work, int nwork, int64_t now ) {
+	rq_ent_t*	tab = &rq_tab[0][0];
+	int	idx;
+	int	next;
+
+	for( idx = rq_heads[list]; idx != 0; idx = next ) {
+		next = tab[idx-1].next;
+		if( list == RQ_READY || tab[idx-1].due <= now ) {
+			rq_unlink( idx-1 );
+			tab[idx-1].state = RQ_BUSY;
+			work[nwork++] = idx-1;
+		}
+	}
+
+	return nwork;
+}
+
+/*
+	Refill the entry's token bucket based on elapsed time and take a token if there
+	is one. Returns 1 if a token was taken, 0 if the bucket is empty. Lock must be held.
+*/
+static int rq_take_token( rq_ent_t* ep, int64_t now ) {
+	int64_t	n;
+
+	if( ep->refill_ms == 0 ) {							// first use, start full
+		ep->tokens = MB_TOKENS;
+		ep->refill_ms = now;
+	}
+
+	if( (n = (now - ep->refill_ms) / MB_REFILL_MS) > 0 ) {
+		ep->tokens += n;
+		ep->refill_ms += n * MB_REFILL_MS;
+		if( ep->tokens >= MB_TOKENS ) {
+			ep->tokens = MB_TOKENS;
+			ep->refill_ms = now;
+		}
+	}
+
+	if( ep->tokens > 0 ) {
+		ep->tokens--;
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+	Number of ticks until the entry's bucket gets its next token; never less than
+	the debounce window. Lock must be held.
+*/
+static int rq_token_delay( rq_ent_t* ep, int64_t now ) {
+	int	d;
+
+	d = (int) ((ep->refill_ms + MB_REFILL_MS - now) / RQ_TICK_MS) + 1;
+	if( d < RQ_DEBOUNCE ) {
+		d = RQ_DEBOUNCE;
+	}
+	if( d > RQ_MAX_DELAY ) {
+		d = RQ_MAX_DELAY;
+	}
+
+	return d;
+}
+
+/*
+	Poke the refresh thread.
+*/
+static void rq_wake( void ) {
+	uint64_t one = 1;
+
+	if( rq_efd >= 0 ) {
+		if( write( rq_efd, &one, sizeof( one ) ) < 0 ) {
+			bleat_printf( 2, "refresh queue wake failed: %s", strerror( errno ) );
+		}
+	}
+}
+
+/*
+	Queue a refresh for the port/vf. Mailbox driven work is rate limited per VF with a
+	token bucket; a VF without a token has its refresh deferred until a token is due
+	rather than dropped, so it is always eventually restored. Repeat events for a VF
+	with a refresh already pending collapse into that refresh; a pending entry is only
+	moved up to the ready list if it was not kicked within the debounce window (and
+	it has a token). Tok (RQ_TOK_ const) says whether the token for the event is to
+	be taken here or was already taken (or refused) by the caller, so an event costs
+	one token however many kinds of work it causes. Returns 1 if the event resulted
+	in immediate work, 0 if it was coalesced or deferred.
+*/
+static int rq_add( portid_t port_id, uint16_t vf_id, int tok ) {
+	rq_ent_t*	ep;
+	int64_t		now;
+	int			idx;
+	int			rc = 0;
+
+	idx = (port_id * MAX_VFS) + vf_id;
+	ep = &rq_tab[port_id][vf_id];
+	now = rq_now_ms();
+
+	rte_spinlock_lock(&rte_refresh_q_lock);
+	if( tok != RQ_TOK_PAID ) {							// a paid event was counted when the token was taken
+		ep->events++;
+	}
+	switch( ep->state ) {
+		case RQ_IDLE:
+			ep->state = RQ_PENDING;
+			ep->delay = 1;
+			ep->mcounter = 0;
+			ep->queued_ms = now;
+			ep->kick_ms = now;
+			rq_stats.queued++;
+			if( ++rq_stats.depth > rq_stats.max_depth ) {
+				rq_stats.max_depth = rq_stats.depth;
+			}
+			if( tok == RQ_TOK_PAID || (tok == RQ_TOK_TAKE && rq_take_token( ep, now )) ) {
+				rq_link( idx, RQ_READY );
+				rc = 1;
+			} else {
+				ep->suppressed++;
+				rq_sched( idx, rq_token_delay( ep, now ) );
+				bleat_printf( 2, "refresh for %d/%d deferred: mailbox rate limit", port_id, vf_id );
+			}
+			break;
+
+		case RQ_PENDING:
+			rq_stats.kicks++;
+			if( ep->list != RQ_READY && now - ep->kick_ms >= RQ_DEBOUNCE * RQ_TICK_MS && (tok == RQ_TOK_PAID || (tok == RQ_TOK_TAKE && rq_take_token( ep, now ))) ) {
+				rq_unlink( idx );
+				rq_link( idx, RQ_READY );
+				ep->delay = 1;							// backoff starts over
+				ep->kick_ms = now;
+				rc = 1;
+			} else {
+				ep->suppressed++;						// rides on the refresh already pending
+			}
+			break;
+
+		default:										// busy; rerun (debounced) when finished
+			rq_stats.kicks++;
+			if( ep->again ) {
+				ep->suppressed++;
+			}
+			ep->again = 1;
+			break;
+	}
+	rte_spinlock_unlock(&rte_refresh_q_lock);
+
+	rq_wake();
+	vfd_wake();											// let the main loop know something happened
+
+	return rc;
+}
 
 /*
 	Add a reset event to our queue.  We will pop it and update the nic
-	when the pf/vf queues are ready. If a reset for the pf/vf is already on
-	the queue then we do nothing.
+	when the pf/vf queues are ready. If a reset for the pf/vf is already
+	pending the event is merged with it (see rq_add()); if the reset is in
+	progress it will be run again when finished.
+	No NIC access is done here; this is called on the interrupt thread.
 */
 void
 add_refresh_queue(u_int8_t port_id, uint16_t vf_id)
 {
-	struct rq_entry *refresh_item;
+	if( port_id >= MAX_PORTS || vf_id >= MAX_VFS ) {
+		bleat_printf( 0, "WRN: refresh queue: port/vf out of range: %d/%d", port_id, vf_id );
+		return;
+	}
 
-	/* look for refresh request and update enabled status if already there */
+	if( rq_add( port_id, vf_id, RQ_TOK_TAKE ) ) {
+		bleat_printf( 2, "adding refresh to queue for %d/%d", port_id, vf_id );
+	}
+}
+
+/*
+	Called before mailbox driven work which must be done now (e.g. a restore on
+	api negotiate) to check the VF's token bucket. Returns 1 if the work may be
+	done. If the VF is over its rate, 0 is returned and a (deferred) refresh is
+	queued in its place so that the restore still happens once the VF quiets down.
+	If refresh is set the event also wants a refresh queued (set lpe); it is queued
+	on the same token rather than charging the VF a second one.
+*/
+extern int mb_rate_check( portid_t port_id, uint16_t vf_id, int refresh ) {
+	rq_ent_t*	ep;
+	int			ok;
+
+	if( port_id >= MAX_PORTS || vf_id >= MAX_VFS ) {
+		return 1;
+	}
+
+	ep = &rq_tab[port_id][vf_id];
 	rte_spinlock_lock(&rte_refresh_q_lock);
-	for( refresh_item = rq_list; refresh_item != NULL; refresh_item = refresh_item->next ) {
-		if (refresh_item->port_id == port_id && refresh_item->vf_id == vf_id){
-			if (!refresh_item->enabled) {
-				refresh_item->enabled = is_rx_queue_on(port_id, vf_id, &refresh_item->mcounter );
-			}
+	ok = rq_take_token( ep, rq_now_ms() );
+	if( ok ) {
+		ep->events++;
+	}
+	rte_spinlock_unlock(&rte_refresh_q_lock);
 
-			rte_spinlock_unlock(&rte_refresh_q_lock);
-			return;
+	if( ! ok ) {
+		bleat_printf( 2, "mailbox work for %d/%d over rate; converted to deferred refresh", port_id, vf_id );
+		rq_add( port_id, vf_id, RQ_TOK_NONE );						// counts the event and suppression; no second try at the bucket
+	} else {
+		if( refresh ) {
+			rq_add( port_id, vf_id, RQ_TOK_PAID );
 		}
 	}
 
+	return ok;
+}
+
+/*
+	Fill buf with the mailbox event counters for the port/vf. Returns the length,
+	0 if nothing has been suppressed for the VF (nothing interesting to show).
+*/
+extern int mb_vf_stats( portid_t port_id, int vf_id, char* buf, int blen ) {
+	rq_ent_t*	ep;
+	int	l;
+
+	*buf = 0;
+	if( port_id >= MAX_PORTS || vf_id < 0 || vf_id >= MAX_VFS ) {
+		return 0;
+	}
+
+	ep = &rq_tab[port_id][vf_id];
+	rte_spinlock_lock(&rte_refresh_q_lock);
+	if( ep->suppressed == 0 ) {
+		rte_spinlock_unlock(&rte_refresh_q_lock);
+		return 0;
+	}
+	l = snprintf( buf, blen, "pf %d vf %d mbox events: %ld  suppressed: %ld  tokens: %d\n", port_id, vf_id, ep->events, ep->suppressed, ep->tokens );
 	rte_spinlock_unlock(&rte_refresh_q_lock);
 
-	refresh_item = malloc(sizeof(*refresh_item));
-	if (refresh_item == NULL)
-		rte_exit(EXIT_FAILURE, "add_refresh_queue(): Can not allocate memory\n");
+	if( l >= blen ) {
+		l = blen - 1;
+	}
+	return l;
+}
+
+/*
+	Service one entry taken from the wheel. The first time through the drop enable
+	bit is set (emulates the kernel driver); then if the VF queues are on we restore
+	the VF and clear the drop bit, else the entry goes back on the wheel with the
+	next backoff delay. Runs without the lock held; the entry is busy so nobody else
+	will move it.
+*/
+static void rq_service( int idx ) {
+	rq_ent_t*	ep;
+	portid_t	port_id;
+	uint16_t	vf_id;
+	int			on;
+	double		lat;
+
+	ep = &(&rq_tab[0][0])[idx];
+	port_id = idx / MAX_VFS;
+	vf_id = idx % MAX_VFS;
+
+	if( ! ep->drop_on ) {
+		set_rx_drop( port_id, vf_id, SET_ON );					// set the drop enable flag (emulate kernel driver)
+		ep->drop_on = 1;
+	}
 
-	refresh_item->port_id = port_id;
-	refresh_item->vf_id = vf_id;
-	refresh_item->mcounter = 0;
-	refresh_item->enabled = is_rx_queue_on(port_id, vf_id, &refresh_item->mcounter );
-	refresh_item->prev = NULL;
-	bleat_printf( 2, "adding refresh to queue for %d/%d", port_id, vf_id );
+	on = is_rx_queue_on( port_id, vf_id, &ep->mcounter );
+	if( on ) {
+		bleat_printf( 2, "refresh item enabled: updating VF: %d", vf_id );
+		restore_vf_setings( port_id, vf_id );					// refresh all of our configuration back onto the NIC
+
+		bleat_printf( 3, "refresh_queue: clearing enable queue drop for %d/%d", port_id, vf_id );
+		set_rx_drop( port_id, vf_id, SET_OFF );
+		ep->drop_on = 0;
+	}
 
 	rte_spinlock_lock(&rte_refresh_q_lock);
-	
-	set_rx_drop( refresh_item->port_id, refresh_item->vf_id, SET_ON );		// set the drop enable flag (emulate kernel driver)
+	rq_stats.polls++;
+	if( on ) {
+		lat = (double) (rq_now_ms() - ep->queued_ms);
+		rq_stats.restores++;
+		rq_stats.lat_ms = lat;
+		if( lat > rq_stats.lat_max_ms ) {
+			rq_stats.lat_max_ms = lat;
+		}
 
-	refresh_item->next = rq_list;						// push on the head of the list, order is unimportant
-	rq_list = refresh_item;
-	if( refresh_item->next ) {
-		refresh_item->next->prev = refresh_item;
+		if( ep->again ) {										// reset arrived while we were working; do it again after the debounce window
+			ep->again = 0;
+			ep->state = RQ_PENDING;
+			ep->delay = 1;
+			ep->queued_ms = ep->kick_ms = rq_now_ms();
+			rq_sched( idx, RQ_DEBOUNCE );
+		} else {
+			ep->state = RQ_IDLE;
+			rq_stats.depth--;
+		}
+	} else {
+		if( ep->again ) {										// mailbox activity; check again on the next tick
+			ep->again = 0;
+			ep->delay = 1;
+		}
+		ep->state = RQ_PENDING;
+		rq_sched( idx, ep->delay );
+		ep->delay *= 2;
+		if( ep->delay > RQ_MAX_DELAY ) {
+			ep->delay = RQ_MAX_DELAY;
+		}
 	}
 	rte_spinlock_unlock(&rte_refresh_q_lock);
 }
 
 /*
-	If a queued block for port/vf exists, mark it enabled. This is a hack.
-	There are observed cases where the VF tx/rx queues never show ready. This
-	function will force the pending reset to be dispatchable regardless of
-	what the state of the NIC is.  This funciton is called when we receive a
-	mailbox message which we interpret as meaning that the device is up and
-	in a 'ready' state.
-DEPRECATED
-static void enable_refresh_queue(u_int8_t port_id, uint16_t vf_id)
-{
-	struct rq_entry *refresh_item;
+	Return the ms until the next wheel slot with something on it, 0 if the ready
+	list has something, or -1 if there is nothing pending. Lock must be held.
+*/
+static int rq_next_due( void ) {
+	int64_t	now;
+	int64_t	t;
 
-	bleat_printf( 3, "enable is looking for: %d %d", port_id, vf_id );
-	rte_spinlock_lock(&rte_refresh_q_lock);
-	XXTAILQ_FOREACH(refresh_item, &rq_head, rq_entries) {
-		if (refresh_item->port_id == port_id && refresh_item->vf_id == vf_id){
-			bleat_printf( 2, "enabling %d/%d", port_id, vf_id );
-			refresh_item->enabled = 1;
+	if( rq_heads[RQ_READY] ) {
+		return 0;
+	}
+
+	now = rq_now_ms() / RQ_TICK_MS;						// servicing may have taken us past rq_last
+	for( t = rq_last + 1; t < rq_last + RQ_SLOTS; t++ ) {
+		if( rq_heads[t % RQ_SLOTS] ) {
+			return t <= now ? 0 : (int) (t - now) * RQ_TICK_MS;
 		}
 	}
+
+	return -1;
+}
+
+/*
+	Fill buf with the refresh queue counters. Returns the length added.
+*/
+extern int refresh_stats( char* buf, int blen ) {
+	int	l;
+
+	rte_spinlock_lock(&rte_refresh_q_lock);
+	l = snprintf( buf, blen, "refresh queue: queued: %ld  kicks: %ld  polls: %ld  restores: %ld  depth: %d  max-depth: %d  last: %.0fms  worst: %.0fms\n",
+		rq_stats.queued, rq_stats.kicks, rq_stats.polls, rq_stats.restores, rq_stats.depth, rq_stats.max_depth, rq_stats.lat_ms, rq_stats.lat_max_ms );
 	rte_spinlock_unlock(&rte_refresh_q_lock);
-	return;
+
+	if( l >= blen ) {
+		l = blen - 1;
+	}
+	return l;
 }
+
+/*
+	Add the refresh queue counters to buf in OpenMetrics form. Returns the length added.
 */
+extern int refresh_metrics( char* buf, int blen ) {
+	int	l;
 
+	rte_spinlock_lock(&rte_refresh_q_lock);
+	l = snprintf( buf, blen,
+		"# TYPE vfd_refresh_queue_depth gauge\n# HELP vfd_refresh_queue_depth VF resets waiting for queues to come ready.\nvfd_refresh_queue_depth %d\n"
+		"# TYPE vfd_refresh_queue_max_depth gauge\nvfd_refresh_queue_max_depth %d\n"
+		"# TYPE vfd_refresh_queued counter\nvfd_refresh_queued_total %ld\n"
+		"# TYPE vfd_refresh_kicks counter\n# HELP vfd_refresh_kicks Resets received while one was already pending.\nvfd_refresh_kicks_total %ld\n"
+		"# TYPE vfd_refresh_polls counter\nvfd_refresh_polls_total %ld\n"
+		"# TYPE vfd_refresh_restores counter\nvfd_refresh_restores_total %ld\n"
+		"# TYPE vfd_refresh_restore_seconds gauge\n# HELP vfd_refresh_restore_seconds Queue to restore time of the last completed reset.\nvfd_refresh_restore_seconds %.3f\n"
+		"# TYPE vfd_refresh_restore_max_seconds gauge\nvfd_refresh_restore_max_seconds %.3f\n",
+		rq_stats.depth, rq_stats.max_depth, rq_stats.queued, rq_stats.kicks, rq_stats.polls, rq_stats.restores,
+		rq_stats.lat_ms / 1000.0, rq_stats.lat_max_ms / 1000.0 );
+	rte_spinlock_unlock(&rte_refresh_q_lock);
+
+	if( l >= blen ) {
+		l = blen - 1;
+	}
+	return l;
+}
 
 /*
 	This is executed in it's own thread and is responsible for checking the
-	queue of pending resets. When a pending reset becomes 'enabled' then
-	the following happen:
-		- restore_vf_settings() executed for the VF
+	pending resets. The thread blocks until either a reset is queued (eventfd)
+	or the next wheel slot with something on it comes due. Due entries are taken
+	off the wheel under the lock and then serviced (see rq_service()) without it:
+		- restore_vf_settings() executed for the VF when its queues are on
 		- drop enable bit is CLEARED for all of the VF's queues.
-		- the block is removed from the queue
+		- otherwise the entry is rescheduled with backoff
 */
 void
 process_refresh_queue(void)
 {
-	struct rq_entry* next_item;		// pointer makes delete and free safe in loop
+	static int work[MAX_PORTS * MAX_VFS];		// entries to service this pass
+	struct pollfd	pfd;
+	uint64_t	junk;
+	int64_t		now;
+	int			nwork;
+	int			to;
+	int			i;
 
-	while(1) {
+	if( (rq_efd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC )) < 0 ) {
+		bleat_printf( 0, "WRN: refresh queue: unable to create eventfd, polling every tick: %s", strerror( errno ) );
+	}
 
-		usleep(200000);
-		//usleep(5000000);
-		struct rq_entry *refresh_item;
+	rte_spinlock_lock(&rte_refresh_q_lock);
+	rq_last = rq_now_ms() / RQ_TICK_MS;
+	rte_spinlock_unlock(&rte_refresh_q_lock);
 
+	while(1) {
 		rte_spinlock_lock(&rte_refresh_q_lock);
-		for( refresh_item = rq_list; refresh_item != NULL; refresh_item = next_item ) {
-			next_item = refresh_item->next;			// if we delete we need this to go forward
-
-			//printf("checking the queue:  PORT: %d, VF: %d, Enabled: %d\n", refresh_item->port_id, refresh_item->vf_id, refresh_item->enabled);
-			/* check if item's q is enabled, update VF and remove item from queue */
-			if(refresh_item->enabled){
-				bleat_printf( 2, "refresh item enabled: updating VF: %d", refresh_item->vf_id);
- 
-				restore_vf_setings(refresh_item->port_id, refresh_item->vf_id);		// refresh all of our configuration back onto the NIC
-				
-				bleat_printf( 3, "refresh_queue: clearing enable queue drop for %d/%d", refresh_item->port_id, refresh_item->vf_id );
-				set_rx_drop( refresh_item->port_id, refresh_item->vf_id, SET_OFF );
-
-				if( refresh_item->prev ) {
-					refresh_item->prev->next = refresh_item->next;
-				} else {
-					rq_list = refresh_item->next;						// when the head
-				}
-				if( refresh_item->next ) {
-					refresh_item->next->prev = refresh_item->prev;
-				}
-				memset( refresh_item, 0, sizeof( *refresh_item ) );
-				free(refresh_item);
-			}
-			else
-			{
-				refresh_item->enabled = is_rx_queue_on(refresh_item->port_id, refresh_item->vf_id, &refresh_item->mcounter );
-				//printf("updating item:  PORT: %d, VF: %d, Enabled: %d\n", refresh_item->port_id, refresh_item->vf_id, refresh_item->enabled);
-			}
+		now = rq_now_ms() / RQ_TICK_MS;
+		nwork = rq_take( RQ_READY, work, 0, now );
+		if( now - rq_last >= RQ_SLOTS ) {					// been away a full revolution; everything is due
+			rq_last = now - RQ_SLOTS;
+		}
+		while( rq_last < now ) {
+			rq_last++;
+			nwork = rq_take( rq_last % RQ_SLOTS, work, nwork, now );
+		}
+		rte_spinlock_unlock(&rte_refresh_q_lock);
+
+		for( i = 0; i < nwork; i++ ) {
+			rq_service( work[i] );
 		}
 
+		rte_spinlock_lock(&rte_refresh_q_lock);
+		to = rq_next_due();
 		rte_spinlock_unlock(&rte_refresh_q_lock);
+
+		if( to == 0 ) {
+			continue;
+		}
+
+		if( rq_efd < 0 ) {
+			usleep( RQ_TICK_MS * 1000 );
+			continue;
+		}
+
+		pfd.fd = rq_efd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if( poll( &pfd, 1, to ) > 0 ) {
+			if( read( rq_efd, &junk, sizeof( junk ) ) < 0 ) {		// drain; nonblocking so EAGAIN is fine
+				junk = 0;
+			}
+		}
 	}
 }
 
@@ -1330,211 +1605,184 @@ nic_stats_clear(portid_t port_id)
 }
 
 
-int
-nic_stats_display(uint16_t port_id, char * buff, int bsize)
-{
-	struct rte_eth_stats stats;
-	struct rte_eth_link link;
-	rte_eth_link_get_nowait(port_id, &link);
-	rte_eth_stats_get(port_id, &stats);	
-
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			spoffed[port_id] += vfd_ixgbe_get_pf_spoof_stats(port_id); 
-			break;
-			
-		case VFD_FVL25:		
-			spoffed[port_id] = vfd_i40e_get_pf_spoof_stats(port_id);  // FVL25 doesn't reset counters on read, so no adding here
-			break;
+/*
+	Extended stats selection. Resolving xstat names means two get_names calls and
+	a table of several hundred names, so it is done once per port; after that only
+	the ids of the selected stats are kept and a display (or stats sweep) is a
+	single rte_eth_xstats_get_by_id() for just those ids. The values are read only by
+	the stats sweep (xstats_collect()); show ex, dump and the exporter format from the
+	snapshot. The selection is a list of fnmatch() patterns from the parm file (xstats);
+	without one the packet size histogram is shown as it always has been. The lock is held across driver calls
+	so it is a mutex rather than a spin lock.
+*/
+static const char* xs_def_pats[] = { "rx_size_*", "tx_size_*" };
 
-		case VFD_BNXT:
-			spoffed[port_id] = vfd_bnxt_get_pf_spoof_stats(port_id);  // BNXT counters are not-reset-on-read. No need to add.
-			break;
-			
-		case VFD_MLX5:
-			spoffed[port_id] += vfd_mlx5_get_pf_spoof_stats(port_id); 
-			break;
+static const char** xs_pats = xs_def_pats;
+static int xs_npats = sizeof( xs_def_pats ) / sizeof( xs_def_pats[0] );
 
-		default:
-			bleat_printf( 0, "nic_stats_display: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
-	}
-	
+static struct {
+	int		loaded;
+	int		n;										// number selected
+	uint64_t*	ids;
+	uint64_t*	values;
+	struct rte_eth_xstat_name* names;				// name of each selected id
+} xs_sel[MAX_PORTS];
+static pthread_mutex_t xs_lock = PTHREAD_MUTEX_INITIALIZER;
 
-	char status[5];
-	if(!link.link_status)
-		stpcpy(status, "DOWN");
-	else
-		stpcpy(status, "UP  ");
-
-		//" %6s %6"PRIu16" %6"PRIu16" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu32" %lld\n",
-	return snprintf( buff, bsize, " %6s  %6d %6d %15lld %15lld %15lld %15lld %15lld %15lld %15d %15lld\n",
-		status,
-		(int) link.link_speed,
-		(int) link.link_duplex,
-		(long long) stats.ipackets,
-		(long long) stats.ibytes,
-		(long long) stats.ierrors,
-		(long long) stats.imissed,
-		(long long) stats.opackets,
-		(long long) stats.obytes,
-		(int) stats.oerrors,
-		(long long) spoffed[port_id]
-	);
+/*
+	Drop the port's resolved selection. Caller holds xs_lock.
+*/
+static void xs_flush( portid_t port_id ) {
+	free( xs_sel[port_id].ids );
+	free( xs_sel[port_id].values );
+	free( xs_sel[port_id].names );
+	memset( &xs_sel[port_id], 0, sizeof( xs_sel[port_id] ) );
 }
 
 /*
-*	prints VF statistics
-	Returns number of characters placd into buff, or -1 if error (vf not in use
-	or out of range).  The parm ivf is the virtual function number which is maintained
-	as integer in our datstructs allowing -1 to indicate an uninstalled/delted VF.
-	It is converted to uint32 for calculations here.
+	Resolve the selected names to ids for the port. Caller holds xs_lock.
+	Returns the number selected or -1 on error.
 */
-int
-vf_stats_display(uint16_t port_id, uint32_t pf_ari, int ivf, char * buff, int bsize)
-{
-	uint32_t vf;
-	int result = 0;
-	uint64_t vf_spoffed = 0;
-	uint64_t vf_rx_dropped = 0;
-		
-	if( ivf < 0 || ivf > 31 ) {
-		return -1;
-	}
+static int xs_resolve( portid_t port_id ) {
+	struct rte_eth_xstat_name* all;
+	int		cnt;
+	int		i;
+	int		j;
+	int		n = 0;
 
-	vf = (uint32_t) ivf;						// unsinged for rest
+	xs_flush( port_id );
 
-	uint32_t new_ari;
-	struct rte_pci_addr vf_pci_addr;
-	
-	bleat_printf( 5, "vf_stats_display: pf/vf=%d/%d", port_id, vf);
-
-	struct sriov_port_s *port = &running_config->ports[port_id];	
-	new_ari = pf_ari + port->vf_offset + (vf * port->vf_stride);
+	if( (cnt = rte_eth_xstats_get_names( port_id, NULL, 0 )) < 0 ) {
+		bleat_printf( 0, "fail: unable to get count of xstats for port: %d", port_id );
+		return -1;
+	}
 
-	bleat_printf( 5, "vf_stats_display: offset=%d, stride=%d", port->vf_offset, port->vf_stride);
+	if( (all = (struct rte_eth_xstat_name *) malloc( sizeof( *all ) * (cnt + 1) )) == NULL ) {
+		bleat_printf( 0, "fail: unable to allocate memory for xstat names for port: %d", port_id );
+		return -1;
+	}
+	if( cnt != rte_eth_xstats_get_names( port_id, all, cnt ) ) {
+		bleat_printf( 0, "fail: unable to get xstat names for port: %d", port_id );
+		free( all );
+		return -1;
+	}
 
-	vf_pci_addr.domain = 0;
-	vf_pci_addr.bus = (new_ari >> 8) & 0xff;
-	vf_pci_addr.devid = (new_ari >> 3) & 0x1f;
-	vf_pci_addr.function = new_ari & 0x7;
+	xs_sel[port_id].ids = (uint64_t *) malloc( sizeof( uint64_t ) * (cnt + 1) );
+	xs_sel[port_id].values = (uint64_t *) malloc( sizeof( uint64_t ) * (cnt + 1) );
+	xs_sel[port_id].names = (struct rte_eth_xstat_name *) malloc( sizeof( *all ) * (cnt + 1) );
+	if( xs_sel[port_id].ids == NULL || xs_sel[port_id].values == NULL || xs_sel[port_id].names == NULL ) {
+		bleat_printf( 0, "fail: unable to allocate memory for xstat for port: %d", port_id );
+		xs_flush( port_id );
+		free( all );
+		return -1;
+	}
 
+	for( i = 0; i < cnt; i++ ) {
+		for( j = 0; j < xs_npats; j++ ) {
+			if( xs_pats[j] != NULL && fnmatch( xs_pats[j], all[i].name, 0 ) == 0 ) {
+				xs_sel[port_id].ids[n] = i;
+				xs_sel[port_id].names[n] = all[i];
+				n++;
+				break;
+			}
+		}
+	}
+	free( all );
 
-	struct rte_eth_stats stats;
-	memset( &stats, 0, sizeof( stats ) );			// not all NICs fill all data, so ensure we have 0s
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			result = vfd_ixgbe_get_vf_stats(port_id, vf, &stats);
-			stats.oerrors = 0;
-			break;
-			
-		case VFD_FVL25:		
-			result = vfd_i40e_get_vf_stats(port_id, vf, &stats);
-			break;
+	xs_sel[port_id].n = n;
+	xs_sel[port_id].loaded = 1;
+	bleat_printf( 2, "xstats: port %d: %d of %d extended stats selected", port_id, n, cnt );
+	return n;
+}
 
-		case VFD_BNXT:
-			result = vfd_bnxt_get_vf_stats(port_id, vf, &stats);
-			if (rte_pmd_bnxt_get_vf_tx_drop_count(port_id, vf, &vf_spoffed))
-				vf_spoffed = UINT64_MAX;
-			break;
-			
-		case VFD_MLX5:
-			result = vfd_mlx5_get_vf_stats(port_id, vf, &stats);
-			vf_spoffed = vfd_mlx5_get_vf_spoof_stats(port_id, vf);
-			break;
+/*
+	Fetch the selected values for the port into its values array; the selection is
+	resolved if it hasn't been, and again if the driver rejects the ids (the set
+	changes if the port is reconfigured). Caller holds xs_lock. Returns the number
+	of values or -1.
+*/
+static int xs_fetch( portid_t port_id ) {
+	int		tries;
 
-		default:
-			bleat_printf( 0, "vf_stats_display: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
-	}
-	
-	if( result != 0 ) {
-		bleat_printf( 0, "fail: vf_stats_display: port %d, vf=%d: errno=%d", port_id, vf, result );
+	if( port_id >= MAX_PORTS ) {
+		return -1;
 	}
 
+	for( tries = 0; tries < 2; tries++ ) {
+		if( ! xs_sel[port_id].loaded && xs_resolve( port_id ) < 0 ) {
+			return -1;
+		}
+		if( xs_sel[port_id].n == 0 ) {
+			return 0;
+		}
 
-	char status[5];
-	int mcounter = 0;
-	if(!is_rx_queue_on(port_id, vf, &mcounter ))
-		stpcpy(status, "DOWN");
-	else
-	    stpcpy(status, "UP  ");
-	
+		if( rte_eth_xstats_get_by_id( port_id, xs_sel[port_id].ids, xs_sel[port_id].values, xs_sel[port_id].n ) == xs_sel[port_id].n ) {
+			return xs_sel[port_id].n;
+		}
+		xs_sel[port_id].loaded = 0;
+	}
 
-	return 	snprintf(buff, bsize, "%2s %6d    %04X:%02X:%02X.%01X %6s %30"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64"\n",
-				"vf", vf, vf_pci_addr.domain, vf_pci_addr.bus, vf_pci_addr.devid, vf_pci_addr.function, status,
-				stats.ipackets, stats.ibytes, stats.ierrors, vf_rx_dropped, stats.opackets, stats.obytes, stats.oerrors, vf_spoffed);
-				
+	bleat_printf( 0, "fail: unable to get xstat for port: %d", port_id );
+	return -1;
 }
 
-
 /*
-	prints extended PF statistics
-	rx_size_64_packets: 0
-	rx_size_65_to_127_packets: 0
-	rx_size_128_to_255_packets: 0
-	rx_size_256_to_511_packets: 0
-	rx_size_512_to_1023_packets: 0
-	rx_size_1024_to_max_packets: 0
-	tx_size_64_packets: 0
-	tx_size_65_to_127_packets: 0
-	tx_size_128_to_255_packets: 0
-	tx_size_256_to_511_packets: 0
-	tx_size_512_to_1023_packets: 0
-	tx_size_1024_to_max_packets: 0
-
-	eturns number of characters placed into buff.
+	Set the extended stat name patterns; nil or none restores the default. The
+	pattern strings are not copied and must persist (they are the parms). Selections
+	already resolved are dropped and resolved against the new list on next use.
 */
-int
-port_xstats_display(uint16_t port_id, char * buff, int bsize)
-{
-	struct rte_eth_xstat *xstats;
-	int cnt_xstats, idx_xstat;
-	struct rte_eth_xstat_name *xstats_names;
+extern void xstats_select( char** pats, int npats ) {
+	int		i;
 
-	cnt_xstats = rte_eth_xstats_get_names(port_id, NULL, 0);
-	if (cnt_xstats  < 0) {
-		bleat_printf( 0, "fail: unable to get count of xstats for port: %d", port_id);
-		return 0;
+	pthread_mutex_lock( &xs_lock );
+	if( pats != NULL && npats > 0 ) {
+		xs_pats = (const char **) pats;
+		xs_npats = npats;
+	} else {
+		xs_pats = xs_def_pats;
+		xs_npats = sizeof( xs_def_pats ) / sizeof( xs_def_pats[0] );
 	}
 
-	xstats_names = malloc(sizeof(struct rte_eth_xstat_name) * cnt_xstats);
-	if (xstats_names == NULL) {
-		bleat_printf( 0, "fail: unable to allocate memory for xstat names for port: %d", port_id);
-		return 0;
+	for( i = 0; i < MAX_PORTS; i++ ) {
+		xs_flush( i );
 	}
-	
-	if (cnt_xstats != rte_eth_xstats_get_names(port_id, xstats_names, cnt_xstats)) {
-		bleat_printf( 0, "fail: unable to get xstat names for port: %d", port_id);
-		free(xstats_names);
-		return 0;
+	pthread_mutex_unlock( &xs_lock );
+}
+
+/*
+	Resolve the selection for the port now (called as the port is initialised) so
+	that the first show or scrape doesn't pay for it.
+*/
+extern void xstats_init( portid_t port_id ) {
+	if( port_id >= MAX_PORTS ) {
+		return;
 	}
 
-	xstats = malloc(sizeof(struct rte_eth_xstat) * cnt_xstats);
-	if (xstats == NULL) {
-		bleat_printf( 0, "fail: unable to allocate memory for xstat for port: %d", port_id);
-		free(xstats_names);
-		return 0;
+	pthread_mutex_lock( &xs_lock );
+	xs_resolve( port_id );
+	pthread_mutex_unlock( &xs_lock );
+}
+
+/*
+	Copy the port's selected extended stats, names and values, into the caller's
+	arrays (the stats sweep fills the snapshot with this). At most max are copied.
+	Returns the number copied, 0 if none are selected or they can't be fetched.
+*/
+extern int xstats_collect( portid_t port_id, char (*names)[RTE_ETH_XSTATS_NAME_SIZE], uint64_t* values, int max ) {
+	int		n;
+	int		i;
+
+	pthread_mutex_lock( &xs_lock );
+	if( (n = xs_fetch( port_id )) > max ) {
+		n = max;
 	}
-	
-	if (cnt_xstats != rte_eth_xstats_get(port_id, xstats, cnt_xstats)) {
-		bleat_printf( 0, "fail: unable to get xstat for port: %d", port_id);
-		free(xstats_names);
-		free(xstats);
-		return 0;
+	for( i = 0; i < n; i++ ) {
+		memcpy( names[i], xs_sel[port_id].names[i].name, RTE_ETH_XSTATS_NAME_SIZE );
+		values[i] = xs_sel[port_id].values[i];
 	}
+	pthread_mutex_unlock( &xs_lock );
 
-  int lw = 0;
-	for (idx_xstat = 0; idx_xstat < cnt_xstats; idx_xstat++)
-		if (strncmp(xstats_names[idx_xstat].name, "rx_size_", 8) == 0 || strncmp(xstats_names[idx_xstat].name, "tx_size_", 8) == 0)
-			lw += snprintf(buff + lw, bsize - lw, "%s: %"PRIu64"\n", xstats_names[idx_xstat].name, xstats[idx_xstat].value);		
-
-	free(xstats_names);
-	free(xstats);
-	
-	return lw;
+	return n < 0 ? 0 : n;
 }
 
 
@@ -1547,26 +1795,11 @@ int
 dump_all_vlans(portid_t port_id)
 {
 	int result = 0;
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			result = vfd_ixgbe_dump_all_vlans(port_id);
-			break;
-			
-		case VFD_FVL25:		
-			result = vfd_i40e_dump_all_vlans(port_id);
-			break;
+	const struct vfd_nic_ops* ops;
 
-		case VFD_BNXT:
-			result = vfd_bnxt_dump_all_vlans(port_id);
-			break;
-			
-		case VFD_MLX5:
-			break;
-
-		default:
-			bleat_printf( 0, "set_queue_drop: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
+	ops = port_ops( port_id );
+	if( ops->dump_all_vlans != NULL ) {
+		result = ops->dump_all_vlans(port_id);
 	}
 	
 	return result;
@@ -1590,13 +1823,39 @@ int lsi_event_callback(uint16_t port_id, enum rte_eth_event_type type, void *par
 				("full-duplex") : ("half-duplex"));
 
 		if( type == RTE_ETH_EVENT_INTR_LSC ) {
-			restore_vf_setings( port_id, -1 );				// reset _all_ VFs on the port
+			struct sriov_port_s* port;
+			struct timeval	start;						// restore start; used if we didn't see the down event
+			struct timeval	done;
+			int	nvfs;
+
+			gettimeofday( &start, NULL );
+			nvfs = restore_vf_setings( port_id, -1 );				// reset _all_ VFs on the port
+			gettimeofday( &done, NULL );
+
+			if( (port = suss_port( port_id )) != NULL ) {
+				port->restore_ms = timeDelta( &done, port->link_down_ts.tv_sec ? &port->link_down_ts : &start );
+				if( port->restore_ms > port->restore_max_ms ) {
+					port->restore_max_ms = port->restore_ms;
+				}
+				port->restore_nvfs = nvfs;
+				port->nrestores++;
+				bleat_printf( 1, "port %d link restore: %d VFs restored %.3fms after link down (restore pass %.3fms)",
+					port_id, nvfs, port->restore_ms, timeDelta( &done, &start ) );
+				memset( &port->link_down_ts, 0, sizeof( port->link_down_ts ) );
+			}
 		}
-	} else
+	} else {
+		struct sriov_port_s* port;
+
 		bleat_printf( 3, "Port %d Link Down", port_id);
+		if( (port = suss_port( port_id )) != NULL && port->link_down_ts.tv_sec == 0 ) {		// keep the first down if we flap more than once
+			gettimeofday( &port->link_down_ts, NULL );
+		}
+	}
 
 	// notify every VF about link status change
 	ping_vfs(port_id, -1);
+	vfd_wake();
 
 	return 0;   // CAUTION:  as of 2017/07/05 it seems this value is ignored by dpdk, but it might not alwyas be
 }
@@ -1648,26 +1907,11 @@ port_init(uint16_t port, __attribute__((__unused__)) struct rte_mempool *mbuf_po
 				lsi_event_callback, NULL);
 	
 	
-	uint dev_type = get_nic_type(port);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			retval = rte_eth_dev_callback_register(port, RTE_ETH_EVENT_VF_MBOX, vfd_ixgbe_vf_msb_event_callback, NULL);
-			break;
-			
-		case VFD_FVL25:		
-			retval = rte_eth_dev_callback_register(port, RTE_ETH_EVENT_VF_MBOX, vfd_i40e_vf_msb_event_callback, NULL);
-			break;
-
-		case VFD_BNXT:
-			retval = rte_eth_dev_callback_register(port, RTE_ETH_EVENT_VF_MBOX, vfd_bnxt_vf_msb_event_callback, NULL);
-			break;
-			
-		case VFD_MLX5:
-			break;
-
-		default:
-			bleat_printf( 0, "port_init: unknown device type: %u, port: %u", port, dev_type);
-			break;	
+	if( pf->nic_ops == NULL ) {						// should have been set when mapped, but don't assume
+		vfd_set_nic_ops( pf );
+	}
+	if( pf->nic_ops->mbox_cb != NULL ) {
+		retval = rte_eth_dev_callback_register(port, RTE_ETH_EVENT_VF_MBOX, pf->nic_ops->mbox_cb, NULL);
 	}
 	
 	if (retval != 0) {
@@ -1702,6 +1946,7 @@ port_init(uint16_t port, __attribute__((__unused__)) struct rte_mempool *mbuf_po
 		bleat_printf( 0, "CRI: abort: cannot start port %u", port);
 		return 1;
 	}
+	reg_invalidate( port );							// start rewrites registers; don't trust anything shadowed before
 
 	
 	// Display the port MAC address.
@@ -1791,29 +2036,12 @@ void
 ping_vfs(portid_t port_id, int vf)
 {
 	int retval = 0;
+	const struct vfd_nic_ops* ops;
 	
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			retval = vfd_ixgbe_ping_vfs(port_id, vf);
-			break;
-			
-		case VFD_FVL25:		
-			retval = vfd_i40e_ping_vfs(port_id, vf);
-			break;
-
-		case VFD_BNXT:
-			retval = vfd_bnxt_ping_vfs(port_id, vf);
-			break;
-
-		case VFD_MLX5:
-			break;
-			
-		default:
-			bleat_printf( 0, "ping_vfs: unknown device type: %u, port: %u", port_id, dev_type);
-			break;		
+	ops = port_ops( port_id );
+	if( ops->ping_vfs != NULL ) {
+		retval = ops->ping_vfs(port_id, vf);
 	}
-			
 	
 	if (retval < 0) {
 		bleat_printf( 0, "ping_vfs: failed, port %u, vf %d", port_id, vf);
@@ -1945,25 +2173,24 @@ void dump_dev_info( int num_ports  ) {
 	}
 }
 
+/*
+	Drain and free anything which has been queued for the PF on NICs where nothing
+	else will read it (bnxt).
+*/
 void discard_pf_traffic (portid_t port_id)
 {
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_BNXT:
-		{
 #define MAX_PKT_BURST	32
-			struct rte_mbuf *pkts_burst[MAX_PKT_BURST];
-			uint16_t nb_pkts;
-
-			while ( (nb_pkts = rte_eth_rx_burst(port_id, 0, pkts_burst, MAX_PKT_BURST)) > 0 ) {
-				uint16_t idx;
-				for (idx = 0; idx < nb_pkts; idx++)
-					rte_pktmbuf_free(pkts_burst[idx]);
-				bleat_printf( 4, "Discarded %hu frames on PF %d", nb_pkts, port_id);
-			}
-		}
-		break;
-		default:
+	struct rte_mbuf *pkts_burst[MAX_PKT_BURST];
+	uint16_t nb_pkts;
+	uint16_t idx;
+
+	if( ! (port_ops( port_id )->flags & NOF_DISCARD_PFRX) ) {
 		return;
 	}
+
+	while ( (nb_pkts = rte_eth_rx_burst(port_id, 0, pkts_burst, MAX_PKT_BURST)) > 0 ) {
+		for (idx = 0; idx < nb_pkts; idx++)
+			rte_pktmbuf_free(pkts_burst[idx]);
+		bleat_printf( 4, "Discarded %hu frames on PF %d", nb_pkts, port_id);
+	}
 }
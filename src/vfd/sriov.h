@@ -14,6 +14,27 @@
 					Fix comment in same initialisation.
 				16 May 2017 - Add flow control flag constant.
 				10 Oct 2017 - Change set_mirror proto.
+				16 Oct 2026 - Add vfd_wake() proto.
+				16 Oct 2026 - Add per-port dirty VF list and nic call counters.
+				16 Oct 2026 - Add link flap restore timing to port.
+				16 Oct 2026 - Add per NIC driver ops table.
+				16 Oct 2026 - Register access goes through vfd_reg.c (cached bar, shadow).
+				16 Oct 2026 - Refresh queue list replaced with a table in sriov.c.
+				16 Oct 2026 - Add mailbox event queue constants and protos.
+				16 Oct 2026 - Add mailbox rate limit protos.
+				16 Oct 2026 - Add stats snapshot (vfd_stats.c).
+				16 Oct 2026 - Add rate history protos (vfd_rates.c).
+				16 Oct 2026 - MACs are held as 48 bit values; add the per-port MAC index.
+				16 Oct 2026 - Port, VF and mirror arrays are allocated to the real size; VLAN
+							and MAC lists are split off the VF into separate cold storage.
+				16 Oct 2026 - Add the per-port vfid to vfs index map.
+				16 Oct 2026 - VF masks are 64 bit words in a vf_mask_t so more than 32 VFs
+							can be addressed; the vlan filter op is given the mask's base VF.
+				16 Oct 2026 - Add the per-port vlan table (vfd_vlan.c) and the nic's vlan filter capacity.
+				16 Oct 2026 - Add the driver's VF limit (vf_limit) to the nic ops.
+				16 Oct 2026 - nic_calls is per thread.
+				16 Oct 2026 - Add the port's vlan_pending flag.
+				16 Oct 2026 - Add mbq_stop().
 */
 
 #ifndef _SRIOV_H_
@@ -160,7 +181,20 @@ typedef uint16_t streamid_t;
 
 #define MAX_QUEUE_ID ((1 << (sizeof(queueid_t) * 8)) - 1)
 
-#define VFN2MASK(N) (1U << (N))
+#define VFN2MASK(N) (1ULL << ((N) & 63))		// bit for vf N in its 64 bit word of a vf_mask_t
+
+/*
+	A set of VFs on a port which may be wider than the 64 bits that the dpdk
+	mask based calls accept; word i covers VFs i*64 through i*64+63.
+*/
+#define VF_MASK_WORDS	((MAX_VFS + 63) / 64)
+typedef struct vf_mask {
+	uint64_t	w[VF_MASK_WORDS];
+} vf_mask_t;
+
+#define VFM_SET(m, N)	((m)->w[(N) >> 6] |= VFN2MASK( N ))
+#define VFM_CLR(m, N)	((m)->w[(N) >> 6] &= ~VFN2MASK( N ))
+#define VFM_ISSET(m, N)	(((m)->w[(N) >> 6] & VFN2MASK( N )) != 0)
 
 #define BUF_SIZE 1024
 
@@ -211,12 +245,17 @@ struct itvl_stats
 } itvl[2];
 
 /*
-	Manages information for a single virtual function (VF).
+	Manages information for a single virtual function (VF). The VFs of a port are held
+	in one dense array which the update, restore and callback paths scan, so the fields
+	they test are kept at the front and the (large) vlan and mac lists are held in a
+	parallel vf_lists array; vlans and macs point at the VF's entry there.
 */
 struct vf_s
 {
 	int     num;
 	int     last_updated;        
+	int		dirty;					// set when the VF is on the port's dirty list
+	int     link;                 /* -1 = down, 0 = mirror PF, 1 = up  */
 	/**
 	 *     no app m->ol_flags | PKT_TX_VLAN_PKT   |  app does m->ol_flags | PKT_TX_VLAN_PKT
 	 *     strip_stag  = 0 Y, 1 strip, 1 Y                                             | 0 NO, 1 Y, 1 Y
@@ -235,20 +274,29 @@ struct vf_s
 	int     allow_untagged;
 	double  rate;
 	double  min_rate;
-	int     link;                 /* -1 = down, 0 = mirror PF, 1 = up  */
 	int     num_vlans;
 	int     num_macs;
 	int		first_mac;				// index of first mac in list (1 if VF has not changed their mac, 0 if they've pushed one down)
-	int     vlans[MAX_VF_VLANS];
-	char    macs[MAX_VF_MACS][18];	// human readable MAC strings
 	int     rx_q_ready;
 	int 	default_mac_set;
-
 	uid_t	owner;					// user id which 'owns' the VF (owner of the config file from stat())
+	uint8_t	qshares[MAX_TCS];		// percentage of each queue (TC) that has been set in the config for the vf
+
+	int*	vlans;					// MAX_VF_VLANS entries in the port's vf_lists
+	uint64_t* macs;					// MAX_VF_MACS entries; 48 bit values, first octet in the high byte (see mac_aton())
 	char*	start_cb;				// user commands driven just after initialisation and just before termination
 	char*	stop_cb;
 	char*	config_name;			// name given in config file for delete confirmation
-	uint8_t	qshares[MAX_TCS];		// percentage of each queue (TC) that has been set in the config for the vf
+};
+
+/*
+	Cold storage for a VF: the vlan and mac lists which are referenced only when the
+	VF is added or (re)programmed.
+*/
+struct vf_lists
+{
+	int		vlans[MAX_VF_VLANS];
+	uint64_t macs[MAX_VF_MACS];
 };
 
 
@@ -263,8 +311,80 @@ struct mirror_s
 };
 
 
+									// nic ops flags
+#define NOF_PFSPOOF_COR		0x01	// pf spoof counter is cleared on read; we must accumulate
+#define NOF_DISCARD_PFRX	0x02	// pf rx queue must be drained by us (nothing else reads it)
+#define NOF_FORCE_MACSPOOF	0x04	// mac antispoof must be on as it cannot differ from vlan antispoof
+
+									// mailbox event types (stats buckets) passed to mbq_add()
+#define MBE_NEGOTIATE		0
+#define MBE_SET_LPE			1
+#define MBE_RESET			2
+#define MBE_UNKNOWN			3
+#define MBE_OTHER			4
+#define MBE_NTYPES			5
+
+									// mailbox event work flags passed to mbq_add()
+#define MBF_RESTORE			0x01	// restore_vf_setings() for the vf
+#define MBF_FC				0x02	// set flow control on (if allowed)
+#define MBF_LOOPBACK		0x04	// set tx loopback based on config
+#define MBF_UNTAGGED_OFF	0x08	// disallow untagged
+#define MBF_REFRESH			0x10	// also queue a refresh (on the restore's rate limit token)
+
+/*
+	Driver operations for a NIC family. Each backend (vfd_ixgbe.c etc.) provides one of these
+	and it is selected by dpdk driver name when the port is mapped (vfd_set_nic_ops()); the
+	setters in sriov.c dispatch through the table rather than sussing out the device type on
+	every call.  A nil function pointer indicates that the NIC doesn't support the operation
+	and the call is silently skipped, with two exceptions noted below where a generic dpdk
+	call is made instead.
+*/
+struct vfd_nic_ops
+{
+	const char*	driver;				// dpdk driver name which selects this table
+	int			type;				// VFD_ constant (what get_nic_type() returns)
+	int			flags;				// NOF_ constants
+	int			vlan_filters;		// distinct vlan ids the nic's VF vlan filter can hold (VLVF size); 0: MAX_PF_VLANS
+	int			vf_limit;			// VFs the nic can isolate (vlan filter mask reach); VFs at or above are refused; 0: no limit
+
+	int (*set_vf_link_status)( uint16_t port, uint16_t vf, int status );
+	int (*set_vf_min_rate)( uint16_t port, uint16_t vf, uint16_t rate, uint64_t q_msk );
+	int (*set_vf_rate_limit)( uint16_t port, uint16_t vf, uint16_t rate, uint64_t q_msk );
+	int (*set_vf_vlan_insert)( uint16_t port, uint16_t vf, uint16_t vlan );
+	int (*set_vf_cvlan_insert)( uint16_t port, uint16_t vf, uint16_t vlan );
+	int (*set_vf_vlan_stripq)( uint16_t port, uint16_t vf, uint8_t on );
+	int (*set_vf_cvlan_stripq)( uint16_t port, uint16_t vf, uint8_t on );
+	int (*set_vf_broadcast)( uint16_t port, uint16_t vf, uint8_t on );
+	int (*set_vf_multicast_promisc)( uint16_t port, uint16_t vf, uint8_t on );
+	int (*set_vf_unicast_promisc)( uint16_t port, uint16_t vf, uint8_t on );
+	int (*allow_untagged)( uint16_t port, uint16_t vf, uint8_t on );
+	int (*set_vf_mac_addr)( uint16_t port, uint16_t vf, struct ether_addr* mac );
+	int (*del_vf_mac_addr)( uint16_t port, uint16_t vf, struct ether_addr* mac );		// nil: rte_eth_dev_mac_addr_remove()
+	int (*set_vf_default_mac_addr)( uint16_t port, uint16_t vf, struct ether_addr* mac );
+	int (*set_vf_vlan_filter)( uint16_t port, uint16_t vlan, uint64_t vf_mask, uint16_t vf_base, uint8_t on );	// mask bit n is vf vf_base+n
+	int (*set_vf_vlan_anti_spoof)( uint16_t port, uint16_t vf, uint8_t on );
+	int (*set_vf_mac_anti_spoof)( uint16_t port, uint16_t vf, uint8_t on );
+	int (*set_tx_loopback)( uint16_t port, uint8_t on );
+	int (*set_mirror)( uint16_t port, uint32_t vf, uint8_t id, uint8_t target, uint8_t direction );	// nil: rte mirror rule
+	int (*get_split_ctlreg)( uint16_t port, uint16_t vf );
+	void (*set_split_erop)( uint16_t port, uint16_t vf, int state );
+	void (*set_rx_drop)( uint16_t port, uint16_t vf, int state );
+	void (*set_pfrx_drop)( uint16_t port, int state );
+	int (*set_all_queues_drop_en)( uint16_t port, uint8_t on );
+	void (*disable_default_pool)( uint16_t port );
+	int (*is_rx_queue_on)( uint16_t port, uint16_t vf, int* mcounter );
+	int (*ping_vfs)( uint16_t port, int16_t vf );
+	int (*dump_all_vlans)( uint16_t port );
+	uint32_t (*get_pf_spoof_stats)( uint16_t port );
+	int (*get_vf_stats)( uint16_t port, uint16_t vf, struct rte_eth_stats* stats );
+	uint64_t (*get_vf_spoof_stats)( uint16_t port, uint16_t vf );
+	rte_eth_dev_cb_fn mbox_cb;		// mailbox (VF_MBOX event) callback
+};
+
 /*
-	Manages information for a single NIC port. Each port may have up to MAX_VFS configured.
+	Manages information for a single NIC port. Each port may have up to MAX_VFS configured,
+	but the vfs, mirrors, vf_lists and dirty arrays are allocated (vfd_size_port()) only
+	for the number the NIC reports when the port is mapped; vfs_alloc is that size.
 */
 typedef struct sriov_port_s
 {
@@ -278,11 +398,25 @@ typedef struct sriov_port_s
 	int			nvfs_config;			// actual number of configured vfs; could be less than max
 	int			ntcs;					// number traffic clases (must be 4 or 8)
 	int     	num_vfs;					// number of VF spaces in the list used, NOT the total allocated on the port
-	struct  	mirror_s mirrors[MAX_VFS];	// mirror info for each VF
-	struct  	vf_s vfs[MAX_VFS];
+	int			vfs_alloc;				// number of entries allocated in vfs, mirrors, vf_lists and dirty
+	struct  	vf_s* vfs;
+	struct  	mirror_s* mirrors;		// mirror info for each VF (parallel to vfs)
+	struct		vf_lists* vf_lists;		// vlan/mac lists for each VF (parallel to vfs)
+	int16_t*	vf_slot;				// vfid -> index in vfs; -1 if the vf isn't configured (vfs_alloc entries)
 	tc_class_t*	tc_config[MAX_TCS];		// configuration information (max/min lsp/gsp) for the TC	(set from config)
 	int*		vftc_qshares;			// queue percentages arranged by vf/tc (computed with each add/del of a vf)
 	uint8_t		tc2bwg[MAX_TCS];		// maps each TC to a bandwidth group (set from config info)
+	int			ndirty;					// number of VFs on the dirty list
+	int*		dirty;					// indexes (into vfs) of VFs changed since the last update_nic() pass
+	int			vlan_pending;			// vlan filter writes failed; update_nic() retries them even when no VF is dirty
+	struct timeval link_down_ts;		// time the link was reported down (zero if up)
+	int			nrestores;				// number of link up restores (flaps) seen
+	int			restore_nvfs;			// VFs restored on the last one
+	double		restore_ms;				// last link down to all VFs restored time (ms)
+	double		restore_max_ms;			// worst seen
+	const struct vfd_nic_ops* nic_ops;	// driver functions for the NIC (set when the port is mapped)
+	struct mac_ix* mac_ix;				// MAC -> vf/slot index for duplicate checks (vfd_mac.c)
+	struct vlan_tab* vlan_tab;			// vlan -> VF membership and programmed filter state (vfd_vlan.c)
 	
 	// will keep PCI First VF offset and Stride here
 	uint16_t vf_offset;
@@ -295,11 +429,67 @@ typedef struct sriov_port_s
 typedef struct sriov_conf_c
 {
 	int     num_ports;						// number of ports actually used in ports array
-	struct sriov_port_s ports[MAX_PORTS];	// ports; CAUTION: order may not be device id order
+	struct sriov_port_s* ports;				// ports (num_ports allocated); CAUTION: order may not be device id order
 	rte_spinlock_t update_lock;				// we lock the config during update and deployment
 	void*	mir_id_mgr;						// reference point for the id manager to allocate mirror ids
+	uint64_t nupdates;						// number of update_nic() passes which programmed at least one VF
+	uint64_t tot_nic_calls;					// total nic calls made by those passes
+	int		last_nic_calls;					// nic calls made by the most recent pass
+	int		last_nvfs;						// VFs programmed by the most recent pass
 } sriov_conf_t;
 
+/*
+	Counter snapshot for all PFs and VFs taken in a single sweep (vfd_stats.c).
+	Struct of arrays: PF values are indexed by config port index; the VFs of
+	a port are contiguous (vf_first/vf_count) and in VF number order. Consumers
+	format from this rather than going to the NIC themselves.
+*/
+#define SNAP_MAX_VFS	(MAX_PORTS * MAX_VFS)
+#define STATS_MAX_AGE	1000				// ms an on demand consumer will accept before a new sweep is made
+#define SNAP_MAX_XS		64					// selected extended stats kept per PF
+
+typedef struct stats_snap {
+	uint64_t	gen;						// sweep number; 0 if never collected
+	long long	ms;							// monotonic ms the sweep was made
+	int			nports;
+	int			nvfs;
+
+	int			pf_port[MAX_PORTS];			// rte port number
+	int			pf_valid[MAX_PORTS];		// pci address was available; pf is skipped if not
+	uint16_t	pf_domain[MAX_PORTS];
+	uint32_t	pf_ari[MAX_PORTS];			// bus/dev/function packed
+	uint8_t		pf_link[MAX_PORTS];
+	uint32_t	pf_speed[MAX_PORTS];
+	uint16_t	pf_duplex[MAX_PORTS];
+	uint64_t	pf_ipackets[MAX_PORTS];
+	uint64_t	pf_ibytes[MAX_PORTS];
+	uint64_t	pf_ierrors[MAX_PORTS];
+	uint64_t	pf_imissed[MAX_PORTS];
+	uint64_t	pf_nombuf[MAX_PORTS];
+	uint64_t	pf_opackets[MAX_PORTS];
+	uint64_t	pf_obytes[MAX_PORTS];
+	uint64_t	pf_oerrors[MAX_PORTS];
+	uint64_t	pf_spoofed[MAX_PORTS];
+	int16_t		pf_six[MAX_PORTS];			// pf index for each rte port number; -1 if not in the snapshot
+	int			pf_nxs[MAX_PORTS];			// selected extended stats (xstats parm) collected for the pf
+	char		pf_xs_name[MAX_PORTS][SNAP_MAX_XS][RTE_ETH_XSTATS_NAME_SIZE];
+	uint64_t	pf_xs_val[MAX_PORTS][SNAP_MAX_XS];
+	int			vf_first[MAX_PORTS];		// index of the port's first VF in the vf_ arrays
+	int			vf_count[MAX_PORTS];
+
+	int16_t		vf_num[SNAP_MAX_VFS];
+	uint32_t	vf_ari[SNAP_MAX_VFS];		// bus/dev/function of the VF
+	uint8_t		vf_up[SNAP_MAX_VFS];		// rx queue is enabled
+	uint64_t	vf_ipackets[SNAP_MAX_VFS];
+	uint64_t	vf_ibytes[SNAP_MAX_VFS];
+	uint64_t	vf_ierrors[SNAP_MAX_VFS];
+	uint64_t	vf_nombuf[SNAP_MAX_VFS];
+	uint64_t	vf_opackets[SNAP_MAX_VFS];
+	uint64_t	vf_obytes[SNAP_MAX_VFS];
+	uint64_t	vf_oerrors[SNAP_MAX_VFS];
+	uint64_t	vf_spoofed[SNAP_MAX_VFS];
+} stats_snap_t;
+
 
 enum print_warning {
 	ENABLED_WARN = 0,
@@ -316,41 +506,35 @@ struct pstat
   struct timeval endTime;
 };
 
-/*
-	Manages a reset for a port/vf pair. These are queued when a reset is received
-	by callback/mbox message until the VF's queues are ready.
-*/
-struct rq_entry 
-{
-	struct rq_entry* next;		// link references
-	struct rq_entry* prev;
-
-	uint8_t	port_id;
-	uint16_t vf_id;
-	uint8_t enabled;
-	int		mcounter;			// message counter so as not to flood the log
-};
-
+// ----------- register i/o (vfd_reg.c) ------------------------------------------------------------
+extern uint32_t reg_read( portid_t port, uint32_t off );
+extern void reg_write( portid_t port, uint32_t off, uint32_t val );
+extern uint32_t reg_sread( portid_t port, uint32_t off );
+extern void reg_swrite( portid_t port, uint32_t off, uint32_t val );
+extern uint32_t reg_rmw( portid_t port, uint32_t off, uint32_t mask, uint32_t val );
+extern uint32_t reg_rmw_sel( portid_t port, uint32_t sel_off, uint32_t sel, uint32_t off, uint32_t mask, uint32_t val );
+extern void reg_batch( portid_t port );
+extern int reg_flush( portid_t port );
+extern void reg_invalidate( portid_t port );
+extern int reg_stats( portid_t port, char* buf, int blen );
+
+// ---- mailbox event queue (vfd_mbq.c) ----
+extern int mbq_init( void );
+extern void mbq_stop( void );
+extern void mbq_add( int type, uint16_t port, uint16_t vf, int flags );
+extern int mbq_stats_str( char* buf, int blen );
+extern int mbq_metrics( char* buf, int blen );
 
 // ----------- inline expansions ---------------------------------------------------------------------
 
 /**
- * Read/Write operations on a PCI register of a port.
+ * Read/Write operations on a PCI register of a port. These go directly to the
+ * NIC (no shadow), but use the BAR address cached by vfd_reg.c.
  */
 static inline uint32_t
 port_pci_reg_read(portid_t port, uint32_t reg_off)
 {
- 
-  struct rte_eth_dev_info dev_info;
-  rte_eth_dev_info_get(port, &dev_info);
-
-	void *reg_addr;
-	uint32_t reg_v;
-
-	reg_addr = (void *)
-		((char *)dev_info.pci_dev->mem_resource[0].addr + reg_off);
-	reg_v = *((volatile uint32_t *)reg_addr);
-	return rte_le_to_cpu_32(reg_v);
+	return reg_read( port, reg_off );
 }
 
 #define port_id_pci_reg_read(pt_id, reg_off) \
@@ -359,19 +543,26 @@ port_pci_reg_read(portid_t port, uint32_t reg_off)
 static inline void
 port_pci_reg_write(portid_t port, uint32_t reg_off, uint32_t reg_v)
 {
-  struct rte_eth_dev_info dev_info;
-  rte_eth_dev_info_get(port, &dev_info);
- 
-	void *reg_addr;
-
-	reg_addr = (void *)
-		((char *)dev_info.pci_dev->mem_resource[0].addr + reg_off);
-	*((volatile uint32_t *)reg_addr) = rte_cpu_to_le_32(reg_v);
+	reg_write( port, reg_off, reg_v );
 }
 
 #define port_id_pci_reg_write(pt_id, reg_off, reg_value) \
 	port_pci_reg_write(&ports[(pt_id)], (reg_off), (reg_value))
 
+/*
+	Return the index in port->vfs of the VF with the given id, or -1 if the
+	VF isn't configured on the port.
+*/
+static inline int
+vf_slot( struct sriov_port_s* port, int vfid )
+{
+	if( vfid < 0 || vfid >= port->vfs_alloc ) {
+		return -1;
+	}
+
+	return port->vf_slot[vfid];
+}
+
 
 // ---------------------- globals ------------------------------------------------------------------
 const char* version;
@@ -399,7 +590,7 @@ struct timeval endTime;
 
 uint32_t spoffed[MAX_PORTS]; 		// # of spoffed packets per PF
 
-struct rq_entry *rq_list;			// reset queue list of VMs we are waiting on queue ready bits for
+extern __thread uint64_t nic_calls;	// calls this thread made to the nic through the sriov.c wrappers (update_nic's count is a delta of it)
 
 // ---------------------- prototypes ------------------------------------------------------------------
 void port_mtu_set(portid_t port_id, uint16_t mtu);
@@ -422,9 +613,9 @@ void set_vf_allow_mcast(portid_t port_id, uint16_t vf_id, int on);
 void set_vf_allow_un_ucast(portid_t port_id, uint16_t vf_id, int on);
 void set_vf_allow_untagged(portid_t port_id, uint16_t vf_id, int on);
 
-void set_vf_rx_vlan(portid_t port_id, uint16_t vlan_id, uint64_t vf_mask, uint8_t on);
-void set_vf_rx_mac(portid_t port_id, const char* mac, uint32_t vf, uint8_t on);
-void set_vf_default_mac( portid_t port_id, const char* mac, uint32_t vf );
+int set_vf_rx_vlan(portid_t port_id, uint16_t vlan_id, const vf_mask_t* vf_mask, uint8_t on);
+void set_vf_rx_mac(portid_t port_id, uint64_t mac, uint32_t vf, uint8_t on);
+void set_vf_default_mac( portid_t port_id, uint64_t mac, uint32_t vf );
 
 void set_vf_vlan_anti_spoofing(portid_t port_id, uint32_t vf, uint8_t on);
 void set_vf_mac_anti_spoofing(portid_t port_id, uint32_t vf, uint8_t on);
@@ -434,9 +625,6 @@ int set_vf_min_rate(portid_t port_id, uint16_t vf, uint16_t rate, uint64_t q_msk
 int set_vf_link_status(portid_t port_id, uint16_t vf, int status);
 
 void nic_stats_clear(portid_t port_id);
-int nic_stats_display(uint16_t port_id, char * buff, int blen);
-int vf_stats_display(uint16_t port_id, uint32_t pf_ari, int vf, char * buff, int bsize);
-int port_xstats_display(uint16_t port_id, char * buff, int bsize);
 int dump_all_vlans(portid_t port_id);
 void ping_vfs(portid_t port_id, int vf);
 
@@ -457,12 +645,11 @@ int readConfigFile(char *fname);
 void dump_sriov_config( sriov_conf_t* config);
 void dump_dev_info( int num_ports );
 int update_ports_config(void);
-int cmp_vfs (const void * a, const void * b);
 void disable_default_pool(portid_t port_id);
 
 int lsi_event_callback(uint16_t port_id, enum rte_eth_event_type type, void *param, void* data );
 //int lsi_event_callback(uint16_t port_id, enum rte_eth_event_type type, void *param, void *ret_param);
-void restore_vf_setings(uint16_t port_id, int vf);
+int restore_vf_setings(uint16_t port_id, int vf);
 
 // callback validation support
 int valid_mtu( int port, int mtu );
@@ -477,13 +664,48 @@ struct mirror_s*  suss_mirror( int port, int vfid );
 
 void add_refresh_queue(u_int8_t port_id, uint16_t vf_id);
 void process_refresh_queue(void);
+extern int refresh_stats( char* buf, int blen );
+extern int refresh_metrics( char* buf, int blen );
+extern int nic_err_metrics( char* buf, int blen );
+extern void xstats_select( char** pats, int npats );
+extern void xstats_init( portid_t port_id );
+extern int xstats_collect( portid_t port_id, char (*names)[RTE_ETH_XSTATS_NAME_SIZE], uint64_t* values, int max );
+extern int mb_rate_check( portid_t port_id, uint16_t vf_id, int refresh );
+extern int mb_vf_stats( portid_t port_id, int vf_id, char* buf, int blen );
+extern void vfd_wake( void );
 int is_rx_queue_on(portid_t port_id, uint16_t vf_id, int* mcounter );
 
 int vfd_update_nic( parms_t* parms, sriov_conf_t* conf );
+extern void mark_vf_dirty( struct sriov_port_s* port, int vidx, int state );
 int vfd_init_fifo( parms_t* parms );
 //int is_valid_mac_str( char* mac );
 char*  gen_stats( sriov_conf_t* conf, int pf_only, int pf );
+
+// ---- stats snapshot (vfd_stats.c) ---------------------
+extern int stats_collect( sriov_conf_t* conf, int max_age );
+extern void stats_hk( sriov_conf_t* conf, int ivl );
+extern const stats_snap_t* stats_snap_get( sriov_conf_t* conf, int max_age );
+extern void stats_snap_put( void );
+extern int stats_snap_pf( const stats_snap_t* snap, int port );
+extern int stats_snap_vf( const stats_snap_t* snap, int port, int vf );
+extern int stats_pf_line( const stats_snap_t* snap, int pidx, char* buf, int blen );
+extern int stats_vf_line( const stats_snap_t* snap, int vidx, char* buf, int blen );
+extern int stats_xs_str( const stats_snap_t* snap, int pidx, char* buf, int blen );
+extern int stats_engine_str( char* buf, int blen );
+extern int stats_shm_start( const char* path );
+extern void stats_shm_stop( void );
+
+// ---- metrics exporter (vfd_metrics.c) ----------------
+extern int metrics_start( const char* addr, sriov_conf_t* conf, int sweeping );
+extern void metrics_stop( void );
+
+// ---- rate history (vfd_rates.c) -----------------------
+extern int rates_start( sriov_conf_t* conf );
+extern void rates_stop( void );
+extern char* gen_rates( const char* target, int json, const char** err );
 int get_nic_type(portid_t port_id);
+extern const struct vfd_nic_ops* vfd_set_nic_ops( sriov_port_t* pf );
+extern const struct vfd_nic_ops* get_nic_ops( portid_t port_id );
 int get_mac_antispoof( portid_t port_id );
 int get_max_qpp( uint32_t port_id );
 int get_num_vfs( uint32_t port_id );
@@ -491,14 +713,36 @@ void discard_pf_traffic( portid_t portid );
 
 void log_port_state( struct sriov_port_s* port, const_str msg );
 
+// ---- nic backend ops tables (vfd_<family>.c) --------------
+extern const struct vfd_nic_ops vfd_ixgbe_ops;
+extern const struct vfd_nic_ops vfd_i40e_ops;
+extern const struct vfd_nic_ops vfd_bnxt_ops;
+extern const struct vfd_nic_ops vfd_mlx5_ops;
+
 // ---- mac support ---------------------------------------
+#define MAC_STR_LEN	18					// buffer needed for mac_ntoa()
+
 extern int mac_init( void );
-extern int add_mac( int port, int vfid, char* mac );
-extern int can_add_mac( int port, int vfid, char* mac );
+extern int mac_aton( const char* str, uint64_t* mac );
+extern char* mac_ntoa( uint64_t mac, char* buf );
+extern uint64_t mac_from_ea( const struct ether_addr* ea );
+extern void mac_to_ea( uint64_t mac, struct ether_addr* ea );
+extern int find_mac( int port, uint64_t mac, int* vfid, int* slot );
+extern int add_mac( int port, int vfid, uint64_t mac );
+extern int can_add_mac( int port, int vfid, uint64_t mac );
 extern int clear_macs( int port, int vfid, int assign_random );
-extern int push_mac( int port, int vfid, char* mac );
+extern int push_mac( int port, int vfid, uint64_t mac );
 extern int set_macs( int port, int vfid );
 
+// ---- vlan table (vfd_vlan.c) ---------------------------
+extern int vlan_capacity( struct sriov_port_s* p );
+extern int vlan_count( struct sriov_port_s* p );
+extern int vlan_new_count( struct sriov_port_s* p, const int* vlans, int nvlans );
+extern void vlan_join( struct sriov_port_s* p, struct vf_s* vf );
+extern void vlan_leave( struct sriov_port_s* p, struct vf_s* vf );
+extern void vlan_forget( struct sriov_port_s* p, struct vf_s* vf );
+extern int vlan_push( struct sriov_port_s* p );
+
 //-- testing --
 extern void set_fc_on( portid_t pf, int force );
 extern void set_fd_off( portid_t port_id );
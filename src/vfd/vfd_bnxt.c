@@ -184,10 +184,16 @@ vfd_bnxt_set_vf_vlan_tag(uint16_t port_id, uint16_t vf_id, uint8_t on)
 
 
 int 
-vfd_bnxt_set_vf_vlan_filter(uint16_t port_id, uint16_t vlan_id, __attribute__((__unused__)) uint64_t vf_mask,  __attribute__((__unused__)) uint8_t on)
+vfd_bnxt_set_vf_vlan_filter(uint16_t port_id, uint16_t vlan_id, __attribute__((__unused__)) uint64_t vf_mask, uint16_t vf_base, __attribute__((__unused__)) uint8_t on)
 {
+	int diag;
+
+	if( vf_base != 0 ) {					// dpdk's mask reaches only the first 64 VFs
+		bleat_printf( 0, "rte_pmd_bnxt_set_vf_vlan_filter: cannot filter vlan %d for VFs %d and above on port %d", vlan_id, vf_base, port_id );
+		return -ENOTSUP;
+	}
 
-	int diag = rte_pmd_bnxt_set_vf_vlan_filter(port_id, vlan_id, vf_mask, on);
+	diag = rte_pmd_bnxt_set_vf_vlan_filter(port_id, vlan_id, vf_mask, on);
 	
 	if (diag < 0) {
 		bleat_printf( 0, "rte_pmd_bnxt_set_vf_vlan_filter failed: port_pi=%d, vlan_id=%d) failed rc=%d", port_id, vlan_id, diag );
@@ -237,8 +243,7 @@ vfd_bnxt_reset_vf_stats(uint16_t port_id, uint16_t vf_id)
 static bool verify_mac_address(uint16_t port_id, uint16_t vf, void *mac, void *mask)
 {
 	struct vf_s *vf_cfg = suss_vf(port_id, vf);
-	struct ether_addr mac_addr;
-	int i;
+	int owner;
 
 	if (vf_cfg == NULL)
 		return false;
@@ -251,20 +256,8 @@ static bool verify_mac_address(uint16_t port_id, uint16_t vf, void *mac, void *m
 	if (vf_cfg->num_macs == 0)
 		return true;
 
-	for (i=0; i<vf_cfg->num_macs; i++) {
-		ether_aton_r(vf_cfg->macs[i], &mac_addr);
-		if (memcmp(&mac_addr, mac, sizeof(mac_addr)) == 0)
-			return true;
-	}
-
-	// must run in reverse order because of FV oddness
-	for( i = vf_cfg->num_macs; i >= vf_cfg->first_mac; i-- ) {
-		ether_aton_r(vf_cfg->macs[i], &mac_addr);
-		if (memcmp(&mac_addr, mac, sizeof(mac_addr)) == 0)
-			return true;
-	}
-
-	return false;
+	/* the port's mac index knows which VF, if any, the address belongs to */
+	return find_mac(port_id, mac_from_ea((struct ether_addr *) mac), &owner, NULL) && owner == vf;
 }
 
 static void apply_rx_restrictions(uint16_t port_id, uint16_t vf, struct hwrm_cfa_l2_set_rx_mask_input *mi)
@@ -472,10 +465,10 @@ vfd_bnxt_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type, v
 		/* Verify */
 	}
 
-	if (add_refresh)
-		add_refresh_queue(port_id, vf);		// schedule a complete refresh when the queue goes hot
 	if (restore)
-		restore_vf_setings(port_id, vf);	// refresh all of our configuration back onto the NIC
+		mbq_add( MBE_OTHER, port_id, vf, MBF_RESTORE | (add_refresh ? MBF_REFRESH : 0) );	// restore on the mailbox worker; refresh (same token) when the queue goes hot
+	else if (add_refresh)
+		add_refresh_queue(port_id, vf);		// schedule a complete refresh when the queue goes hot
 
 	bleat_printf( 3, "Type: %d, Port: %d, VF: %d, OUT: %d, _T: %d",
 	             type, port_id, vf, p->retval, mbox_type);
@@ -609,3 +602,49 @@ vfd_bnxt_dump_all_vlans(uint16_t port_id)
 	bleat_printf( 0, "vfd_bnxt_dump_all_vlans(): not implemented for port=%d", port_id );	
 	return 0;
 }
+
+/*
+	Return the tx drop (spoof) count for the VF, or UINT64_MAX if it cannot be fetched.
+*/
+static uint64_t vfd_bnxt_get_vf_tx_drops( uint16_t port_id, uint16_t vf_id ) {
+	uint64_t count = 0;
+
+	if( rte_pmd_bnxt_get_vf_tx_drop_count( port_id, vf_id, &count ) ) {
+		return UINT64_MAX;
+	}
+
+	return count;
+}
+
+/*
+	Driver ops for the broadcom (bnxt) family.
+*/
+const struct vfd_nic_ops vfd_bnxt_ops = {
+	.driver = "net_bnxt",
+	.type = VFD_BNXT,
+	.flags = NOF_DISCARD_PFRX,
+	.vf_limit = 64,								// dpdk's vlan filter mask reaches only the first 64 VFs
+
+	.set_vf_vlan_insert = vfd_bnxt_set_vf_vlan_insert,
+	.set_vf_vlan_stripq = vfd_bnxt_set_vf_vlan_stripq,
+	.set_vf_broadcast = vfd_bnxt_set_vf_broadcast,
+	.set_vf_multicast_promisc = vfd_bnxt_set_vf_multicast_promisc,
+	.set_vf_unicast_promisc = vfd_bnxt_set_vf_unicast_promisc,
+	.allow_untagged = vfd_bnxt_allow_untagged,
+	.set_vf_mac_addr = vfd_bnxt_set_vf_mac_addr,
+	.set_vf_default_mac_addr = vfd_bnxt_set_vf_default_mac_addr,
+	.set_vf_vlan_filter = vfd_bnxt_set_vf_vlan_filter,
+	.set_vf_vlan_anti_spoof = vfd_bnxt_set_vf_vlan_anti_spoof,
+	.set_vf_mac_anti_spoof = vfd_bnxt_set_vf_mac_anti_spoof,
+	.set_tx_loopback = vfd_bnxt_set_tx_loopback,
+	.set_split_erop = vfd_bnxt_set_split_erop,
+	.set_rx_drop = vfd_bnxt_set_rx_drop,
+	.set_all_queues_drop_en = vfd_bnxt_set_all_queues_drop_en,
+	.is_rx_queue_on = vfd_bnxt_is_rx_queue_on,
+	.ping_vfs = vfd_bnxt_ping_vfs,
+	.dump_all_vlans = vfd_bnxt_dump_all_vlans,
+	.get_pf_spoof_stats = vfd_bnxt_get_pf_spoof_stats,
+	.get_vf_stats = vfd_bnxt_get_vf_stats,
+	.get_vf_spoof_stats = vfd_bnxt_get_vf_tx_drops,
+	.mbox_cb = vfd_bnxt_vf_msb_event_callback,
+};
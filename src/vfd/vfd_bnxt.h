@@ -23,7 +23,7 @@ int vfd_bnxt_set_vf_vlan_stripq(uint16_t port, uint16_t vf, uint8_t on);
 int vfd_bnxt_set_vf_vlan_insert(uint16_t port, uint16_t vf_id, uint16_t vlan_id);
 int vfd_bnxt_set_vf_broadcast(uint16_t port, uint16_t vf_id, uint8_t on);
 int vfd_bnxt_set_vf_vlan_tag(uint16_t port, uint16_t vf_id, uint8_t on);
-int vfd_bnxt_set_vf_vlan_filter(uint16_t port, uint16_t vlan_id, uint64_t vf_mask, uint8_t on);
+int vfd_bnxt_set_vf_vlan_filter(uint16_t port, uint16_t vlan_id, uint64_t vf_mask, uint16_t vf_base, uint8_t on);
 int vfd_bnxt_get_vf_stats(uint16_t port, uint16_t vf_id, struct rte_eth_stats *stats);
 int vfd_bnxt_reset_vf_stats(uint16_t port, uint16_t vf_id);
 
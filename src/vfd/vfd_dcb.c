@@ -5,7 +5,8 @@
 	Date:		28 October 2016
 	Author:		E. Scott Daniels
 
-	Mods:
+	Mods:		16 Oct 2026 - Register the mailbox callback from the port's driver ops.
+				16 Oct 2026 - Invalidate register shadow after dcb configure; batch plane writes.
 
 	useful doc:
 		http://dpdk.org/doc/api/vmdq_dcb_2main_8c-example.html
@@ -91,10 +92,13 @@ extern int vfd_dcb_config( sriov_port_t *pf ) {
 		tc_pctgs[i] = pf->tc_config[i]->min_bw;		// snag min bandwidth percentage for the tc
 	}
 
-	if (get_nic_type(port) != VFD_MLX5) { // No support in mlx5 yet
+	if( pf->nic_ops == NULL || pf->nic_ops->type != VFD_MLX5 ) { // No support in mlx5 yet
 		ixgbe_configure_dcb( pf_dev );											// set up dcb
+		reg_invalidate( port );													// dpdk just rewrote the registers; drop anything shadowed
+		reg_batch( port );
 		qos_set_tdplane( port, tc_pctgs, pf->tc2bwg, pf->ntcs, pf->mtu );		// configure tc plane with our percentages
 		qos_set_txpplane( port, tc_pctgs, pf->tc2bwg, pf->ntcs, pf->mtu );		// configure packet plane with our percentages
+		reg_flush( port );														// planes must be set before arbitors are enabled
 		qos_enable_arb( port );													// finally turn arbitors on
 	} else {
 		vfd_mlx5_set_prio_trust(port);
@@ -145,23 +149,11 @@ extern int dcb_port_init( sriov_port_t *pf, __attribute__((__unused__)) struct r
 	}
 
 
-	uint dev_type = get_nic_type(port);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			retval = rte_eth_dev_callback_register(port, RTE_ETH_EVENT_VF_MBOX, vfd_ixgbe_vf_msb_event_callback, NULL);
-			break;
-			
-		case VFD_FVL25:		
-			retval = rte_eth_dev_callback_register(port, RTE_ETH_EVENT_VF_MBOX, vfd_i40e_vf_msb_event_callback, NULL);
-			break;
-
-		case VFD_BNXT:
-			retval = rte_eth_dev_callback_register(port, RTE_ETH_EVENT_VF_MBOX, vfd_bnxt_vf_msb_event_callback, NULL);
-			break;
-			
-		default:
-			bleat_printf( 0, "port_init: unknown device type: %u, port: %u", port, dev_type);
-			break;	
+	if( pf->nic_ops == NULL ) {						// should have been set when mapped, but don't assume
+		vfd_set_nic_ops( pf );
+	}
+	if( pf->nic_ops->mbox_cb != NULL ) {
+		retval = rte_eth_dev_callback_register(port, RTE_ETH_EVENT_VF_MBOX, pf->nic_ops->mbox_cb, NULL);
 	}
 
 
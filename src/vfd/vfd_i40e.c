@@ -204,9 +204,16 @@ vfd_i40e_allow_untagged(uint16_t port_id, uint16_t vf_id, uint8_t on)
 
 
 int 
-vfd_i40e_set_vf_vlan_filter(uint16_t port_id, uint16_t vlan_id, uint64_t vf_mask, uint8_t on)
+vfd_i40e_set_vf_vlan_filter(uint16_t port_id, uint16_t vlan_id, uint64_t vf_mask, uint16_t vf_base, uint8_t on)
 {
-	int diag = rte_pmd_i40e_set_vf_vlan_filter(port_id, vlan_id, vf_mask, on);
+	int diag;
+
+	if( vf_base != 0 ) {					// dpdk's mask reaches only the first 64 VFs
+		bleat_printf( 0, "rte_pmd_i40e_set_vf_vlan_filter: cannot filter vlan %d for VFs %d and above on port %d", vlan_id, vf_base, port_id );
+		return -ENOTSUP;
+	}
+
+	diag = rte_pmd_i40e_set_vf_vlan_filter(port_id, vlan_id, vf_mask, on);
 	if (diag < 0) {
 		bleat_printf( 0, "rte_pmd_i40e_set_vf_vlan_filter failed: (port_pi=%d, vlan_id=%d, vf_mask=%d) failed rc=%d", port_id, vlan_id, vf_mask, diag );
 	} else {
@@ -375,7 +382,7 @@ vfd_i40e_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type, v
 			vfp->rx_q_ready = 0;		// set queue ready flag off
 			rte_spinlock_unlock( &running_config->update_lock );
 			
-			set_vf_allow_untagged(port_id, vf, 0);
+			mbq_add( MBE_RESET, port_id, vf, MBF_UNTAGGED_OFF );		// nic work is done on the mailbox worker
 			
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			
@@ -711,3 +718,45 @@ vfd_i40e_dump_all_vlans(uint16_t port_id)
 }
 
 
+
+/*
+	We force vlan antispoofing on, so mac antispoofing is always left off on the
+	fortville (allowing guests to use any mac) regardless of what the caller asks.
+*/
+static int vfd_i40e_force_mac_anti_spoof( uint16_t port_id, uint16_t vf_id, __attribute__((__unused__)) uint8_t on ) {
+	return vfd_i40e_set_vf_mac_anti_spoof( port_id, vf_id, 0 );
+}
+
+/*
+	Driver ops for the fortville (i40e) family.
+*/
+const struct vfd_nic_ops vfd_i40e_ops = {
+	.driver = "net_i40e",
+	.type = VFD_FVL25,
+	.flags = 0,
+	.vf_limit = 64,								// dpdk's vlan filter mask reaches only the first 64 VFs
+
+	.set_vf_vlan_insert = vfd_i40e_set_vf_vlan_insert,
+	.set_vf_vlan_stripq = vfd_i40e_set_vf_vlan_stripq,
+	.set_vf_broadcast = vfd_i40e_set_vf_broadcast,
+	.set_vf_multicast_promisc = vfd_i40e_set_vf_multicast_promisc,
+	.set_vf_unicast_promisc = vfd_i40e_set_vf_unicast_promisc,
+	.allow_untagged = vfd_i40e_allow_untagged,
+	.set_vf_mac_addr = vfd_i40e_set_vf_mac_addr,
+	.set_vf_default_mac_addr = vfd_i40e_set_vf_default_mac_addr,
+	.set_vf_vlan_filter = vfd_i40e_set_vf_vlan_filter,
+	.set_vf_vlan_anti_spoof = vfd_i40e_set_vf_vlan_anti_spoof,
+	.set_vf_mac_anti_spoof = vfd_i40e_force_mac_anti_spoof,
+	.set_tx_loopback = vfd_i40e_set_tx_loopback,
+	.get_split_ctlreg = vfd_i40e_get_split_ctlreg,
+	.set_split_erop = vfd_i40e_set_split_erop,
+	.set_rx_drop = vfd_i40e_set_rx_drop,
+	.set_pfrx_drop = vfd_i40e_set_pfrx_drop,
+	.set_all_queues_drop_en = vfd_i40e_set_all_queues_drop_en,
+	.is_rx_queue_on = vfd_i40e_is_rx_queue_on,
+	.ping_vfs = vfd_i40e_ping_vfs,
+	.dump_all_vlans = vfd_i40e_dump_all_vlans,
+	.get_pf_spoof_stats = vfd_i40e_get_pf_spoof_stats,
+	.get_vf_stats = vfd_i40e_get_vf_stats,
+	.mbox_cb = vfd_i40e_vf_msb_event_callback,
+};
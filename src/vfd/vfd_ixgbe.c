@@ -202,9 +202,16 @@ vfd_ixgbe_allow_untagged(uint16_t port_id, uint16_t vf_id, uint8_t on)
 
 
 int 
-vfd_ixgbe_set_vf_vlan_filter(uint16_t port_id, uint16_t vlan_id, uint64_t vf_mask, uint8_t on)
+vfd_ixgbe_set_vf_vlan_filter(uint16_t port_id, uint16_t vlan_id, uint64_t vf_mask, uint16_t vf_base, uint8_t on)
 {
-	int diag = rte_pmd_ixgbe_set_vf_vlan_filter(port_id, vlan_id, vf_mask, on);
+	int diag;
+
+	if( vf_base != 0 ) {					// the nic has only 64 pools
+		bleat_printf( 0, "vfd_ixgbe_set_vf_vlan_filter: vf %d is beyond the 64 pools of port %d", vf_base, port_id );
+		return -EINVAL;
+	}
+
+	diag = rte_pmd_ixgbe_set_vf_vlan_filter(port_id, vlan_id, vf_mask, on);
 	if (diag < 0) {
 		bleat_printf( 0, "rte_pmd_ixgbe_set_vf_vlan_filter failed: (port_id=%d, vlan_id=%d) failed rc=%d", port_id, vlan_id, diag );
 	} else {
@@ -223,7 +230,7 @@ vfd_ixgbe_get_vf_stats(uint16_t port_id, uint16_t vf_id, struct rte_eth_stats *s
 	//diag = rte_pmd_ixgbe_get_vf_stats(port_id, vf_id, stats);
 
 
-	if(vf_id > 31 ) {
+	if(vf_id > 63 ) {						// per pool counters exist for 64 pools
 		return -1;
 	}
 
@@ -346,7 +353,7 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 			snprintf( wbuf, sizeof( wbuf ), "%02x:%02x:%02x:%02x:%02x:%02x", new_mac->addr_bytes[0], new_mac->addr_bytes[1],
 					new_mac->addr_bytes[2], new_mac->addr_bytes[3], new_mac->addr_bytes[4], new_mac->addr_bytes[5] );
 
-			if( ! push_mac( port_id, vf, wbuf ) ) {								// push onto the head of our list
+			if( ! push_mac( port_id, vf, mac_from_ea( new_mac ) ) ) {			// push onto the head of our list
 				bleat_printf( 1, "guest attempt to push mac address fails: %s: (sending nack)", wbuf );
 				p->retval = RTE_PMD_IXGBE_MB_EVENT_NOOP_NACK;     				// guest should see failure
 			} else {
@@ -398,10 +405,7 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 				p->retval = RTE_PMD_IXGBE_MB_EVENT_NOOP_NACK;     /* noop & nack */
 			}
 			
-			restore_vf_setings(port_id, vf);
-			set_fc_on( port_id, !FORCE );							// enable flow control if allowed (force off)
-			tx_set_loopback( port_id, suss_loopback( port_id ) );	// enable loopback if set (could be reset if link was down)
-			add_refresh_queue( port_id, vf );						// schedule a complete refresh when the queue goes hot
+			mbq_add( MBE_SET_LPE, port_id, vf, MBF_RESTORE | MBF_FC | MBF_LOOPBACK | MBF_REFRESH );	// nic work on the mailbox worker; refresh when the queue goes hot
 			break;
 
 		case IXGBE_VF_SET_MACVLAN:
@@ -431,7 +435,7 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 						clear_macs( port_id, vf, KEEP_DEFAULT );
 						p->retval = RTE_PMD_IXGBE_MB_EVENT_PROCEED;
 					} else {
-						if( add_mac( port_id, vf, wbuf ) ) {					// add to the VF's mac list, if not there and if room on both pf and vf
+						if( add_mac( port_id, vf, mac_from_ea( new_mac ) ) ) {		// add to the VF's mac list, if not there and if room on both pf and vf
 							bleat_printf( 1, "set macvlan event received: pf/vf=%d/%d %s (responding proceed)", port_id, vf, wbuf );
 							p->retval = RTE_PMD_IXGBE_MB_EVENT_PROCEED;
 							add_refresh = 1;
@@ -459,9 +463,9 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 			bleat_printf( 1, "set negotiate event received: port=%d (responding proceed)", port_id );
 			p->retval =  RTE_PMD_IXGBE_MB_EVENT_PROCEED;   /* do what's needed */
 			
-			set_fc_on( port_id, !FORCE );									// enable flow control if allowed
-			restore_vf_setings(port_id, vf);							// these must happen now, do NOT queue it. if not immediate guest-guest may hang
-			tx_set_loopback( port_id, suss_loopback( port_id ) );		// enable loopback if set (could be reset if link goes down)
+			// these must happen now, do NOT put on the refresh queue (if not immediate guest-guest may hang); the
+			// mailbox worker runs them as soon as we return rather than holding the interrupt thread
+			mbq_add( MBE_NEGOTIATE, port_id, vf, MBF_FC | MBF_RESTORE | MBF_LOOPBACK );
 			break;
 
 		case IXGBE_VF_GET_QUEUES:
@@ -482,7 +486,7 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 			bleat_printf( 1, "unknown event request received: port=%d (responding nop+nak)", port_id );
 			p->retval = RTE_PMD_IXGBE_MB_EVENT_NOOP_NACK;     /* noop & nack */
 
-			restore_vf_setings(port_id, vf);		// refresh all of our configuration back onto the NIC
+			mbq_add( MBE_UNKNOWN, port_id, vf, MBF_RESTORE );		// refresh all of our configuration back onto the NIC
 			break;
 	}
 
@@ -512,10 +516,12 @@ vfd_ixgbe_get_vf_spoof_stats(__attribute__((__unused__)) uint16_t port_id, __att
 void 
 vfd_ixgbe_disable_default_pool(uint16_t port_id)
 {
-	uint32_t ctrl = port_pci_reg_read(port_id, IXGBE_VT_CTL);
-	ctrl |= IXGBE_VT_CTL_DIS_DEFPL;
-	bleat_printf( 3, "vfd_ixgbe_disable_default_pool bar=0x%08X, port=%d ctrl=0x%08x ", IXGBE_VT_CTL, port_id, ctrl);
-	port_pci_reg_write( port_id, IXGBE_VT_CTL, ctrl);	
+	uint32_t ctrl = port_pci_reg_read( port_id, IXGBE_VT_CTL );		// not shadowed: a reset clears the bit behind the cache's back
+
+	bleat_printf( 3, "vfd_ixgbe_disable_default_pool bar=0x%08X, port=%d ctrl=0x%08x ", IXGBE_VT_CTL, port_id, ctrl | IXGBE_VT_CTL_DIS_DEFPL );
+	if( (ctrl & IXGBE_VT_CTL_DIS_DEFPL) == 0 ) {
+		port_pci_reg_write( port_id, IXGBE_VT_CTL, ctrl | IXGBE_VT_CTL_DIS_DEFPL );
+	}
 }
 
 
@@ -690,3 +696,61 @@ vfd_ixgbe_dump_all_vlans(uint16_t port_id)
 	return count;
 }
 
+
+/*
+	Niantic requires mac antispoofing to be on if vlan antispoofing is on, so we
+	ignore the caller's value and always set it.
+*/
+static int vfd_ixgbe_force_mac_anti_spoof( uint16_t port_id, uint16_t vf_id, __attribute__((__unused__)) uint8_t on ) {
+	return vfd_ixgbe_set_vf_mac_anti_spoof( port_id, vf_id, 1 );
+}
+
+/*
+	The tx error counter isn't kept per VF on the niantic; what dpdk returns is
+	garbage so we zero it.
+*/
+static int vfd_ixgbe_get_vf_stats_oe( uint16_t port_id, uint16_t vf_id, struct rte_eth_stats *stats ) {
+	int rc;
+
+	rc = vfd_ixgbe_get_vf_stats( port_id, vf_id, stats );
+	stats->oerrors = 0;
+
+	return rc;
+}
+
+/*
+	Driver ops for the niantic (ixgbe) family.
+*/
+const struct vfd_nic_ops vfd_ixgbe_ops = {
+	.driver = "net_ixgbe",
+	.type = VFD_NIANTIC,
+	.flags = NOF_PFSPOOF_COR | NOF_FORCE_MACSPOOF,
+	.vlan_filters = 64,							// VLVF entries; shared by all pools
+	.vf_limit = 64,								// pools
+
+	.set_vf_rate_limit = vfd_ixgbe_set_vf_rate_limit,
+	.set_vf_vlan_insert = vfd_ixgbe_set_vf_vlan_insert,
+	.set_vf_vlan_stripq = vfd_ixgbe_set_vf_vlan_stripq,
+	.set_vf_broadcast = vfd_ixgbe_set_vf_broadcast,
+	.set_vf_multicast_promisc = vfd_ixgbe_set_vf_multicast_promisc,
+	.set_vf_unicast_promisc = vfd_ixgbe_set_vf_unicast_promisc,
+	.allow_untagged = vfd_ixgbe_allow_untagged,
+	.set_vf_mac_addr = vfd_ixgbe_set_vf_mac_addr,
+	.set_vf_default_mac_addr = vfd_ixgbe_set_vf_default_mac_addr,
+	.set_vf_vlan_filter = vfd_ixgbe_set_vf_vlan_filter,
+	.set_vf_vlan_anti_spoof = vfd_ixgbe_set_vf_vlan_anti_spoof,
+	.set_vf_mac_anti_spoof = vfd_ixgbe_force_mac_anti_spoof,
+	.set_tx_loopback = vfd_ixgbe_set_tx_loopback,
+	.get_split_ctlreg = vfd_ixgbe_get_split_ctlreg,
+	.set_split_erop = vfd_ixgbe_set_split_erop,
+	.set_rx_drop = vfd_ixgbe_set_rx_drop,
+	.set_pfrx_drop = vfd_ixgbe_set_pfrx_drop,
+	.set_all_queues_drop_en = vfd_ixgbe_set_all_queues_drop_en,
+	.disable_default_pool = vfd_ixgbe_disable_default_pool,
+	.is_rx_queue_on = vfd_ixgbe_is_rx_queue_on,
+	.ping_vfs = vfd_ixgbe_ping_vfs,
+	.dump_all_vlans = vfd_ixgbe_dump_all_vlans,
+	.get_pf_spoof_stats = vfd_ixgbe_get_pf_spoof_stats,
+	.get_vf_stats = vfd_ixgbe_get_vf_stats_oe,
+	.mbox_cb = vfd_ixgbe_vf_msb_event_callback,
+};
@@ -9,135 +9,275 @@
 
 	Mods:		18 Apr 2018 - Correct for issue 294, and one off bug when adding
 					white list macs, and possible one off bug in clear macs.
+				16 Oct 2026 - MACs are kept as 48 bit values and the symtab is replaced
+					with a per-port index which maps each MAC to its VF and slot.
+				16 Oct 2026 - mac_aton() accepts single digit octets as ether_aton() did.
 */
 
 
 #include <vfdlib.h>		// if vfdlib.h needs an include it must be included there, can't be include prior
-#include <symtab.h>		// our symbol table things
 #include "sriov.h"
 
 
 /*
-	We use a staic symbol table to map MACs. Each VF has a slice of the table
-	based on their RTE port number.  We don't worry about tracking random MAC
-	addresses, but when a VF is removed from our control we will generate a 
-	random address to it so that if the guest restarts on a differnt VF and 
-	decides to push the same MAC in as the default there won't be a collision.	
+	Each port has an open addressed (linear probe) index of the MACs assigned to its
+	VFs, mapping the MAC to the VF and the slot in the VF's list. It is used to catch
+	duplicates on the PF and to find a MAC's owner without a scan. The PF limit
+	(MAX_PF_MACS) bounds the population, so the index is fixed at twice that and
+	never resized. Deletes shift entries back rather than leaving tombstones.
+
+	We don't worry about tracking random MAC addresses, but when a VF is removed from
+	our control we will generate a random address to it so that if the guest restarts
+	on a differnt VF and decides to push the same MAC in as the default there won't be
+	a collision.
 */
-static void*	mac_stab = NULL;
+#define MIX_BITS	8
+#define MIX_SIZE	(1 << MIX_BITS)
+#define MIX_MASK	(MIX_SIZE - 1)
+
+#if MIX_SIZE < MAX_PF_MACS * 2
+#error "MIX_BITS is too small for MAX_PF_MACS"
+#endif
+
+#define MAC_EMPTY	0						// unused index slot; the all zero mac is never valid
+
+typedef struct mac_ent {
+	uint64_t	mac;
+	uint16_t	vf;
+	uint16_t	slot;						// index in the VF's macs list
+} mac_ent_t;
+
+struct mac_ix {
+	int			n;							// number in use
+	mac_ent_t	ents[MIX_SIZE];
+};
+
+static int mac_ready = 0;
 
 // -----------------------------------------------------------------------------------------------------------
 
 /*
-	Generates a psuedo random mac address into the caller's buffer and ensures that it is unicast and that the 
-	local assignment bit is on (IEEE802). We aren't generating these for security so the system rand function 
-	is fine.
+	Fibonacci hash of the mac; the top bits are well mixed even though vendor
+	assigned MACs share the leading three octets.
 */
-static void gen_rand_mac( unsigned char* mac ) {
-	int r;
-	int i;
+static inline int mix_hash( uint64_t mac ) {
+	return (int) ((mac * 0x9e3779b97f4a7c15ULL) >> (64 - MIX_BITS));
+}
 
-	r = rand();
-	for( i = 0; i < 6; i++ ) {
-		mac[i] = r & 0xff;
-		r >>= 4;
+/*
+	Return the port's index, allocating it on first use.
+*/
+static struct mac_ix* mix_get( struct sriov_port_s* p ) {
+	if( p->mac_ix == NULL ) {
+		if( (p->mac_ix = (struct mac_ix *) calloc( 1, sizeof( *p->mac_ix ) )) == NULL ) {
+			bleat_printf( 0, "CRI: unable to allocate mac index for port %d", p->rte_port_number );
+		}
 	}
-	mac[0] &= 0xfe;				// unicast
-	mac[0] |= 0x02;				// local -- should prevent collision with any vendor assigned mac leading 3
+
+	return p->mac_ix;
 }
 
 /*
-	Generate a random human readable mac string.
-	Caller must free.
+	Return the entry for mac or nil.
 */
-static char* gen_rand_hrmac( void ) {
-	char wbuf[128];
-	unsigned char mbuf[8];
+static mac_ent_t* mix_find( struct mac_ix* ix, uint64_t mac ) {
+	int i;
+
+	for( i = mix_hash( mac ); ix->ents[i].mac != MAC_EMPTY; i = (i + 1) & MIX_MASK ) {
+		if( ix->ents[i].mac == mac ) {
+			return &ix->ents[i];
+		}
+	}
 
-	gen_rand_mac( mbuf );
-	snprintf( wbuf, sizeof( wbuf ), "%02x:%02x:%02x:%02x:%02x:%02x", mbuf[0], mbuf[1], mbuf[2], mbuf[3], mbuf[4], mbuf[5] );
-	return strdup( wbuf );
+	return NULL;
 }
 
 /*
-	Validate the string passed in contains a plausable MAC address of the form:
-		hh:hh:hh:hh:hh:hh
-
-	Returns 0 if invalid, 1 if ok.
+	Add or update the mac. Returns 0 if the index is full (the PF limit should make
+	that impossible).
 */
-static int is_valid_mac_str( char* mac ) {
-	char*	dmac;				// dup so we can bugger it
-	char*	tok;				// pointer at token
-	char*	strtp = NULL;		// strtok_r reference
-	int		ccount = 0;
-	
-	if( mac == NULL ) {
-		return 0;
+static int mix_put( struct mac_ix* ix, uint64_t mac, int vf, int slot ) {
+	int i;
+
+	for( i = mix_hash( mac ); ix->ents[i].mac != MAC_EMPTY && ix->ents[i].mac != mac; i = (i + 1) & MIX_MASK );
+
+	if( ix->ents[i].mac == MAC_EMPTY ) {
+		if( ix->n >= MIX_SIZE - 1 ) {
+			return 0;
+		}
+		ix->n++;
 	}
 
-	if( strlen( mac ) < 17 ) {
-		return 0;
+	ix->ents[i].mac = mac;
+	ix->ents[i].vf = vf;
+	ix->ents[i].slot = slot;
+	return 1;
+}
+
+/*
+	Remove the mac. Entries following it in the run are shifted back into the hole
+	when their home slot allows it, so that lookups never need tombstones.
+*/
+static void mix_del( struct mac_ix* ix, uint64_t mac ) {
+	mac_ent_t*	e;
+	int		hole;
+	int		i;
+	int		home;
+
+	if( (e = mix_find( ix, mac )) == NULL ) {
+		return;
 	}
 
-	for( tok = mac; *tok; tok++ ) {
-		if( ! isxdigit( *tok ) ) {
-			if( *tok != ':' ) {				// invalid character
-				return 0;
-			} else {
-				ccount++;					// count colons to ensure right number of tokens
-			}
+	hole = e - ix->ents;
+	for( i = (hole + 1) & MIX_MASK; ix->ents[i].mac != MAC_EMPTY; i = (i + 1) & MIX_MASK ) {
+		home = mix_hash( ix->ents[i].mac );
+		if( ((i - home) & MIX_MASK) >= ((i - hole) & MIX_MASK) ) {		// home is at or before the hole; can move
+			ix->ents[hole] = ix->ents[i];
+			hole = i;
 		}
 	}
 
-	if( ccount != 5 ) {				// bad number of colons
-		return 0;
+	ix->ents[hole].mac = MAC_EMPTY;
+	ix->n--;
+}
+
+/*
+	Generates a psuedo random mac address and ensures that it is unicast and that the 
+	local assignment bit is on (IEEE802). We aren't generating these for security so the system rand function 
+	is fine.
+*/
+static uint64_t gen_rand_mac( void ) {
+	uint64_t mac = 0;
+	int r;
+	int i;
+
+	r = rand();
+	for( i = 0; i < 6; i++ ) {
+		mac = (mac << 8) | (r & 0xff);
+		r >>= 4;
 	}
-	
-	if( (dmac = strdup( mac )) == NULL ) {
-		return 0;							// shouldn't happen, but be parinoid
+	mac &= ~(0x01ULL << 40);		// unicast
+	mac |= 0x02ULL << 40;			// local -- should prevent collision with any vendor assigned mac leading 3
+	return mac;
+}
+
+// --------------------- public ------------------------------------------------------------------------------
+
+/*
+	Convert a human readable MAC (hh:hh:hh:hh:hh:hh) to its 48 bit value. An octet
+	may be a single digit (0:1b:...) as ether_aton() allowed. Returns 1 if the string
+	was valid, 0 if not.
+*/
+extern int mac_aton( const char* str, uint64_t* mac ) {
+	uint64_t	v = 0;
+	int			i;
+	int			oct;
+	int			lo;
+
+	if( str == NULL ) {
+		return 0;
 	}
 
-	tok = strtok_r( dmac, ":", &strtp );
-	while( tok ) {
-		if( atoi( tok ) > 255 ) {			// can't be negative or sign would pop earlier check
-			free( dmac );
+	for( i = 0; i < 6; i++ ) {
+		if( (oct = xdigit( *str )) < 0 ) {
+			return 0;
+		}
+		str++;
+		if( (lo = xdigit( *str )) >= 0 ) {				// second digit is optional
+			oct = (oct << 4) | lo;
+			str++;
+		}
+		v = (v << 8) | oct;
+
+		if( *str != (i < 5 ? ':' : 0) ) {
 			return 0;
 		}
-		tok = strtok_r( NULL, ":", &strtp );
+		str++;
 	}
-	free( dmac );
 
+	*mac = v;
 	return 1;
 }
 
-// --------------------- public ------------------------------------------------------------------------------
+/*
+	Format the mac into the caller's buffer (at least MAC_STR_LEN bytes) and return it.
+*/
+extern char* mac_ntoa( uint64_t mac, char* buf ) {
+	snprintf( buf, MAC_STR_LEN, "%02x:%02x:%02x:%02x:%02x:%02x",
+		(int) (mac >> 40) & 0xff, (int) (mac >> 32) & 0xff, (int) (mac >> 24) & 0xff,
+		(int) (mac >> 16) & 0xff, (int) (mac >> 8) & 0xff, (int) mac & 0xff );
+	return buf;
+}
 
 /*
-	Do any initialisation that is necessary:
-		1) create the symtab
-		2) collect the random addresses assigned
+	Convert between the 48 bit value and the struct the NIC functions want.
+*/
+extern uint64_t mac_from_ea( const struct ether_addr* ea ) {
+	uint64_t	v = 0;
+	int			i;
+
+	for( i = 0; i < 6; i++ ) {
+		v = (v << 8) | ea->addr_bytes[i];
+	}
+
+	return v;
+}
+
+extern void mac_to_ea( uint64_t mac, struct ether_addr* ea ) {
+	int i;
+
+	for( i = 5; i >= 0; i-- ) {
+		ea->addr_bytes[i] = mac & 0xff;
+		mac >>= 8;
+	}
+}
+
+/*
+	Do any initialisation that is necessary. The per-port indexes are allocated
+	as they are needed.
 
 	Returns 1 on success. If called a second time, it will return 1.
 */
 extern int mac_init( void ) {
 
-	if( mac_stab ) {			// already initialised, don't collect bad MAC addresses
+	if( mac_ready ) {			// already initialised
 		return 1;
 	}
 
 	srand( (int) (getpid() + time( NULL ))  );			// set seed for randomised mac addresses
+	mac_ready = 1;
 
-	if( (mac_stab = sym_alloc( 1023 )) == NULL ) {
-		bleat_printf( 0, "CRI: unable to allocate mac symbol table" );
+	return 1;
+}
+
+/*
+	Look up the mac on the port. If it is assigned to a VF, 1 is returned and the VF
+	number and the index in its mac list are placed in vfid and slot (either may be nil).
+	Returns 0 if the mac is not known on the port.
+*/
+extern int find_mac( int port, uint64_t mac, int* vfid, int* slot ) {
+	struct sriov_port_s* p;
+	mac_ent_t*	e;
+
+	if( (p = suss_port( port )) == NULL || p->mac_ix == NULL ) {
 		return 0;
 	}
 
+	if( (e = mix_find( p->mac_ix, mac )) == NULL ) {
+		return 0;
+	}
+
+	if( vfid ) {
+		*vfid = e->vf;
+	}
+	if( slot ) {
+		*slot = e->slot;
+	}
 	return 1;
 }
 
-
 /*
-	Checks to see if the MAC (human readable) is valid from the perspective of:
+	Checks to see if the MAC is valid from the perspective of:
 
 		1) the addition of a MAC does not cause the PF limit to be exceeded 
 		2) the VF has room for another MAC.  (see note)
@@ -157,16 +297,14 @@ extern int mac_init( void ) {
 	validate that the total for the VF isn't busted; in this case we expect
 	that the VF number is < 0, and skip this check.
 */
-extern int can_add_mac( int port, int vfid, char* mac ) {
+extern int can_add_mac( int port, int vfid, uint64_t mac ) {
 	struct vf_s* vf = NULL;				// references to our pf/vf structs
 	struct sriov_port_s* p = NULL;
-	int total = 0;						// number of MACs defined for the PF
-	int i;
-	void* sresult;						// result from the symtab look up
-	
+	struct mac_ix* ix;
+	char	mbuf[MAC_STR_LEN];
 
-	if( ! is_valid_mac_str( mac ) ) {		// will also test for nil pointer
-		bleat_printf( 1, "can_add_mac: mac is not valid: %s", mac );
+	if( mac == MAC_EMPTY || mac > 0xffffffffffffULL ) {
+		bleat_printf( 1, "can_add_mac: mac is not valid: %s", mac_ntoa( mac, mbuf ) );
 		return 0;
 	}
 
@@ -175,17 +313,17 @@ extern int can_add_mac( int port, int vfid, char* mac ) {
 		return 0;
 	}
 
-	if( (sresult = sym_get( mac_stab, mac, port )) ) {			// see if defined for any VF on the PF
-		bleat_printf( 1, "can_add_mac: mac is already assigned to on port %d: %s", port, mac );
+	if( (ix = mix_get( p )) == NULL ) {
 		return 0;
 	}
 
-	for( i = 0; i < p->num_vfs; i++ ) {			// we do NOT depend on a counter inc'd and dec'd we count every time to be sure
-		total += p->vfs[i].num_macs;
+	if( mix_find( ix, mac ) != NULL ) {										// see if defined for any VF on the PF
+		bleat_printf( 1, "can_add_mac: mac is already assigned to on port %d: %s", port, mac_ntoa( mac, mbuf ) );
+		return 0;
 	}
 
-	if( total+1 > MAX_PF_MACS ) {
-		bleat_printf( 1, "can_add_mac: adding mac would exceed PF limit: pf/vf=%d/%d current_pf=%d mac=%s", port, vfid, total, mac );
+	if( ix->n + 1 > MAX_PF_MACS ) {
+		bleat_printf( 1, "can_add_mac: adding mac would exceed PF limit: pf/vf=%d/%d current_pf=%d mac=%s", port, vfid, ix->n, mac_ntoa( mac, mbuf ) );
 		return 0;
 	}
 
@@ -196,7 +334,7 @@ extern int can_add_mac( int port, int vfid, char* mac ) {
 		}
 
 		if( vf->num_macs +1 > MAX_VF_MACS ) {
-			bleat_printf( 1, "can_add_mac: adding mac would exceed VF limit: pf/vf=%d/%d current_vf=%d mac=%s", port, vfid, vf->num_macs, mac );
+			bleat_printf( 1, "can_add_mac: adding mac would exceed VF limit: pf/vf=%d/%d current_vf=%d mac=%s", port, vfid, vf->num_macs, mac_ntoa( mac, mbuf ) );
 			return 0;
 		}
 	}
@@ -205,27 +343,25 @@ extern int can_add_mac( int port, int vfid, char* mac ) {
 }
 
 /*
-	Accepts a mac string and adds it to the list of MACs for the pf/vf provided that it is valid
+	Adds the mac to the list of MACs for the pf/vf provided that it is valid
 	(see can_add_mac() function).
 
 	If the MAC is already listed for the PF/VF given, then we do nothing and silently
 	ignore the call returning 1 (success).
 
-	The parm mac is expected to be an ASCII-z string in human readable xx:xx... form.
-
 	This function does NOT push anything out to the NIC; it only sets the MAC addresses
 	up in the VF struct which is then used by the functions that acutually update the 
 	NIC at the appropriate time(s).
 */
-extern int add_mac( int port, int vfid, char* mac ) {
+extern int add_mac( int port, int vfid, uint64_t mac ) {
 	struct vf_s* vf = NULL;				// references to our pf/vf structs
 	struct sriov_port_s* p = NULL;
-	int total = 0;						// number of MACs defined for the PF
-	int i;
+	mac_ent_t*	e;
 	int ip;								// insert point if good to insert mac
+	char	mbuf[MAC_STR_LEN];
 
-	if( mac == NULL || ! *mac ) {
-		bleat_printf( 1, "add_mac: nil mac pointer, or empty string pf/vf=%d/%d", port, vfid );
+	if( mac == MAC_EMPTY ) {
+		bleat_printf( 1, "add_mac: empty mac pf/vf=%d/%d", port, vfid );
 		return 0;
 	}
 	
@@ -240,11 +376,9 @@ extern int add_mac( int port, int vfid, char* mac ) {
 	}
 
 																				// this check must be BEFORE can_add_mac() call
-	for( i = vf->first_mac; i < vf->num_macs + vf->first_mac; i++ ) {			// if duplicate of what defined for this VF, then its OK
-		if( strcmp( vf->macs[i], mac ) == 0 ) {
-			bleat_printf( 1, "add_mac: no action needed: mac already in list for: pf/vf=%d/%d mac=%s", port, vfid, mac );
-			return 1;
-		}
+	if( p->mac_ix != NULL && (e = mix_find( p->mac_ix, mac )) != NULL && e->vf == vfid ) {		// if duplicate of what defined for this VF, then its OK
+		bleat_printf( 1, "add_mac: no action needed: mac already in list for: pf/vf=%d/%d mac=%s", port, vfid, mac_ntoa( mac, mbuf ) );
+		return 1;
 	}
 
 	if( ! can_add_mac( port, vfid, mac ) ) {
@@ -253,12 +387,14 @@ extern int add_mac( int port, int vfid, char* mac ) {
 
 	//  --- all vetting must be before this, at this point we're good to add, so update things ----------------
 	ip = vf->num_macs + vf->first_mac;					// MUST compute insert point before increasing num macs!
+	if( ! mix_put( p->mac_ix, mac, vfid, ip ) ) {		// assign this to the PF space for dup checking
+		bleat_printf( 0, "ERR: add_mac: mac index full: pf/vf=%d/%d", port, vfid );
+		return 0;
+	}
 	vf->num_macs++;
-	bleat_printf( 2, "add_mac: allowed: pf/vf=%d/%d pf_nm=%d nm=%d fm=%d ip=%d %s", port, vfid, total+1, vf->num_macs, vf->first_mac, ip, mac );
+	bleat_printf( 2, "add_mac: allowed: pf/vf=%d/%d pf_nm=%d nm=%d fm=%d ip=%d %s", port, vfid, p->mac_ix->n, vf->num_macs, vf->first_mac, ip, mac_ntoa( mac, mbuf ) );
 
-	sym_map( mac_stab, mac, port, (void*) 1 );		// assign this to the PF space for dup checking
-	strncpy( vf->macs[ip], mac, 17 );					// will add final 0 if a:b:c style resulting in short string
-	vf->macs[ip][17] = 0;								// if long string passed in; ensure 0 terminated
+	vf->macs[ip] = mac;
 
 	return 1;
 }
@@ -277,10 +413,11 @@ extern int add_mac( int port, int vfid, char* mac ) {
 extern int clear_macs( int port, int vfid, int assign_random ) {
 	struct vf_s* vf = NULL;				// references to our pf/vf information
 	struct sriov_port_s* pf = NULL;
-	char*	mac;
-	char*	rmac;						// random mac
+	uint64_t	rmac;					// random mac
 	int m;
 	int	si;								// stop index
+	char	mbuf[MAC_STR_LEN];
+	char	rbuf[MAC_STR_LEN];
 	
 	if( (pf = suss_port( port )) == NULL ) {
 		bleat_printf( 1, "clear_macs: port doesn't map: %d", port );
@@ -295,26 +432,28 @@ extern int clear_macs( int port, int vfid, int assign_random ) {
 	si = vf->num_macs + vf->first_mac;
 	bleat_printf( 1, "clearing macs for pf/vf=%d/%d use_rand=%d fm=%d nm=%d si=%d", port, vfid, assign_random, vf->first_mac, vf->num_macs, si );
 	for( m = vf->first_mac + 1; m < si; ++m ) {						// for all but the default
-		mac = vf->macs[m];
-		bleat_printf( 2, "clear macs:  [%d] pf/vf=%d/%d %s", m, pf->rte_port_number, vf->num, mac );
+		bleat_printf( 2, "clear macs:  [%d] pf/vf=%d/%d %s", m, pf->rte_port_number, vf->num, mac_ntoa( vf->macs[m], mbuf ) );
 		
-		sym_del( mac_stab, vf->macs[m], port );							// nix from the symtab
-		set_vf_rx_mac( port, mac, vfid, SET_OFF );						// clear from 'white list'
+		if( pf->mac_ix != NULL ) {
+			mix_del( pf->mac_ix, vf->macs[m] );						// nix from the index
+		}
+		set_vf_rx_mac( port, vf->macs[m], vfid, SET_OFF );				// clear from 'white list'
 	}
 
 	if( assign_random ) {										// if replacing the default, do so with a random address
-		sym_del( mac_stab, vf->macs[vf->first_mac], port );		// ensure old one is not in the symtab
+		if( pf->mac_ix != NULL ) {
+			mix_del( pf->mac_ix, vf->macs[vf->first_mac] );		// ensure old one is not in the index
+		}
 
-		rmac = gen_rand_hrmac();								// random mac to push into the nic
+		rmac = gen_rand_mac();									// random mac to push into the nic
 		set_vf_default_mac( port, rmac, vfid );
 
-		bleat_printf( 2, "clear macs: replacing default (%s) with random: %s", vf->macs[vf->first_mac], rmac );
-		free( rmac );
+		bleat_printf( 2, "clear macs: replacing default (%s) with random: %s", mac_ntoa( vf->macs[vf->first_mac], mbuf ), mac_ntoa( rmac, rbuf ) );
 
 		vf->num_macs = 0;		// at this point we are not shoving any addresses to the NIC for this VF
 		vf->first_mac = 1;
 	} else {
-		bleat_printf( 2, "clear macs: leaving default [%d] %s", vf->first_mac, vf->macs[vf->first_mac] );
+		bleat_printf( 2, "clear macs: leaving default [%d] %s", vf->first_mac, mac_ntoa( vf->macs[vf->first_mac], mbuf ) );
 		vf->num_macs = 1;		// we are leaving the default in place so adjust
 	}
 
@@ -322,23 +461,25 @@ extern int clear_macs( int port, int vfid, int assign_random ) {
 }
 
 /*
-	Pushes the mac string onto the head of the list for the given port/vf combination. Sets
+	Pushes the mac onto the head of the list for the given port/vf combination. Sets
 	the first mac index to be 0 so that it is used if a port/vf reset is triggered.
-	Mac is a nil terminated ascii string of the form xx:xx:xx:xx:xx:xx.
+	If the guest has already pushed a mac, the one in slot 0 is replaced.
 
 	Returns 1 if mac can and was pushed on the list, 0 on error.
 */
-extern int push_mac( int port, int vfid, char* mac ) {
+extern int push_mac( int port, int vfid, uint64_t mac ) {
 	struct vf_s* vf;
+	struct sriov_port_s* p;
+	char	mbuf[MAC_STR_LEN];
 	
-	if( (vf = suss_vf( port, vfid )) == NULL ) {
+	if( (p = suss_port( port )) == NULL || (vf = suss_vf( port, vfid )) == NULL ) {
 		bleat_printf( 2, "push_mac: vf doesn't map: pf/vf=%d/%d", port, vfid );
 		return 0;
 	}
 
 	
-	if( vf->num_macs > 0  && strcmp( mac, vf->macs[vf->first_mac] ) == 0 ) {		// we already have this as the default
-		bleat_printf( 2, "push_mac: mac is already default for pf/vf=%d/%d [%d] nm=%d: %s", port, vfid, vf->first_mac, vf->num_macs, mac );
+	if( vf->num_macs > 0  && mac == vf->macs[vf->first_mac] ) {		// we already have this as the default
+		bleat_printf( 2, "push_mac: mac is already default for pf/vf=%d/%d [%d] nm=%d: %s", port, vfid, vf->first_mac, vf->num_macs, mac_ntoa( mac, mbuf ) );
 		return 1;
 	}
 
@@ -346,11 +487,16 @@ extern int push_mac( int port, int vfid, char* mac ) {
 		return 0;								// reason is logged by can_add function, so no msg here
 	}
 
-	vf->first_mac = 0;
-	vf->num_macs++;
-	strcpy( vf->macs[0], mac );			// make our copy
+	if( vf->first_mac == 0 && vf->num_macs > 0 ) {			// replacing one the guest pushed earlier
+		mix_del( p->mac_ix, vf->macs[0] );
+	} else {
+		vf->first_mac = 0;
+		vf->num_macs++;
+	}
+	vf->macs[0] = mac;
+	mix_put( p->mac_ix, mac, vfid, 0 );						// can_add_mac ensured the index exists and has room
 
-	bleat_printf( 1, "push_mac: default mac pushed onto head of list: pf/vf=%d/%d %s num=%d", port, vfid, vf->macs[0], vf->num_macs );
+	bleat_printf( 1, "push_mac: default mac pushed onto head of list: pf/vf=%d/%d %s num=%d", port, vfid, mac_ntoa( mac, mbuf ), vf->num_macs );
 	return 1;
 }
 
@@ -364,9 +510,9 @@ extern int push_mac( int port, int vfid, char* mac ) {
 extern int set_macs( int port, int vfid ) {
 	struct vf_s* vf = NULL;				// references to our pf/vf information
 	struct sriov_port_s* pf = NULL;
-	char*	mac;
 	int m;
 	int si;								// start index for reverse loop
+	char	mbuf[MAC_STR_LEN];
 	
 	if( (pf = suss_port( port )) == NULL ) {
 		bleat_printf( 1, "set_macs: port doesn't map: %d", port );
@@ -382,13 +528,12 @@ extern int set_macs( int port, int vfid ) {
 	bleat_printf( 1, "configuring %d mac addresses on pf/vf=%d/%d firstmac=%d nm=%d si=%d", vf->num_macs, port, vfid, vf->first_mac, vf->num_macs,  si );
 
 	for( m = si; m >= vf->first_mac; m-- ) {
-		mac = vf->macs[m];
-		bleat_printf( 2, "set_mac: adding mac [%d]: port: %d vf: %d mac: %s", m, port, vfid, mac );
+		bleat_printf( 2, "set_mac: adding mac [%d]: port: %d vf: %d mac: %s", m, port, vfid, mac_ntoa( vf->macs[m], mbuf ) );
 
 		if( m > vf->first_mac ) {
-			set_vf_rx_mac( port, mac, vfid, SET_ON );	// set in whitelist
+			set_vf_rx_mac( port, vf->macs[m], vfid, SET_ON );	// set in whitelist
 		} else {
-			set_vf_default_mac( port, mac, vfid );		// first is set as default
+			set_vf_default_mac( port, vf->macs[m], vfid );		// first is set as default
 		}
 	}
 
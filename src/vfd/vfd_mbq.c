@@ -0,0 +1,337 @@
+// vi: sw=4 ts=4 noet:
+/*
+	Mnemonic:	vfd_mbq.c
+	Abstract:	Mailbox event queue. The driver mailbox callbacks run on the EAL
+				interrupt thread which also handles link state and mailbox messages
+				for every other PF. The callbacks make the accept/nack decision and
+				then, rather than reprogramming the NIC inline, queue a small event
+				which is pulled off of an rte_ring by the mailbox worker thread and
+				executed there.
+
+				Event blocks come from a static pool whose free list is also a ring;
+				the callbacks are the only producer of work (single interrupt thread)
+				and the worker is the only consumer, so both rings are single
+				producer/consumer. If the queue cannot take an event (not initialised,
+				pool exhausted) the work is done inline as it was before.
+
+				Restores are subject to the VF's mailbox rate limit (mb_rate_check()); a
+				refresh queued with a restore (MBF_REFRESH) rides on the same token.
+
+				Per event type we track the number queued, current and max depth, the
+				number serviced and the queue to completion latency.
+
+				mbq_stop() joins the worker before the ports are closed; anything still
+				queued, or arriving after, is dropped rather than run against a port
+				which is being torn down.
+
+	Date:		16 Oct 2026
+*/
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+
+#include "sriov.h"
+
+#define MBQ_SIZE		1024				// ring size (power of 2); the ring holds one less
+#define MBQ_BURST		32					// max events pulled from the ring at once
+
+typedef struct {
+	uint8_t		type;						// MBE_ constant (stats bucket)
+	uint8_t		flags;						// MBF_ constants: what is to be done
+	uint16_t	port;
+	uint16_t	vf;
+	uint64_t	qtsc;						// tsc when queued
+} mb_event_t;
+
+typedef struct {
+	long		queued;
+	long		inline_run;					// run on the interrupt thread because we could not queue
+	long		serviced;
+	int			depth;						// currently queued
+	int			max_depth;
+	double		lat_us;						// last queue to completion time
+	double		lat_max_us;
+	double		lat_tot_us;					// for average
+} mbq_stat_t;
+
+static const char* mbe_names[MBE_NTYPES] = { "negotiate", "set-lpe", "reset", "unknown", "other" };
+
+static mb_event_t	events[MBQ_SIZE];		// event pool
+static struct rte_ring*	work_ring = NULL;
+static struct rte_ring*	free_ring = NULL;
+static int			mbq_efd = -1;			// eventfd used to wake the worker
+static pthread_t	mbq_tid;
+static volatile int	mbq_run = 0;			// cleared by mbq_stop() to end the worker
+static mbq_stat_t	mbq_stats[MBE_NTYPES];
+static rte_spinlock_t mbq_slock = RTE_SPINLOCK_INITIALIZER;		// protects stats
+
+/*
+	Do the work described by flags. This is the slow stuff (reprograms the NIC).
+*/
+static void mbq_exec( uint16_t port, uint16_t vf, int flags ) {
+	if( flags & MBF_UNTAGGED_OFF ) {
+		set_vf_allow_untagged( port, vf, 0 );
+	}
+
+	if( flags & MBF_FC ) {
+		set_fc_on( port, !FORCE );							// enable flow control if allowed
+	}
+
+	if( flags & MBF_RESTORE ) {
+		restore_vf_setings( port, vf );						// refresh all of our configuration back onto the NIC
+	}
+
+	if( flags & MBF_LOOPBACK ) {
+		tx_set_loopback( port, suss_loopback( port ) );		// enable loopback if set (could be reset if link goes down)
+	}
+}
+
+/*
+	Worker thread: block until poked, then drain the ring.
+*/
+static void* mbq_worker( void* data ) {
+	void*		ev[MBQ_BURST];
+	mb_event_t*	ep;
+	mbq_stat_t*	sp;
+	struct pollfd	pfd;
+	uint64_t	junk;
+	unsigned	n;
+	unsigned	i;
+	double		lat;
+	double		tsc_us;
+
+	RTE_SET_USED( data );
+
+	tsc_us = (double) rte_get_tsc_hz() / 1000000.0;
+	if( tsc_us <= 0.0 ) {
+		tsc_us = 1.0;
+	}
+
+	pfd.fd = mbq_efd;
+	pfd.events = POLLIN;
+	while( mbq_run ) {
+		pfd.revents = 0;
+		if( poll( &pfd, 1, 1000 ) > 0 ) {					// timeout is a safety net should a poke be lost
+			if( read( mbq_efd, &junk, sizeof( junk ) ) < 0 ) {
+				junk = 0;
+			}
+		}
+
+		while( mbq_run && (n = rte_ring_dequeue_burst( work_ring, ev, MBQ_BURST, NULL )) > 0 ) {
+			for( i = 0; i < n; i++ ) {
+				ep = (mb_event_t *) ev[i];
+				bleat_printf( 3, "mbq: servicing %s event for pf/vf=%d/%d flags=%02x", mbe_names[ep->type], ep->port, ep->vf, ep->flags );
+				mbq_exec( ep->port, ep->vf, ep->flags );
+
+				lat = (double) (rte_rdtsc() - ep->qtsc) / tsc_us;
+				rte_spinlock_lock( &mbq_slock );
+				sp = &mbq_stats[ep->type];
+				sp->serviced++;
+				sp->depth--;
+				sp->lat_us = lat;
+				sp->lat_tot_us += lat;
+				if( lat > sp->lat_max_us ) {
+					sp->lat_max_us = lat;
+				}
+				rte_spinlock_unlock( &mbq_slock );
+
+				rte_ring_enqueue( free_ring, ep );
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*
+	Create the rings and start the worker. Must be called after the EAL is
+	initialised and before the mailbox callbacks are registered.
+	Returns 0 on success; on failure the callbacks continue to run things
+	inline so this is not fatal.
+*/
+extern int mbq_init( void ) {
+	int	i;
+
+	if( work_ring != NULL ) {
+		return 0;
+	}
+
+	if( (mbq_efd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC )) < 0 ) {
+		bleat_printf( 0, "WRN: mbq: unable to create eventfd; mailbox work will run on the interrupt thread: %s", strerror( errno ) );
+		return -1;
+	}
+
+	free_ring = rte_ring_create( "vfd_mbq_free", MBQ_SIZE, rte_socket_id(), RING_F_SP_ENQ | RING_F_SC_DEQ );
+	work_ring = rte_ring_create( "vfd_mbq_work", MBQ_SIZE, rte_socket_id(), RING_F_SP_ENQ | RING_F_SC_DEQ );
+	if( free_ring == NULL || work_ring == NULL ) {
+		bleat_printf( 0, "WRN: mbq: unable to create rings; mailbox work will run on the interrupt thread" );
+		work_ring = NULL;
+		return -1;
+	}
+
+	for( i = 0; i < MBQ_SIZE - 1; i++ ) {						// ring holds size-1
+		rte_ring_enqueue( free_ring, &events[i] );
+	}
+
+	mbq_run = 1;
+	if( pthread_create( &mbq_tid, NULL, mbq_worker, NULL ) != 0 ) {
+		bleat_printf( 0, "WRN: mbq: unable to start worker thread; mailbox work will run on the interrupt thread" );
+		mbq_run = 0;
+		work_ring = NULL;
+		return -1;
+	}
+	if( rte_thread_setname( mbq_tid, "vfd-mbq" ) != 0 ) {
+		bleat_printf( 2, "error: failed to set thread name: %s", "vfd-mbq" );
+	}
+
+	bleat_printf( 1, "mailbox event queue started: %d events", MBQ_SIZE - 1 );
+	return 0;
+}
+
+/*
+	Stop the worker and wait for it; the event it is running finishes. Must be
+	called before the ports are closed.
+*/
+extern void mbq_stop( void ) {
+	uint64_t	one = 1;
+
+	if( ! mbq_run ) {
+		return;
+	}
+
+	mbq_run = 0;
+	if( write( mbq_efd, &one, sizeof( one ) ) < 0 ) {		// don't wait out the poll timeout
+		bleat_printf( 2, "mbq: wake failed: %s", strerror( errno ) );
+	}
+	pthread_join( mbq_tid, NULL );
+	bleat_printf( 1, "mailbox event queue stopped" );
+}
+
+/*
+	Called from a mailbox callback to have the work in flags (MBF_ constants)
+	done for the pf/vf on the worker thread. Type is the MBE_ constant used to
+	bucket the stats.  If we cannot queue the event the work is done now.
+*/
+extern void mbq_add( int type, uint16_t port, uint16_t vf, int flags ) {
+	mb_event_t*	ep = NULL;
+	mbq_stat_t*	sp;
+	uint64_t	one = 1;
+
+	if( type < 0 || type >= MBE_NTYPES ) {
+		type = MBE_OTHER;
+	}
+	sp = &mbq_stats[type];
+
+	if( work_ring != NULL && ! mbq_run ) {					// stopped; the ports are going away
+		bleat_printf( 2, "mbq: shutting down; %s event for pf/vf=%d/%d dropped", mbe_names[type], port, vf );
+		return;
+	}
+
+	if( flags & (MBF_RESTORE | MBF_REFRESH) ) {
+		if( ! mb_rate_check( port, vf, flags & MBF_REFRESH ) ) {		// over the vf's rate; restore becomes a deferred refresh
+			flags &= ~MBF_RESTORE;
+		}
+		flags &= ~MBF_REFRESH;										// refresh was queued by the check
+		if( flags == 0 ) {
+			return;
+		}
+	}
+
+	if( work_ring == NULL || rte_ring_dequeue( free_ring, (void **) &ep ) != 0 ) {
+		rte_spinlock_lock( &mbq_slock );
+		sp->inline_run++;
+		rte_spinlock_unlock( &mbq_slock );
+
+		mbq_exec( port, vf, flags );
+		return;
+	}
+
+	ep->type = type;
+	ep->flags = flags;
+	ep->port = port;
+	ep->vf = vf;
+	ep->qtsc = rte_rdtsc();
+
+	rte_spinlock_lock( &mbq_slock );						// before enqueue so worker cannot decrement first
+	sp->queued++;
+	sp->depth++;
+	if( sp->depth > sp->max_depth ) {
+		sp->max_depth = sp->depth;
+	}
+	rte_spinlock_unlock( &mbq_slock );
+
+	rte_ring_enqueue( work_ring, ep );						// cannot fail; pool is smaller than the ring
+	if( write( mbq_efd, &one, sizeof( one ) ) < 0 ) {
+		bleat_printf( 2, "mbq: wake failed: %s", strerror( errno ) );
+	}
+}
+
+/*
+	Fill buf with the per event type counters; only types which have seen
+	traffic are listed. Returns the length of the string placed into buf.
+*/
+extern int mbq_stats_str( char* buf, int blen ) {
+	mbq_stat_t*	sp;
+	int	l = 0;
+	int	i;
+
+	*buf = 0;
+	rte_spinlock_lock( &mbq_slock );
+	for( i = 0; i < MBE_NTYPES && l < blen - 1; i++ ) {
+		sp = &mbq_stats[i];
+		if( sp->queued + sp->inline_run == 0 ) {
+			continue;
+		}
+
+		l += snprintf( buf + l, blen - l, "mbox %-9s queued: %ld  inline: %ld  serviced: %ld  depth: %d  max-depth: %d  lat: %.0fus  avg: %.0fus  worst: %.0fus\n",
+			mbe_names[i], sp->queued, sp->inline_run, sp->serviced, sp->depth, sp->max_depth,
+			sp->lat_us, sp->serviced ? sp->lat_tot_us / sp->serviced : 0.0, sp->lat_max_us );
+	}
+	rte_spinlock_unlock( &mbq_slock );
+
+	if( l >= blen ) {
+		l = blen - 1;
+	}
+	return l;
+}
+
+/*
+	Add the mailbox event counters to buf in OpenMetrics form, labeled by event
+	type. Returns the length added.
+*/
+extern int mbq_metrics( char* buf, int blen ) {
+	mbq_stat_t	st[MBE_NTYPES];
+	int	l;
+	int	i;
+
+	rte_spinlock_lock( &mbq_slock );
+	memcpy( st, mbq_stats, sizeof( st ) );
+	rte_spinlock_unlock( &mbq_slock );
+
+	l = snprintf( buf, blen, "# TYPE vfd_mbox_events counter\n# HELP vfd_mbox_events Mailbox events by type and how they were run.\n" );
+	for( i = 0; i < MBE_NTYPES && l < blen; i++ ) {
+		l += snprintf( buf + l, blen - l, "vfd_mbox_events_total{type=\"%s\",run=\"queued\"} %ld\nvfd_mbox_events_total{type=\"%s\",run=\"inline\"} %ld\n",
+			mbe_names[i], st[i].queued, mbe_names[i], st[i].inline_run );
+	}
+
+	if( l < blen ) {
+		l += snprintf( buf + l, blen - l, "# TYPE vfd_mbox_queue_depth gauge\n" );
+	}
+	for( i = 0; i < MBE_NTYPES && l < blen; i++ ) {
+		l += snprintf( buf + l, blen - l, "vfd_mbox_queue_depth{type=\"%s\"} %d\n", mbe_names[i], st[i].depth );
+	}
+
+	if( l < blen ) {
+		l += snprintf( buf + l, blen - l, "# TYPE vfd_mbox_latency_seconds summary\n# HELP vfd_mbox_latency_seconds Queue to completion time of serviced events.\n" );
+	}
+	for( i = 0; i < MBE_NTYPES && l < blen; i++ ) {
+		l += snprintf( buf + l, blen - l, "vfd_mbox_latency_seconds_count{type=\"%s\"} %ld\nvfd_mbox_latency_seconds_sum{type=\"%s\"} %.6f\n",
+			mbe_names[i], st[i].serviced, mbe_names[i], st[i].lat_tot_us / 1000000.0 );
+	}
+
+	if( l >= blen ) {
+		l = blen - 1;
+	}
+	return l;
+}
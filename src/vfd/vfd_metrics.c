@@ -0,0 +1,488 @@
+// vi: sw=4 ts=4 noet:
+/*
+	Mnemonic:	vfd_metrics.c
+	Abstract:	OpenMetrics (Prometheus) exporter. A small HTTP/1.0 responder
+				listens on a unix stream socket or on a loopback TCP port (the
+				metrics parm) and answers GET /metrics with:
+					- PF and VF counters and link/queue state from the stats snapshot,
+					  labeled with pciid, port and vf
+					- request counts, errors and latency by request type, and the
+					  nic worker queue (vfd_rif.c)
+					- refresh queue depth and counters (sriov.c)
+					- mailbox event counts by type (vfd_mbq.c)
+					- failed nic calls by op (sriov.c)
+					- the PF extended stats selected with the xstats parm, collected
+					  into the snapshot by the stats sweep
+
+				Device metrics are rendered once per snapshot generation and the text
+				is kept; a scrape sends the kept text plus the internal metrics, which
+				are a fixed size, so scrape cost does not grow with the number of VFs.
+				Scrapes never sweep the NICs when something else is sweeping on a
+				schedule (stats_interval or the rate sampler); otherwise the snapshot
+				is refreshed when older than STATS_MAX_AGE.
+
+				Scrapes are served one at a time by the exporter thread; nothing here
+				runs on the main or request threads.
+
+	Date:		16 Oct 2026
+*/
+
+#include <pthread.h>
+#include <poll.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sriov.h"
+#include "vfd_rif.h"
+
+#define MET_INT_SIZE	(64 * 1024)				// internal metrics buffer
+#define MET_REQ_SIZE	2048					// max request header we read
+#define MET_IO_MS		1000					// client read/write timeout
+
+#define MC_PF			0x01					// counter applies to pfs
+#define MC_VF			0x02					// counter applies to vfs
+
+typedef struct {
+	const char*	name;							// family name (_total is added to samples)
+	const char*	help;
+	int			flags;							// MC_ constants
+	size_t		pf_off;							// offset of the uint64_t pf array in the snapshot
+	size_t		vf_off;							// offset of the uint64_t vf array in the snapshot
+} met_ctr_t;
+
+static const met_ctr_t counters[] = {
+	{ "rx_packets", "Packets received.", MC_PF | MC_VF, offsetof( stats_snap_t, pf_ipackets ), offsetof( stats_snap_t, vf_ipackets ) },
+	{ "rx_bytes", "Bytes received.", MC_PF | MC_VF, offsetof( stats_snap_t, pf_ibytes ), offsetof( stats_snap_t, vf_ibytes ) },
+	{ "rx_errors", "Receive errors.", MC_PF | MC_VF, offsetof( stats_snap_t, pf_ierrors ), offsetof( stats_snap_t, vf_ierrors ) },
+	{ "rx_missed", "Packets dropped by the NIC (rx fifo full).", MC_PF, offsetof( stats_snap_t, pf_imissed ), 0 },
+	{ "rx_nombuf", "Receive mbuf allocation failures.", MC_PF | MC_VF, offsetof( stats_snap_t, pf_nombuf ), offsetof( stats_snap_t, vf_nombuf ) },
+	{ "tx_packets", "Packets transmitted.", MC_PF | MC_VF, offsetof( stats_snap_t, pf_opackets ), offsetof( stats_snap_t, vf_opackets ) },
+	{ "tx_bytes", "Bytes transmitted.", MC_PF | MC_VF, offsetof( stats_snap_t, pf_obytes ), offsetof( stats_snap_t, vf_obytes ) },
+	{ "tx_errors", "Transmit errors.", MC_PF | MC_VF, offsetof( stats_snap_t, pf_oerrors ), offsetof( stats_snap_t, vf_oerrors ) },
+	{ "spoofed", "Packets dropped by anti-spoofing.", MC_PF | MC_VF, offsetof( stats_snap_t, pf_spoofed ), offsetof( stats_snap_t, vf_spoofed ) },
+	{ NULL, NULL, 0, 0, 0 }
+};
+
+static pthread_t	met_tid;
+static volatile int	met_run = 0;
+static int			met_fd = -1;				// listening socket
+static char*		met_upath = NULL;			// unix socket path (removed at stop)
+static sriov_conf_t* met_conf = NULL;
+static int			met_max_age = STATS_MAX_AGE;
+
+static char*		dev_body = NULL;			// rendered device metrics (exporter thread only)
+static int			dev_len = 0;
+static int			dev_size = 0;
+static uint64_t		dev_gen = 0;				// snapshot generation dev_body was rendered from
+static long			nscrapes = 0;
+
+/*
+	Append to the device body, growing it as needed. Returns 0 on allocation failure.
+*/
+static int dev_cat( const char* str, int l ) {
+	char*	nbuf;
+	int		nsize;
+
+	if( dev_len + l + 1 > dev_size ) {
+		nsize = dev_size > 0 ? dev_size : 16 * 1024;
+		while( dev_len + l + 1 > nsize ) {
+			nsize *= 2;
+		}
+		if( (nbuf = (char *) realloc( dev_body, nsize )) == NULL ) {
+			bleat_printf( 0, "ERR: metrics: realloc failed" );
+			return 0;
+		}
+		dev_body = nbuf;
+		dev_size = nsize;
+	}
+
+	memcpy( dev_body + dev_len, str, l );
+	dev_len += l;
+	dev_body[dev_len] = 0;
+	return 1;
+}
+
+static void pf_labels( const stats_snap_t* snap, int i, char* buf, int blen ) {
+	uint32_t ari;
+
+	ari = snap->pf_ari[i];
+	snprintf( buf, blen, "pciid=\"%04x:%02x:%02x.%x\",port=\"%d\"",
+		snap->pf_domain[i], (ari >> 8) & 0xff, (ari >> 3) & 0x1f, ari & 0x7, snap->pf_port[i] );
+}
+
+static void vf_labels( const stats_snap_t* snap, int i, int v, char* buf, int blen ) {
+	uint32_t ari;
+
+	ari = snap->vf_ari[v];
+	snprintf( buf, blen, "pciid=\"%04x:%02x:%02x.%x\",port=\"%d\",vf=\"%d\"",
+		snap->pf_domain[i], (ari >> 8) & 0xff, (ari >> 3) & 0x1f, ari & 0x7, snap->pf_port[i], snap->vf_num[v] );
+}
+
+/*
+	Render the pf and vf metrics from the snapshot into dev_body. Families are
+	contiguous as OpenMetrics requires: every device for one family, then the next.
+*/
+static void render_devs( const stats_snap_t* snap ) {
+	const met_ctr_t* cp;
+	const uint64_t*	vals;
+	char	labels[128];
+	char	buf[512];
+	int		i;
+	int		v;
+	int		l;
+
+	dev_len = 0;
+	if( ! dev_cat( "", 0 ) ) {
+		return;
+	}
+
+	l = snprintf( buf, sizeof( buf ), "# TYPE vfd_pf_link_up gauge\n# HELP vfd_pf_link_up PF link state (1 up).\n" );
+	dev_cat( buf, l );
+	for( i = 0; i < snap->nports; i++ ) {
+		if( snap->pf_valid[i] ) {
+			pf_labels( snap, i, labels, sizeof( labels ) );
+			l = snprintf( buf, sizeof( buf ), "vfd_pf_link_up{%s} %d\n", labels, snap->pf_link[i] ? 1 : 0 );
+			dev_cat( buf, l );
+		}
+	}
+
+	l = snprintf( buf, sizeof( buf ), "# TYPE vfd_pf_link_speed_mbps gauge\n" );
+	dev_cat( buf, l );
+	for( i = 0; i < snap->nports; i++ ) {
+		if( snap->pf_valid[i] ) {
+			pf_labels( snap, i, labels, sizeof( labels ) );
+			l = snprintf( buf, sizeof( buf ), "vfd_pf_link_speed_mbps{%s} %u\n", labels, (unsigned) snap->pf_speed[i] );
+			dev_cat( buf, l );
+		}
+	}
+
+	l = snprintf( buf, sizeof( buf ), "# TYPE vfd_vf_queue_ready gauge\n# HELP vfd_vf_queue_ready VF rx queue is enabled (1) by the guest driver.\n" );
+	dev_cat( buf, l );
+	for( i = 0; i < snap->nports; i++ ) {
+		for( v = snap->vf_first[i]; v < snap->vf_first[i] + snap->vf_count[i]; v++ ) {
+			vf_labels( snap, i, v, labels, sizeof( labels ) );
+			l = snprintf( buf, sizeof( buf ), "vfd_vf_queue_ready{%s} %d\n", labels, snap->vf_up[v] ? 1 : 0 );
+			dev_cat( buf, l );
+		}
+	}
+
+	for( cp = counters; cp->name != NULL; cp++ ) {
+		if( cp->flags & MC_PF ) {
+			vals = (const uint64_t *) (((const char *) snap) + cp->pf_off);
+			l = snprintf( buf, sizeof( buf ), "# TYPE vfd_pf_%s counter\n# HELP vfd_pf_%s %s\n", cp->name, cp->name, cp->help );
+			dev_cat( buf, l );
+			for( i = 0; i < snap->nports; i++ ) {
+				if( snap->pf_valid[i] ) {
+					pf_labels( snap, i, labels, sizeof( labels ) );
+					l = snprintf( buf, sizeof( buf ), "vfd_pf_%s_total{%s} %llu\n", cp->name, labels, (unsigned long long) vals[i] );
+					dev_cat( buf, l );
+				}
+			}
+		}
+
+		if( cp->flags & MC_VF ) {
+			vals = (const uint64_t *) (((const char *) snap) + cp->vf_off);
+			l = snprintf( buf, sizeof( buf ), "# TYPE vfd_vf_%s counter\n# HELP vfd_vf_%s %s\n", cp->name, cp->name, cp->help );
+			dev_cat( buf, l );
+			for( i = 0; i < snap->nports; i++ ) {
+				for( v = snap->vf_first[i]; v < snap->vf_first[i] + snap->vf_count[i]; v++ ) {
+					vf_labels( snap, i, v, labels, sizeof( labels ) );
+					l = snprintf( buf, sizeof( buf ), "vfd_vf_%s_total{%s} %llu\n", cp->name, labels, (unsigned long long) vals[v] );
+					dev_cat( buf, l );
+				}
+			}
+		}
+	}
+
+	l = snprintf( buf, sizeof( buf ), "# TYPE vfd_pf_xstat counter\n# HELP vfd_pf_xstat Selected extended (driver) stats of the PF.\n" );
+	dev_cat( buf, l );
+	for( i = 0; i < snap->nports; i++ ) {
+		if( snap->pf_valid[i] ) {
+			for( v = 0; v < snap->pf_nxs[i]; v++ ) {
+				l = snprintf( buf, sizeof( buf ), "vfd_pf_xstat_total{port=\"%d\",name=\"%.*s\"} %llu\n",
+					snap->pf_port[i], RTE_ETH_XSTATS_NAME_SIZE, snap->pf_xs_name[i][v], (unsigned long long) snap->pf_xs_val[i][v] );
+				dev_cat( buf, l );
+			}
+		}
+	}
+
+	dev_gen = snap->gen;
+}
+
+/*
+	Bring the device metrics up to date with the snapshot and fill ibuf with the
+	internal metrics. Returns the length of ibuf.
+*/
+static int render( char* ibuf, int iblen ) {
+	const stats_snap_t* snap;
+	struct timespec ts;
+	long long	now;
+	long long	age;
+	uint64_t	gen;
+	int		l;
+
+	snap = stats_snap_get( met_conf, met_max_age );
+	if( snap->gen != dev_gen || dev_body == NULL ) {
+		render_devs( snap );
+	}
+	gen = snap->gen;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	now = ((long long) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+	age = snap->gen ? now - snap->ms : 0;
+	stats_snap_put( );
+
+	l = snprintf( ibuf, iblen,
+		"# TYPE vfd_stats_sweeps counter\nvfd_stats_sweeps_total %llu\n"
+		"# TYPE vfd_stats_age_seconds gauge\n# HELP vfd_stats_age_seconds Age of the snapshot the device metrics came from.\nvfd_stats_age_seconds %.3f\n"
+		"# TYPE vfd_metrics_scrapes counter\nvfd_metrics_scrapes_total %ld\n",
+		(unsigned long long) gen, (double) age / 1000.0, nscrapes );
+
+	if( l < iblen ) {
+		l += vfd_req_metrics( ibuf + l, iblen - l );
+	}
+	if( l < iblen - 1 ) {
+		l += refresh_metrics( ibuf + l, iblen - l );
+	}
+	if( l < iblen - 1 ) {
+		l += mbq_metrics( ibuf + l, iblen - l );
+	}
+	if( l < iblen - 1 ) {
+		l += nic_err_metrics( ibuf + l, iblen - l );
+	}
+	if( l < iblen - 1 ) {
+		l += snprintf( ibuf + l, iblen - l, "# EOF\n" );
+	}
+
+	if( l >= iblen ) {
+		l = iblen - 1;
+	}
+	return l;
+}
+
+/*
+	Write all of buf; returns 0 if the client went away or stalled.
+*/
+static int met_send( int fd, const char* buf, int len ) {
+	int	n;
+
+	while( len > 0 ) {
+		if( (n = send( fd, buf, len, MSG_NOSIGNAL )) <= 0 ) {
+			if( n < 0 && errno == EINTR ) {
+				continue;
+			}
+			return 0;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return 1;
+}
+
+/*
+	Read the request header and answer it. Anything other than GET of / or
+	/metrics gets a 404.
+*/
+static void serve( int fd, char* ibuf, int iblen ) {
+	struct pollfd	pfd;
+	struct timeval	tv;
+	char	req[MET_REQ_SIZE];
+	char	hdr[256];
+	int		rlen = 0;
+	int		n;
+	int		ilen;
+	int		hlen;
+
+	tv.tv_sec = MET_IO_MS / 1000;
+	tv.tv_usec = (MET_IO_MS % 1000) * 1000;
+	setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof( tv ) );
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while( rlen < (int) sizeof( req ) - 1 ) {
+		pfd.revents = 0;
+		if( poll( &pfd, 1, MET_IO_MS ) <= 0 ) {
+			return;
+		}
+		if( (n = recv( fd, req + rlen, sizeof( req ) - 1 - rlen, 0 )) <= 0 ) {
+			return;
+		}
+		rlen += n;
+		req[rlen] = 0;
+		if( strstr( req, "\r\n\r\n" ) != NULL || strstr( req, "\n\n" ) != NULL ) {
+			break;
+		}
+	}
+
+	if( strncmp( req, "GET / ", 6 ) != 0 && strncmp( req, "GET /metrics", 12 ) != 0 ) {
+		hlen = snprintf( hdr, sizeof( hdr ), "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 10\r\nConnection: close\r\n\r\nnot found\n" );
+		met_send( fd, hdr, hlen );
+		return;
+	}
+
+	nscrapes++;
+	ilen = render( ibuf, iblen );
+	hlen = snprintf( hdr, sizeof( hdr ), "HTTP/1.0 200 OK\r\nContent-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\nContent-Length: %d\r\nConnection: close\r\n\r\n",
+		dev_len + ilen );
+
+	if( met_send( fd, hdr, hlen ) && (dev_len == 0 || met_send( fd, dev_body, dev_len )) ) {
+		met_send( fd, ibuf, ilen );
+	}
+}
+
+/*
+	Exporter thread: accept and serve one scrape at a time until stopped.
+*/
+static void* met_listener( void* data ) {
+	struct pollfd	pfd;
+	char*	ibuf;
+	int		fd;
+
+	RTE_SET_USED( data );
+
+	if( (ibuf = (char *) malloc( MET_INT_SIZE )) == NULL ) {
+		bleat_printf( 0, "ERR: metrics: unable to allocate buffer; exporter not running" );
+		return NULL;
+	}
+
+	pfd.fd = met_fd;
+	pfd.events = POLLIN;
+	while( met_run ) {
+		pfd.revents = 0;
+		if( poll( &pfd, 1, 1000 ) <= 0 ) {					// timeout lets us notice a stop
+			continue;
+		}
+
+		if( (fd = accept( met_fd, NULL, NULL )) < 0 ) {
+			continue;
+		}
+		serve( fd, ibuf, MET_INT_SIZE );
+		close( fd );
+	}
+
+	free( ibuf );
+	return NULL;
+}
+
+/*
+	Create the listening socket from the metrics parm: a path (leading /) is a unix
+	stream socket; otherwise [host:]port where host must be a loopback address.
+	Returns the fd or -1.
+*/
+static int met_listen( const char* addr ) {
+	struct sockaddr_un	uaddr;
+	struct sockaddr_in	iaddr;
+	const char*	pstr;
+	char		host[64];
+	int			fd;
+	int			on = 1;
+
+	if( *addr == '/' ) {
+		if( strlen( addr ) >= sizeof( uaddr.sun_path ) ) {
+			bleat_printf( 0, "WRN: metrics: socket path too long: %s", addr );
+			return -1;
+		}
+		memset( &uaddr, 0, sizeof( uaddr ) );
+		uaddr.sun_family = AF_UNIX;
+		strcpy( uaddr.sun_path, addr );
+		unlink( addr );
+
+		if( (fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 )) < 0 || bind( fd, (struct sockaddr *) &uaddr, sizeof( uaddr ) ) < 0 || listen( fd, 8 ) < 0 ) {
+			bleat_printf( 0, "WRN: metrics: unable to listen on %s: %s", addr, strerror( errno ) );
+			if( fd >= 0 ) {
+				close( fd );
+			}
+			return -1;
+		}
+
+		met_upath = strdup( addr );
+		return fd;
+	}
+
+	strcpy( host, "127.0.0.1" );
+	if( (pstr = strrchr( addr, ':' )) != NULL ) {
+		snprintf( host, sizeof( host ), "%.*s", (int) (pstr - addr), addr );
+		pstr++;
+		if( strcmp( host, "localhost" ) == 0 ) {
+			strcpy( host, "127.0.0.1" );
+		}
+	} else {
+		pstr = addr;
+	}
+
+	memset( &iaddr, 0, sizeof( iaddr ) );
+	iaddr.sin_family = AF_INET;
+	iaddr.sin_port = htons( atoi( pstr ) );
+	if( atoi( pstr ) <= 0 || inet_pton( AF_INET, host, &iaddr.sin_addr ) != 1 || (ntohl( iaddr.sin_addr.s_addr ) >> 24) != 127 ) {
+		bleat_printf( 0, "WRN: metrics: listen address must be a unix socket path or a loopback [host:]port: %s", addr );
+		return -1;
+	}
+
+	if( (fd = socket( AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0 )) < 0 ) {
+		bleat_printf( 0, "WRN: metrics: unable to create socket: %s", strerror( errno ) );
+		return -1;
+	}
+	setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on ) );
+	if( bind( fd, (struct sockaddr *) &iaddr, sizeof( iaddr ) ) < 0 || listen( fd, 8 ) < 0 ) {
+		bleat_printf( 0, "WRN: metrics: unable to listen on %s: %s", addr, strerror( errno ) );
+		close( fd );
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+	Start the exporter listening on addr (the metrics parm). When sweeping is true
+	something else sweeps the NICs on a schedule and scrapes use whatever snapshot
+	is current; otherwise a scrape refreshes a snapshot older than STATS_MAX_AGE.
+	Returns 0 on success; failure is not fatal.
+*/
+extern int metrics_start( const char* addr, sriov_conf_t* conf, int sweeping ) {
+	if( met_run || addr == NULL || *addr == 0 ) {
+		return 0;
+	}
+
+	if( (met_fd = met_listen( addr )) < 0 ) {
+		return -1;
+	}
+
+	met_conf = conf;
+	met_max_age = sweeping ? -1 : STATS_MAX_AGE;
+	met_run = 1;
+	if( pthread_create( &met_tid, NULL, met_listener, NULL ) != 0 ) {
+		bleat_printf( 0, "WRN: metrics: unable to start the exporter thread: %s", strerror( errno ) );
+		met_run = 0;
+		close( met_fd );
+		met_fd = -1;
+		return -1;
+	}
+	if( rte_thread_setname( met_tid, "vfd-metrics" ) != 0 ) {
+		bleat_printf( 2, "error: failed to set thread name: %s", "vfd-metrics" );
+	}
+
+	bleat_printf( 1, "metrics exporter listening on %s", addr );
+	return 0;
+}
+
+/*
+	Stop the exporter; returns when the thread has exited.
+*/
+extern void metrics_stop( void ) {
+	if( ! met_run ) {
+		return;
+	}
+
+	met_run = 0;
+	pthread_join( met_tid, NULL );
+	close( met_fd );
+	met_fd = -1;
+	if( met_upath != NULL ) {
+		unlink( met_upath );
+		free( met_upath );
+		met_upath = NULL;
+	}
+}
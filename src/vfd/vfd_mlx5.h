@@ -27,15 +27,14 @@ int vfd_mlx5_set_vf_link_status(uint16_t port_id, uint16_t vf_id, int status);
 uint32_t vfd_mlx5_get_pf_spoof_stats(uint16_t port_id);
 int vfd_mlx5_get_num_vfs(uint16_t port_id);
 int vfd_mlx5_get_vf_stats(uint16_t port_id, uint16_t vf_id, struct rte_eth_stats *stats);
-uint64_t vfd_mlx5_get_vf_sysfs_counter(char *ifname, const char *counter,  uint16_t vf_id);
-uint64_t vfd_mlx5_get_vf_ethtool_counter(char *ifname, const char *counter);
 uint64_t vfd_mlx5_get_vf_spoof_stats(uint16_t port_id, uint16_t vf_id);
 int vfd_mlx5_pf_vf_offset(char *pciid);
-int vfd_mlx5_set_vf_vlan_filter(uint16_t port_id, uint16_t vlan_id, uint64_t vf_mask, uint8_t on);
+int vfd_mlx5_set_vf_vlan_filter(uint16_t port_id, uint16_t vlan_id, uint64_t vf_mask, uint16_t vf_base, uint8_t on);
 int vfd_mlx5_set_vf_promisc(uint16_t port_id, uint16_t vf_id, uint8_t on);
 int vfd_mlx5_set_qos_pf(uint16_t port_id, tc_class_t **tc_config, uint8_t ntcs);
 int vfd_mlx5_set_prio_trust(uint16_t port_id);
 int vfd_mlx5_set_mirror( uint16_t port_id, uint32_t vf, uint8_t target, uint8_t direction);
 int vfd_mlx5_set_vf_tcqos( uint16_t port_id, uint32_t vf, uint8_t tc, uint32_t rate );
+int vfd_mlx5_set_vf_tcqos_all( uint16_t port_id, uint32_t vf, const uint32_t* rates );
 
 #endif
@@ -4,6 +4,10 @@
 	Date:		October 2017
 	Author:		Alex Zelezniak
 
+	Mods:		16 Oct 2026 - Stats requests are answered from the stats snapshot.
+				16 Oct 2026 - VF MACs are 48 bit values; no string conversion.
+				16 Oct 2026 - Port for a VF address is found with suss_port().
+
 */
 
 #include "sriov.h"
@@ -216,9 +220,6 @@ device_message(int port, int vf, int req, int resp)
 	struct rte_eth_link link;
 	struct rte_eth_dev_info dev_info;
 	
-	uint8_t bytes[6];
-	int values[6];
-	int i;
 	struct vf_s* vfp;
 	struct ether_addr e_addr;
 
@@ -246,24 +247,55 @@ device_message(int port, int vf, int req, int resp)
 	
 	if(req == NL_VF_STATS_RQ) {
 		struct rte_eth_stats rt_stats;
+		const stats_snap_t* snap;
+		int sidx;
 		
+		memset( &rt_stats, 0, sizeof( rt_stats ) );
+		snap = stats_snap_get( running_config, STATS_MAX_AGE );		// one sweep serves every netdev asking at about the same time
 		if(vf == MAX_VFS - 1) {
-			rte_eth_stats_get(port, &rt_stats);		//PF			
-			rte_eth_link_get_nowait(port, &link);
+			if( (sidx = stats_snap_pf( snap, port )) >= 0 ) {		//PF
+				rt_stats.ipackets = snap->pf_ipackets[sidx];
+				rt_stats.opackets = snap->pf_opackets[sidx];
+				rt_stats.ibytes = snap->pf_ibytes[sidx];
+				rt_stats.obytes = snap->pf_obytes[sidx];
+				rt_stats.ierrors = snap->pf_ierrors[sidx];
+				rt_stats.oerrors = snap->pf_oerrors[sidx];
+				rt_stats.rx_nombuf = snap->pf_nombuf[sidx];
+
+				msg_rq->info->link_state = snap->pf_link[sidx];
+				msg_rq->info->link_speed = snap->pf_speed[sidx];
+				msg_rq->info->link_duplex = snap->pf_duplex[sidx];
+			} else {
+				rte_eth_stats_get(port, &rt_stats);
+				rte_eth_link_get_nowait(port, &link);
 			
-			msg_rq->info->link_state = link.link_status;
-			msg_rq->info->link_speed = link.link_speed;
-			msg_rq->info->link_duplex = link.link_duplex;
+				msg_rq->info->link_state = link.link_status;
+				msg_rq->info->link_speed = link.link_speed;
+				msg_rq->info->link_duplex = link.link_duplex;
+			}
 			
 		} else {
-			get_vf_stats(port, vf, &rt_stats);		//VF
+			if( (sidx = stats_snap_vf( snap, port, vf )) >= 0 ) {	//VF
+				rt_stats.ipackets = snap->vf_ipackets[sidx];
+				rt_stats.opackets = snap->vf_opackets[sidx];
+				rt_stats.ibytes = snap->vf_ibytes[sidx];
+				rt_stats.obytes = snap->vf_obytes[sidx];
+				rt_stats.ierrors = snap->vf_ierrors[sidx];
+				rt_stats.oerrors = snap->vf_oerrors[sidx];
+				rt_stats.rx_nombuf = snap->vf_nombuf[sidx];
+
+				msg_rq->info->link_state = snap->vf_up[sidx];
+			} else {
+				get_vf_stats(port, vf, &rt_stats);
 			
-			int mcounter = 0;
-			if(is_rx_queue_on(port, vf, &mcounter ))
-				msg_rq->info->link_state = 1;
-			else
-				msg_rq->info->link_state = 0;
+				int mcounter = 0;
+				if(is_rx_queue_on(port, vf, &mcounter ))
+					msg_rq->info->link_state = 1;
+				else
+					msg_rq->info->link_state = 0;
+			}
 		}
+		stats_snap_put( );
 		
 		
 		msg_rq->info->stats->rx_packets	= rt_stats.ipackets;
@@ -283,17 +315,11 @@ device_message(int port, int vf, int req, int resp)
 			// VF
 			vfp = suss_vf( port, vf );
 				
-			len = sscanf( vfp->macs[0], "%x:%x:%x:%x:%x:%x",
-				&values[0], &values[1], &values[2], &values[3], &values[4], &values[5]);
-					
-			if (len == 6) {
-				// convert to uint8_t 
-				for( i = 0; i < 6; ++i )
-					bytes[i] = (uint8_t) values[i];	
-				
-				memcpy(msg_rq->info->mac,  bytes, 6);				
+			if( vfp != NULL && vfp->macs[0] != 0 ) {
+				mac_to_ea( vfp->macs[0], &e_addr );
+				memcpy(msg_rq->info->mac, (char *) &e_addr, 6);
 			} else {
-				bleat_printf( 3, "nl: incorrect MAC: %s\n", vfp->macs[0]);
+				bleat_printf( 3, "nl: no MAC for vf %d", vf );
 				memset(msg_rq->info->mac,  0, 6);	
 			}
 		} else {
@@ -318,8 +344,8 @@ device_message(int port, int vf, int req, int resp)
 			
 			// VF
 			uint32_t pf_ari = dev_info.pci_dev->addr.bus << 8 | dev_info.pci_dev->addr.devid << 3 | dev_info.pci_dev->addr.function;
-			struct sriov_port_s *p = &running_config->ports[port];	
-			uint32_t new_ari = pf_ari + p->vf_offset + (vf * p->vf_stride);
+			struct sriov_port_s *p = suss_port( port );
+			uint32_t new_ari = p != NULL ? pf_ari + p->vf_offset + (vf * p->vf_stride) : pf_ari;
 			
 			int domain = 0;
 			int bus = (new_ari >> 8) & 0xff;
@@ -431,30 +457,15 @@ int
 get_vf_stats(int port_id, int vf, struct rte_eth_stats *stats)
 {
 	int result = -1;
-	uint dev_type = get_nic_type(port_id);
-	
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			result = vfd_ixgbe_get_vf_stats(port_id, vf, stats);
-			stats->oerrors = 0;
-			break;
-			
-		case VFD_FVL25:		
-			result = vfd_i40e_get_vf_stats(port_id, vf, stats);
-			break;
+	const struct vfd_nic_ops* ops;
 
-		case VFD_BNXT:
-			result = vfd_bnxt_get_vf_stats(port_id, vf, stats);
-			break;
-			
-		case VFD_MLX5:
-			result = vfd_mlx5_get_vf_stats(port_id, vf, stats);
-			break;
+	ops = get_nic_ops( port_id );
+	if( ops->get_vf_stats != NULL ) {
+		result = ops->get_vf_stats(port_id, vf, stats);
+	} else {
+		bleat_printf( 2, "get_vf_stats: unsupported device type: %u, port: %u", ops->type, port_id );
+	}
 
-		default:
-			bleat_printf( 2, "get_vf_stats: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
-	}	
 	return result;
 }
 
@@ -0,0 +1,458 @@
+// vi: sw=4 ts=4 noet:
+/*
+	Mnemonic:	vfd_rates.c
+	Abstract:	Per PF/VF rate history. A sampler thread records the rx/tx packet and
+				byte counters, errors and spoofed packets of every PF and configured
+				VF from the stats snapshot (vfd_stats.c) into two rings per device:
+				one sample a second for the last five minutes, and one a minute for
+				the last day. Current, average and peak rates are computed from the
+				rings when asked (show rates).
+
+				The sampler asks for a snapshot no older than its period, so when
+				something else (show, netlink, an exporter) has just swept the NICs
+				that sweep is used rather than making another.
+
+				Counters which go backwards (VF reset, PF stats reset) are treated as
+				having restarted from zero.
+
+				Ring space is allocated the first time a device is seen and is kept
+				(a deleted VF may come back); devices not in the latest snapshot are
+				not shown.
+
+	Date:		16 Oct 2026
+*/
+
+#include <pthread.h>
+#include <ctype.h>
+
+#include "sriov.h"
+
+#define RATE_FINE_MS	1000				// fine ring period (ms) and size (5 minutes)
+#define RATE_FINE_N		300
+#define RATE_COARSE_MS	60000				// coarse ring period and size (24 hours)
+#define RATE_COARSE_N	1440
+
+#define RS_RXP		0						// sample fields
+#define RS_RXB		1
+#define RS_TXP		2
+#define RS_TXB		3
+#define RS_ERR		4						// rx + tx errors
+#define RS_SPOOF	5
+#define RS_NFIELDS	6
+
+#define PF_SLOT		MAX_VFS					// device slot used for the PF itself
+
+typedef struct {
+	long long	ms;							// snapshot time
+	uint64_t	v[RS_NFIELDS];
+} rsample_t;
+
+typedef struct {
+	int			port;						// rte port number
+	int			vf;							// -1 for the pf
+	uint64_t	gen;						// snapshot generation last recorded
+	rsample_t	fine[RATE_FINE_N];
+	int			fhead;						// next insert
+	int			fcount;
+	rsample_t	coarse[RATE_COARSE_N];
+	int			chead;
+	int			ccount;
+} rate_dev_t;
+
+typedef struct {							// computed rates for one device
+	double	rxpps;							// over the last fine period
+	double	rxbps;
+	double	txpps;
+	double	txbps;
+	double	errps;
+	double	spoofps;
+	double	rxbps_1m;						// averages
+	double	txbps_1m;
+	double	rxbps_1h;
+	double	txbps_1h;
+	double	peak_rxpps;						// peak single period rates over the fine ring
+	double	peak_rxbps;
+	double	peak_txpps;
+	double	peak_txbps;
+	double	peak_rxbps_60s;					// peak one minute averages over the coarse ring
+	double	peak_txbps_60s;
+} rate_view_t;
+
+static rate_dev_t*	devs[MAX_PORTS][MAX_VFS+1];		// indexed by rte port and vf number (PF_SLOT for the pf)
+static pthread_mutex_t rates_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t	last_gen = 0;				// snapshot generation of the most recent record
+static volatile int	sampler_run = 0;
+static pthread_t	sampler_tid;
+
+// ---------------------------------------------------------------------------------------------------
+
+/*
+	Return sample k back (0 is the newest) from a ring.
+*/
+static inline rsample_t* ring_ent( rsample_t* ring, int n, int head, int k ) {
+	return &ring[(head - 1 - k + (n * 2)) % n];
+}
+
+/*
+	Counter change; a counter that went backwards restarted from 0.
+*/
+static inline uint64_t cdelta( uint64_t old, uint64_t new ) {
+	return new >= old ? new - old : new;
+}
+
+/*
+	Average per second rate of field f over the last nback periods of the ring.
+*/
+static double ring_rate( rsample_t* ring, int n, int head, int count, int nback, int f ) {
+	uint64_t	sum = 0;
+	long long	dt;
+	int			k;
+
+	if( nback > count - 1 ) {
+		nback = count - 1;
+	}
+	if( nback <= 0 ) {
+		return 0.0;
+	}
+
+	for( k = 0; k < nback; k++ ) {
+		sum += cdelta( ring_ent( ring, n, head, k+1 )->v[f], ring_ent( ring, n, head, k )->v[f] );
+	}
+
+	if( (dt = ring_ent( ring, n, head, 0 )->ms - ring_ent( ring, n, head, nback )->ms) <= 0 ) {
+		return 0.0;
+	}
+	return (double) sum * 1000.0 / (double) dt;
+}
+
+/*
+	Largest single period per second rate of field f in the ring.
+*/
+static double ring_peak( rsample_t* ring, int n, int head, int count, int f ) {
+	rsample_t*	a;
+	rsample_t*	b;
+	double		r;
+	double		peak = 0.0;
+	int			k;
+
+	for( k = 0; k < count - 1; k++ ) {
+		b = ring_ent( ring, n, head, k );
+		a = ring_ent( ring, n, head, k+1 );
+		if( b->ms > a->ms ) {
+			r = (double) cdelta( a->v[f], b->v[f] ) * 1000.0 / (double) (b->ms - a->ms);
+			if( r > peak ) {
+				peak = r;
+			}
+		}
+	}
+
+	return peak;
+}
+
+/*
+	Compute the rate view for a device. Caller must hold the lock.
+*/
+static void dev_view( rate_dev_t* dp, rate_view_t* rv ) {
+	memset( rv, 0, sizeof( *rv ) );
+
+	rv->rxpps = ring_rate( dp->fine, RATE_FINE_N, dp->fhead, dp->fcount, 1, RS_RXP );
+	rv->rxbps = ring_rate( dp->fine, RATE_FINE_N, dp->fhead, dp->fcount, 1, RS_RXB ) * 8.0;
+	rv->txpps = ring_rate( dp->fine, RATE_FINE_N, dp->fhead, dp->fcount, 1, RS_TXP );
+	rv->txbps = ring_rate( dp->fine, RATE_FINE_N, dp->fhead, dp->fcount, 1, RS_TXB ) * 8.0;
+	rv->errps = ring_rate( dp->fine, RATE_FINE_N, dp->fhead, dp->fcount, 1, RS_ERR );
+	rv->spoofps = ring_rate( dp->fine, RATE_FINE_N, dp->fhead, dp->fcount, 1, RS_SPOOF );
+
+	rv->rxbps_1m = ring_rate( dp->fine, RATE_FINE_N, dp->fhead, dp->fcount, 60, RS_RXB ) * 8.0;
+	rv->txbps_1m = ring_rate( dp->fine, RATE_FINE_N, dp->fhead, dp->fcount, 60, RS_TXB ) * 8.0;
+	rv->rxbps_1h = ring_rate( dp->coarse, RATE_COARSE_N, dp->chead, dp->ccount, 60, RS_RXB ) * 8.0;
+	rv->txbps_1h = ring_rate( dp->coarse, RATE_COARSE_N, dp->chead, dp->ccount, 60, RS_TXB ) * 8.0;
+
+	rv->peak_rxpps = ring_peak( dp->fine, RATE_FINE_N, dp->fhead, dp->fcount, RS_RXP );
+	rv->peak_rxbps = ring_peak( dp->fine, RATE_FINE_N, dp->fhead, dp->fcount, RS_RXB ) * 8.0;
+	rv->peak_txpps = ring_peak( dp->fine, RATE_FINE_N, dp->fhead, dp->fcount, RS_TXP );
+	rv->peak_txbps = ring_peak( dp->fine, RATE_FINE_N, dp->fhead, dp->fcount, RS_TXB ) * 8.0;
+	rv->peak_rxbps_60s = ring_peak( dp->coarse, RATE_COARSE_N, dp->chead, dp->ccount, RS_RXB ) * 8.0;
+	rv->peak_txbps_60s = ring_peak( dp->coarse, RATE_COARSE_N, dp->chead, dp->ccount, RS_TXB ) * 8.0;
+}
+
+/*
+	Return the device block, allocating it on first use. Caller must hold the lock.
+*/
+static rate_dev_t* get_dev( int port, int vf ) {
+	rate_dev_t*	dp;
+	int			slot;
+
+	slot = vf < 0 ? PF_SLOT : vf;
+	if( port < 0 || port >= MAX_PORTS || slot >= MAX_VFS + 1 ) {
+		return NULL;
+	}
+
+	if( (dp = devs[port][slot]) == NULL ) {
+		if( (dp = (rate_dev_t *) malloc( sizeof( *dp ) )) == NULL ) {
+			bleat_printf( 0, "WRN: rates: unable to allocate history for pf/vf %d/%d", port, vf );
+			return NULL;
+		}
+		memset( dp, 0, sizeof( *dp ) );
+		dp->port = port;
+		dp->vf = vf;
+		devs[port][slot] = dp;
+	}
+
+	return dp;
+}
+
+/*
+	Add a sample to the device's fine ring, and to the coarse ring when a coarse
+	period has passed since the last one.
+*/
+static void add_sample( rate_dev_t* dp, uint64_t gen, long long ms, uint64_t rxp, uint64_t rxb, uint64_t txp, uint64_t txb, uint64_t err, uint64_t spoof ) {
+	rsample_t*	sp;
+
+	sp = &dp->fine[dp->fhead];
+	sp->ms = ms;
+	sp->v[RS_RXP] = rxp;
+	sp->v[RS_RXB] = rxb;
+	sp->v[RS_TXP] = txp;
+	sp->v[RS_TXB] = txb;
+	sp->v[RS_ERR] = err;
+	sp->v[RS_SPOOF] = spoof;
+	dp->fhead = (dp->fhead + 1) % RATE_FINE_N;
+	if( dp->fcount < RATE_FINE_N ) {
+		dp->fcount++;
+	}
+
+	if( dp->ccount == 0 || ms - ring_ent( dp->coarse, RATE_COARSE_N, dp->chead, 0 )->ms >= RATE_COARSE_MS ) {
+		dp->coarse[dp->chead] = *sp;
+		dp->chead = (dp->chead + 1) % RATE_COARSE_N;
+		if( dp->ccount < RATE_COARSE_N ) {
+			dp->ccount++;
+		}
+	}
+
+	dp->gen = gen;
+}
+
+/*
+	Record every device in the snapshot.
+*/
+static void rates_record( const stats_snap_t* snap ) {
+	rate_dev_t*	dp;
+	int		i;
+	int		j;
+
+	pthread_mutex_lock( &rates_lock );
+	for( i = 0; i < snap->nports; i++ ) {
+		if( ! snap->pf_valid[i] ) {
+			continue;
+		}
+
+		if( (dp = get_dev( snap->pf_port[i], -1 )) != NULL ) {
+			add_sample( dp, snap->gen, snap->ms, snap->pf_ipackets[i], snap->pf_ibytes[i], snap->pf_opackets[i], snap->pf_obytes[i],
+				snap->pf_ierrors[i] + snap->pf_oerrors[i], snap->pf_spoofed[i] );
+		}
+
+		for( j = snap->vf_first[i]; j < snap->vf_first[i] + snap->vf_count[i]; j++ ) {
+			if( (dp = get_dev( snap->pf_port[i], snap->vf_num[j] )) != NULL ) {
+				add_sample( dp, snap->gen, snap->ms, snap->vf_ipackets[j], snap->vf_ibytes[j], snap->vf_opackets[j], snap->vf_obytes[j],
+					snap->vf_ierrors[j] + snap->vf_oerrors[j], snap->vf_spoofed[j] );
+			}
+		}
+	}
+	last_gen = snap->gen;
+	pthread_mutex_unlock( &rates_lock );
+}
+
+/*
+	Sampler thread. Takes a (possibly shared) snapshot once per fine period and
+	records it.
+*/
+static void* rate_sampler( void* data ) {
+	sriov_conf_t*	conf;
+	const stats_snap_t* snap;
+
+	conf = (sriov_conf_t *) data;
+	while( sampler_run ) {
+		stats_collect( conf, RATE_FINE_MS - (RATE_FINE_MS / 10) );		// reuse a sweep that another consumer just made
+		snap = stats_snap_get( conf, -1 );
+		if( snap->gen != last_gen ) {
+			rates_record( snap );
+		}
+		stats_snap_put( );
+
+		usleep( RATE_FINE_MS * 1000 );
+	}
+
+	return NULL;
+}
+
+/*
+	Start the sampler. Returns 0 on success; failure is not fatal (show rates
+	reports nothing).
+*/
+extern int rates_start( sriov_conf_t* conf ) {
+	if( sampler_run ) {
+		return 0;
+	}
+
+	sampler_run = 1;
+	if( pthread_create( &sampler_tid, NULL, rate_sampler, conf ) != 0 ) {
+		bleat_printf( 0, "WRN: rates: unable to start the sampler thread: %s", strerror( errno ) );
+		sampler_run = 0;
+		return -1;
+	}
+	if( rte_thread_setname( sampler_tid, "vfd-rates" ) != 0 ) {
+		bleat_printf( 2, "error: failed to set thread name: %s", "vfd-rates" );
+	}
+
+	bleat_printf( 1, "rate sampler started: %ds x %d and %ds x %d", RATE_FINE_MS / 1000, RATE_FINE_N, RATE_COARSE_MS / 1000, RATE_COARSE_N );
+	return 0;
+}
+
+/*
+	Stop the sampler; returns when the thread has exited (at most one period).
+*/
+extern void rates_stop( void ) {
+	if( ! sampler_run ) {
+		return;
+	}
+
+	sampler_run = 0;
+	pthread_join( sampler_tid, NULL );
+}
+
+/*
+	Parse a show rates target: pfN or pfN:vfM (pf is the port number shown by show).
+	Sets *port and *vf to -1 when not given. Returns 0 if the target isn't recognised.
+*/
+static int parse_target( const char* target, int* port, int* vf ) {
+	char*	tok;
+
+	*port = -1;
+	*vf = -1;
+	if( target == NULL || *target == 0 ) {
+		return 1;
+	}
+
+	if( strncmp( target, "pf", 2 ) != 0 || ! isdigit( *(target+2) ) ) {
+		return 0;
+	}
+	*port = atoi( target + 2 );
+
+	if( (tok = strchr( target, ':' )) != NULL ) {
+		if( strncmp( tok + 1, "vf", 2 ) != 0 || ! isdigit( *(tok+3) ) ) {
+			return 0;
+		}
+		*vf = atoi( tok + 3 );
+	}
+
+	return 1;
+}
+
+/*
+	Add the formatted device to the buffer; returns the new length or -1 if it
+	did not fit.
+*/
+static int fmt_dev( rate_dev_t* dp, int json, int first, char* buf, int blen, int l ) {
+	rate_view_t	rv;
+	int			n;
+
+	dev_view( dp, &rv );
+	if( json ) {
+		n = snprintf( buf + l, blen - l, "%s{ \"pf\": %d, \"vf\": %d, \"rx_pps\": %.0f, \"rx_bps\": %.0f, \"tx_pps\": %.0f, \"tx_bps\": %.0f, "
+			"\"err_ps\": %.0f, \"spoof_ps\": %.0f, \"rx_bps_1m\": %.0f, \"tx_bps_1m\": %.0f, \"rx_bps_1h\": %.0f, \"tx_bps_1h\": %.0f, "
+			"\"peak_rx_pps\": %.0f, \"peak_rx_bps\": %.0f, \"peak_tx_pps\": %.0f, \"peak_tx_bps\": %.0f, "
+			"\"peak_rx_bps_60s\": %.0f, \"peak_tx_bps_60s\": %.0f }\n",
+			first ? "" : ",", dp->port, dp->vf,
+			rv.rxpps, rv.rxbps, rv.txpps, rv.txbps, rv.errps, rv.spoofps,
+			rv.rxbps_1m, rv.txbps_1m, rv.rxbps_1h, rv.txbps_1h,
+			rv.peak_rxpps, rv.peak_rxbps, rv.peak_txpps, rv.peak_txbps, rv.peak_rxbps_60s, rv.peak_txbps_60s );
+	} else {
+		n = snprintf( buf + l, blen - l, "%2s %4d %4d %12.0f %14.0f %12.0f %14.0f %8.0f %8.0f %14.0f %14.0f %14.0f %14.0f %12.0f %14.0f %12.0f %14.0f\n",
+			dp->vf < 0 ? "pf" : "vf", dp->port, dp->vf < 0 ? 0 : dp->vf,
+			rv.rxpps, rv.rxbps, rv.txpps, rv.txbps, rv.errps, rv.spoofps,
+			rv.rxbps_1m, rv.txbps_1m, rv.rxbps_1h, rv.txbps_1h,
+			rv.peak_rxpps, rv.peak_rxbps, rv.peak_txpps, rv.peak_txbps );
+	}
+
+	if( n >= blen - l - 4 ) {									// leave room to close a json array
+		return -1;
+	}
+	return l + n;
+}
+
+/*
+	Generate the rates for show. Target is nil/empty for all, pfN or pfN:vfM; if json
+	is set a json array is generated rather than a table. Returns a buffer the caller
+	must free, or nil with *err set to a static message.
+*/
+extern char* gen_rates( const char* target, int json, const char** err ) {
+	rate_dev_t*	dp;
+	char*	buf;
+	char*	nbuf;
+	int		blen;
+	int		l = 0;
+	int		nl;
+	int		port;
+	int		vf;
+	int		p;
+	int		v;
+	int		first = 1;
+
+	*err = NULL;
+	if( ! parse_target( target, &port, &vf ) ) {
+		*err = "unrecognised target; expected pfN or pfN:vfM";
+		return NULL;
+	}
+
+	if( ! sampler_run && last_gen == 0 ) {
+		*err = "rate sampler is not running";
+		return NULL;
+	}
+
+	blen = 16 * 1024;
+	if( (buf = (char *) malloc( sizeof( char ) * blen )) == NULL ) {
+		*err = "memory allocation error";
+		return NULL;
+	}
+
+	if( json ) {
+		l = snprintf( buf, blen, "[\n" );
+	} else {
+		l = snprintf( buf, blen, "\n%2s %4s %4s %12s %14s %12s %14s %8s %8s %14s %14s %14s %14s %12s %14s %12s %14s\n",
+			"", "PF", "VF", "RX pps", "RX bps", "TX pps", "TX bps", "Err/s", "Spoof/s",
+			"RX bps 1m", "TX bps 1m", "RX bps 1h", "TX bps 1h", "Peak RX pps", "Peak RX bps", "Peak TX pps", "Peak TX bps" );
+	}
+
+	pthread_mutex_lock( &rates_lock );
+	for( p = 0; p < MAX_PORTS; p++ ) {
+		if( port >= 0 && p != port ) {
+			continue;
+		}
+
+		for( v = -1; v < MAX_VFS; v++ ) {						// pf first, then its VFs in order
+			if( (vf >= 0 && v != vf) || (dp = devs[p][v < 0 ? PF_SLOT : v]) == NULL || dp->gen != last_gen ) {
+				continue;										// not selected, never seen or not in the latest snapshot
+			}
+
+			while( (nl = fmt_dev( dp, json, first, buf, blen, l )) < 0 ) {
+				blen *= 2;
+				if( (nbuf = (char *) realloc( buf, sizeof( char ) * blen )) == NULL ) {
+					pthread_mutex_unlock( &rates_lock );
+					free( buf );
+					*err = "memory allocation error";
+					return NULL;
+				}
+				buf = nbuf;
+			}
+			l = nl;
+			first = 0;
+		}
+	}
+	pthread_mutex_unlock( &rates_lock );
+
+	if( json ) {
+		snprintf( buf + l, blen - l, "]" );						// room is left by fmt_dev's test
+	}
+
+	return buf;
+}
@@ -0,0 +1,381 @@
+// vi: sw=4 ts=4 noet:
+/*
+	Mnemonic:	vfd_reg.c
+	Abstract:	Register I/O for the NICs which we poke directly (niantic). The BAR (mem
+				resource 0) address of each port is looked up once and cached rather than
+				running rte_eth_dev_info_get() on every access.
+
+				Registers that VFd owns (qos/dcb arbiter, credit and mapping registers) can
+				be accessed through a shadow. A shadowed read returns the last value we
+				wrote (or read) without going to the NIC; MMIO reads are uncached and slow.
+				A shadowed write is skipped when the value has not changed.  Writes can
+				also be batched (reg_batch()) and are pushed to the NIC in the order they
+				were first changed when reg_flush() is called.
+
+				Registers which the hardware, the VF driver or DPDK may change under us
+				(stats, queue enable, split receive control, the queue drop enable command
+				register, etc.) must be accessed with reg_read() and reg_write() which
+				always touch the NIC.
+
+				Indirect registers (a selector register is written and then the data
+				register) are shadowed by selector value using the _sel functions; the
+				selector is rewritten with the data.
+
+				CAUTION: the shadow functions are not thread safe; the caller must hold the
+				update lock or be running during initialisation.
+
+	Date:		16 Oct 2026
+*/
+
+#include "sriov.h"
+
+#define REG_SLOTS		1024				// shadow slots per port (power of 2)
+#define REG_MAX_PEND	512					// max writes held in a batch before we flush
+#define REG_USED		(1ULL << 63)		// marks a slot key in use (offset 0 is a valid register)
+#define REG_NO_SEL		0xffffffff			// selector offset for a direct register
+
+typedef struct {
+	uint64_t	key;						// REG_USED | (selector value << 32) | offset
+	uint32_t	sel_off;					// selector register offset, REG_NO_SEL if direct
+	uint32_t	val;						// value we believe is in the register
+	int			pending;					// true if on the pending list (not yet written)
+} reg_slot_t;
+
+typedef struct {
+	volatile uint8_t* bar;					// cached mem_resource[0] address; nil if not yet looked up
+	int			nobar;						// lookup failed; don't keep trying
+	reg_slot_t*	slots;						// shadow, allocated on first use
+	int			nslots;						// slots in use
+	int			batching;					// writes are being held
+	int			npend;
+	int			pend[REG_MAX_PEND];			// slot indexes waiting to be written, in first change order
+
+	uint64_t	nreads;						// reads which went to the nic
+	uint64_t	nwrites;					// writes which went to the nic
+	uint64_t	nhits;						// shadowed reads satisfied without touching the nic
+	uint64_t	nskipped;					// shadowed writes skipped as the value didn't change
+} reg_port_t;
+
+static reg_port_t reg_ports[MAX_PORTS];
+
+/*
+	Return the cached bar for the port; look it up if we haven't yet. Returns nil if
+	the port is out of range or the device has no mapped resource.
+*/
+static inline volatile uint8_t* get_bar( portid_t port ) {
+	reg_port_t* rp;
+	struct rte_eth_dev_info dev_info;
+
+	if( port >= MAX_PORTS ) {
+		return NULL;
+	}
+
+	rp = &reg_ports[port];
+	if( rp->bar != NULL || rp->nobar ) {
+		return rp->bar;
+	}
+
+	memset( &dev_info, 0, sizeof( dev_info ) );
+	rte_eth_dev_info_get( port, &dev_info );
+	if( dev_info.pci_dev == NULL || dev_info.pci_dev->mem_resource[0].addr == NULL ) {
+		bleat_printf( 0, "WRN: reg: no bar address for port %d; register access disabled", (int) port );
+		rp->nobar = 1;
+		return NULL;
+	}
+
+	rp->bar = (volatile uint8_t *) dev_info.pci_dev->mem_resource[0].addr;
+	bleat_printf( 2, "reg: port %d bar cached: %p", (int) port, rp->bar );
+	return rp->bar;
+}
+
+static inline uint32_t bar_read( volatile uint8_t* bar, uint32_t off ) {
+	return rte_le_to_cpu_32( *((volatile uint32_t *) (bar + off)) );
+}
+
+static inline void bar_write( volatile uint8_t* bar, uint32_t off, uint32_t val ) {
+	*((volatile uint32_t *) (bar + off)) = rte_cpu_to_le_32( val );
+}
+
+/*
+	Find the shadow slot for the key; allocates the shadow on first call. Returns the
+	slot index or -1 if the shadow is full (or can't be allocated). If create is
+	set and the key isn't found, a slot is claimed and *new is set to true.
+*/
+static int find_slot( reg_port_t* rp, uint64_t key, int create, int* new ) {
+	uint32_t	h;
+	int			i;
+
+	*new = 0;
+	if( rp->slots == NULL ) {
+		if( ! create ) {
+			return -1;
+		}
+		if( (rp->slots = (reg_slot_t *) malloc( sizeof( *rp->slots ) * REG_SLOTS )) == NULL ) {
+			return -1;
+		}
+		memset( rp->slots, 0, sizeof( *rp->slots ) * REG_SLOTS );
+	}
+
+	h = (uint32_t) ((key ^ (key >> 29)) * 2654435761U);			// offsets are multiples of 4 so mix before masking
+	for( i = 0; i < REG_SLOTS; i++ ) {
+		h &= (REG_SLOTS - 1);
+		if( rp->slots[h].key == key ) {
+			return (int) h;
+		}
+
+		if( rp->slots[h].key == 0 ) {
+			if( ! create || rp->nslots >= REG_SLOTS - (REG_SLOTS/4) ) {		// keep it from filling; past this we go direct
+				return -1;
+			}
+
+			rp->slots[h].key = key;
+			rp->nslots++;
+			*new = 1;
+			return (int) h;
+		}
+
+		h++;
+	}
+
+	return -1;
+}
+
+/*
+	Push one slot to the nic, selector first if it's an indirect register.
+*/
+static void write_slot( reg_port_t* rp, reg_slot_t* s ) {
+	if( s->sel_off != REG_NO_SEL ) {
+		bar_write( rp->bar, s->sel_off, (uint32_t) ((s->key >> 32) & 0x7fffffff) );
+		rp->nwrites++;
+	}
+	bar_write( rp->bar, (uint32_t) (s->key & 0xffffffff), s->val );
+	rp->nwrites++;
+}
+
+/*
+	Write all held slots in the order they were first changed. Batching state is
+	not changed.
+*/
+static int flush_pend( reg_port_t* rp ) {
+	reg_slot_t*	s;
+	int			i;
+	int			n;
+
+	n = rp->npend;
+	for( i = 0; i < rp->npend; i++ ) {
+		s = &rp->slots[rp->pend[i]];
+		s->pending = 0;
+		write_slot( rp, s );
+	}
+	rp->npend = 0;
+
+	return n;
+}
+
+/*
+	Common shadowed read-modify-write.  The new value is (current & mask) | val and
+	the current value is returned (handy for the log messages the callers like to
+	generate).  If the register isn't in the shadow it is read from the nic (selector
+	written first for an indirect register).
+*/
+static uint32_t shadow_rmw( portid_t port, uint32_t sel_off, uint32_t sel, uint32_t off, uint32_t mask, uint32_t val ) {
+	reg_port_t*	rp;
+	reg_slot_t*	s;
+	uint64_t	key;
+	uint32_t	cval;
+	uint32_t	nval;
+	int			idx;
+	int			new;
+
+	if( get_bar( port ) == NULL ) {
+		return 0;
+	}
+	rp = &reg_ports[port];
+
+	key = REG_USED | ((uint64_t) (sel & 0x7fffffff) << 32) | off;
+	if( (idx = find_slot( rp, key, 1, &new )) < 0 ) {			// no shadow room; go direct
+		flush_pend( rp );										// keep order with anything held
+		if( sel_off != REG_NO_SEL ) {
+			bar_write( rp->bar, sel_off, sel );
+			rp->nwrites++;
+		}
+		cval = bar_read( rp->bar, off );
+		rp->nreads++;
+		bar_write( rp->bar, off, (cval & mask) | val );
+		rp->nwrites++;
+		return cval;
+	}
+
+	s = &rp->slots[idx];
+	if( new ) {
+		s->sel_off = sel_off;
+		s->pending = 0;
+		if( sel_off != REG_NO_SEL ) {
+			flush_pend( rp );									// held indirect writes must go before we move the selector
+			bar_write( rp->bar, sel_off, sel );
+			rp->nwrites++;
+		}
+		s->val = bar_read( rp->bar, off );
+		rp->nreads++;
+	} else {
+		rp->nhits++;
+	}
+
+	cval = s->val;
+	nval = (cval & mask) | val;
+	if( nval == cval ) {
+		if( mask != 0xffffffff || val != 0 ) {					// not just a read
+			rp->nskipped++;
+		}
+		return cval;
+	}
+
+	s->val = nval;
+	if( rp->batching ) {
+		if( ! s->pending ) {
+			if( rp->npend >= REG_MAX_PEND ) {
+				flush_pend( rp );
+			}
+			s->pending = 1;
+			rp->pend[rp->npend++] = idx;
+		}
+	} else {
+		write_slot( rp, s );
+	}
+
+	return cval;
+}
+
+// -------------------------------------------------------------------------------------------
+
+/*
+	Read a register directly from the nic.
+*/
+extern uint32_t reg_read( portid_t port, uint32_t off ) {
+	volatile uint8_t* bar;
+
+	if( (bar = get_bar( port )) == NULL ) {
+		return 0;
+	}
+
+	reg_ports[port].nreads++;
+	return bar_read( bar, off );
+}
+
+/*
+	Write a register directly to the nic. If the register is in the shadow the
+	shadow is updated so that it doesn't go stale.
+*/
+extern void reg_write( portid_t port, uint32_t off, uint32_t val ) {
+	volatile uint8_t* bar;
+	reg_port_t*	rp;
+	int			idx;
+	int			new;
+
+	if( (bar = get_bar( port )) == NULL ) {
+		return;
+	}
+
+	rp = &reg_ports[port];
+	if( (idx = find_slot( rp, REG_USED | off, 0, &new )) >= 0 && ! rp->slots[idx].pending ) {
+		rp->slots[idx].val = val;
+	}
+
+	rp->nwrites++;
+	bar_write( bar, off, val );
+}
+
+/*
+	Return the value of a register we own, from the shadow if we have it.
+*/
+extern uint32_t reg_sread( portid_t port, uint32_t off ) {
+	return shadow_rmw( port, REG_NO_SEL, 0, off, 0xffffffff, 0 );
+}
+
+/*
+	Set a register we own to val. Nothing is written if the value is unchanged.
+*/
+extern void reg_swrite( portid_t port, uint32_t off, uint32_t val ) {
+	shadow_rmw( port, REG_NO_SEL, 0, off, 0, val );
+}
+
+/*
+	Read-modify-write a register we own: (current & mask) | val. Returns the value
+	before the change. Nothing is written if the value is unchanged.
+*/
+extern uint32_t reg_rmw( portid_t port, uint32_t off, uint32_t mask, uint32_t val ) {
+	return shadow_rmw( port, REG_NO_SEL, 0, off, mask, val );
+}
+
+/*
+	Read-modify-write an indirect register which is selected by writing sel to the
+	selector register at sel_off. Shadowed by selector value.
+*/
+extern uint32_t reg_rmw_sel( portid_t port, uint32_t sel_off, uint32_t sel, uint32_t off, uint32_t mask, uint32_t val ) {
+	return shadow_rmw( port, sel_off, sel, off, mask, val );
+}
+
+/*
+	Start holding shadowed writes for the port until reg_flush() is called.
+*/
+extern void reg_batch( portid_t port ) {
+	if( port < MAX_PORTS ) {
+		reg_ports[port].batching = 1;
+	}
+}
+
+/*
+	Write everything being held for the port and stop batching. Returns the number
+	of registers written.
+*/
+extern int reg_flush( portid_t port ) {
+	if( port >= MAX_PORTS ) {
+		return 0;
+	}
+
+	reg_ports[port].batching = 0;
+	return flush_pend( &reg_ports[port] );
+}
+
+/*
+	Drop the shadow and the cached bar for the port. Must be called after anything
+	(e.g. a dpdk port start/configure) which might rewrite registers that we shadow.
+	Anything held in a batch is written first.
+*/
+extern void reg_invalidate( portid_t port ) {
+	reg_port_t*	rp;
+
+	if( port >= MAX_PORTS ) {
+		return;
+	}
+
+	reg_flush( port );
+	rp = &reg_ports[port];
+	if( rp->slots != NULL ) {
+		memset( rp->slots, 0, sizeof( *rp->slots ) * REG_SLOTS );
+	}
+	rp->nslots = 0;
+	rp->bar = NULL;
+	rp->nobar = 0;
+}
+
+/*
+	Format the register access counters for the port into buf. Returns the number
+	of characters added, 0 if the port has had no register access.
+*/
+extern int reg_stats( portid_t port, char* buf, int blen ) {
+	reg_port_t*	rp;
+
+	if( port >= MAX_PORTS || buf == NULL || blen <= 0 ) {
+		return 0;
+	}
+
+	rp = &reg_ports[port];
+	if( rp->nreads + rp->nwrites + rp->nhits == 0 ) {
+		return 0;
+	}
+
+	return snprintf( buf, blen, "pf %d registers: %llu reads  %llu writes  %llu shadow hits  %llu writes skipped\n",
+		(int) port, (unsigned long long) rp->nreads, (unsigned long long) rp->nwrites,
+		(unsigned long long) rp->nhits, (unsigned long long) rp->nskipped );
+}
@@ -26,6 +26,28 @@
 				17 Apr 2018 : Correct bug related to issue 291.
 				18 Apr 2018 : Correct placment for first_mac initialisation.
 				24 Apr 2018 : Correct double free bug if pciid wasn't right in a config file.
+				16 Oct 2026 : Add/del now put the VF on the port's dirty list for update_nic.
+				16 Oct 2026 : Mirror requests go through set_mirror_wrp() so the NIC's driver ops are used.
+				16 Oct 2026 : Add unix seqpacket request socket alongside the fifo; responses to
+								socket requests are written on the requesting connection.
+				16 Oct 2026 : Add batch action: many adds/deletes with a single nic update.
+				16 Oct 2026 : Requests which change state are queued to an ordered nic worker thread;
+								ping and show are served immediately.
+				16 Oct 2026 : Add show rates. Quotes and backslashes in response messages are escaped.
+				16 Oct 2026 : Count requests, errors and latency by request type for the metrics exporter.
+				16 Oct 2026 : Requests are parsed with the jwrapper arena on the stack.
+				16 Oct 2026 : Config MACs are converted to 48 bit values when vetted.
+				16 Oct 2026 : Ports are allocated for the configured pciids and each port's VF
+							arrays are sized by vfd_size_port() when the port is mapped.
+				16 Oct 2026 : Duplicate vfid check on add uses the port's vfid map.
+				16 Oct 2026 : Vfid is limited by the VFs allocated on the port rather than 31.
+				16 Oct 2026 : VFs join/leave the port's vlan table; the PF vlan limit is the
+							nic's filter capacity applied to distinct ids. Vlan dup check is O(n).
+				16 Oct 2026 : Add rejects a vfid the nic's driver cannot isolate (ops vf_limit).
+				16 Oct 2026 : Socket responses are serialised per client; show mirror runs on the nic worker.
+				16 Oct 2026 : Batch runs a nic update before an add that follows a delete so the vfid is free.
+				16 Oct 2026 : Show ex and dump take the extended stats from the stats snapshot.
+				16 Oct 2026 : A VF's mac count is the number add_mac() actually kept.
 */
 
 
@@ -33,6 +55,65 @@
 #include "sriov.h"
 #include "vfd_rif.h"
 
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+#define MAX_SOCK_CLIENTS	64			// max concurrent request socket connections
+#define SOCK_RBUF_SIZE		8192		// max size of a request message on the socket
+#define SOCK_CHUNK			(64 * 1024)	// max size of a single response message on the socket
+#define SOCK_SEND_TO		1000		// ms we will wait for a client to drain before giving up on it
+
+static int	sock_lfd = -1;				// request socket listener
+static int	sock_ep = -1;				// epoll set of listener and client connections
+static int	sock_clients[MAX_SOCK_CLIENTS];		// connected client fds (-1 when slot is free)
+static int	sock_pending[MAX_SOCK_CLIENTS];		// requests from the client still queued to the nic worker
+static int	sock_closing[MAX_SOCK_CLIENTS];		// dropped, but fd held open until pending requests finish
+static pthread_mutex_t sock_wlocks[MAX_SOCK_CLIENTS];	// per client; keeps the messages of one response together
+static int	sock_nclients = 0;
+static pthread_mutex_t sock_lock = PTHREAD_MUTEX_INITIALIZER;		// protects the client table
+
+#define REQ_Q_MAX			1024		// max requests waiting for the nic worker
+#define WQ_OFF				0			// nic worker states
+#define WQ_RUNNING			1
+#define WQ_STOPPING			2
+
+static pthread_mutex_t wq_lock = PTHREAD_MUTEX_INITIALIZER;		// protects the nic worker queue and counters
+static pthread_cond_t wq_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t	wq_tid;
+static int			wq_state = WQ_OFF;
+static req_t*		wq_head = NULL;		// requests waiting for the nic worker
+static req_t*		wq_tail = NULL;
+static parms_t*		wq_parms = NULL;
+static sriov_conf_t* wq_conf = NULL;
+static int			wq_depth = 0;
+static int			wq_max_depth = 0;
+static long			wq_queued = 0;		// requests handed to the nic worker
+static long			wq_done = 0;
+static long			wq_inline = 0;		// requests served immediately by the control thread
+static long long	wq_wait_ms = 0;		// queue wait of the last request the worker picked up
+static long long	wq_wait_max = 0;
+
+#define REQ_NTYPES			(RT_BATCH+1)
+#define REQ_NBUCKETS		8			// latency histogram buckets (plus +Inf)
+
+typedef struct {
+	long	count;
+	long	errors;						// requests which got an error response
+	double	sum;						// total latency (seconds), receipt or queueing to response
+	long	buckets[REQ_NBUCKETS];		// not cumulative; summed when formatted
+} req_metric_t;
+
+static const char* req_names[REQ_NTYPES] = { "nop", "add", "delete", "show", "ping", "verbose", "dump", "mirror", "cpu_alarm", "batch" };
+static const double req_bounds[REQ_NBUCKETS] = { 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0, 5.0 };
+static req_metric_t	req_metrics[REQ_NTYPES];
+static pthread_mutex_t req_mlock = PTHREAD_MUTEX_INITIALIZER;
+
+static req_t* parse_request( char* rbuf );
+static int is_readonly( req_t* req );
 //--------------------------------------------------------------------------------------------------------------
 
 /*
@@ -56,6 +137,258 @@ extern int vfd_init_fifo( parms_t* parms ) {
 	return 0;
 }
 
+/*
+	Create the unix domain (seqpacket) request socket. Each client keeps a connection
+	open and sends one request (the same json that is written to the fifo) per message;
+	the response is written back on the connection. Returns an fd which can be added
+	to the caller's epoll set (it becomes readable when a client connects or has sent
+	something) or -1 on failure. Failure is not fatal; the fifo still works.
+*/
+extern int vfd_init_sock( parms_t* parms ) {
+	struct sockaddr_un	addr;
+	struct epoll_event	ev;
+	int	i;
+
+	if( !parms || parms->sock_path == NULL || *parms->sock_path == 0 ) {
+		return -1;
+	}
+
+	if( strlen( parms->sock_path ) >= sizeof( addr.sun_path ) ) {
+		bleat_printf( 0, "ERR: request socket path too long: %s", parms->sock_path );
+		return -1;
+	}
+
+	for( i = 0; i < MAX_SOCK_CLIENTS; i++ ) {
+		sock_clients[i] = -1;
+		sock_pending[i] = 0;
+		sock_closing[i] = 0;
+		pthread_mutex_init( &sock_wlocks[i], NULL );
+	}
+
+	if( (sock_lfd = socket( AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 )) < 0 ) {
+		bleat_printf( 0, "ERR: unable to create request socket: %s", strerror( errno ) );
+		return -1;
+	}
+
+	memset( &addr, 0, sizeof( addr ) );
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, parms->sock_path );
+	unlink( parms->sock_path );										// hard unlink; we don't care if it fails
+
+	umask( 0 );														// like the fifo, wide open as regular users send requests
+	if( bind( sock_lfd, (struct sockaddr *) &addr, sizeof( addr ) ) < 0 || listen( sock_lfd, 16 ) < 0 ) {
+		bleat_printf( 0, "ERR: unable to bind/listen on request socket (%s): %s", parms->sock_path, strerror( errno ) );
+		close( sock_lfd );
+		sock_lfd = -1;
+		return -1;
+	}
+
+	if( (sock_ep = epoll_create1( EPOLL_CLOEXEC )) < 0 ) {
+		bleat_printf( 0, "ERR: unable to create request socket epoll set: %s", strerror( errno ) );
+		close( sock_lfd );
+		sock_lfd = -1;
+		return -1;
+	}
+
+	memset( &ev, 0, sizeof( ev ) );
+	ev.events = EPOLLIN;
+	ev.data.fd = sock_lfd;
+	epoll_ctl( sock_ep, EPOLL_CTL_ADD, sock_lfd, &ev );
+
+	bleat_printf( 0, "listening for requests via socket: %s", parms->sock_path );
+	return sock_ep;
+}
+
+/*
+	Close the request socket and all client connections; unlink the socket.
+*/
+extern void vfd_close_sock( parms_t* parms ) {
+	int i;
+
+	for( i = 0; i < MAX_SOCK_CLIENTS; i++ ) {
+		if( sock_clients[i] >= 0 ) {
+			close( sock_clients[i] );
+			sock_clients[i] = -1;
+		}
+	}
+	sock_nclients = 0;
+
+	if( sock_ep >= 0 ) {
+		close( sock_ep );
+		sock_ep = -1;
+	}
+
+	if( sock_lfd >= 0 ) {
+		close( sock_lfd );
+		sock_lfd = -1;
+		if( parms && parms->sock_path ) {
+			unlink( parms->sock_path );
+		}
+	}
+}
+
+/*
+	Return the client table slot for fd, or -1. Caller must hold sock_lock.
+*/
+static int sock_slot( int fd ) {
+	int i;
+
+	for( i = 0; i < MAX_SOCK_CLIENTS; i++ ) {
+		if( sock_clients[i] == fd ) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+	Free the slot and close the connection. Caller must hold sock_lock.
+*/
+static void sock_free_slot( int i ) {
+	close( sock_clients[i] );
+	bleat_printf( 3, "request socket: client %d disconnected; %d remain", sock_clients[i], sock_nclients - 1 );
+	sock_clients[i] = -1;
+	sock_pending[i] = 0;
+	sock_closing[i] = 0;
+	sock_nclients--;
+}
+
+/*
+	Drop a client connection. If the nic worker still has requests from the client
+	the fd is held open (so that the number cannot be reused under the worker) and
+	closed when the last of them finishes.
+*/
+static void sock_drop( int fd ) {
+	int i;
+
+	pthread_mutex_lock( &sock_lock );
+	if( (i = sock_slot( fd )) >= 0 && !sock_closing[i] ) {
+		epoll_ctl( sock_ep, EPOLL_CTL_DEL, fd, NULL );
+		if( sock_pending[i] > 0 ) {
+			sock_closing[i] = 1;
+		} else {
+			sock_free_slot( i );
+		}
+	}
+	pthread_mutex_unlock( &sock_lock );
+}
+
+/*
+	Note that a request from the client has been queued to the nic worker.
+*/
+static void sock_hold( int fd ) {
+	int i;
+
+	pthread_mutex_lock( &sock_lock );
+	if( (i = sock_slot( fd )) >= 0 ) {
+		sock_pending[i]++;
+	}
+	pthread_mutex_unlock( &sock_lock );
+}
+
+/*
+	The nic worker has finished with a request from the client; close the
+	connection if it was dropped while the request was outstanding.
+*/
+static void sock_release( int fd ) {
+	int i;
+
+	pthread_mutex_lock( &sock_lock );
+	if( (i = sock_slot( fd )) >= 0 ) {
+		if( sock_pending[i] > 0 ) {
+			sock_pending[i]--;
+		}
+		if( sock_closing[i] && sock_pending[i] == 0 ) {
+			sock_free_slot( i );
+		}
+	}
+	pthread_mutex_unlock( &sock_lock );
+}
+
+/*
+	Accept all pending connections on the listener.
+*/
+static void sock_accept( void ) {
+	struct epoll_event	ev;
+	int	fd;
+	int	i;
+
+	while( (fd = accept( sock_lfd, NULL, NULL )) >= 0 ) {
+		fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+		fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+		pthread_mutex_lock( &sock_lock );
+		for( i = 0; i < MAX_SOCK_CLIENTS && sock_clients[i] >= 0; i++ );
+		if( i >= MAX_SOCK_CLIENTS ) {
+			pthread_mutex_unlock( &sock_lock );
+			bleat_printf( 1, "WRN: request socket: too many clients (%d); connection refused", MAX_SOCK_CLIENTS );
+			close( fd );
+			continue;
+		}
+
+		memset( &ev, 0, sizeof( ev ) );
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		if( epoll_ctl( sock_ep, EPOLL_CTL_ADD, fd, &ev ) < 0 ) {
+			pthread_mutex_unlock( &sock_lock );
+			close( fd );
+			continue;
+		}
+
+		sock_clients[i] = fd;
+		sock_pending[i] = 0;
+		sock_closing[i] = 0;
+		sock_nclients++;
+		pthread_mutex_unlock( &sock_lock );
+		bleat_printf( 3, "request socket: client %d connected; %d total", fd, sock_nclients );
+	}
+}
+
+/*
+	Return the write lock for the client, or nil if the client has gone or is being
+	dropped. The slot cannot be reused while the caller is answering one of the client's
+	requests: a worker request holds it via sock_pending, and only the main thread (which
+	answers the rest) frees a slot that has none pending.
+*/
+static pthread_mutex_t* sock_wlock( int fd ) {
+	pthread_mutex_t* wl = NULL;
+	int i;
+
+	pthread_mutex_lock( &sock_lock );
+	if( (i = sock_slot( fd )) >= 0 && !sock_closing[i] ) {
+		wl = &sock_wlocks[i];
+	}
+	pthread_mutex_unlock( &sock_lock );
+
+	return wl;
+}
+
+/*
+	Send len bytes of buf as a single message on the client connection, waiting a short
+	while for the client to drain if the socket is full. Returns 0 on success, -1 if the
+	client should be dropped.
+*/
+static int sock_send( int fd, const char* buf, int len ) {
+	struct pollfd	pfd;
+
+	while( send( fd, buf, len, MSG_NOSIGNAL ) < 0 ) {
+		if( errno != EAGAIN && errno != EWOULDBLOCK ) {
+			bleat_printf( 1, "WRN: request socket: send to client %d failed: %s", fd, strerror( errno ) );
+			return -1;
+		}
+
+		pfd.fd = fd;
+		pfd.events = POLLOUT;
+		if( poll( &pfd, 1, SOCK_SEND_TO ) <= 0 ) {
+			bleat_printf( 1, "WRN: request socket: client %d is not reading; dropping it", fd );
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
 /*
 	Move a 'used' configuration file. If suffix is nil, then we move the file to the 'live'
 	directory and do not change the filename.  If a suffix is provided, we just rename the 
@@ -250,12 +583,12 @@ void gen_port_qshares( sriov_port_t *port ) {
 	int		vfid;							// the vf number we are looking at (vf # might not correspond to index in table)
 	double	factor;							// normalisation factor
 
-	norm_pctgs = (int *) malloc( sizeof( *norm_pctgs ) * MAX_QUEUES );
+	norm_pctgs = (int *) malloc( sizeof( *norm_pctgs ) * MAX_VFS * MAX_TCS );		// indexed by vfid * ntcs, so sized for every vfid, not just the nic's queue count
 	if( norm_pctgs == NULL ) {
-		bleat_printf( 0, "error: unable to allocate %d bytes for max-pctg array", sizeof( *norm_pctgs ) * MAX_QUEUES  );
+		bleat_printf( 0, "error: unable to allocate %d bytes for max-pctg array", sizeof( *norm_pctgs ) * MAX_VFS * MAX_TCS  );
 		return;
 	}
-	memset( norm_pctgs, 0, sizeof( *norm_pctgs ) * MAX_QUEUES );
+	memset( norm_pctgs, 0, sizeof( *norm_pctgs ) * MAX_VFS * MAX_TCS );
 
 	ntcs = port->ntcs;
 	for( i = 0; i < ntcs; i++ ) {			// for each tc, compute the overall sum based on configured
@@ -338,6 +671,12 @@ extern void vfd_add_ports( parms_t* parms, sriov_conf_t* conf ) {
 		return;
 	}
 	called = 1;
+
+	if( (conf->ports = (struct sriov_port_s *) calloc( parms->npciids > 0 ? parms->npciids : 1, sizeof( *conf->ports ) )) == NULL ) {
+		bleat_printf( 0, "CRI: unable to allocate %d ports", parms->npciids );
+		rte_spinlock_unlock( &conf->update_lock );
+		return;
+	}
 	
 	for( i = 0; pidx < MAX_PORTS  && i < parms->npciids; i++, pidx++ ) {
 		pfc = &parms->pciids[i];					// point at the pf's configuration info
@@ -392,9 +731,73 @@ extern void vfd_add_ports( parms_t* parms, sriov_conf_t* conf ) {
 	rte_spinlock_unlock( &conf->update_lock );
 }
 
+/*
+	Allocate the VF related arrays for a port based on the number of VFs that the NIC
+	reports as configured (nvfs). Called once the port is mapped to a device; until
+	then the port has no VF space and adds are rejected. Returns 1 on success.
+*/
+extern int vfd_size_port( struct sriov_port_s* port, int nvfs ) {
+	int i;
+
+	if( port == NULL ) {
+		return 0;
+	}
+
+	if( nvfs > MAX_VFS ) {
+		bleat_printf( 0, "WRN: port %s reports %d VFs; only %d will be managed", port->pciid, nvfs, MAX_VFS );
+		nvfs = MAX_VFS;
+	}
+	if( nvfs <= 0 || port->vfs_alloc >= nvfs ) {			// nothing to do, or already big enough
+		return 1;
+	}
+
+	free( port->vfs );
+	free( port->mirrors );
+	free( port->vf_lists );
+	free( port->dirty );
+	free( port->vf_slot );
+	port->vfs = (struct vf_s *) calloc( nvfs, sizeof( *port->vfs ) );
+	port->mirrors = (struct mirror_s *) calloc( nvfs, sizeof( *port->mirrors ) );
+	port->vf_lists = (struct vf_lists *) calloc( nvfs, sizeof( *port->vf_lists ) );
+	port->dirty = (int *) calloc( nvfs, sizeof( *port->dirty ) );
+	port->vf_slot = (int16_t *) malloc( nvfs * sizeof( *port->vf_slot ) );
+	if( port->vfs == NULL || port->mirrors == NULL || port->vf_lists == NULL || port->dirty == NULL || port->vf_slot == NULL ) {
+		bleat_printf( 0, "CRI: unable to allocate VF space for %d VFs on port %s", nvfs, port->pciid );
+		free( port->vfs );
+		free( port->mirrors );
+		free( port->vf_lists );
+		free( port->dirty );
+		free( port->vf_slot );
+		port->vfs = NULL;
+		port->mirrors = NULL;
+		port->vf_lists = NULL;
+		port->dirty = NULL;
+		port->vf_slot = NULL;
+		port->vfs_alloc = 0;
+		return 0;
+	}
+
+	for( i = 0; i < nvfs; i++ ) {
+		port->vfs[i].num = -1;
+		port->vfs[i].vlans = port->vf_lists[i].vlans;
+		port->vfs[i].macs = port->vf_lists[i].macs;
+		port->mirrors[i].target = MAX_VFS + 1;					// target is unsigned -- set out of range high
+		port->vf_slot[i] = -1;
+	}
+
+	port->vfs_alloc = nvfs;
+	port->num_vfs = 0;
+	port->ndirty = 0;
+	bleat_printf( 2, "port %s: space allocated for %d VFs (%d bytes hot, %d bytes cold)", port->pciid, nvfs,
+		(int) (nvfs * sizeof( *port->vfs )), (int) (nvfs * sizeof( *port->vf_lists )) );
+
+	return 1;
+}
+
 /*
 	Trapse through the mirror stuff and generate a buffer with statistics.
-	Caller must free buffer returned.
+	Caller must free buffer returned. Must run on the nic worker (is_readonly())
+	as the mirror blocks are changed there without a lock.
 */
 static char* gen_mirror_stats( struct sriov_conf_c* conf, int limit ) {
 	char* buf;
@@ -554,7 +957,7 @@ static int vfd_update_mirror( sriov_conf_t* conf, const_str req, char** reason )
 
 					if( state ) {									// all vetted successfully
 						bleat_printf( 1, "update mirror:  setting: pf/vf=%d/%d dir=%d target=%d",  pf->rte_port_number, vf->num, req_dir, mirror->target );
-						if( set_mirror( pf->rte_port_number, vf->num, mirror->id, mirror->target, mirror->dir ) < 0 ) {		// actually do it
+						if( set_mirror_wrp( pf->rte_port_number, vf->num, mirror->id, mirror->target, mirror->dir ) < 0 ) {		// actually do it
 							msg = "unable to update nic with mirror request";
 							state = 0;
 						} else {
@@ -602,15 +1005,16 @@ static int vfd_update_mirror( sriov_conf_t* conf, const_str req, char** reason )
 extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 	vf_config_t* vfc;					// raw vf config file contents	
 	int	i;
-	int j;
 	int vidx;							// index into the vf array
 	int	hole = -1;						// first hole in the list;
 	struct sriov_port_s* port = NULL;	// reference to a single port in the config
 	struct vf_s*	vf;					// point at the vf we need to fill in
 	char mbuf[BUF_1K];					// message buffer if we fail
-	int tot_vlans = 0;					// must count vlans and macs to ensure limit not busted
 	//int tot_macs = 0;
 	float tot_min_rate = 0;
+	uint64_t mac;						// mac from the config as a 48 bit value
+	uint64_t vlan_seen[4096 / 64];		// vlan ids seen in the config list (dup check)
+	int nnew;							// vlan ids the VF would add to those in use on the PF
 	
 
 	if( conf == NULL || fname == NULL ) {
@@ -662,23 +1066,22 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 		return 0;
 	}
 
-	for( i = 0; i < port->num_vfs; i++ ) {				// ensure ID is not already defined
+	if( vf_slot( port, vfc->vfid ) >= 0 ) {			// ensure ID is not already defined
+		snprintf( mbuf, sizeof( mbuf ), "vfid %d already exists on port %s", vfc->vfid, vfc->pciid );
+		bleat_printf( 1, "vf not added: %s", mbuf );
+		if( reason ) {
+			*reason = strdup( mbuf );
+		}
+		free_config( vfc );
+		return 0;
+	}
+
+	for( i = 0; i < port->num_vfs; i++ ) {				// find a hole and sum what is already committed
 		if( port->vfs[i].num < 0 ) {					// this is a hole
 			if( hole < 0 ) {
 				hole = i;								// we'll insert here
 			}
 		} else {
-			if( port->vfs[i].num == vfc->vfid ) {			// dup, fail
-				snprintf( mbuf, sizeof( mbuf ), "vfid %d already exists on port %s", vfc->vfid, vfc->pciid );
-				bleat_printf( 1, "vf not added: %s", mbuf );
-				if( reason ) {
-					*reason = strdup( mbuf );
-				}
-				free_config( vfc );
-				return 0;
-			}
-
-			tot_vlans += port->vfs[i].num_vlans;
 			//tot_macs += port->vfs[i].num_macs;
 			tot_min_rate += port->vfs[i].min_rate;
 		}
@@ -690,7 +1093,7 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 		vidx = i;
 	}
 
-	if( vidx >= MAX_VFS || vfc->vfid < 0 || vfc->vfid > 31 ) {				// something is out of range TODO: replace 31 with actual number of VFs?
+	if( vidx >= port->vfs_alloc || vfc->vfid < 0 || vfc->vfid >= port->vfs_alloc ) {		// something is out of range
 		snprintf( mbuf, sizeof( mbuf ), "max VFs already defined or vfid %d is out of range", vfc->vfid );
 		bleat_printf( 1, "vf not added: %s", mbuf );
 		if( reason ) {
@@ -712,18 +1115,20 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 		return 0;
 	}
 
-	if( vfc->min_rate + tot_min_rate > 1 ) {	// Rate oversubscription
-		snprintf( mbuf, sizeof( mbuf ), "total guaranteed rate exceeds link speed" );
+	if( port->nic_ops != NULL && port->nic_ops->vf_limit > 0 && vfc->vfid >= port->nic_ops->vf_limit ) {	// nic cannot isolate (vlan filter) this VF
+		snprintf( mbuf, sizeof( mbuf ), "vf %d is out of range; the %s driver can isolate only VFs 0-%d on port %s",
+			vfc->vfid, port->nic_ops->driver, port->nic_ops->vf_limit - 1, port->pciid );
 		bleat_printf( 1, "vf not added: %s", mbuf );
 		if( reason ) {
 			*reason = strdup( mbuf );
 		}
+
 		free_config( vfc );
 		return 0;
 	}
 
-	if( vfc->nvlans > MAX_VF_VLANS ) {				// more than allowed for a single VF
-		snprintf( mbuf, sizeof( mbuf ), "number of vlans supplied (%d) exceeds the maximum (%d)", vfc->nvlans, MAX_VF_VLANS );
+	if( vfc->min_rate + tot_min_rate > 1 ) {	// Rate oversubscription
+		snprintf( mbuf, sizeof( mbuf ), "total guaranteed rate exceeds link speed" );
 		bleat_printf( 1, "vf not added: %s", mbuf );
 		if( reason ) {
 			*reason = strdup( mbuf );
@@ -732,8 +1137,8 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 		return 0;
 	}
 
-	if( vfc->nvlans + tot_vlans > MAX_PF_VLANS ) { 			// would bust the total across the whole PF
-		snprintf( mbuf, sizeof( mbuf ), "number of vlans supplied (%d) cauess total for PF to exceed the maximum (%d)", vfc->nvlans, MAX_PF_VLANS );
+	if( vfc->nvlans > MAX_VF_VLANS ) {				// more than allowed for a single VF
+		snprintf( mbuf, sizeof( mbuf ), "number of vlans supplied (%d) exceeds the maximum (%d)", vfc->nvlans, MAX_VF_VLANS );
 		bleat_printf( 1, "vf not added: %s", mbuf );
 		if( reason ) {
 			*reason = strdup( mbuf );
@@ -752,10 +1157,11 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 		return 0;
 	}
 
-														// check vlan and mac arrays for duplicate values and bad things
-	if( vfc->nvlans == 1 ) {							// no need for a dup check, just a range check
-		if( vfc->vlans[0] < 1 || vfc->vlans[0] > 4095 ) {
-			snprintf( mbuf, sizeof( mbuf ), "invalid vlan id: %d", vfc->vlans[0] );
+														// check vlan array for duplicate values and bad things
+	memset( vlan_seen, 0, sizeof( vlan_seen ) );
+	for( i = 0; i < vfc->nvlans; i++ ) {
+		if( vfc->vlans[i] < 1 || vfc->vlans[i] > 4095 ) {				// range check
+			snprintf( mbuf, sizeof( mbuf ), "invalid vlan id: %d", vfc->vlans[i] );
 			bleat_printf( 1, "vf not added: %s", mbuf );
 			if( reason ) {
 				*reason = strdup( mbuf );
@@ -763,30 +1169,27 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 			free_config( vfc );
 			return 0;
 		}
-	} else {
-		for( i = 0; i < vfc->nvlans-1; i++ ) {
-			if( vfc->vlans[i] < 1 || vfc->vlans[i] > 4095 ) {			// range check
-				snprintf( mbuf, sizeof( mbuf ), "invalid vlan id: %d", vfc->vlans[i] );
-				bleat_printf( 1, "vf not added: %s", mbuf );
-				if( reason ) {
-					*reason = strdup( mbuf );
-				}
-				free_config( vfc );
-				return 0;
-			}
-	
-			for( j = i+1; j < vfc->nvlans; j++ ) {
-				if( vfc->vlans[i] == vfc->vlans[j] ) {					// dup check
-					snprintf( mbuf, sizeof( mbuf ), "duplicate vlan in list: %d", vfc->vlans[i] );
-					bleat_printf( 1, "vf not added: %s", mbuf );
-					if( reason ) {
-						*reason = strdup( mbuf );
-					}
-					free_config( vfc );
-					return 0;
-				}
+
+		if( vlan_seen[vfc->vlans[i] >> 6] & (1ULL << (vfc->vlans[i] & 63)) ) {		// dup check
+			snprintf( mbuf, sizeof( mbuf ), "duplicate vlan in list: %d", vfc->vlans[i] );
+			bleat_printf( 1, "vf not added: %s", mbuf );
+			if( reason ) {
+				*reason = strdup( mbuf );
 			}
+			free_config( vfc );
+			return 0;
+		}
+		vlan_seen[vfc->vlans[i] >> 6] |= 1ULL << (vfc->vlans[i] & 63);
+	}
+
+	if( (nnew = vlan_new_count( port, vfc->vlans, vfc->nvlans )) + vlan_count( port ) > vlan_capacity( port ) ) {		// would bust what the nic can filter for the PF
+		snprintf( mbuf, sizeof( mbuf ), "vlans supplied add %d ids to the %d in use on the PF which exceeds what the nic can filter (%d)", nnew, vlan_count( port ), vlan_capacity( port ) );
+		bleat_printf( 1, "vf not added: %s", mbuf );
+		if( reason ) {
+			*reason = strdup( mbuf );
 		}
+		free_config( vfc );
+		return 0;
 	}
 
 	if( vfc->nmacs > MAX_VF_MACS ) {				// too many mac addresses specified for this (can_add cannot check this until VF/PF is actually added to config)
@@ -800,7 +1203,7 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 	}
 
 	for( i = 0; i < vfc->nmacs; i++ ) {				// if a mac is duplicated it will be weeded out when we add
-		if( ! can_add_mac( port->rte_port_number, -1, vfc->macs[i] ) ) {			// must pass -1 for vfid as it's not in the config yet
+		if( ! mac_aton( vfc->macs[i], &mac ) || ! can_add_mac( port->rte_port_number, -1, mac ) ) {	// must pass -1 for vfid as it's not in the config yet
 			snprintf( mbuf, sizeof( mbuf ), "mac cannot be added to this port (invalid, inuse, or max exceeded for VF): mac=(%s)", vfc->macs[i] ? vfc->macs[i] : "" );
 			bleat_printf( 0, "vf not added: %s", mbuf );
 			if( reason ) {
@@ -876,18 +1279,21 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 	bleat_printf( 2, "vf configuration vet complete for %s", vfc->name );
 
 	// All validation was successful, safe to update the config data
-	if( vidx == port->num_vfs ) {		// inserting at end, bump the num we have used
+	rte_spinlock_lock( &conf->update_lock );
+
+	if( vidx == port->num_vfs ) {		// inserting at end, bump the num we have used (under lock as readers walk 0..num_vfs)
 		port->num_vfs++;
 	}
-	
-	rte_spinlock_lock( &conf->update_lock );
 
 	vf = &port->vfs[vidx];						// copy from config data doing any translation needed
 	memset( vf, 0, sizeof( *vf ) );				// assume zeroing everything is good
+	vf->vlans = port->vf_lists[vidx].vlans;		// except the pointers to the cold lists
+	vf->macs = port->vf_lists[vidx].macs;
 	vf->config_name = strdup( vfc->name );		// hold name for delete
 	vf->owner = vfc->owner;
 	vf->num = vfc->vfid;
-	port->vfs[vidx].last_updated = ADDED;		// signal main code to configure the buggger
+	port->vf_slot[vf->num] = vidx;				// vfid is range checked against nvfs_config above
+	mark_vf_dirty( port, vidx, ADDED );			// signal main code to configure the buggger
 	vf->strip_stag = vfc->strip_stag;
 	vf->strip_ctag = vfc->strip_ctag;
 	vf->insert_stag = vfc->strip_stag;			// both are pulled from same config parm
@@ -935,15 +1341,16 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 		vf->vlans[i] = vfc->vlans[i];
 	}
 	vf->num_vlans = vfc->nvlans;
+	vlan_join( port, vf );												// after strip settings; the filter is pushed by update_nic
 
 	vf->first_mac = 1;													// if guests pushes a mac, we'll add it to [0] and reset the index
 	for( i = 1; i <= vfc->nmacs; i++ ) {								// src is 0 based but vf list is 1 based to allow for easy push if guests sets a default mac
-		//strcpy( vf->macs[i], vfc->macs[i-1] );						// length vetted earlier, so this is safe
-		add_mac( port->rte_port_number, vf->num, vfc->macs[i-1] );		// this should not fail as we vetted it before
+		mac_aton( vfc->macs[i-1], &mac );								// vetted earlier, so this is safe
+		if( ! add_mac( port->rte_port_number, vf->num, mac ) ) {		// add_mac counts those it keeps in num_macs; a duplicate is kept once
+			bleat_printf( 0, "WRN: add: mac %s was not added to pf/vf=%d/%d", vfc->macs[i-1], port->rte_port_number, vf->num );
+		}
 	}
 
-	vf->num_macs = vfc->nmacs;
-
 	for( i = 0; i < MAX_TCS; i++ ) {				// copy in the VF's share of each traffic class (percentage)
 		vf->qshares[i] = vfc->qshare[i];
 	}
@@ -1080,15 +1487,7 @@ extern int vfd_del_vf( parms_t* parms, sriov_conf_t* conf, char* fname, char** r
 		return 0;
 	}
 
-	vidx = -1;
-	for( i = 0; i < port->num_vfs; i++ ) {				// suss out the id that is listed
-		if( port->vfs[i].num == vfc->vfid ) {			// this is it.
-			vidx = i;
-			break;
-		}
-	}
-
-	if( vidx < 0 ) {									//  vf not configured on this port
+	if( (vidx = vf_slot( port, vfc->vfid )) < 0 ) {		//  vf not configured on this port
 		snprintf( mbuf, mblen, "%s: vf %d not configured on port %s", vfc->name, vfc->vfid, vfc->pciid );
 		bleat_printf( 1, "no config change related to del request: %s", mbuf );
 		if( reason ) {
@@ -1115,7 +1514,10 @@ extern int vfd_del_vf( parms_t* parms, sriov_conf_t* conf, char* fname, char** r
 	bleat_printf( 2, "del: config data: pciid: %s", vfc->pciid );
 	bleat_printf( 2, "del: config data: vfid: %d", vfc->vfid );
 
-	port->vfs[vidx].last_updated = DELETED;			// signal main code to nuke the puppy (vfid stays set so we don't see it as a hole until it's gone)
+	rte_spinlock_lock( &conf->update_lock );
+	mark_vf_dirty( port, vidx, DELETED );			// signal main code to nuke the puppy (vfid stays set so we don't see it as a hole until it's gone)
+	vlan_leave( port, &port->vfs[vidx] );			// its vlans no longer count against the PF; filters are removed by update_nic
+	rte_spinlock_unlock( &conf->update_lock );
 	
 	if( reason ) {
 		*reason = NULL;
@@ -1174,6 +1576,89 @@ extern int vfd_write( int fd, const_str buf, int len ) {
 	return -1;
 }
 
+/*
+	Build the json response (including the trailing end of message marker). The message
+	is split on newlines into an array of strings as json does not allow newlines in a
+	string. Returns a buffer the caller must free, and the length via len; nil on error.
+*/
+static char* build_response( int state, const_str vfd_rid, const_str msg, int* len ) {
+	char*	rbuf;
+	char*	dmsg;			// duplicate message that we can mutilate
+	char*	dptr;			// pointer into dmsg for strtok
+	char*	tok;
+	const_str	sep = "\n";	// message seperators in the array; lead newline helps with visual alignment which can be important
+	const_str	cp;
+	char*	wp;
+	int		rlen;
+	int		nlines = 1;
+	int		nesc = 0;		// characters needing an escape
+	int		l;
+
+	if( vfd_rid == NULL ) {
+		bleat_printf( 1, "response: did not have a vfd_rid to send back" );
+		vfd_rid = "not-supplied";
+	}
+
+	if( msg != NULL ) {
+		for( cp = msg; *cp; cp++ ) {
+			switch( *cp ) {
+				case '\n':
+					nlines++;
+					break;
+
+				case '"':
+				case '\\':
+				case '\t':
+					nesc++;
+					break;
+			}
+		}
+	}
+
+	rlen = 128 + strlen( vfd_rid ) + (msg ? strlen( msg ) : 0) + (nlines * 4) + nesc;		// each line gets at most sep and two quotes
+	if( (rbuf = (char *) malloc( sizeof( char ) * rlen )) == NULL ) {
+		return NULL;
+	}
+
+	l = snprintf( rbuf, rlen, "{ \"action\": \"response\", \"vfd_rid\": \"%s\", \"state\": \"%s\", \"msg\": [", vfd_rid, state ? "ERROR" : "OK" );
+	bleat_printf( 3, "response: header: %s", rbuf );
+
+	if( msg != NULL  && (dmsg = strdup( msg )) != NULL ) {
+		dptr = dmsg;
+		while( (tok = strtok_r( NULL, "\n", &dptr )) != NULL ) {		//  bloody json doesn't accept strings with newlines, so we build an array; grrr
+			l += snprintf( rbuf + l, rlen - l, "%s\"", sep );
+			for( wp = rbuf + l; *tok; tok++ ) {						// copy escaping things that would break the json string
+				switch( *tok ) {
+					case '"':
+					case '\\':
+						*wp++ = '\\';
+						*wp++ = *tok;
+						break;
+
+					case '\t':
+						*wp++ = '\\';
+						*wp++ = 't';
+						break;
+
+					default:
+						*wp++ = *tok;
+						break;
+				}
+			}
+			*wp++ = '"';
+			*wp = 0;
+			l = wp - rbuf;
+			sep = ",\n";												// after the first we need commas before the next
+		}
+
+		free( dmsg );
+	}
+
+	l += snprintf( rbuf + l, rlen - l, " ] }\n@eom@\n" );				// terminate the the message array, then the json
+	*len = l;
+	return rbuf;
+}
+
 /*
 	Construct json to write onto the response pipe.  The response pipe is opened in non-block mode
 	so that it will fail immiediately if there isn't a reader or the pipe doesn't exist. We assume
@@ -1187,22 +1672,14 @@ extern int vfd_write( int fd, const_str buf, int len ) {
 */
 extern void vfd_response( char* rpipe, int state, const_str vfd_rid, const_str msg ) {
 	int 	fd;
-	char	buf[BUF_1K * 4];
-	char*	dmsg;			// duplicate message that we can mutilate
-	char*	dptr;			// pointer into dmsg for strtok
-	char*	tok;
-	const_str	sep = "\n";	// message seperators in the array; lead newline helps with visual alignment which can be important
+	char*	rbuf;
+	int		rlen;
 
 	if( rpipe == NULL ) {
 		bleat_printf( 1, "response: unable to respond, response pipe name is nil" );
 		return;
 	}
 
-	if( vfd_rid == NULL ) {
-		bleat_printf( 1, "response: did not have a vfd_rid to send back" );
-		vfd_rid = "not-supplied";
-	}
-
 	bleat_printf( 3, "response: opening response pipe: %s", rpipe );
 	if( (fd = open( rpipe, O_WRONLY | O_NONBLOCK, 0 )) < 0 ) {
 	 	bleat_printf( 0, "unable to deliver response: open failed: %s: %s", rpipe, strerror( errno ) );
@@ -1212,32 +1689,71 @@ extern void vfd_response( char* rpipe, int state, const_str vfd_rid, const_str m
 	if( bleat_will_it( 4 ) ) {
 		bleat_printf( 4, "sending response: %s(%d) [%d] %s", rpipe, fd, state, msg );
 	} else {
-		bleat_printf( 2, "sending response: %s(%d) [%d] %d bytes", rpipe, fd, state, strlen( msg ) );
+		bleat_printf( 2, "sending response: %s(%d) [%d] %d bytes", rpipe, fd, state, msg ? strlen( msg ) : 0 );
 	}
 
-	snprintf( buf, sizeof( buf ), "{ \"action\": \"response\", \"vfd_rid\": \"%s\", \"state\": \"%s\", \"msg\": [", vfd_rid, state ? "ERROR" : "OK" );
-	bleat_printf( 3, "response: header: %s", buf );
+	if( (rbuf = build_response( state, vfd_rid, msg, &rlen )) != NULL ) {
+		if( vfd_write( fd, rbuf, rlen ) > 0 ) {
+			bleat_printf( 2, "response written to pipe" );			// only if all of message written
+		}
+		free( rbuf );
+	}
 
-	if( vfd_write( fd, buf, strlen( buf ) ) > 0 ) {
-		if( msg != NULL  && (dmsg = strdup( msg )) != NULL ) {
-			dptr = dmsg;
-			while( (tok = strtok_r( NULL, "\n", &dptr )) != NULL ) {	//  bloody json doesn't accept strings with newlines, so we build an array; grrr
-				snprintf( buf, sizeof( buf ), "%s\"%s\"", sep, tok );
-				vfd_write( fd, buf, strlen( buf ) );					// ignore state; we need to close the json regardless
-				sep = ",\n";											// after the first we need commas before the next
-			}
+	close( fd );
+}
 
-			free( dmsg );
-		}
+/*
+	Send a response to the requestor. If the request arrived on the request socket
+	the response goes back on that connection (split into SOCK_CHUNK sized messages
+	if large; the client reads until the end of message marker just as it does from
+	the fifo), otherwise it is written to the response fifo named in the request.
+*/
+extern void vfd_respond( req_t* req, int state, const_str msg ) {
+	pthread_mutex_t* wl;
+	char*	rbuf;
+	int		rlen;
+	int		off;
+	int		n;
+
+	if( state != RESP_OK ) {
+		req->failed = 1;
 	}
-	
-	snprintf( buf, sizeof( buf ), " ] }\n@eom@\n" );				// terminate the the message array, then the json
-	vfd_write( fd, buf, strlen( buf ) );
-	bleat_printf( 2, "response written to pipe" );			// only if all of message written
 
+	if( req->sock_fd < 0 ) {
+		vfd_response( req->resp_fifo, state, req->vfd_rid, msg );
+		return;
+	}
 
-	bleat_pop_lvl();			// we assume it was pushed when the request received; we pop it once we respond
-	close( fd );
+	bleat_printf( 2, "sending response: socket(%d) [%d] %d bytes", req->sock_fd, state, msg ? strlen( msg ) : 0 );
+	if( (wl = sock_wlock( req->sock_fd )) == NULL ) {				// dropped by the other lane while this was running
+		req->sock_fd = -1;
+		if( req->resp_fifo != NULL ) {			// prevent any further response attempts going to a fifo
+			free( req->resp_fifo );
+			req->resp_fifo = NULL;
+		}
+		return;
+	}
+
+	if( (rbuf = build_response( state, req->vfd_rid, msg, &rlen )) != NULL ) {
+		pthread_mutex_lock( wl );									// both lanes may answer the same client; a slow client blocks only itself
+		for( off = 0; off < rlen; off += n ) {
+			n = rlen - off > SOCK_CHUNK ? SOCK_CHUNK : rlen - off;
+			if( rlen - (off + n) > 0 && rlen - (off + n) < 16 ) {		// keep the end of message marker whole in the last message
+				n -= 16;
+			}
+			if( sock_send( req->sock_fd, rbuf + off, n ) < 0 ) {
+				sock_drop( req->sock_fd );
+				req->sock_fd = -1;
+				if( req->resp_fifo != NULL ) {		// prevent any further response attempts going to a fifo
+					free( req->resp_fifo );
+					req->resp_fifo = NULL;
+				}
+				break;
+			}
+		}
+		pthread_mutex_unlock( wl );
+		free( rbuf );
+	}
 }
 
 /*
@@ -1255,7 +1771,18 @@ extern void vfd_free_request( req_t* req ) {
 		free( req->resp_fifo );
 	}
 
-	free( req );
+	if( req->items != NULL ) {
+		int i;
+
+		for( i = 0; i < req->nitems; i++ ) {
+			if( req->items[i].resource != NULL ) {
+				free( req->items[i].resource );
+			}
+		}
+		free( req->items );
+	}
+
+	free( req );
 }
 
 /*
@@ -1264,12 +1791,7 @@ extern void vfd_free_request( req_t* req ) {
 	properly free it.
 */
 extern req_t* vfd_read_request( parms_t* parms ) {
-	void*	jblob;				// json parsing stuff
 	char*	rbuf;				// raw request buffer from the pipe
-	char*	stuff;				// stuff teased out of the json blob
-	char*	rid;				// request id we must track for caller
-	req_t*	req = NULL;
-	int		lvl;				// log level supplied
 
 	rbuf = rfifo_read( parms->rfifo );
 	if( ! *rbuf ) {				// empty, nothing to do
@@ -1277,7 +1799,22 @@ extern req_t* vfd_read_request( parms_t* parms ) {
 		return NULL;
 	}
 
-	if( (jblob = jw_new( rbuf )) == NULL ) {
+	return parse_request( rbuf );
+}
+
+/*
+	Parse a raw json request into a request block. The raw buffer is freed.
+	A pointer to the struct is returned; the caller must use vfd_free_request() to
+	properly free it.
+*/
+static req_t* parse_request( char* rbuf ) {
+	void*	jblob;				// json parsing stuff
+	char*	stuff;				// stuff teased out of the json blob
+	char*	rid;				// request id we must track for caller
+	req_t*	req = NULL;
+	char	abuf[JW_ARENA_SIZE] __attribute__ ((aligned (8)));	// parse arena; an oversized request is allocated
+
+	if( (jblob = jw_new_arena( rbuf, abuf, sizeof( abuf ) )) == NULL ) {
 		bleat_printf( 0, "ERR: failed to create a json parsing object for: %s", rbuf );
 		free( rbuf );
 		return NULL;
@@ -1297,6 +1834,7 @@ extern req_t* vfd_read_request( parms_t* parms ) {
 		return NULL;
 	}
 	memset( req, 0, sizeof( *req ) );
+	req->sock_fd = -1;
 
 	bleat_printf( 2, "raw message: (%s)", rbuf );
 
@@ -1310,6 +1848,10 @@ extern req_t* vfd_read_request( parms_t* parms ) {
 			req->rtype = RT_ADD;
 			break;
 
+		case 'b':					// batch of adds/deletes
+			req->rtype = RT_BATCH;
+			break;
+
 		case 'c':					// assume "cpu_alrm_thresh"
 			req->rtype = RT_CPU_ALARM;
 			break;
@@ -1343,6 +1885,8 @@ extern req_t* vfd_read_request( parms_t* parms ) {
 		default:
 			bleat_printf( 0, "ERR: unrecognised action in request: %s", rbuf );
 			jw_nuke( jblob );
+			vfd_free_request( req );
+			free( rbuf );
 			return NULL;
 			break;
 	}
@@ -1354,14 +1898,46 @@ extern req_t* vfd_read_request( parms_t* parms ) {
 			req->resource = strdup( stuff );
 		}
 	}
+	if( req->rtype == RT_BATCH && (req->nitems = jw_array_len( jblob, "params.items" )) > 0 ) {
+		void*	iblob;				// the item object
+		int		i;
+
+		if( req->nitems > MAX_BATCH ) {
+			bleat_printf( 0, "WRN: batch request has too many items: %d; only the first %d will be processed", req->nitems, MAX_BATCH );
+			req->nitems = MAX_BATCH;
+		}
+
+		if( (req->items = (req_item_t *) malloc( sizeof( *req->items ) * req->nitems )) == NULL ) {
+			req->nitems = 0;
+		} else {
+			memset( req->items, 0, sizeof( *req->items ) * req->nitems );
+			for( i = 0; i < req->nitems; i++ ) {
+				req->items[i].rtype = RT_NOP;								// unrecognised until proven otherwise
+				if( (iblob = jw_obj_ele( jblob, "params.items", i )) != NULL ) {
+					if( (stuff = jw_string( iblob, "action" )) != NULL ) {
+						if( strcmp( stuff, "add" ) == 0 ) {
+							req->items[i].rtype = RT_ADD;
+						} else {
+							if( strncmp( stuff, "del", 3 ) == 0 ) {
+								req->items[i].rtype = RT_DEL;
+							}
+						}
+					}
+					if( (stuff = jw_string( iblob, "filename" )) != NULL ) {
+						req->items[i].resource = strdup( stuff );
+					}
+				}
+			}
+		}
+	}
+
 	if( (stuff = jw_string( jblob, "params.r_fifo")) != NULL ) {
 		req->resp_fifo = strdup( stuff );
 	} else {
 		bleat_printf( 1, "no response fifo given in request" );
 	}
 	
-	req->log_level = lvl = jw_missing( jblob, "params.loglevel" ) ? 0 : (int) jw_value( jblob, "params.loglevel" );
-	bleat_push_glvl( lvl );					// push the level if greater, else push current so pop won't fail
+	req->log_level = jw_missing( jblob, "params.loglevel" ) ? 0 : (int) jw_value( jblob, "params.loglevel" );
 
 	free( rbuf );
 	jw_nuke( jblob );
@@ -1370,9 +1946,12 @@ extern req_t* vfd_read_request( parms_t* parms ) {
 
 /*
 	Fill a buffer with the extended stats for all ports. Caller must free the buffer.
-	If memory becomes an issue, this returns NULL to indicate error.
+	If memory becomes an issue, this returns NULL to indicate error. The values come
+	from the stats snapshot (a sweep is made if it is stale) so that nothing but the
+	sweep reads the NIC's extended stats.
 */
 static char* gen_exstats( sriov_conf_t* conf ) {
+	const stats_snap_t* snap;
 	char*	xbuf = NULL;							// extended stats from one port
 	char*	rbuf = NULL;							// response buffer with all output
 	int		rbsize = sizeof( char ) * 1024 * 10;	// amount allocated in rbuf
@@ -1380,19 +1959,25 @@ static char* gen_exstats( sriov_conf_t* conf ) {
 	int		xbsize = sizeof( char ) * 1024 * 5;
 	int		i;
 	int		len;
+	int		pidx;
 
 	if( (rbuf = (char *) malloc( rbsize )) != NULL ) {
 		*rbuf = 0;
 		if( (xbuf = (char *) malloc( xbsize )) != NULL ) {
+			snap = stats_snap_get( conf, STATS_MAX_AGE );
 			for( i = 0; i < conf->num_ports; i++ ) {
 				len = sprintf( xbuf, "\nport %d:\n", i );
-				len += port_xstats_display( conf->ports[i].rte_port_number, xbuf + len, xbsize - len );
-				if( len + rbused > rbsize ) {
-					while( rbused + len < rbsize ) {
+				if( (pidx = stats_snap_pf( snap, conf->ports[i].rte_port_number )) >= 0 ) {
+					len += stats_xs_str( snap, pidx, xbuf + len, xbsize - len );
+				}
+				if( len + rbused >= rbsize ) {
+					while( rbused + len >= rbsize ) {
 						rbsize += rbsize/2;
 					}
 					if( (rbuf = (char *) realloc( rbuf, rbsize )) == NULL ) {
 						bleat_printf( 0, "WARN: unable to get enough memory to display extended stats" );
+						stats_snap_put( );
+						free( xbuf );
 						return NULL;
 					}
 				}
@@ -1400,6 +1985,7 @@ static char* gen_exstats( sriov_conf_t* conf ) {
 				strcat( rbuf, xbuf );
 				rbused += len;
 			}
+			stats_snap_put( );
 
 			free( xbuf );
 		}
@@ -1410,248 +1996,718 @@ static char* gen_exstats( sriov_conf_t* conf ) {
 
 												
 /*
-	Request interface. Checks the request pipe and handles a reqest. If
-	forever is set then this is a black hole (never returns).
-	Returns true if it handled a request, false otherwise.
+	Validate and apply one batch item to the in memory config; no nic update is driven.
+	For adds, the config is moved to the live directory (or marked .error) as with a
+	single add. Returns 1 on success. The result message for the item is placed into
+	rbuf.
 */
-extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
-	req_t*	req;
+static int batch_item( parms_t* parms, sriov_conf_t* conf, int idx, req_item_t* item, char* rbuf, int rlen ) {
+	char	fname[2048];
+	char*	reason = NULL;
+	int		ok = 0;
+
+	if( item->resource == NULL || (item->rtype != RT_ADD && item->rtype != RT_DEL) ) {
+		snprintf( rbuf, rlen, "[%d] %s: ERROR: item must have an action of add or delete and a filename", idx, item->resource ? item->resource : "missing-filename" );
+		return 0;
+	}
+
+	if( strchr( item->resource, '/' ) != NULL ) {									// assume fully qualified if it has a slant
+		snprintf( fname, sizeof( fname ), "%s", item->resource );
+	} else {
+		if( item->rtype == RT_ADD ) {
+			snprintf( fname, sizeof( fname ), "%s/%s", parms->config_dir, item->resource );
+		} else {
+			snprintf( fname, sizeof( fname ), "%s_live/%s", parms->config_dir, item->resource );		// if unqualified, assume it's in the live for deletion
+		}
+	}
+
+	if( item->rtype == RT_ADD ) {
+		bleat_printf( 2, "batch: adding vf from file: %s", fname );
+		if( (ok = vfd_add_vf( conf, fname, &reason )) ) {
+			relocate_vf_config( parms, fname, NULL );					// move the config to the live directory on success
+			snprintf( rbuf, rlen, "[%d] add %s: OK", idx, item->resource );
+		} else {
+			relocate_vf_config( parms, fname, ".error" );
+			snprintf( rbuf, rlen, "[%d] add %s: ERROR: %s", idx, item->resource, reason ? reason : "" );
+		}
+	} else {
+		bleat_printf( 2, "batch: deleting vf from file: %s", fname );
+		if( (ok = vfd_del_vf( parms, conf, fname, &reason )) ) {
+			snprintf( rbuf, rlen, "[%d] delete %s: OK", idx, item->resource );
+		} else {
+			snprintf( rbuf, rlen, "[%d] delete %s: ERROR: %s", idx, item->resource, reason ? reason : "" );
+		}
+	}
+
+	if( !ok && reason != NULL ) {
+		free( reason );
+	}
+
+	return ok;
+}
+
+/*
+	Execute a batch request. Each item is validated and applied to the in memory
+	config in order (exactly as a single add/delete would be) and then one nic
+	update pushes all of the changed VFs. The response has one line per item with
+	the item's result; the overall state is OK only if every item succeeded.
+
+	A delete only marks the VF; its vfid is released by the nic update. So that a VF
+	can be evacuated and rebuilt in one batch, an add which follows an accepted delete
+	first runs a nic update for the items so far. For example, to replace pf0:vf3:
+		iplex batch delete:vf3-old add:vf3-new
+	makes two nic passes (the delete, then the add); a batch of only adds, or only
+	deletes, makes one.
+*/
+static void batch_request( parms_t* parms, sriov_conf_t* conf, req_t* req ) {
+	char*	rbuf;			// response; one line per item
+	int		rlen;
+	int		l = 0;
+	int		i;
+	int		nok = 0;
+	int		ndel = 0;		// deletes accepted since the last nic update
+	int		nupd_err = 0;	// failed nic updates
+	char	ibuf[1024];
+
+	if( req->nitems <= 0 ) {
+		vfd_respond( req, RESP_ERROR, "batch request has no items (params.items)" );
+		return;
+	}
+
+	rlen = (req->nitems + 2) * sizeof( ibuf );
+	if( (rbuf = (char *) malloc( sizeof( char ) * rlen )) == NULL ) {
+		vfd_respond( req, RESP_ERROR, "batch request failed: memory allocation error" );
+		return;
+	}
+	*rbuf = 0;
+
+	for( i = 0; i < req->nitems; i++ ) {
+		if( ndel > 0 && req->items[i].rtype == RT_ADD ) {							// release deleted vfids so the add can reuse one
+			bleat_printf( 2, "batch: nic update before item %d to release %d deleted VFs", i, ndel );
+			if( vfd_update_nic( parms, conf ) != 0 ) {
+				l += snprintf( rbuf + l, rlen - l, "nic update failed; %d accepted items may not be configured\n", nok );
+				nupd_err++;
+			}
+			ndel = 0;
+		}
+
+		if( batch_item( parms, conf, i, &req->items[i], ibuf, sizeof( ibuf ) ) ) {
+			nok++;
+			if( req->items[i].rtype == RT_DEL ) {
+				ndel++;
+			}
+		}
+		l += snprintf( rbuf + l, rlen - l, "%s\n", ibuf );
+	}
+
+	if( nok > 0 ) {
+		if( vfd_update_nic( parms, conf ) != 0 ) {									// one pass for everything accepted since the last
+			l += snprintf( rbuf + l, rlen - l, "nic update failed; %d accepted items may not be configured\n", nok );
+			nupd_err++;
+		}
+	}
+	if( nupd_err > 0 ) {
+		nok = 0;
+	}
+
+	snprintf( rbuf + l, rlen - l, "batch: %d of %d items applied", nok, req->nitems );
+	bleat_printf( 1, "batch request: %d of %d items applied", nok, req->nitems );
+	vfd_respond( req, nok == req->nitems ? RESP_OK : RESP_ERROR, rbuf );
+	free( rbuf );
+
+	if( bleat_will_it( 4 ) ) {
+		dump_sriov_config( conf );
+	}
+}
+
+/*
+	Record the request's outcome and latency. Latency is from when the request was
+	queued to the nic worker (if it was) or started (if not) until now.
+*/
+static void req_metric( req_t* req, struct timespec* start ) {
+	req_metric_t*	mp;
+	struct timespec	now;
+	double	lat;
+	int		i;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	lat = (double) (now.tv_sec - start->tv_sec) + ((double) (now.tv_nsec - start->tv_nsec) / 1000000000.0);
+	if( req->qms > 0 ) {
+		lat += (double) ((((long long) start->tv_sec * 1000) + (start->tv_nsec / 1000000)) - req->qms) / 1000.0;
+	}
+
+	mp = &req_metrics[(req->rtype >= 0 && req->rtype < REQ_NTYPES) ? req->rtype : RT_NOP];
+	for( i = 0; i < REQ_NBUCKETS && lat > req_bounds[i]; i++ );
+
+	pthread_mutex_lock( &req_mlock );
+	mp->count++;
+	if( req->failed ) {
+		mp->errors++;
+	}
+	mp->sum += lat;
+	if( i < REQ_NBUCKETS ) {
+		mp->buckets[i]++;
+	}
+	pthread_mutex_unlock( &req_mlock );
+}
+
+/*
+	Execute a request and send the response. The response goes back to where the
+	request came from (fifo or socket) via vfd_respond().
+*/
+static void handle_request( parms_t *parms, sriov_conf_t* conf, req_t* req ) {
 	char	mbuf[2048];			// message and work buffer
 	char*	buf;				// buffer gnerated by something else
 	int		rc = 0;
 	char*	reason;
-	int		req_handled = 0;
-
-	if( forever ) {
-		bleat_printf( 1, "req_if: forever loop entered" );
-	}
+	struct timespec	start;
 
+	clock_gettime( CLOCK_MONOTONIC, &start );
 	memset( mbuf, 0, sizeof( mbuf ) );								// avoid valgrind's kinckers twisting because it's not intiialised
 	*mbuf = 0;
-	do {
-		if( (req = vfd_read_request( parms )) != NULL ) {
-			bleat_printf( 3, "got request" );
-			req_handled = 1;
 
-			switch( req->rtype ) {
-				case RT_PING:
-					bleat_printf( 3, "responding to ping" );
-					snprintf( mbuf, sizeof( mbuf ), "pong: %s", version );
-					vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, mbuf );
-					break;
+	if( !is_readonly( req ) ) {
+		bleat_push_glvl( req->log_level );			// push the level if greater, else push current so pop won't fail
+	}
 
-				case RT_ADD:
-					if( strchr( req->resource, '/' ) != NULL ) {									// assume fully qualified if it has a slant
-						strcpy( mbuf, req->resource );
-					} else {
-						snprintf( mbuf, sizeof( mbuf ), "%s/%s", parms->config_dir, req->resource );
-					}
+	switch( req->rtype ) {
+		case RT_PING:
+			bleat_printf( 3, "responding to ping" );
+			snprintf( mbuf, sizeof( mbuf ), "pong: %s", version );
+			vfd_respond( req, RESP_OK, mbuf );
+			break;
 
-					bleat_printf( 2, "adding vf from file: %s", mbuf );
-					if( vfd_add_vf( conf, mbuf, &reason ) ) {				// read the config file and add to in mem config if ok
-						relocate_vf_config( parms, mbuf, NULL );			// move the config to the live directory on success (nil suffix indicates live dir)
-						if( vfd_update_nic( parms, conf ) == 0 ) {			// added to config was good, drive the nic update
-							snprintf( mbuf, sizeof( mbuf ), "vf added successfully: %s", req->resource );
-							vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, mbuf );
-							bleat_printf( 1, "vf added: %s", mbuf );
-						} else {
-							// TODO -- must turn the vf off so that another add can be sent without forcing a delete
-							// 		update_nic always returns good now, so this waits until it catches errors and returns bad
-							snprintf( mbuf, sizeof( mbuf ), "vf add failed: unable to configure the vf for: %s", req->resource );
-							vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, mbuf );
-							bleat_printf( 1, "vf add failed nic update error" );
-						}
-					} else {
-						relocate_vf_config( parms, mbuf, ".error" );		// move the config file to *.error for debugging, but keep in same directory
-						snprintf( mbuf, sizeof( mbuf ), "unable to add vf: %s: %s", req->resource, reason );
-						vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, mbuf );
-						free( reason );
-					}
-					if( bleat_will_it( 4 ) ) {					// TODO:  remove after testing
+		case RT_ADD:
+			if( strchr( req->resource, '/' ) != NULL ) {									// assume fully qualified if it has a slant
+				strcpy( mbuf, req->resource );
+			} else {
+				snprintf( mbuf, sizeof( mbuf ), "%s/%s", parms->config_dir, req->resource );
+			}
+
+			bleat_printf( 2, "adding vf from file: %s", mbuf );
+			if( vfd_add_vf( conf, mbuf, &reason ) ) {				// read the config file and add to in mem config if ok
+				relocate_vf_config( parms, mbuf, NULL );			// move the config to the live directory on success (nil suffix indicates live dir)
+				if( vfd_update_nic( parms, conf ) == 0 ) {			// added to config was good, drive the nic update
+					snprintf( mbuf, sizeof( mbuf ), "vf added successfully: %s", req->resource );
+					vfd_respond( req, RESP_OK, mbuf );
+					bleat_printf( 1, "vf added: %s", mbuf );
+				} else {
+					// TODO -- must turn the vf off so that another add can be sent without forcing a delete
+					// 		update_nic always returns good now, so this waits until it catches errors and returns bad
+					snprintf( mbuf, sizeof( mbuf ), "vf add failed: unable to configure the vf for: %s", req->resource );
+					vfd_respond( req, RESP_ERROR, mbuf );
+					bleat_printf( 1, "vf add failed nic update error" );
+				}
+			} else {
+				relocate_vf_config( parms, mbuf, ".error" );		// move the config file to *.error for debugging, but keep in same directory
+				snprintf( mbuf, sizeof( mbuf ), "unable to add vf: %s: %s", req->resource, reason );
+				vfd_respond( req, RESP_ERROR, mbuf );
+				free( reason );
+			}
+			if( bleat_will_it( 4 ) ) {					// TODO:  remove after testing
   						dump_sriov_config( conf );
-					}
-					break;
+			}
+			break;
 
-				case RT_DEL:
-					if( strchr( req->resource, '/' ) != NULL ) {									// assume fully qualified if it has a slant
-						strcpy( mbuf, req->resource );
-					} else {
-						snprintf( mbuf, sizeof( mbuf ), "%s_live/%s", parms->config_dir, req->resource );		// if unqualified, assume it's in the live for deletion
-					}
+		case RT_DEL:
+			if( strchr( req->resource, '/' ) != NULL ) {									// assume fully qualified if it has a slant
+				strcpy( mbuf, req->resource );
+			} else {
+				snprintf( mbuf, sizeof( mbuf ), "%s_live/%s", parms->config_dir, req->resource );		// if unqualified, assume it's in the live for deletion
+			}
 
-					bleat_printf( 1, "deleting vf from file: %s", mbuf );
-					if( vfd_del_vf( parms, conf, mbuf, &reason ) ) {		// successfully updated internal struct
-						if( vfd_update_nic( parms, conf ) == 0 ) {			// nic update was good too
-							snprintf( mbuf, sizeof( mbuf ), "vf deleted successfully: %s", req->resource );
-							vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, mbuf );
-							bleat_printf( 1, "vf deleted: %s", mbuf );
-						} // TODO need else -- see above
-					} else {
-						snprintf( mbuf, sizeof( mbuf ), "unable to delete internal config for vf: %s: %s", req->resource, reason );
-						vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, mbuf );
-						free( reason );
-					}
-					if( bleat_will_it( 4 ) ) {					// TODO:  remove after testing
+			bleat_printf( 1, "deleting vf from file: %s", mbuf );
+			if( vfd_del_vf( parms, conf, mbuf, &reason ) ) {		// successfully updated internal struct
+				if( vfd_update_nic( parms, conf ) == 0 ) {			// nic update was good too
+					snprintf( mbuf, sizeof( mbuf ), "vf deleted successfully: %s", req->resource );
+					vfd_respond( req, RESP_OK, mbuf );
+					bleat_printf( 1, "vf deleted: %s", mbuf );
+				} // TODO need else -- see above
+			} else {
+				snprintf( mbuf, sizeof( mbuf ), "unable to delete internal config for vf: %s: %s", req->resource, reason );
+				vfd_respond( req, RESP_ERROR, mbuf );
+				free( reason );
+			}
+			if( bleat_will_it( 4 ) ) {					// TODO:  remove after testing
   						dump_sriov_config( conf );
-					}
-					break;
+			}
+			break;
 
-				case RT_DUMP:									// spew everything to the log
-					dump_dev_info( conf->num_ports);			// general info about each port
+		case RT_DUMP:									// spew everything to the log
+			dump_dev_info( conf->num_ports);			// general info about each port
   					dump_sriov_config( conf );					// pf/vf specific info
-					vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, "dump captured in the log" );
+			vfd_respond( req, RESP_OK, "dump captured in the log" );
 
-					char*	stats_buf;
-					if( (stats_buf = (char *) malloc( sizeof( char ) * 10 * 1024 )) != NULL ) {
-						if( port_xstats_display( 0, stats_buf, sizeof( char ) * 1024 * 10 ) > 0 ) {
-							bleat_printf( 0, "%s", stats_buf );
-						}
+			char*	stats_buf;
+			if( (stats_buf = gen_exstats( conf )) != NULL ) {		// from the stats snapshot, not the nic
+				bleat_printf( 0, "%s", stats_buf );
+				free( stats_buf );
+			}
+			break;
 
-						free( stats_buf );
-					}
-					break;
+		case RT_MIRROR:
+			if( parms->forreal ) {
+				if( vfd_update_mirror( conf, req->resource, &reason ) ) {
+					snprintf( mbuf, sizeof( mbuf ), "mirror update successful: %s", req->resource );
+					vfd_respond( req, RESP_OK, mbuf );
+				} else {
+					snprintf( mbuf, sizeof( mbuf ), "mirror update failed: %s: %s", req->resource, reason ? reason : "" );
+					vfd_respond( req, RESP_ERROR, mbuf );
+				}
+				bleat_printf( 1, "%s", mbuf );
 
-				case RT_MIRROR:
-					if( parms->forreal ) {
-						if( vfd_update_mirror( conf, req->resource, &reason ) ) {
-							snprintf( mbuf, sizeof( mbuf ), "mirror update successful: %s", req->resource );
-							vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, mbuf );
-						} else {
-							snprintf( mbuf, sizeof( mbuf ), "mirror update failed: %s: %s", req->resource, reason ? reason : "" );
-							vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, mbuf );
-						}
-						bleat_printf( 1, "%s", mbuf );
+			} else {
+				bleat_printf( 1, "mirror request received, but ignored (forreal is off): %s", req->resource == NULL ? "" : req->resource );
+			}
+			break;
 
-					} else {
-						bleat_printf( 1, "mirror request received, but ignored (forreal is off): %s", req->resource == NULL ? "" : req->resource );
-					}
-					break;
+		case RT_SHOW:
+			if( parms->forreal ) {
+				if( req->resource == NULL ) {
+					vfd_respond( req, RESP_ERROR, "unable to generate stats: internal mishap: null resource" );
+				} else {
+					switch( *req->resource ) {
+						case 'a':
+							if( strcmp( req->resource, "all" ) == 0 ) {				// dump just the VF information
+								if( (buf = gen_stats( conf, !PFS_ONLY, ALL_PFS )) != NULL )  {
+									vfd_respond( req, RESP_OK, buf );
+									free( buf );
+								} else {
+									vfd_respond( req, RESP_ERROR, "unable to generate stats" );
+								}
+							} else {
+								vfd_respond( req, RESP_ERROR, "unrecognised show suboption" );
+							}
+							break;
 
-				case RT_SHOW:
-					if( parms->forreal ) {
-						if( req->resource == NULL ) {
-							vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unable to generate stats: internal mishap: null resource" );
-						} else {
-							switch( *req->resource ) {
-								case 'a':
-									if( strcmp( req->resource, "all" ) == 0 ) {				// dump just the VF information
-										if( (buf = gen_stats( conf, !PFS_ONLY, ALL_PFS )) != NULL )  {
-											vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, buf );
-											free( buf );
-										} else {
-											vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unable to generate stats" );
-										}
-									} else {
-										vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unrecognised show suboption" );
-									}
-									break;
-
-								case 'e':
-									if( strncmp( req->resource, "ex", 2 ) == 0 ) {							// show extended stats
-										buf = gen_exstats( conf );						// create a buffer with stats for all ports
-										if( buf != NULL ) {
-											vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, buf );
-											free( buf );
-										} else {
-											vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unable to generate extended stats" );
-										}
-									} else {
-										vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unrecognised show suboption" );
-									}
-									break;
+						case 'e':
+							if( strncmp( req->resource, "ex", 2 ) == 0 ) {							// show extended stats
+								buf = gen_exstats( conf );						// create a buffer with stats for all ports
+								if( buf != NULL ) {
+									vfd_respond( req, RESP_OK, buf );
+									free( buf );
+								} else {
+									vfd_respond( req, RESP_ERROR, "unable to generate extended stats" );
+								}
+							} else {
+								vfd_respond( req, RESP_ERROR, "unrecognised show suboption" );
+							}
+							break;
 
-								case 'm':			// show mirrors for a pf
-									if( strncmp( req->resource, "mirror", 6 ) == 0 ) {
-										if( (buf = gen_mirror_stats( conf, -1 )) != NULL ) {
-											vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, buf );
-											free( buf );
-										} else {
-											vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unable to generate mirror stats" );
-										}
-									} else {
-										vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unrecognised show suboption" );
-									}
-									break;
+						case 'm':			// show mirrors for a pf
+							if( strncmp( req->resource, "mirror", 6 ) == 0 ) {
+								if( (buf = gen_mirror_stats( conf, -1 )) != NULL ) {
+									vfd_respond( req, RESP_OK, buf );
+									free( buf );
+								} else {
+									vfd_respond( req, RESP_ERROR, "unable to generate mirror stats" );
+								}
+							} else {
+								vfd_respond( req, RESP_ERROR, "unrecognised show suboption" );
+							}
+							break;
 
-								case 'p':
-									if( strcmp( req->resource, "pfs" ) == 0 ) {								// dump just the PF information (skip vf)
-										if( (buf = gen_stats( conf, PFS_ONLY, ALL_PFS )) != NULL )  {
-											vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, buf );
-											free( buf );
-										} else {
-											vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unable to generate pf stats" );
-										}
-									} else {
-										vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unrecognised show suboption" );
-									}
-									break;
-								
-								default:
-									if( isdigit( *req->resource ) ) {						// dump just for the indicated pf
-										if( (buf = gen_stats( conf, !PFS_ONLY, atoi( req->resource ) )) != NULL )  {
-											vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, buf );
-											free( buf );
+						case 'r':			// show rates [pfN[:vfM]] [json]
+							if( strncmp( req->resource, "rates", 5 ) == 0 ) {
+								char*	target = NULL;
+								char*	tok;
+								char*	tptr;
+								const char*	err = NULL;
+								int		json = 0;
+
+								if( (tptr = strdup( req->resource + 5 )) != NULL ) {
+									char*	dp = tptr;
+
+									while( (tok = strtok_r( NULL, " ", &dp )) != NULL ) {
+										if( strcmp( tok, "json" ) == 0 ) {
+											json = 1;
 										} else {
-											vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unable to generate pf stats" );
-										}
-									} else {												// assume we dump for all
-										if( req->resource ) {
-											bleat_printf( 2, "show: unknown target supplied: %s", req->resource );
+											target = tok;
 										}
-										vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, 
-												"unable to generate stats: unnown target supplied (not one of all, pfs, extended or pf-number)" );
 									}
+								}
+
+								if( (buf = gen_rates( target, json, &err )) != NULL ) {
+									vfd_respond( req, RESP_OK, buf );
+									free( buf );
+								} else {
+									snprintf( mbuf, sizeof( mbuf ), "unable to generate rates: %s", err ? err : "unknown error" );
+									vfd_respond( req, RESP_ERROR, mbuf );
+								}
+
+								if( tptr != NULL ) {
+									free( tptr );
+								}
+							} else {
+								vfd_respond( req, RESP_ERROR, "unrecognised show suboption" );
 							}
-						}
-					} else {
-						vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "VFD running in 'no harm' (-n) mode; no stats available." );
-					}
-					break;
+							break;
 
-				case RT_CPU_ALARM:
-						if( req->resource != NULL ) {
-							if( strchr( req->resource, '%' ) ) {				// allow 30% or .30
-								parms->cpu_alrm_thresh = (double) atoi( req->resource ) / 100.0;
+						case 'p':
+							if( strcmp( req->resource, "pfs" ) == 0 ) {								// dump just the PF information (skip vf)
+								if( (buf = gen_stats( conf, PFS_ONLY, ALL_PFS )) != NULL )  {
+									vfd_respond( req, RESP_OK, buf );
+									free( buf );
+								} else {
+									vfd_respond( req, RESP_ERROR, "unable to generate pf stats" );
+								}
 							} else {
-								parms->cpu_alrm_thresh = strtod( req->resource, NULL );
+								vfd_respond( req, RESP_ERROR, "unrecognised show suboption" );
 							}
-							if( parms->cpu_alrm_thresh < 0.05 ) {
-								parms->cpu_alrm_thresh = 0.05;			// enforce sanity (no upper limit enforced allowing it to be set off with high value)
+							break;
+						
+						default:
+							if( isdigit( *req->resource ) ) {						// dump just for the indicated pf
+								if( (buf = gen_stats( conf, !PFS_ONLY, atoi( req->resource ) )) != NULL )  {
+									vfd_respond( req, RESP_OK, buf );
+									free( buf );
+								} else {
+									vfd_respond( req, RESP_ERROR, "unable to generate pf stats" );
+								}
+							} else {												// assume we dump for all
+								if( req->resource ) {
+									bleat_printf( 2, "show: unknown target supplied: %s", req->resource );
+								}
+								vfd_respond( req, RESP_ERROR, 
+										"unable to generate stats: unnown target supplied (not one of all, pfs, extended, rates or pf-number)" );
 							}
+					}
+				}
+			} else {
+				vfd_respond( req, RESP_ERROR, "VFD running in 'no harm' (-n) mode; no stats available." );
+			}
+			break;
 
-							bleat_printf( 1, "cpu alarm threshold changed to %d%%", (int) (parms->cpu_alrm_thresh  * 100) );
-							snprintf( mbuf, sizeof( mbuf ), "cpu alarm threshold changed to: %d%%", (int) (parms->cpu_alrm_thresh * 100) );
-						} else {
-							rc = 1;
-							snprintf( mbuf, sizeof( mbuf ), "cpu alarm threshold not changed to: bad or missing value" );
-						}
+		case RT_BATCH:
+			batch_request( parms, conf, req );
+			break;
 
-						vfd_response( req->resp_fifo, rc, req->vfd_rid, mbuf );
-						break;
+		case RT_CPU_ALARM:
+				if( req->resource != NULL ) {
+					if( strchr( req->resource, '%' ) ) {				// allow 30% or .30
+						parms->cpu_alrm_thresh = (double) atoi( req->resource ) / 100.0;
+					} else {
+						parms->cpu_alrm_thresh = strtod( req->resource, NULL );
+					}
+					if( parms->cpu_alrm_thresh < 0.05 ) {
+						parms->cpu_alrm_thresh = 0.05;			// enforce sanity (no upper limit enforced allowing it to be set off with high value)
+					}
 
+					bleat_printf( 1, "cpu alarm threshold changed to %d%%", (int) (parms->cpu_alrm_thresh  * 100) );
+					snprintf( mbuf, sizeof( mbuf ), "cpu alarm threshold changed to: %d%%", (int) (parms->cpu_alrm_thresh * 100) );
+				} else {
+					rc = 1;
+					snprintf( mbuf, sizeof( mbuf ), "cpu alarm threshold not changed to: bad or missing value" );
+				}
 
-				case RT_VERBOSE:
-					if( req->log_level >= 0 ) {
-						bleat_set_lvl( req->log_level );
-						bleat_push_lvl( req->log_level );			// save it so when we pop later it doesn't revert
+				vfd_respond( req, rc, mbuf );
+				break;
 
-						bleat_printf( 0, "verbose level changed to %d", req->log_level );
-						snprintf( mbuf, sizeof( mbuf ), "verbose level changed to: %d", req->log_level );
-					} else {
-						rc = 1;
-						snprintf( mbuf, sizeof( mbuf ), "loglevel out of range: %d", req->log_level );
-					}
 
-					vfd_response( req->resp_fifo, rc, req->vfd_rid, mbuf );
-					break;
-					
+		case RT_VERBOSE:
+			if( req->log_level >= 0 ) {
+				bleat_set_lvl( req->log_level );
+				bleat_push_lvl( req->log_level );			// save it so when we pop later it doesn't revert
 
-				default:
-					vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "dummy request handler: urrecognised request." );
-					break;
+				bleat_printf( 0, "verbose level changed to %d", req->log_level );
+				snprintf( mbuf, sizeof( mbuf ), "verbose level changed to: %d", req->log_level );
+			} else {
+				rc = 1;
+				snprintf( mbuf, sizeof( mbuf ), "loglevel out of range: %d", req->log_level );
 			}
 
-			vfd_free_request( req );
+			vfd_respond( req, rc, mbuf );
+			break;
+			
+
+		default:
+			vfd_respond( req, RESP_ERROR, "dummy request handler: urrecognised request." );
+			break;
+	}
+
+	if( !is_readonly( req ) ) {
+		bleat_pop_lvl();
+	}
+
+	req_metric( req, &start );
+}
+
+static long long wq_now_ms( void ) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ((long long) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+/*
+	NIC worker thread. Executes queued requests one at a time in the order they were
+	received so that adds, deletes and the like are applied exactly as they would
+	have been inline. When stopping, anything still queued is answered with an
+	error rather than being executed.
+*/
+static void* req_worker( void* data ) {
+	req_t*	req;
+	int		fd;
+	int		stopping;
+	long long	wait;
+
+	while( 1 ) {
+		pthread_mutex_lock( &wq_lock );
+		while( wq_head == NULL && wq_state == WQ_RUNNING ) {
+			pthread_cond_wait( &wq_cond, &wq_lock );
+		}
+
+		if( (req = wq_head) == NULL ) {						// stopping and drained
+			pthread_mutex_unlock( &wq_lock );
+			break;
+		}
+
+		if( (wq_head = req->next) == NULL ) {
+			wq_tail = NULL;
+		}
+		wq_depth--;
+		wait = wq_now_ms() - req->qms;
+		wq_wait_ms = wait;
+		if( wait > wq_wait_max ) {
+			wq_wait_max = wait;
+		}
+		stopping = wq_state != WQ_RUNNING;
+		pthread_mutex_unlock( &wq_lock );
+
+		fd = req->sock_fd;									// respond may clear it if the client goes away
+		if( stopping ) {
+			vfd_respond( req, RESP_ERROR, "VFd is shutting down; request was not executed" );
+		} else {
+			bleat_printf( 3, "nic worker: executing request %s (waited %lldms)", req->vfd_rid ? req->vfd_rid : "", wait );
+			handle_request( wq_parms, wq_conf, req );
+		}
+
+		if( fd >= 0 ) {
+			sock_release( fd );
+		}
+		vfd_free_request( req );
+
+		pthread_mutex_lock( &wq_lock );
+		wq_done++;
+		pthread_mutex_unlock( &wq_lock );
+	}
+
+	return NULL;
+}
+
+/*
+	Start the NIC worker. Until this is called (or if it fails) every request is
+	executed inline by the caller of vfd_req_if()/vfd_sock_if(). Returns 0 on success.
+*/
+extern int vfd_start_req_worker( parms_t* parms, sriov_conf_t* conf ) {
+	if( wq_state != WQ_OFF ) {
+		return 0;
+	}
+
+	wq_parms = parms;
+	wq_conf = conf;
+	wq_state = WQ_RUNNING;
+	if( pthread_create( &wq_tid, NULL, req_worker, NULL ) != 0 ) {
+		bleat_printf( 0, "WRN: unable to start request worker thread; requests will be executed inline: %s", strerror( errno ) );
+		wq_state = WQ_OFF;
+		return -1;
+	}
+	if( rte_thread_setname( wq_tid, "vfd-req" ) != 0 ) {
+		bleat_printf( 2, "error: failed to set thread name: %s", "vfd-req" );
+	}
+
+	bleat_printf( 1, "request worker thread started" );
+	return 0;
+}
+
+/*
+	Stop the NIC worker. The request being executed is allowed to finish; anything
+	still queued is rejected. Returns after the thread has exited.
+*/
+extern void vfd_stop_req_worker( void ) {
+	if( wq_state != WQ_RUNNING ) {
+		return;
+	}
+
+	pthread_mutex_lock( &wq_lock );
+	wq_state = WQ_STOPPING;
+	pthread_cond_signal( &wq_cond );
+	pthread_mutex_unlock( &wq_lock );
+
+	pthread_join( wq_tid, NULL );
+	wq_state = WQ_OFF;
+}
+
+/*
+	Read only requests, which are answered immediately from the control thread.
+	Dump walks the live config (callback strings, vf_slot map) and verbose changes
+	the log level which the worker pushes and pops, so both are queued to the
+	worker with the requests which change state.
+*/
+static int is_readonly( req_t* req ) {
+	switch( req->rtype ) {
+		case RT_PING:
+			return 1;
+
+		case RT_SHOW:					// mirror state is changed by the worker without a lock; that show must queue behind it
+			return req->resource == NULL || strncmp( req->resource, "mirror", 6 ) != 0;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+/*
+	Run a request. Read only requests (or all requests if the worker isn't running)
+	are executed now; anything that changes state is queued to the NIC worker so that
+	it is not waiting behind slow NIC work. Responses carry the request's vfd_rid so
+	a socket client with several requests outstanding can match them up.
+	Returns true if the request was queued; the worker then owns (and frees) it.
+*/
+static int dispatch_request( parms_t *parms, sriov_conf_t* conf, req_t* req ) {
+	int	fd;
+
+	if( is_readonly( req ) || wq_state != WQ_RUNNING ) {
+		pthread_mutex_lock( &wq_lock );
+		wq_inline++;
+		pthread_mutex_unlock( &wq_lock );
+
+		handle_request( parms, conf, req );
+		return 0;
+	}
+
+	if( (fd = req->sock_fd) >= 0 ) {
+		sock_hold( fd );
+	}
+
+	pthread_mutex_lock( &wq_lock );
+	if( wq_depth >= REQ_Q_MAX ) {
+		pthread_mutex_unlock( &wq_lock );
+		bleat_printf( 1, "WRN: request worker queue is full (%d); request rejected", REQ_Q_MAX );
+		vfd_respond( req, RESP_ERROR, "request queue is full; try again later" );
+		if( fd >= 0 ) {
+			sock_release( fd );
+		}
+		return 0;
+	}
+
+	req->next = NULL;
+	req->qms = wq_now_ms();
+	if( wq_tail != NULL ) {
+		wq_tail->next = req;
+	} else {
+		wq_head = req;
+	}
+	wq_tail = req;
+	wq_queued++;
+	if( ++wq_depth > wq_max_depth ) {
+		wq_max_depth = wq_depth;
+	}
+	pthread_cond_signal( &wq_cond );
+	pthread_mutex_unlock( &wq_lock );
+
+	bleat_printf( 3, "request queued to nic worker: depth=%d", wq_depth );
+	return 1;
+}
+
+/*
+	Fill buf with the request lane counters. Returns the length of the string placed into buf.
+*/
+extern int vfd_req_stats( char* buf, int blen ) {
+	int l;
+
+	pthread_mutex_lock( &wq_lock );
+	l = snprintf( buf, blen, "requests  inline: %ld  queued: %ld  done: %ld  depth: %d  max-depth: %d  wait: %lldms  max-wait: %lldms\n",
+		wq_inline, wq_queued, wq_done, wq_depth, wq_max_depth, wq_wait_ms, wq_wait_max );
+	pthread_mutex_unlock( &wq_lock );
+
+	if( l >= blen ) {
+		l = blen - 1;
+	}
+	return l;
+}
+
+/*
+	Add the request counters to buf in OpenMetrics form: a latency histogram and
+	error count per request type (types never seen are skipped), and the nic
+	worker queue. Returns the length added.
+*/
+extern int vfd_req_metrics( char* buf, int blen ) {
+	req_metric_t	m[REQ_NTYPES];
+	long	cum;
+	int		l;
+	int		t;
+	int		i;
+
+	pthread_mutex_lock( &req_mlock );
+	memcpy( m, req_metrics, sizeof( m ) );
+	pthread_mutex_unlock( &req_mlock );
+
+	l = snprintf( buf, blen, "# TYPE vfd_request_seconds histogram\n# HELP vfd_request_seconds Time from receipt (or queueing) to response.\n" );
+	for( t = 0; t < REQ_NTYPES && l < blen; t++ ) {
+		if( m[t].count == 0 ) {
+			continue;
+		}
+
+		cum = 0;
+		for( i = 0; i < REQ_NBUCKETS && l < blen; i++ ) {
+			cum += m[t].buckets[i];
+			l += snprintf( buf + l, blen - l, "vfd_request_seconds_bucket{type=\"%s\",le=\"%g\"} %ld\n", req_names[t], req_bounds[i], cum );
+		}
+		if( l < blen ) {
+			l += snprintf( buf + l, blen - l, "vfd_request_seconds_bucket{type=\"%s\",le=\"+Inf\"} %ld\nvfd_request_seconds_count{type=\"%s\"} %ld\nvfd_request_seconds_sum{type=\"%s\"} %.6f\n",
+				req_names[t], m[t].count, req_names[t], m[t].count, req_names[t], m[t].sum );
+		}
+	}
+
+	if( l < blen ) {
+		l += snprintf( buf + l, blen - l, "# TYPE vfd_request_errors counter\n" );
+	}
+	for( t = 0; t < REQ_NTYPES && l < blen; t++ ) {
+		if( m[t].count > 0 ) {
+			l += snprintf( buf + l, blen - l, "vfd_request_errors_total{type=\"%s\"} %ld\n", req_names[t], m[t].errors );
+		}
+	}
+
+	if( l < blen ) {
+		pthread_mutex_lock( &wq_lock );
+		l += snprintf( buf + l, blen - l,
+			"# TYPE vfd_request_queue_depth gauge\n# HELP vfd_request_queue_depth Requests waiting for the nic worker.\nvfd_request_queue_depth %d\n"
+			"# TYPE vfd_request_queue_max_depth gauge\nvfd_request_queue_max_depth %d\n"
+			"# TYPE vfd_request_queue_wait_max_seconds gauge\nvfd_request_queue_wait_max_seconds %.3f\n",
+			wq_depth, wq_max_depth, (double) wq_wait_max / 1000.0 );
+		pthread_mutex_unlock( &wq_lock );
+	}
+
+	if( l >= blen ) {
+		l = blen - 1;
+	}
+	return l;
+}
+
+/*
+	Request interface. Checks the request pipe and handles a reqest. If
+	forever is set then this is a black hole (never returns).
+	Returns true if it handled a request, false otherwise.
+*/
+extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
+	req_t*	req;
+	int		req_handled = 0;
+
+	if( forever ) {
+		bleat_printf( 1, "req_if: forever loop entered" );
+	}
+
+	do {
+		if( (req = vfd_read_request( parms )) != NULL ) {
+			bleat_printf( 3, "got request" );
+			req_handled = 1;
+
+			if( !dispatch_request( parms, conf, req ) ) {
+				vfd_free_request( req );
+			}
 		}
 		
 		if( forever )
@@ -1660,3 +2716,76 @@ extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
 
 	return req_handled;			// true if we did something -- more frequent recall if we did
 }
+
+/*
+	Socket request interface. Accepts any new connections and handles every request
+	that is waiting on a client connection. Never blocks; call when the fd returned
+	by vfd_init_sock() is readable (or periodically). Returns the number of requests
+	handled.
+*/
+extern int vfd_sock_if( parms_t *parms, sriov_conf_t* conf ) {
+	struct epoll_event	events[MAX_SOCK_CLIENTS];
+	req_t*	req;
+	char*	rbuf;
+	int		nev;
+	int		i;
+	int		fd;
+	int		len;
+	int		handled = 0;
+
+	if( sock_ep < 0 ) {
+		return 0;
+	}
+
+	if( (nev = epoll_wait( sock_ep, events, MAX_SOCK_CLIENTS, 0 )) <= 0 ) {
+		return 0;
+	}
+
+	for( i = 0; i < nev; i++ ) {
+		fd = events[i].data.fd;
+		if( fd == sock_lfd ) {
+			sock_accept();
+			continue;
+		}
+
+		if( (rbuf = (char *) malloc( sizeof( char ) * (SOCK_RBUF_SIZE + 1) )) == NULL ) {
+			break;
+		}
+
+		while( fd >= 0 && (len = recv( fd, rbuf, SOCK_RBUF_SIZE, MSG_TRUNC )) != 0 ) {		// seqpacket: one request per message
+			if( len < 0 ) {
+				if( errno != EAGAIN && errno != EWOULDBLOCK ) {
+					sock_drop( fd );
+				}
+				break;
+			}
+
+			if( len > SOCK_RBUF_SIZE ) {
+				bleat_printf( 0, "ERR: request socket: request from client %d too large: %d bytes (max %d); dropping client", fd, len, SOCK_RBUF_SIZE );
+				sock_drop( fd );
+				break;
+			}
+
+			rbuf[len] = 0;
+			if( (req = parse_request( strdup( rbuf ) )) != NULL ) {
+				bleat_printf( 3, "got request on socket %d", fd );
+				req->sock_fd = fd;
+				if( !dispatch_request( parms, conf, req ) ) {
+					if( req->sock_fd < 0 ) {					// send failed and client was dropped
+						fd = -1;
+					}
+					vfd_free_request( req );
+				}
+				handled++;
+			}
+		}
+
+		if( len == 0 && fd >= 0 ) {								// orderly close by client
+			sock_drop( fd );
+		}
+
+		free( rbuf );
+	}
+
+	return handled;
+}
@@ -5,6 +5,11 @@
 	Abstract:	Request interface header.
 	Author:		E. Scott Daniels
 	Date:		11 October 2016
+
+	Mods:		16 Oct 2026 - Add request socket support.
+				16 Oct 2026 - Add batch request.
+				16 Oct 2026 - Add the nic worker request lane.
+				16 Oct 2026 - Add vfd_size_port().
 */
 
 #ifndef _VFD_RIF_H
@@ -27,22 +32,37 @@
 #define RT_DUMP 6
 #define RT_MIRROR 7				// mirror on/off command
 #define RT_CPU_ALARM 8			// set the cpu alarm threshold
+#define RT_BATCH 9				// list of adds/deletes applied with one nic update
 
 #define BUF_1K	1024			// simple buffer size constants
 #define BUF_10K BUF_1K * 10
 
+#define MAX_BATCH	256			// max items in a batch request
+
+typedef struct request_item {	// one add/delete in a batch request
+	int		rtype;				// RT_ADD or RT_DEL
+	char*	resource;			// config file name
+} req_item_t;
+
 typedef struct request {
 	int		rtype;				// type: RT_ const
 	char*	resource;			// parm file name, show target, etc.
 	char*	resp_fifo;			// name of the return pipe
 	int		log_level;			// for verbose
 	char*	vfd_rid;			// request id that must be placed into the response (allows single response pipe by request process)
+	int		sock_fd;			// request socket connection the request arrived on; -1 if from the fifo
+	int		nitems;				// number of items in a batch request
+	req_item_t*	items;			// the batch items
+	long long	qms;			// monotonic ms when queued to the nic worker
+	int		failed;				// an error response was sent (request metrics)
+	struct request*	next;		// nic worker queue link
 } req_t;
 
 // ------------------ prototypes ---------------------------------------------
 extern int vfd_init_fifo( parms_t* parms );
 extern int check_tcs( struct sriov_port_s* port, uint8_t *tc_pctgs );
 extern void vfd_add_ports( parms_t* parms, sriov_conf_t* conf );
+extern int vfd_size_port( struct sriov_port_s* port, int nvfs );
 extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason );
 extern void vfd_add_all_vfs(  parms_t* parms, sriov_conf_t* conf );
 extern int vfd_del_vf( parms_t* parms, sriov_conf_t* conf, char* fname, char** reason );
@@ -51,6 +71,14 @@ extern void vfd_response( char* rpipe, int state, const_str vfd_rid, const char*
 extern void vfd_free_request( req_t* req );
 extern req_t* vfd_read_request( parms_t* parms );
 extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever );
+extern int vfd_init_sock( parms_t* parms );
+extern void vfd_close_sock( parms_t* parms );
+extern void vfd_respond( req_t* req, int state, const_str msg );
+extern int vfd_sock_if( parms_t *parms, sriov_conf_t* conf );
+extern int vfd_start_req_worker( parms_t* parms, sriov_conf_t* conf );
+extern void vfd_stop_req_worker( void );
+extern int vfd_req_stats( char* buf, int blen );
+extern int vfd_req_metrics( char* buf, int blen );
 
 
 #endif
@@ -0,0 +1,528 @@
+// vi: sw=4 ts=4 noet:
+/*
+	Mnemonic:	vfd_stats.c
+	Abstract:	Stats snapshot engine. The counters for every PF and configured VF
+				are collected in one sweep into a preallocated struct of arrays
+				snapshot. Show, the netlink stats path and any exporter format from
+				the snapshot so that several consumers polling at the same time cost
+				one pass over the NICs rather than one each.
+
+				A sweep is made from the housekeeping tick when the stats_interval
+				parm is set, or on demand when a consumer asks for a snapshot which
+				is older than it is willing to accept.
+
+				There are two snapshots; the sweep fills the one not being read and
+				then swaps the current pointer under the write side of a rwlock.
+				Consumers hold the read side from stats_snap_get() until they call
+				stats_snap_put(), so a snapshot never changes under a reader.
+
+				The PCI address of a PF does not change, so it is looked up once per
+				port rather than on every sweep.
+
+				The PF extended stats selected with the xstats parm are collected with
+				the rest of the PF's counters so that exporters never go to the NIC.
+
+				When the shm_stats parm is set each sweep is also published to the
+				shared memory segment (lib/shm_stats.c) so that agents on the host
+				can read counters without making requests. The sweep is the only
+				writer and it publishes while holding the collect lock.
+
+	Date:		16 Oct 2026
+*/
+
+#include <pthread.h>
+
+#include "sriov.h"
+
+static stats_snap_t	snaps[2];
+static stats_snap_t* cur_snap = &snaps[0];		// the one consumers read
+static pthread_rwlock_t snap_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t collect_lock = PTHREAD_MUTEX_INITIALIZER;	// one sweep at a time
+
+static int			pci_known[MAX_PORTS];		// pf pci address has been looked up (by rte port number)
+static uint16_t		pci_domain[MAX_PORTS];
+static uint32_t		pci_ari[MAX_PORTS];
+
+static uint64_t	nsweeps_ivl = 0;				// sweeps driven by the interval
+static uint64_t	nsweeps_demand = 0;				// sweeps made because a consumer wanted fresh data
+static uint64_t	nreads = 0;						// snapshots handed to consumers
+static double	sweep_ms = 0.0;					// duration of the last sweep
+static double	sweep_max_ms = 0.0;
+
+static void*	shm_seg = NULL;					// shared memory segment when publishing
+
+static long long stats_now_ms( void ) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ((long long) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+static long long wall_ms( void ) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_REALTIME, &ts );
+	return ((long long) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+/*
+	Look up the pci address of the port once. Returns 0 if dpdk does not
+	know it (the pf is skipped).
+*/
+static int pf_pci( int port ) {
+	struct rte_eth_dev_info dev_info;
+
+	if( port < 0 || port >= MAX_PORTS ) {
+		return 0;
+	}
+
+	if( ! pci_known[port] ) {
+		memset( &dev_info, 0, sizeof( dev_info ) );			// no status from rte function, but if it fails to populate we need to know, so 0s required
+		rte_eth_dev_info_get( port, &dev_info );
+		if( dev_info.pci_dev == NULL ) {
+			return 0;
+		}
+
+		pci_domain[port] = dev_info.pci_dev->addr.domain;
+		pci_ari[port] = dev_info.pci_dev->addr.bus << 8 | dev_info.pci_dev->addr.devid << 3 | dev_info.pci_dev->addr.function;
+		pci_known[port] = 1;
+	}
+
+	return 1;
+}
+
+/*
+	Fill the snapshot with the PF counters for config port index i.
+*/
+static void sweep_pf( stats_snap_t* sp, sriov_port_t* port, int i ) {
+	struct rte_eth_stats stats;
+	struct rte_eth_link link;
+	const struct vfd_nic_ops* ops;
+	int		pn;
+
+	pn = port->rte_port_number;
+	sp->pf_port[i] = pn;
+	if( ! (sp->pf_valid[i] = pf_pci( pn )) ) {
+		return;
+	}
+	sp->pf_domain[i] = pci_domain[pn];
+	sp->pf_ari[i] = pci_ari[pn];
+
+	memset( &stats, 0, sizeof( stats ) );
+	memset( &link, 0, sizeof( link ) );
+	rte_eth_link_get_nowait( pn, &link );
+	rte_eth_stats_get( pn, &stats );
+
+	ops = get_nic_ops( pn );
+	if( ops->get_pf_spoof_stats != NULL ) {
+		if( ops->flags & NOF_PFSPOOF_COR ) {
+			spoffed[pn] += ops->get_pf_spoof_stats( pn ); 		// counter reset on read, so we must accumulate
+		} else {
+			spoffed[pn] = ops->get_pf_spoof_stats( pn );
+		}
+	}
+
+	sp->pf_link[i] = link.link_status;
+	sp->pf_speed[i] = link.link_speed;
+	sp->pf_duplex[i] = link.link_duplex;
+	sp->pf_ipackets[i] = stats.ipackets;
+	sp->pf_ibytes[i] = stats.ibytes;
+	sp->pf_ierrors[i] = stats.ierrors;
+	sp->pf_imissed[i] = stats.imissed;
+	sp->pf_nombuf[i] = stats.rx_nombuf;
+	sp->pf_opackets[i] = stats.opackets;
+	sp->pf_obytes[i] = stats.obytes;
+	sp->pf_oerrors[i] = stats.oerrors;
+	sp->pf_spoofed[i] = spoffed[pn];
+	sp->pf_nxs[i] = xstats_collect( pn, sp->pf_xs_name[i], sp->pf_xs_val[i], SNAP_MAX_XS );
+}
+
+/*
+	Fill snapshot slot j with the counters for the vf.
+*/
+static void sweep_vf( stats_snap_t* sp, sriov_port_t* port, int i, int vf, int j ) {
+	struct rte_eth_stats stats;
+	const struct vfd_nic_ops* ops;
+	int		pn;
+	int		result = 0;
+	int		mcounter = 0;
+
+	pn = port->rte_port_number;
+	sp->vf_num[j] = vf;
+	sp->vf_ari[j] = sp->pf_ari[i] + port->vf_offset + (vf * port->vf_stride);
+	sp->vf_spoofed[j] = 0;
+
+	memset( &stats, 0, sizeof( stats ) );			// not all NICs fill all data, so ensure we have 0s
+	ops = get_nic_ops( pn );
+	if( ops->get_vf_stats != NULL ) {
+		result = ops->get_vf_stats( pn, vf, &stats );
+	}
+	if( ops->get_vf_spoof_stats != NULL ) {
+		sp->vf_spoofed[j] = ops->get_vf_spoof_stats( pn, vf );
+	}
+	if( result != 0 ) {
+		bleat_printf( 0, "fail: stats sweep: port %d, vf=%d: errno=%d", pn, vf, result );
+	}
+
+	sp->vf_up[j] = is_rx_queue_on( pn, vf, &mcounter ) ? 1 : 0;
+	sp->vf_ipackets[j] = stats.ipackets;
+	sp->vf_ibytes[j] = stats.ibytes;
+	sp->vf_ierrors[j] = stats.ierrors;
+	sp->vf_nombuf[j] = stats.rx_nombuf;
+	sp->vf_opackets[j] = stats.opackets;
+	sp->vf_obytes[j] = stats.obytes;
+	sp->vf_oerrors[j] = stats.oerrors;
+}
+
+/*
+	Copy the snapshot into the shared memory segment: one record per pf followed
+	by its vfs. Records are rewritten only under their own sequence number, so a
+	reader never waits on us and we never wait on a reader.
+*/
+static void shm_publish( const stats_snap_t* sp ) {
+	shm_stats_rec_t* rec;
+	long long	now;
+	uint32_t	ari;
+	int		n = 0;
+	int		i;
+	int		j;
+
+	now = wall_ms();
+	for( i = 0; i < sp->nports; i++ ) {
+		if( ! sp->pf_valid[i] || (rec = shm_stats_wbegin( shm_seg, n )) == NULL ) {
+			continue;
+		}
+
+		ari = sp->pf_ari[i];
+		rec->port = sp->pf_port[i];
+		rec->vf = -1;
+		rec->valid = 1;
+		rec->link = sp->pf_link[i];
+		rec->speed = sp->pf_speed[i];
+		snprintf( rec->pciid, sizeof( rec->pciid ), "%04X:%02X:%02X.%01X", sp->pf_domain[i], (ari >> 8) & 0xff, (ari >> 3) & 0x1f, ari & 0x7 );
+		rec->gen = sp->gen;
+		rec->ms = now;
+		rec->ipackets = sp->pf_ipackets[i];
+		rec->ibytes = sp->pf_ibytes[i];
+		rec->ierrors = sp->pf_ierrors[i];
+		rec->imissed = sp->pf_imissed[i];
+		rec->nombuf = sp->pf_nombuf[i];
+		rec->opackets = sp->pf_opackets[i];
+		rec->obytes = sp->pf_obytes[i];
+		rec->oerrors = sp->pf_oerrors[i];
+		rec->spoofed = sp->pf_spoofed[i];
+		shm_stats_wend( rec );
+		n++;
+
+		for( j = sp->vf_first[i]; j < sp->vf_first[i] + sp->vf_count[i]; j++ ) {
+			if( (rec = shm_stats_wbegin( shm_seg, n )) == NULL ) {
+				break;
+			}
+
+			ari = sp->vf_ari[j];
+			rec->port = sp->pf_port[i];
+			rec->vf = sp->vf_num[j];
+			rec->valid = 1;
+			rec->link = sp->vf_up[j];
+			rec->speed = 0;
+			snprintf( rec->pciid, sizeof( rec->pciid ), "%04X:%02X:%02X.%01X", sp->pf_domain[i], (ari >> 8) & 0xff, (ari >> 3) & 0x1f, ari & 0x7 );
+			rec->gen = sp->gen;
+			rec->ms = now;
+			rec->ipackets = sp->vf_ipackets[j];
+			rec->ibytes = sp->vf_ibytes[j];
+			rec->ierrors = sp->vf_ierrors[j];
+			rec->imissed = 0;
+			rec->nombuf = sp->vf_nombuf[j];
+			rec->opackets = sp->vf_opackets[j];
+			rec->obytes = sp->vf_obytes[j];
+			rec->oerrors = sp->vf_oerrors[j];
+			rec->spoofed = sp->vf_spoofed[j];
+			shm_stats_wend( rec );
+			n++;
+		}
+	}
+
+	shm_stats_commit( shm_seg, n, sp->gen, now );
+}
+
+/*
+	Sweep all ports and VFs into a new snapshot and make it current. If the current
+	snapshot is younger than max_age ms nothing is done (another consumer beat us
+	to it); a max_age of 0 forces a sweep. Returns 1 if a sweep was made.
+
+	Like gen_stats() always has, the VF list is read without the update lock so that
+	a sweep is never waiting on an update pass; a VF deleted while we look is simply
+	reported (or not) in this sweep and correct in the next.
+*/
+extern int stats_collect( sriov_conf_t* conf, int max_age ) {
+	stats_snap_t*	sp;
+	sriov_port_t*	port;
+	long long	start;
+	int		i;
+	int		vf;
+
+	if( conf == NULL ) {
+		return 0;
+	}
+
+	pthread_mutex_lock( &collect_lock );
+	start = stats_now_ms();
+	if( max_age > 0 && cur_snap->gen > 0 && start - cur_snap->ms < max_age ) {
+		pthread_mutex_unlock( &collect_lock );
+		return 0;
+	}
+
+	sp = cur_snap == &snaps[0] ? &snaps[1] : &snaps[0];		// only we write the one not current
+	sp->nports = conf->num_ports > MAX_PORTS ? MAX_PORTS : conf->num_ports;
+	sp->nvfs = 0;
+	for( i = 0; i < MAX_PORTS; i++ ) {
+		sp->pf_six[i] = -1;
+	}
+	for( i = 0; i < sp->nports; i++ ) {
+		port = &conf->ports[i];
+		sweep_pf( sp, port, i );
+
+		sp->vf_first[i] = sp->nvfs;
+		sp->vf_count[i] = 0;
+		if( ! sp->pf_valid[i] ) {
+			continue;
+		}
+		if( port->rte_port_number >= 0 && port->rte_port_number < MAX_PORTS ) {
+			sp->pf_six[port->rte_port_number] = i;
+		}
+
+		for( vf = 0; vf < port->vfs_alloc && sp->nvfs < SNAP_MAX_VFS; vf++ ) {	// the vfid map yields in use VFs in number order
+			if( port->vf_slot[vf] < 0 ) {
+				continue;
+			}
+
+			sweep_vf( sp, port, i, vf, sp->nvfs );
+			sp->nvfs++;
+			sp->vf_count[i]++;
+		}
+	}
+
+	sp->ms = stats_now_ms();
+	sp->gen = cur_snap->gen + 1;
+
+	pthread_rwlock_wrlock( &snap_rwlock );						// wait for readers of the current one to finish
+	cur_snap = sp;
+	pthread_rwlock_unlock( &snap_rwlock );
+
+	if( shm_seg != NULL ) {
+		shm_publish( sp );
+	}
+
+	sweep_ms = (double) (sp->ms - start);
+	if( sweep_ms > sweep_max_ms ) {
+		sweep_max_ms = sweep_ms;
+	}
+	if( max_age > 0 ) {
+		nsweeps_demand++;
+	} else {
+		nsweeps_ivl++;
+	}
+	pthread_mutex_unlock( &collect_lock );
+
+	bleat_printf( 4, "stats sweep %llu: %d ports %d vfs in %.0fms", (unsigned long long) sp->gen, sp->nports, sp->nvfs, sweep_ms );
+	return 1;
+}
+
+/*
+	Called on each housekeeping tick; makes a sweep when ivl ms have passed since
+	the last one. An ivl of 0 disables interval sweeps (on demand only).
+*/
+extern void stats_hk( sriov_conf_t* conf, int ivl ) {
+	if( ivl <= 0 ) {
+		return;
+	}
+
+	if( cur_snap->gen == 0 || stats_now_ms() - cur_snap->ms >= ivl ) {
+		stats_collect( conf, 0 );
+	}
+}
+
+/*
+	Return the current snapshot, sweeping first if it is older than max_age ms (a
+	max_age < 0 never sweeps). The caller MUST call stats_snap_put() when finished
+	with it, and must not sweep while holding it.
+*/
+extern const stats_snap_t* stats_snap_get( sriov_conf_t* conf, int max_age ) {
+	if( max_age >= 0 && (cur_snap->gen == 0 || stats_now_ms() - cur_snap->ms >= max_age) ) {
+		stats_collect( conf, max_age );
+	}
+
+	pthread_rwlock_rdlock( &snap_rwlock );
+	__sync_fetch_and_add( &nreads, 1 );
+	return cur_snap;
+}
+
+extern void stats_snap_put( void ) {
+	pthread_rwlock_unlock( &snap_rwlock );
+}
+
+/*
+	Return the snapshot PF index for the rte port number, or -1.
+*/
+extern int stats_snap_pf( const stats_snap_t* snap, int port ) {
+	int i;
+
+	if( port < 0 || port >= MAX_PORTS ) {
+		return -1;
+	}
+
+	i = snap->pf_six[port];
+	return i < snap->nports ? i : -1;				// nports is 0 until the first sweep
+}
+
+/*
+	Return the snapshot VF index for the rte port number and vf, or -1.
+	A port's VFs are in number order, so this is a binary search.
+*/
+extern int stats_snap_vf( const stats_snap_t* snap, int port, int vf ) {
+	int i;
+	int lo;
+	int hi;
+	int mid;
+
+	if( (i = stats_snap_pf( snap, port )) < 0 ) {
+		return -1;
+	}
+
+	lo = snap->vf_first[i];
+	hi = lo + snap->vf_count[i] - 1;
+	while( lo <= hi ) {
+		mid = (lo + hi) / 2;
+		if( snap->vf_num[mid] == vf ) {
+			return mid;
+		}
+		if( snap->vf_num[mid] < vf ) {
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	return -1;
+}
+
+/*
+	Format the show line for snapshot PF index pidx (the pf line layout show has
+	always used). Returns the length.
+*/
+extern int stats_pf_line( const stats_snap_t* snap, int pidx, char* buf, int blen ) {
+	uint32_t	ari;
+
+	ari = snap->pf_ari[pidx];
+	return snprintf( buf, blen, "%s   %4d    %04X:%02X:%02X.%01X %6s  %6d %6d %15lld %15lld %15lld %15lld %15lld %15lld %15d %15lld\n",
+		"pf",
+		snap->pf_port[pidx],
+		snap->pf_domain[pidx], (ari >> 8) & 0xff, (ari >> 3) & 0x1f, ari & 0x7,
+		snap->pf_link[pidx] ? "UP  " : "DOWN",
+		(int) snap->pf_speed[pidx],
+		(int) snap->pf_duplex[pidx],
+		(long long) snap->pf_ipackets[pidx],
+		(long long) snap->pf_ibytes[pidx],
+		(long long) snap->pf_ierrors[pidx],
+		(long long) snap->pf_imissed[pidx],
+		(long long) snap->pf_opackets[pidx],
+		(long long) snap->pf_obytes[pidx],
+		(int) snap->pf_oerrors[pidx],
+		(long long) snap->pf_spoofed[pidx] );
+}
+
+/*
+	Format the extended stats of snapshot PF index pidx, one "name: value" line
+	each (show ex and dump). Returns the length of the string placed into buf.
+*/
+extern int stats_xs_str( const stats_snap_t* snap, int pidx, char* buf, int blen ) {
+	int	l = 0;
+	int	i;
+
+	*buf = 0;
+	for( i = 0; i < snap->pf_nxs[pidx] && l < blen; i++ ) {
+		l += snprintf( buf + l, blen - l, "%.*s: %"PRIu64"\n", RTE_ETH_XSTATS_NAME_SIZE, snap->pf_xs_name[pidx][i], snap->pf_xs_val[pidx][i] );
+	}
+
+	if( l >= blen ) {
+		l = blen - 1;
+	}
+	return l;
+}
+
+/*
+	Format the show line for snapshot VF index vidx (the layout the old
+	vf_stats_display() used). Returns the length.
+*/
+extern int stats_vf_line( const stats_snap_t* snap, int vidx, char* buf, int blen ) {
+	uint32_t	ari;
+
+	ari = snap->vf_ari[vidx];
+	return snprintf( buf, blen, "%2s %6d    %04X:%02X:%02X.%01X %6s %30"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64" %15"PRIu64"\n",
+		"vf", snap->vf_num[vidx], 0, (ari >> 8) & 0xff, (ari >> 3) & 0x1f, ari & 0x7,
+		snap->vf_up[vidx] ? "UP  " : "DOWN",
+		snap->vf_ipackets[vidx], snap->vf_ibytes[vidx], snap->vf_ierrors[vidx], (uint64_t) 0,
+		snap->vf_opackets[vidx], snap->vf_obytes[vidx], snap->vf_oerrors[vidx], snap->vf_spoofed[vidx] );
+}
+
+/*
+	Fill buf with the engine's own counters. Returns the length of the string placed into buf.
+*/
+extern int stats_engine_str( char* buf, int blen ) {
+	int l;
+
+	pthread_mutex_lock( &collect_lock );
+	l = snprintf( buf, blen, "stats sweeps: %llu  interval: %llu  on-demand: %llu  reads: %llu  last: %.0fms  worst: %.0fms  age: %lldms\n",
+		(unsigned long long) cur_snap->gen, (unsigned long long) nsweeps_ivl, (unsigned long long) nsweeps_demand,
+		(unsigned long long) nreads, sweep_ms, sweep_max_ms,
+		cur_snap->gen ? stats_now_ms() - cur_snap->ms : 0LL );
+	pthread_mutex_unlock( &collect_lock );
+
+	if( l >= blen ) {
+		l = blen - 1;
+	}
+	return l;
+}
+
+/*
+	Create the shared memory segment and publish into it on every sweep. Path
+	is the segment file (the shm_stats parm); nil or empty leaves publishing off.
+	Returns 0 on success. If ivl is not 0 the caller's interval drives sweeps;
+	otherwise the segment is only as fresh as on-demand consumers make it.
+*/
+extern int stats_shm_start( const char* path ) {
+	void*	seg;
+
+	if( path == NULL || *path == 0 ) {
+		return 0;
+	}
+
+	if( (seg = shm_stats_create( path, MAX_PORTS + SNAP_MAX_VFS )) == NULL ) {
+		bleat_printf( 0, "WRN: unable to create shared memory stats segment: %s: %s", path, strerror( errno ) );
+		return -1;
+	}
+
+	pthread_mutex_lock( &collect_lock );
+	shm_seg = seg;
+	if( cur_snap->gen > 0 ) {
+		shm_publish( cur_snap );								// no need to wait for the next sweep
+	}
+	pthread_mutex_unlock( &collect_lock );
+
+	bleat_printf( 1, "shared memory stats published to %s", path );
+	return 0;
+}
+
+/*
+	Stop publishing; the segment is marked stale and removed.
+*/
+extern void stats_shm_stop( void ) {
+	void*	seg;
+
+	pthread_mutex_lock( &collect_lock );
+	seg = shm_seg;
+	shm_seg = NULL;
+	pthread_mutex_unlock( &collect_lock );
+
+	shm_stats_close( seg );
+}
@@ -0,0 +1,301 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	vfd_vlan.c
+	Abstract:	Per-port vlan table. For each vlan id that is in use on a port we keep
+				the set of VFs which have the vlan in their config, and the set that
+				the NIC's filter was last programmed with. VFs join and leave the
+				table as they are added and deleted; the NIC is brought in line by
+				vlan_push() which makes one filter call per direction for each vlan
+				whose membership changed, with the mask of all VFs affected, rather
+				than a call for every vlan of every VF.
+
+				The count of vlan ids in use is what the NIC's shared filter (the
+				VLVF on the niantic) must hold, so admission of a new VF is checked
+				against it.
+
+	Date:		16 Oct 2026
+*/
+
+
+#include <vfdlib.h>		// if vfdlib.h needs an include it must be included there, can't be include prior
+#include "sriov.h"
+
+#define VLAN_IDS	4096
+
+typedef struct vlan_ent {
+	vf_mask_t	vfs;						// VFs which have the vlan in their list
+	vf_mask_t	nic;						// VFs the nic filter was last programmed with
+	int			refs;						// number of VFs in vfs
+	int			dirty;						// set when on the table's dirty list
+} vlan_ent_t;
+
+struct vlan_tab {
+	int			nvlans;						// vlan ids with at least one VF
+	int			ndirty;
+	uint64_t	inuse[VLAN_IDS / 64];		// bit for each vlan id with refs > 0
+	vlan_ent_t*	ents[VLAN_IDS];				// allocated on first reference; freed once no VF and no nic bits remain
+	uint16_t	dirty[VLAN_IDS];			// vlan ids whose vfs and nic sets may differ
+};
+
+// -----------------------------------------------------------------------------------------------------------
+
+/*
+	Return the port's table, allocating it on first use.
+*/
+static struct vlan_tab* vtab_get( struct sriov_port_s* p ) {
+	if( p->vlan_tab == NULL ) {
+		if( (p->vlan_tab = (struct vlan_tab *) calloc( 1, sizeof( *p->vlan_tab ) )) == NULL ) {
+			bleat_printf( 0, "CRI: unable to allocate vlan table for port %d", p->rte_port_number );
+		}
+	}
+
+	return p->vlan_tab;
+}
+
+/*
+	Return the entry for the vlan, creating it if create is set. Nil if the id is
+	out of range or the entry can't be allocated.
+*/
+static vlan_ent_t* vtab_ent( struct vlan_tab* vt, int vlan, int create ) {
+	if( vlan < 0 || vlan >= VLAN_IDS ) {
+		return NULL;
+	}
+
+	if( vt->ents[vlan] == NULL && create ) {
+		if( (vt->ents[vlan] = (vlan_ent_t *) calloc( 1, sizeof( vlan_ent_t ) )) == NULL ) {
+			bleat_printf( 0, "CRI: unable to allocate vlan table entry for vlan %d", vlan );
+		}
+	}
+
+	return vt->ents[vlan];
+}
+
+static void vtab_dirty( struct vlan_tab* vt, vlan_ent_t* e, int vlan ) {
+	if( ! e->dirty ) {
+		e->dirty = 1;
+		vt->dirty[vt->ndirty++] = vlan;
+	}
+}
+
+/*
+	The vlans of VFs on an mlx5 with strip on are handled by the insert/strip
+	settings and never put into the filter, so those VFs don't join the table.
+*/
+static inline int vf_filtered( struct sriov_port_s* p, struct vf_s* vf ) {
+	return p->nic_ops == NULL || p->nic_ops->type != VFD_MLX5 || ! (vf->strip_stag || vf->strip_ctag);
+}
+
+/*
+	Set out = a & ~b; returns true if any bit is left.
+*/
+static inline int vfm_diff( vf_mask_t* out, const vf_mask_t* a, const vf_mask_t* b ) {
+	uint64_t any = 0;
+	int i;
+
+	for( i = 0; i < VF_MASK_WORDS; i++ ) {
+		out->w[i] = a->w[i] & ~b->w[i];
+		any |= out->w[i];
+	}
+
+	return any != 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+
+/*
+	Return the number of distinct vlan ids the NIC can filter for the port's VFs.
+	The driver supplies it when the filter is a shared table; otherwise the
+	historic PF limit applies.
+*/
+extern int vlan_capacity( struct sriov_port_s* p ) {
+	if( p->nic_ops != NULL && p->nic_ops->vlan_filters > 0 ) {
+		return p->nic_ops->vlan_filters;
+	}
+
+	return MAX_PF_VLANS;
+}
+
+/*
+	Return the number of vlan ids in use on the port.
+*/
+extern int vlan_count( struct sriov_port_s* p ) {
+	return p->vlan_tab == NULL ? 0 : p->vlan_tab->nvlans;
+}
+
+/*
+	Return the number of ids in the list which are not yet in use on the port;
+	what adding a VF with the list would add to vlan_count(). The list is
+	assumed to have been checked for range and duplicates.
+*/
+extern int vlan_new_count( struct sriov_port_s* p, const int* vlans, int nvlans ) {
+	int i;
+	int n = 0;
+
+	for( i = 0; i < nvlans; i++ ) {
+		if( p->vlan_tab == NULL || (p->vlan_tab->inuse[vlans[i] >> 6] & (1ULL << (vlans[i] & 63))) == 0 ) {
+			n++;
+		}
+	}
+
+	return n;
+}
+
+/*
+	Add the VF to each of its vlans. Caller must hold the update lock.
+*/
+extern void vlan_join( struct sriov_port_s* p, struct vf_s* vf ) {
+	struct vlan_tab* vt;
+	vlan_ent_t*	e;
+	int		vlan;
+	int		i;
+
+	if( vf->num < 0 || ! vf_filtered( p, vf ) || (vt = vtab_get( p )) == NULL ) {
+		return;
+	}
+
+	for( i = 0; i < vf->num_vlans; i++ ) {
+		vlan = vf->vlans[i];
+		if( (e = vtab_ent( vt, vlan, 1 )) == NULL || VFM_ISSET( &e->vfs, vf->num ) ) {
+			continue;
+		}
+
+		VFM_SET( &e->vfs, vf->num );
+		if( e->refs++ == 0 ) {
+			vt->inuse[vlan >> 6] |= 1ULL << (vlan & 63);
+			vt->nvlans++;
+		}
+		vtab_dirty( vt, e, vlan );
+	}
+}
+
+/*
+	Remove the VF from each of its vlans. Safe to call more than once for a VF.
+	Caller must hold the update lock.
+*/
+extern void vlan_leave( struct sriov_port_s* p, struct vf_s* vf ) {
+	struct vlan_tab* vt;
+	vlan_ent_t*	e;
+	int		vlan;
+	int		i;
+
+	if( vf->num < 0 || (vt = p->vlan_tab) == NULL ) {
+		return;
+	}
+
+	for( i = 0; i < vf->num_vlans; i++ ) {
+		vlan = vf->vlans[i];
+		if( (e = vtab_ent( vt, vlan, 0 )) == NULL || ! VFM_ISSET( &e->vfs, vf->num ) ) {
+			continue;
+		}
+
+		VFM_CLR( &e->vfs, vf->num );
+		if( --e->refs == 0 ) {
+			vt->inuse[vlan >> 6] &= ~(1ULL << (vlan & 63));
+			vt->nvlans--;
+		}
+		vtab_dirty( vt, e, vlan );
+	}
+}
+
+/*
+	The NIC has lost (or may have lost) the VF's filter settings, e.g. after a
+	reset; drop the VF from the programmed sets so the next push writes them.
+	Caller must hold the update lock.
+*/
+extern void vlan_forget( struct sriov_port_s* p, struct vf_s* vf ) {
+	struct vlan_tab* vt;
+	vlan_ent_t*	e;
+	int		vlan;
+	int		i;
+
+	if( vf->num < 0 || (vt = p->vlan_tab) == NULL ) {
+		return;
+	}
+
+	for( i = 0; i < vf->num_vlans; i++ ) {
+		vlan = vf->vlans[i];
+		if( (e = vtab_ent( vt, vlan, 0 )) != NULL && VFM_ISSET( &e->nic, vf->num ) ) {
+			VFM_CLR( &e->nic, vf->num );
+			vtab_dirty( vt, e, vlan );
+		}
+	}
+}
+
+/*
+	Program the NIC for every vlan whose membership changed since the last push:
+	VFs which joined are added with a single call and VFs which left are removed
+	with a single call. The programmed set is updated only for calls which
+	succeed; a vlan with a failed call stays on the dirty list, the port's
+	vlan_pending flag is set, and it is written again by the next push (the
+	housekeeping tick drives one if nothing else does). Returns the number of vlans
+	written. Caller must hold the update lock.
+*/
+extern int vlan_push( struct sriov_port_s* p ) {
+	struct vlan_tab* vt;
+	vlan_ent_t*	e;
+	vf_mask_t	m;
+	int		vlan;
+	int		n = 0;
+	int		ok;
+	int		keep = 0;					// vlans left dirty after a failed write
+	int		d;
+	int		i;
+
+	if( (vt = p->vlan_tab) == NULL ) {
+		return 0;
+	}
+
+	for( d = 0; d < vt->ndirty; d++ ) {
+		vlan = vt->dirty[d];
+		if( (e = vt->ents[vlan]) == NULL ) {
+			continue;
+		}
+		e->dirty = 0;
+		ok = 1;
+
+		if( vfm_diff( &m, &e->vfs, &e->nic ) ) {
+			bleat_printf( 2, "add vlan: port: %d vlan: %d vf mask[0]: 0x%016llx", p->rte_port_number, vlan, (unsigned long long) m.w[0] );
+			if( set_vf_rx_vlan( p->rte_port_number, vlan, &m, SET_ON ) == 0 ) {
+				for( i = 0; i < VF_MASK_WORDS; i++ ) {
+					e->nic.w[i] |= m.w[i];
+				}
+			} else {
+				ok = 0;
+			}
+			n++;
+		}
+		if( vfm_diff( &m, &e->nic, &e->vfs ) ) {
+			bleat_printf( 2, "delete vlan: port: %d vlan: %d vf mask[0]: 0x%016llx", p->rte_port_number, vlan, (unsigned long long) m.w[0] );
+			if( set_vf_rx_vlan( p->rte_port_number, vlan, &m, SET_OFF ) == 0 ) {
+				for( i = 0; i < VF_MASK_WORDS; i++ ) {
+					e->nic.w[i] &= ~m.w[i];
+				}
+			} else {
+				ok = 0;
+			}
+			n++;
+		}
+
+		if( ! ok ) {
+			e->dirty = 1;
+			vt->dirty[keep++] = vlan;				// keep < d+1, so this never overwrites one not yet visited
+			continue;
+		}
+
+		if( e->refs == 0 ) {						// nic set matches the (empty) vf set
+			free( e );
+			vt->ents[vlan] = NULL;
+		}
+	}
+
+	vt->ndirty = keep;
+	p->vlan_pending = keep > 0;					// update_nic visits the port for these even if no VF changes
+	if( keep > 0 ) {
+		bleat_printf( 1, "WRN: vlan push: port %d: %d vlan filter(s) not written; will retry", p->rte_port_number, keep );
+	}
+	if( n > 0 ) {
+		bleat_printf( 2, "vlan push: port %d: %d vlan filters written; %d of %d in use", p->rte_port_number, n, vt->nvlans, vlan_capacity( p ) );
+	}
+	return n;
+}